@@ -2267,6 +2267,24 @@ struct bt_le_scan_cb {
 	void (*recv)(const struct bt_le_scan_recv_info *info,
 		     struct net_buf_simple *buf);
 
+	/**
+	 * @brief Optional filter for advertising reports.
+	 *
+	 * Called for each report before the advertiser address is resolved,
+	 * so @p info->addr is the address as reported by the controller.
+	 * The report is passed to @ref recv only if this returns true. If no
+	 * listener accepts a report and no callback was given to
+	 * @ref bt_le_scan_start, the report is dropped without further
+	 * processing.
+	 *
+	 * @param info Advertiser packet and scan response information.
+	 * @param buf  Buffer containing advertiser data.
+	 *
+	 * @return true to receive the report.
+	 */
+	bool (*accept)(const struct bt_le_scan_recv_info *info,
+		       const struct net_buf_simple *buf);
+
 	/** @brief The scanner has stopped scanning after scan timeout. */
 	void (*timeout)(void);
 
@@ -2439,6 +2457,38 @@ int bt_le_scan_cb_register(struct bt_le_scan_cb *cb);
  */
 void bt_le_scan_cb_unregister(struct bt_le_scan_cb *cb);
 
+/** Advertising report statistics */
+struct bt_le_scan_stats {
+	/** Number of advertising reports received */
+	uint32_t received;
+	/** Reports dropped by the host duplicate filter */
+	uint32_t duplicates;
+	/** Reports dropped because no listener accepted them */
+	uint32_t uninterested;
+	/** Reports delivered to at least one listener */
+	uint32_t delivered;
+};
+
+/**
+ * @brief Get the advertising report statistics.
+ *
+ * @kconfig{CONFIG_BT_SCAN_STATS} must be enabled to make this function
+ * available.
+ *
+ * @param stats Statistics.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int bt_le_scan_stats_get(struct bt_le_scan_stats *stats);
+
+/**
+ * @brief Reset the advertising report statistics.
+ *
+ * @kconfig{CONFIG_BT_SCAN_STATS} must be enabled to make this function
+ * available.
+ */
+void bt_le_scan_stats_reset(void);
+
 /**
  * @brief Add device (LE) to filter accept list.
  *
@@ -20,6 +20,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,6 +39,49 @@ extern "C" {
  */
 int bt_rand(void *buf, size_t len);
 
+/** @brief Generate random data with prediction resistance.
+ *
+ *  Like @ref bt_rand, but with @kconfig{CONFIG_BT_RAND_DRBG} the generator
+ *  is reseeded from the controller before the data is generated, so that
+ *  the output does not depend on the earlier state of the generator. Use
+ *  it for long term secrets.
+ *
+ *  @param buf Buffer to insert the random data
+ *  @param len Length of random data to generate
+ *
+ *  @return Zero on success or error code otherwise, positive in case
+ *  of protocol error or negative (POSIX) in case of stack internal error
+ */
+int bt_rand_pr(void *buf, size_t len);
+
+/** Random number generator statistics */
+struct bt_rand_stats {
+	/** Number of generate requests served */
+	uint32_t requests;
+	/** Number of random bytes generated */
+	uint32_t bytes;
+	/** Number of times the generator was seeded from the controller */
+	uint32_t reseeds;
+	/** Number of HCI_LE_Rand commands sent to seed it */
+	uint32_t hci_cmds;
+};
+
+/** @brief Get the random number generator statistics.
+ *
+ *  @kconfig{CONFIG_BT_RAND_DRBG_STATS} must be enabled to make this
+ *  function available.
+ *
+ *  @param stats Statistics.
+ */
+void bt_rand_stats_get(struct bt_rand_stats *stats);
+
+/** @brief Reset the random number generator statistics.
+ *
+ *  @kconfig{CONFIG_BT_RAND_DRBG_STATS} must be enabled to make this
+ *  function available.
+ */
+void bt_rand_stats_reset(void);
+
 /** @brief AES encrypt little-endian data.
  *
  *  An AES encrypt helper is used to request the Bluetooth controller's own
@@ -68,6 +112,117 @@ int bt_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16],
 int bt_encrypt_be(const uint8_t key[16], const uint8_t plaintext[16],
 		  uint8_t enc_data[16]);
 
+/** @internal Expanded key, private to the implementation */
+struct bt_aes_sched;
+
+/** AES-128 encryption context, see @ref bt_aes_ctx_init. */
+struct bt_aes_ctx {
+	/** @internal Key, as used by the implementation */
+	uint8_t key[16];
+	/** @internal Key and data blocks are LS byte first */
+	bool le;
+#if defined(CONFIG_BT_AES_KEY_SCHEDULE)
+	/** @internal Expanded key held by the context, NULL if none */
+	struct bt_aes_sched *sched;
+#endif
+};
+
+#if defined(CONFIG_BT_AES_CTX)
+/** @brief Set up an AES encryption context.
+ *
+ *  Prepares @p ctx for encrypting any number of blocks with @p key, so that
+ *  work depending only on the key, such as the key expansion, is not
+ *  repeated for every block. Use @ref bt_aes_ctx_clear once done with it.
+ *
+ *  @param ctx Context to set up
+ *  @param key 128 bit key for the encryption
+ *  @param le  The key and all data blocks encrypted with the context are
+ *             LS byte first, as with @ref bt_encrypt_le, instead of MS byte
+ *             first, as with @ref bt_encrypt_be.
+ *
+ *  @return Zero on success or error code otherwise.
+ */
+int bt_aes_ctx_init(struct bt_aes_ctx *ctx, const uint8_t key[16], bool le);
+
+/** @brief AES encrypt data blocks with a context.
+ *
+ *  Encrypts each 16 byte block of @p plaintext independently (ECB), all
+ *  blocks are handed to the implementation at once.
+ *
+ *  @param ctx       Context set up with @ref bt_aes_ctx_init
+ *  @param plaintext Data blocks to be encrypted
+ *  @param enc_data  Encrypted data blocks, may be the same as @p plaintext
+ *  @param blocks    Number of 16 byte blocks
+ *
+ *  @return Zero on success or error code otherwise.
+ */
+int bt_aes_encrypt_many(struct bt_aes_ctx *ctx, const uint8_t *plaintext,
+			uint8_t *enc_data, size_t blocks);
+#else
+static inline int bt_aes_ctx_init(struct bt_aes_ctx *ctx, const uint8_t key[16], bool le)
+{
+	memcpy(ctx->key, key, sizeof(ctx->key));
+	ctx->le = le;
+
+	return 0;
+}
+
+static inline int bt_aes_encrypt_many(struct bt_aes_ctx *ctx, const uint8_t *plaintext,
+				      uint8_t *enc_data, size_t blocks)
+{
+	for (size_t i = 0; i < blocks * 16; i += 16) {
+		int err;
+
+		if (ctx->le) {
+			err = bt_encrypt_le(ctx->key, &plaintext[i], &enc_data[i]);
+		} else {
+			err = bt_encrypt_be(ctx->key, &plaintext[i], &enc_data[i]);
+		}
+
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+#endif /* CONFIG_BT_AES_CTX */
+
+/** @brief AES encrypt a single data block with a context.
+ *
+ *  @param ctx       Context set up with @ref bt_aes_ctx_init
+ *  @param plaintext 128 bit data block to be encrypted
+ *  @param enc_data  128 bit encrypted data block
+ *
+ *  @return Zero on success or error code otherwise.
+ */
+static inline int bt_aes_encrypt(struct bt_aes_ctx *ctx, const uint8_t plaintext[16],
+				 uint8_t enc_data[16])
+{
+	return bt_aes_encrypt_many(ctx, plaintext, enc_data, 1);
+}
+
+#if defined(CONFIG_BT_AES_CTX)
+/** @brief Wipe the key material from an AES encryption context.
+ *
+ *  Also releases what the implementation holds for the context. A context
+ *  must be cleared before it is set up again with another key.
+ *
+ *  @param ctx Context to clear
+ */
+void bt_aes_ctx_clear(struct bt_aes_ctx *ctx);
+#else
+static inline void bt_aes_ctx_clear(struct bt_aes_ctx *ctx)
+{
+	/* Keep the compiler from dropping the wipe of a dead object */
+	volatile uint8_t *p = (volatile uint8_t *)ctx;
+
+	for (size_t i = 0; i < sizeof(*ctx); i++) {
+		p[i] = 0U;
+	}
+}
+#endif /* CONFIG_BT_AES_CTX */
+
 
 /** @brief Decrypt big-endian data with AES-CCM.
  *
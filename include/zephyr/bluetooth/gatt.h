@@ -1224,6 +1224,16 @@ struct bt_gatt_notify_params {
 #if defined(CONFIG_BT_EATT)
 	enum bt_att_chan_opt chan_opt;
 #endif /* CONFIG_BT_EATT */
+#if defined(CONFIG_BT_GATT_NOTIFY_SHARED)
+	/** @brief Per subscriber result callback
+	 *
+	 *  Optional, called by @ref bt_gatt_notify_cb when notifying all
+	 *  subscribers, once for every subscribed connection, with 0 if the
+	 *  notification was queued or a negative error. -ENOMEM means the
+	 *  connection is backed up, the notification was not sent to it.
+	 */
+	void (*result)(struct bt_conn *conn, int err, void *user_data);
+#endif /* CONFIG_BT_GATT_NOTIFY_SHARED */
 };
 
 /** @brief Notify attribute value change.
@@ -1242,6 +1252,11 @@ struct bt_gatt_notify_params {
  *  parameters, when using this method the attribute if provided is used as the
  *  start range when looking up for possible matches.
  *
+ *  With @kconfig{CONFIG_BT_GATT_NOTIFY_SHARED}, notifying all subscribers
+ *  (@p conn is NULL) does not wait for buffers: a subscriber that is backed
+ *  up is skipped and reported through the result callback of @p params, the
+ *  others are still notified. 0 is returned if any subscriber was notified.
+ *
  *  @param conn Connection object.
  *  @param params Notification parameters.
  *
@@ -1305,6 +1320,54 @@ int bt_gatt_notify_multiple(struct bt_conn *conn,
 			    uint16_t num_params,
 			    struct bt_gatt_notify_params params[]);
 
+/** Send a batch as soon as another value of the same size would not fit */
+#define BT_GATT_NOTIFY_MULT_FLUSH_FULL BIT(0)
+/** Send a batch as soon as nothing else is in flight on the connection */
+#define BT_GATT_NOTIFY_MULT_FLUSH_IDLE BIT(1)
+
+/** @brief Batching policy of ATT_MULTIPLE_HANDLE_VALUE_NTF PDUs.
+ *
+ *  When the peer supports Multiple Handle Value Notifications,
+ *  `bt_gatt_notify_cb` appends notifications to a pending PDU of the
+ *  connection instead of sending them one by one. The PDU is sent when the
+ *  next notification does not fit, once the latency budget has expired, or
+ *  earlier as selected by @p flags.
+ */
+struct bt_gatt_notify_mult_policy {
+	/** Longest time a notification is held back, in milliseconds.
+	 *  0 disables batching.
+	 */
+	uint16_t latency_ms;
+	/** BT_GATT_NOTIFY_MULT_FLUSH_* flags */
+	uint8_t flags;
+};
+
+/** @brief Set the batching policy of notifications.
+ *
+ *  A notification held back under the previous policy is sent right away.
+ *  Defaults come from @kconfig{CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_MS},
+ *  @kconfig{CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_FULL} and
+ *  @kconfig{CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_IDLE}.
+ *
+ *  @param conn Connection object, or NULL to set the policy of all
+ *              connections, including those established later.
+ *  @param policy Batching policy.
+ *
+ *  @return 0 in case of success or negative value in case of error.
+ */
+int bt_gatt_notify_mult_policy_set(struct bt_conn *conn,
+				   const struct bt_gatt_notify_mult_policy *policy);
+
+/** @brief Get the batching policy of notifications.
+ *
+ *  @param conn Connection object, or NULL for the default policy.
+ *  @param policy Batching policy.
+ *
+ *  @return 0 in case of success or negative value in case of error.
+ */
+int bt_gatt_notify_mult_policy_get(struct bt_conn *conn,
+				   struct bt_gatt_notify_mult_policy *policy);
+
 /** @brief Notify attribute value change.
  *
  *  Send notification of attribute value change, if connection is NULL notify
@@ -211,6 +211,62 @@ int bt_hci_register_vnd_evt_cb(bt_hci_vnd_evt_cb_t cb);
  */
 int bt_hci_le_rand(void *buffer, size_t len);
 
+/** Types of incoming HCI packets queued for the host RX context */
+enum bt_hci_rx_type {
+	/** ISO data */
+	BT_HCI_RX_ISO,
+	/** ACL data */
+	BT_HCI_RX_ACL,
+	/** Events */
+	BT_HCI_RX_EVT,
+
+	BT_HCI_RX_NUM,
+};
+
+/** Statistics of the queue of one type of incoming HCI packets */
+struct bt_hci_rx_queue_stats {
+	/** Number of packets taken from the queue */
+	uint32_t pkts;
+	/** Number of packets currently queued */
+	uint16_t depth;
+	/** Largest number of packets queued at once */
+	uint16_t max_depth;
+	/** Number of packets with a measured time in queue */
+	uint32_t timed;
+	/** Sum of the times in queue of those packets, in microseconds */
+	uint64_t total_wait_us;
+	/** Longest time in queue, in microseconds */
+	uint32_t max_wait_us;
+};
+
+/** Host HCI receive statistics */
+struct bt_hci_rx_stats {
+	/** Per packet type statistics, indexed by @ref bt_hci_rx_type */
+	struct bt_hci_rx_queue_stats queue[BT_HCI_RX_NUM];
+	/** Number of runs of the RX work */
+	uint32_t runs;
+};
+
+/** @brief Get the host HCI receive statistics
+ *
+ *  @kconfig{CONFIG_BT_RECV_STATS} must be enabled to make this function
+ *  available.
+ *
+ *  @param stats Statistics.
+ *
+ *  @return Zero on success or (negative) error code otherwise.
+ */
+int bt_hci_rx_stats_get(struct bt_hci_rx_stats *stats);
+
+/** @brief Reset the host HCI receive statistics
+ *
+ *  Queue depths are kept, since they describe packets still queued.
+ *
+ *  @kconfig{CONFIG_BT_RECV_STATS} must be enabled to make this function
+ *  available.
+ */
+void bt_hci_rx_stats_reset(void);
+
 
 #ifdef __cplusplus
 }
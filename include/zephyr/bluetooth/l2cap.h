@@ -24,6 +24,7 @@
 #include <zephyr/bluetooth/buf.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/tx_sched.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -196,9 +197,29 @@ struct bt_l2cap_le_chan {
 	/** Segment SDU packet from upper layer */
 	struct net_buf			*_sdu;
 	uint16_t			_sdu_len;
-#if defined(CONFIG_BT_L2CAP_SEG_RECV)
+#if defined(CONFIG_BT_L2CAP_SEG_RECV) || defined(CONFIG_BT_L2CAP_RX_POST)
 	uint16_t			_sdu_len_done;
-#endif /* CONFIG_BT_L2CAP_SEG_RECV */
+#endif /* CONFIG_BT_L2CAP_SEG_RECV || CONFIG_BT_L2CAP_RX_POST */
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+	/** @internal Buffers posted with @ref bt_l2cap_chan_rx_post */
+	sys_slist_t			_rx_bufs;
+	/** @internal K-frame waiting for buffers to be posted */
+	struct net_buf			*_rx_held;
+#endif /* CONFIG_BT_L2CAP_RX_POST */
+#if defined(CONFIG_BT_L2CAP_CREDIT_TUNING)
+	/** @internal Credits given and not yet given back by a consumed K-frame */
+	uint16_t			_rx_committed;
+	/** @internal ACL RX buffers committed per credit */
+	uint16_t			_rx_cost;
+	/** @internal Credits the remote is meant to hold */
+	uint16_t			_rx_target;
+	/** @internal K-frames consumed in the current measurement window */
+	uint16_t			_rx_drained;
+	/** @internal Start of the measurement window, in milliseconds */
+	uint32_t			_rx_drain_start;
+	/** @internal Drain rate, in K-frames per second */
+	uint32_t			_rx_drain_rate;
+#endif /* CONFIG_BT_L2CAP_CREDIT_TUNING */
 
 	struct k_work			rx_work;
 	struct k_fifo			rx_queue;
@@ -221,6 +242,10 @@ struct bt_l2cap_le_chan {
 	atomic_t			_pdu_ready_lock;
 	/** @internal Holds the length of the current PDU/segment */
 	size_t				_pdu_remaining;
+#if defined(CONFIG_BT_TX_SCHED)
+	/** @internal TX QoS and scheduler state */
+	struct bt_tx_sched_entity	_tx_sched;
+#endif /* CONFIG_BT_TX_SCHED */
 };
 
 /**
@@ -272,6 +297,22 @@ struct bt_l2cap_br_chan {
 	struct k_fifo			_pdu_tx_queue;
 };
 
+/** @brief L2CAP receive buffer
+ *
+ *  Memory posted to a channel with @ref bt_l2cap_chan_rx_post, for
+ *  channels using @ref bt_l2cap_chan_ops.rx_done.
+ */
+struct bt_l2cap_rx_buf {
+	/** @internal Node in the list of buffers posted to the channel */
+	sys_snode_t node;
+	/** Memory the received data is written to */
+	uint8_t *data;
+	/** Size of @ref bt_l2cap_rx_buf.data */
+	size_t size;
+	/** Number of bytes written, set by the stack */
+	size_t len;
+};
+
 /** @brief L2CAP Channel operations structure.
  *
  * The object has to stay valid and constant for the lifetime of the channel.
@@ -347,7 +388,12 @@ struct bt_l2cap_chan_ops {
 	 *
 	 *  @note This callback is mandatory, unless
 	 *  @kconfig{CONFIG_BT_L2CAP_SEG_RECV} is enabled and seg_recv is
-	 *  supplied.
+	 *  supplied, or @kconfig{CONFIG_BT_L2CAP_RX_POST} is enabled and
+	 *  rx_done is supplied.
+	 *
+	 *  @note With @kconfig{CONFIG_BT_CONN_RX_FRAG_CHAIN} and no alloc_buf
+	 *  callback, @p buf of a dynamic channel may be a chain of fragments,
+	 *  see net_buf_frags_len() and net_buf_linearize().
 	 *
 	 *  If the application returns @c -EINPROGRESS, the application takes
 	 *  ownership of the reference in @p buf. (I.e. This pointer value can
@@ -437,6 +483,41 @@ struct bt_l2cap_chan_ops {
 	void (*seg_recv)(struct bt_l2cap_chan *chan, size_t sdu_len,
 			 off_t seg_offset, struct net_buf_simple *seg);
 #endif /* CONFIG_BT_L2CAP_SEG_RECV */
+
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+	/** @brief Receive SDUs into posted buffers
+	 *
+	 *  This is an alternative to @ref bt_l2cap_chan_ops.recv and
+	 *  @ref bt_l2cap_chan_ops.seg_recv. Only one of them can be set.
+	 *
+	 *  SDUs are written to the buffers posted with
+	 *  @ref bt_l2cap_chan_rx_post, in the order they were posted. Each SDU
+	 *  starts at the beginning of a buffer and continues in the next ones
+	 *  if it does not fit, so every byte lands at its final offset and an
+	 *  SDU that fits a buffer is received contiguously. This is called
+	 *  when a buffer is full or the SDU ends in it, handing the buffer back
+	 *  to the application.
+	 *
+	 *  Flow control follows the posted buffers: the remote is only given
+	 *  the credits they can take whatever it sends. Once the first K-frame
+	 *  of an SDU has given its length, the rest of it is granted the
+	 *  K-frames of the MPS it needs, as far as the buffers hold it. Beyond
+	 *  that every K-frame is counted as a full MPS that ends an SDU, losing
+	 *  the rest of the buffer it ends in, so a buffer takes one K-frame, or
+	 *  its share of one when it is smaller than the MPS. Posting a buffer
+	 *  again once its data is consumed gives the credits back. Buffers of
+	 *  the MPS, or of the SDU size for SDUs of a single K-frame, waste the
+	 *  least.
+	 *
+	 *  The stack guarantees that the SDU length does not exceed MTU and
+	 *  that the K-frames add up to it.
+	 *
+	 *  @param chan The receiving channel.
+	 *  @param buf The buffer, holding @p buf->len bytes of the SDU.
+	 *  @param sdu_end The SDU ends in this buffer.
+	 */
+	void (*rx_done)(struct bt_l2cap_chan *chan, struct bt_l2cap_rx_buf *buf, bool sdu_end);
+#endif /* CONFIG_BT_L2CAP_RX_POST */
 };
 
 /**
@@ -663,6 +744,29 @@ int bt_l2cap_chan_send(struct bt_l2cap_chan *chan, struct net_buf *buf);
  */
 int bt_l2cap_chan_give_credits(struct bt_l2cap_chan *chan, uint16_t additional_credits);
 
+/** @brief Post a receive buffer to a channel
+ *
+ *  Only available for channels using @ref bt_l2cap_chan_ops.rx_done.
+ *  @kconfig{CONFIG_BT_L2CAP_RX_POST} must be enabled to make this function
+ *  available.
+ *
+ *  The buffer belongs to the stack until it is handed back by
+ *  @ref bt_l2cap_chan_ops.rx_done or the channel is disconnected. Buffers
+ *  can be posted before the channel is connected, for instance from the
+ *  server's accept callback, they then set the initial credits.
+ *
+ *  This function depends on a valid @p chan object. Make sure to
+ *  default-initialize or memset @p chan when allocating or reusing it for new
+ *  connections.
+ *
+ *  @param chan Channel object.
+ *  @param buf Buffer, with @p buf->data and @p buf->size set.
+ *
+ *  @return 0 in case of success or negative value in case of error.
+ *  @return -EINVAL if @p chan does not use rx_done or @p buf has no space.
+ */
+int bt_l2cap_chan_rx_post(struct bt_l2cap_chan *chan, struct bt_l2cap_rx_buf *buf);
+
 /** @brief Complete receiving L2CAP channel data
  *
  * Complete the reception of incoming data. This shall only be called if the
@@ -678,6 +782,72 @@ int bt_l2cap_chan_give_credits(struct bt_l2cap_chan *chan, uint16_t additional_c
 int bt_l2cap_chan_recv_complete(struct bt_l2cap_chan *chan,
 				struct net_buf *buf);
 
+/** L2CAP receive statistics */
+struct bt_l2cap_rx_stats {
+	/** Number of SDUs handed to channels */
+	uint32_t sdus;
+	/** Sum of the lengths of those SDUs */
+	uint64_t bytes;
+	/** Number of received bytes the host copied on the way */
+	uint64_t copied;
+};
+
+/** @brief Get the L2CAP receive statistics
+ *
+ *  @kconfig{CONFIG_BT_L2CAP_RX_STATS} must be enabled to make this function
+ *  available.
+ *
+ *  @param stats Statistics.
+ *
+ *  @return Zero on success or (negative) error code otherwise.
+ */
+int bt_l2cap_rx_stats_get(struct bt_l2cap_rx_stats *stats);
+
+/** @brief Reset the L2CAP receive statistics
+ *
+ *  @kconfig{CONFIG_BT_L2CAP_RX_STATS} must be enabled to make this function
+ *  available.
+ */
+void bt_l2cap_rx_stats_reset(void);
+
+/** L2CAP credit auto-tuning statistics */
+struct bt_l2cap_credit_stats {
+	/** Number of LE Flow Control Credit PDUs sent by tuned channels */
+	uint32_t pdus;
+	/** Credits given in those PDUs */
+	uint32_t credits;
+	/** Grants made once the remote had run out of credits */
+	uint32_t starved;
+	/** Grants cut short by the free ACL RX buffers */
+	uint32_t pool_limited;
+	/** Highest credit target of a channel */
+	uint16_t target_max;
+	/** Highest drain rate measured on a channel, in K-frames per second */
+	uint32_t rate_max;
+	/** ACL RX buffers committed to credits not yet consumed */
+	uint32_t bufs;
+	/** Highest number of ACL RX buffers committed to credits */
+	uint32_t bufs_max;
+};
+
+/** @brief Get the L2CAP credit auto-tuning statistics
+ *
+ *  @kconfig{CONFIG_BT_L2CAP_CREDIT_TUNING} must be enabled to make this
+ *  function available.
+ *
+ *  @param stats Statistics.
+ *
+ *  @return Zero on success or (negative) error code otherwise.
+ */
+int bt_l2cap_credit_stats_get(struct bt_l2cap_credit_stats *stats);
+
+/** @brief Reset the L2CAP credit auto-tuning statistics
+ *
+ *  @kconfig{CONFIG_BT_L2CAP_CREDIT_TUNING} must be enabled to make this
+ *  function available.
+ */
+void bt_l2cap_credit_stats_reset(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,180 @@
+/** @file
+ *  @brief Bluetooth TX scheduler API
+ */
+
+/*
+ * Copyright (c) 2024 Xiaomi Corporation
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ZEPHYR_INCLUDE_BLUETOOTH_TX_SCHED_H_
+#define ZEPHYR_INCLUDE_BLUETOOTH_TX_SCHED_H_
+
+/**
+ * @brief TX scheduler
+ * @defgroup bt_tx_sched TX scheduler
+ * @ingroup bluetooth
+ * @{
+ *
+ * The host keeps a ready list of connections with data to send, and per ACL
+ * connection a ready list of L2CAP channels. Whenever the TX processor needs
+ * the next connection, or the next channel to start a PDU on, it asks the
+ * active scheduler to pick one of the ready entries. Fragments of a PDU that
+ * has been started are always sent before switching channels.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/slist.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bt_conn;
+struct bt_l2cap_chan;
+
+/** TX quality of service parameters of a connection or an L2CAP channel */
+struct bt_tx_qos {
+	/** Strict priority class, 0 is served first */
+	uint8_t prio;
+	/** Share of the link relative to the others in the class, 0 counts as 1 */
+	uint8_t weight;
+	/** Latency hint in milliseconds, 0 for none */
+	uint16_t latency_ms;
+};
+
+/** Scheduling state of a connection or an L2CAP channel */
+struct bt_tx_sched_entity {
+	/** QoS parameters */
+	struct bt_tx_qos qos;
+	/** Virtual time, owned by the scheduler */
+	uint32_t vtime;
+	/** Tick at which the entity last started waiting to be served */
+	uint32_t ready_since;
+	/** Set when the entity joins a ready list, the scheduler may clear it */
+	bool fresh;
+};
+
+/** @brief Iterator over the entities of a ready list
+ *
+ *  Entities are returned in the order they became ready. The iterator may be
+ *  copied to walk the list more than once.
+ */
+struct bt_tx_sched_iter {
+	/** @internal Next list node */
+	sys_snode_t *node;
+	/** @internal Offset from the list node to the entity */
+	ptrdiff_t offset;
+};
+
+/** @brief Get the next entity of a ready list
+ *
+ *  @param it Iterator.
+ *
+ *  @return Next entity or NULL at the end of the list.
+ */
+static inline struct bt_tx_sched_entity *bt_tx_sched_iter_next(struct bt_tx_sched_iter *it)
+{
+	sys_snode_t *node = it->node;
+
+	if (node == NULL) {
+		return NULL;
+	}
+
+	it->node = sys_slist_peek_next_no_check(node);
+
+	return (struct bt_tx_sched_entity *)((uint8_t *)node + it->offset);
+}
+
+/** TX scheduler */
+struct bt_tx_sched {
+	/** @brief Pick the entity to serve next
+	 *
+	 *  Called from the TX processor with a non-empty ready list.
+	 *
+	 *  @param it Iterator over the ready entities.
+	 *
+	 *  @return One of the entities of @p it.
+	 */
+	struct bt_tx_sched_entity *(*select)(struct bt_tx_sched_iter *it);
+
+	/** @brief Account for data sent by an entity
+	 *
+	 *  @param entity Entity that was served.
+	 *  @param len Number of bytes charged to it.
+	 */
+	void (*sent)(struct bt_tx_sched_entity *entity, size_t len);
+};
+
+/** Round robin in the order entities became ready, the default */
+extern const struct bt_tx_sched bt_tx_sched_rr;
+
+/** @brief Strict priority classes with weighted fair queuing inside a class
+ *
+ *  Within a class, an entity that has waited longer than its latency hint
+ *  is served before the others, earliest deadline first.
+ */
+extern const struct bt_tx_sched bt_tx_sched_qos;
+
+/** Per priority class latency statistics */
+struct bt_tx_sched_stats {
+	/** Number of times an entity of the class was served */
+	uint32_t count;
+	/** Sum of the waits in microseconds */
+	uint64_t total_us;
+	/** Longest wait in microseconds */
+	uint32_t max_us;
+};
+
+/** @brief Set the TX scheduler
+ *
+ *  @param sched Scheduler, NULL for @ref bt_tx_sched_rr.
+ */
+void bt_tx_sched_set(const struct bt_tx_sched *sched);
+
+/** @brief Set the TX QoS parameters of a connection
+ *
+ *  @param conn Connection object.
+ *  @param qos QoS parameters.
+ *
+ *  @return Zero on success or (negative) error code otherwise.
+ */
+int bt_tx_sched_conn_qos_set(struct bt_conn *conn, const struct bt_tx_qos *qos);
+
+/** @brief Set the TX QoS parameters of an LE L2CAP channel
+ *
+ *  Can be called from the server accept callback, before the channel is
+ *  connected.
+ *
+ *  @param chan Channel object, embedded in a @ref bt_l2cap_le_chan.
+ *  @param qos QoS parameters.
+ *
+ *  @return Zero on success or (negative) error code otherwise.
+ */
+int bt_tx_sched_chan_qos_set(struct bt_l2cap_chan *chan, const struct bt_tx_qos *qos);
+
+/** @brief Get the latency statistics of a priority class
+ *
+ *  @param prio Priority class.
+ *  @param stats Statistics.
+ *
+ *  @return Zero on success or (negative) error code otherwise.
+ */
+int bt_tx_sched_stats_get(uint8_t prio, struct bt_tx_sched_stats *stats);
+
+/** @brief Reset the latency statistics of all priority classes */
+void bt_tx_sched_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ZEPHYR_INCLUDE_BLUETOOTH_TX_SCHED_H_ */
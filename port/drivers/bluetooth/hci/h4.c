@@ -29,6 +29,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <poll.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 #include <limits.h>
 #include <pthread.h>
@@ -45,10 +47,82 @@ LOG_MODULE_REGISTER(bt_driver);
 
 #define DT_DRV_COMPAT zephyr_bt_hci_ttyHCI
 
+#if defined(CONFIG_BT_H4_RX_LATENCY_STATS)
+/* Bucket n counts packets delivered within [2^(n-1), 2^n) microseconds */
+#define H4_RX_LATENCY_BUCKETS 16
+
+struct h4_rx_latency {
+	uint32_t hist[H4_RX_LATENCY_BUCKETS];
+	uint32_t count;
+	uint32_t max_us;
+	uint64_t total_us;
+};
+#endif
+
+/* Most packets are a single buffer, leave room for one fragment on average */
+#define H4_TX_IOV_MAX (CONFIG_BT_H4_TX_BATCH_MAX * 2)
+
+#if defined(CONFIG_BT_H4_TX_STATS)
+struct h4_tx_stats {
+	uint32_t syscalls;
+	uint32_t packets;
+	uint32_t batches;
+	uint32_t max_batch;
+	uint64_t bytes;
+};
+#endif
+
+/* A packet waiting on the TX queue. It lives on its sender's stack, the
+ * sender waits until whoever drains the queue has written the packet.
+ */
+struct h4_tx_req {
+	void *fifo_reserved;
+	struct net_buf *buf;
+	struct k_sem done;
+	/* Result of writing the packet */
+	int err;
+};
+
+enum h4_rx_state {
+	H4_RX_TYPE,
+	H4_RX_HDR,
+	H4_RX_PAYLOAD,
+	H4_RX_DISCARD,
+};
+
+struct h4_rx {
+	enum h4_rx_state state;
+	uint8_t type;
+	/* Largest header, or an event header followed by the LE subevent */
+	uint8_t hdr[BT_HCI_ISO_HDR_SIZE];
+	uint8_t hdr_len;
+	uint8_t hdr_read;
+	struct net_buf *buf;
+	size_t remaining;
+#if defined(CONFIG_BT_H4_RX_LATENCY_STATS)
+	/* When the RX thread last started waiting for the UART */
+	uint64_t ready_us;
+#endif
+};
+
 struct h4_data {
 	int fd;
+	/* Self-pipe used to wake the RX thread out of poll() on close */
+	int wakeup[2];
+	bool shutdown;
 	pthread_mutex_t mutex;
 	bt_hci_recv_t recv;
+	struct h4_rx rx;
+	struct k_sem rx_exit;
+	struct k_fifo tx_queue;
+	/* Packets taken off the TX queue that could not be written */
+	uint32_t tx_dropped;
+#if defined(CONFIG_BT_H4_RX_LATENCY_STATS)
+	struct h4_rx_latency latency;
+#endif
+#if defined(CONFIG_BT_H4_TX_STATS)
+	struct h4_tx_stats tx_stats;
+#endif
 };
 
 #define HCI_DEBUG 0
@@ -70,41 +144,184 @@ static void h4_data_dump(const char *tag, uint8_t type, uint8_t *data, uint32_t
 #endif
 }
 
-static int h4_send_data(struct h4_data *h4, uint8_t *buf, size_t count)
+static int h4_wait_writable(struct h4_data *h4)
+{
+	struct pollfd pollfd = { .fd = h4->fd, .events = POLLOUT };
+
+	if (poll(&pollfd, 1, -1) < 0 && errno != EINTR) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+#if defined(CONFIG_BT_H4_TX_STATS)
+static void h4_tx_stats_dump(struct h4_data *h4)
+{
+	struct h4_tx_stats *stats = &h4->tx_stats;
+
+	if (stats->syscalls == 0) {
+		return;
+	}
+
+	LOG_INF("TX: %u pkts %llu bytes in %u batches, %u syscalls, max batch %u",
+		stats->packets, stats->bytes, stats->batches, stats->syscalls,
+		stats->max_batch);
+}
+#endif /* CONFIG_BT_H4_TX_STATS */
+
+/**
+ * @brief Write an I/O vector to the UART completely
+ * @details Partial writes advance the vector in place, so @p iov is
+ *          clobbered on return.
+ * @return 0 on success, a negative errno on failure.
+ */
+static int h4_writev(struct h4_data *h4, struct iovec *iov, int iovcnt)
 {
-	ssize_t ret, nwritten = 0;
+	ssize_t ret;
 
-	while (nwritten != count) {
-		ret = write(h4->fd, buf + nwritten, count - nwritten);
+	while (iovcnt > 0) {
+		ret = writev(h4->fd, iov, iovcnt);
+#if defined(CONFIG_BT_H4_TX_STATS)
+		h4->tx_stats.syscalls++;
+#endif
 		if (ret < 0) {
-			if (ret == -EAGAIN) {
-				usleep(500);
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN) {
+				ret = h4_wait_writable(h4);
+				if (ret < 0) {
+					return ret;
+				}
 				continue;
 			} else {
-				return ret;
+				return -errno;
 			}
 		}
 
-		nwritten += ret;
+#if defined(CONFIG_BT_H4_TX_STATS)
+		h4->tx_stats.bytes += ret;
+#endif
+
+		while (iovcnt > 0 && ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base = (uint8_t *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
 	}
 
-	return nwritten;
+	return 0;
 }
 
-static struct net_buf *get_rx(const uint8_t *buf)
+/**
+ * @brief Hand a packet's result back to its sender
+ * @details The request may be gone once its sender is woken, so it is not
+ *          touched afterwards. Written packets belong to the driver, a
+ *          packet that failed stays with the sender as bt_send() expects.
+ */
+static void h4_tx_complete(struct h4_tx_req *req, int err)
 {
+	if (err) {
+		/* Take the H:4 packet type off again */
+		net_buf_pull_u8(req->buf);
+	} else {
+		net_buf_unref(req->buf);
+	}
+
+	req->err = err;
+	k_sem_give(&req->done);
+}
+
+/**
+ * @brief Write out queued packets, gathering them into as few writev() as possible
+ * @details Must be called with the TX mutex held. Every fragment of up to
+ *          CONFIG_BT_H4_TX_BATCH_MAX packets is written with a single writev().
+ *          On a write failure the packets of the batch are dropped and
+ *          counted, and each of their senders gets the error.
+ * @return Number of packets taken off the queue.
+ */
+static int h4_tx_drain(struct h4_data *h4)
+{
+	struct iovec iov[H4_TX_IOV_MAX];
+	struct h4_tx_req *batch[CONFIG_BT_H4_TX_BATCH_MAX];
+	struct h4_tx_req *req;
+	int nbufs = 0;
+	int iovcnt = 0;
+	int err = 0;
+
+	while (nbufs < ARRAY_SIZE(batch) &&
+	       (req = k_fifo_get(&h4->tx_queue, K_NO_WAIT)) != NULL) {
+		batch[nbufs++] = req;
+
+		for (struct net_buf *frag = req->buf; frag != NULL; frag = frag->frags) {
+			if (frag->len == 0) {
+				continue;
+			}
+
+			if (iovcnt == ARRAY_SIZE(iov)) {
+				if (!err) {
+					err = h4_writev(h4, iov, iovcnt);
+				}
+				iovcnt = 0;
+			}
+
+			iov[iovcnt].iov_base = frag->data;
+			iov[iovcnt].iov_len = frag->len;
+			iovcnt++;
+		}
+	}
+
+	if (iovcnt > 0 && !err) {
+		err = h4_writev(h4, iov, iovcnt);
+	}
+
+	if (err) {
+		h4->tx_dropped += nbufs;
+		LOG_ERR("Writing %d packets failed (err %d), %u dropped so far", nbufs, err,
+			h4->tx_dropped);
+	}
+
+#if defined(CONFIG_BT_H4_TX_STATS)
+	if (nbufs > 0) {
+		h4->tx_stats.packets += nbufs;
+		h4->tx_stats.batches++;
+		h4->tx_stats.max_batch = MAX(h4->tx_stats.max_batch, nbufs);
+	}
+#endif
+
+	for (int i = 0; i < nbufs; i++) {
+		h4_tx_complete(batch[i], err);
+	}
+
+	return nbufs;
+}
+
+/**
+ * @brief Allocate a receive buffer for an HCI packet
+ * @param type	H4 packet type
+ * @param hdr	HCI packet header, for LE Meta events followed by the subevent
+ * @return Buffer to receive the packet into, NULL if it should be discarded.
+ */
+static struct net_buf *get_rx(uint8_t type, const uint8_t *hdr)
+{
+	const struct bt_hci_evt_hdr *evt = (const struct bt_hci_evt_hdr *)hdr;
 	bool discardable = false;
 	k_timeout_t timeout = K_FOREVER;
 
-	switch (buf[0]) {
+	switch (type) {
 	case BT_HCI_H4_EVT:
-		if (buf[1] == BT_HCI_EVT_LE_META_EVENT &&
-		    (buf[3] == BT_HCI_EVT_LE_ADVERTISING_REPORT)) {
+		if (evt->evt == BT_HCI_EVT_LE_META_EVENT && evt->len > 0 &&
+		    hdr[BT_HCI_EVT_HDR_SIZE] == BT_HCI_EVT_LE_ADVERTISING_REPORT) {
 			discardable = true;
 			timeout = K_NO_WAIT;
 		}
 
-		return bt_buf_get_evt(buf[1], discardable, timeout);
+		return bt_buf_get_evt(evt->evt, discardable, timeout);
 	case BT_HCI_H4_ACL:
 		return bt_buf_get_rx(BT_BUF_ACL_IN, K_FOREVER);
 	case BT_HCI_H4_ISO:
@@ -113,222 +330,360 @@ static struct net_buf *get_rx(const uint8_t *buf)
 		}
 		__fallthrough;
 	default:
-		LOG_ERR("Unknown packet type: %u", buf[0]);
+		LOG_ERR("Unknown packet type: %u", type);
 	}
 
 	return NULL;
 }
 
 /**
- * @brief Decode the length of an HCI H4 packet and check it's complete
- * @details Decodes packet length according to Bluetooth spec v5.4 Vol 4 Part E
- * @param buf	Pointer to a HCI packet buffer
- * @param buf_len	Bytes available in the buffer
- * @return Length of the complete HCI packet in bytes, -1 if cannot find an HCI
- *         packet, 0 if more data required.
+ * @brief Get the header length of an HCI H4 packet
+ * @param type	H4 packet type
+ * @return Header length in bytes, 0 if the packet type is invalid.
  */
-static int32_t hci_packet_complete(const uint8_t *buf, uint16_t buf_len)
+static uint8_t h4_hdr_len(uint8_t type)
 {
-	uint16_t payload_len = 0;
-	const uint8_t type = buf[0];
-	uint8_t header_len = sizeof(type);
-	const uint8_t *hdr = &buf[sizeof(type)];
-
 	switch (type) {
-	case BT_HCI_H4_CMD: {
-		if (buf_len < header_len + BT_HCI_CMD_HDR_SIZE) {
-			return 0;
-		}
-		const struct bt_hci_cmd_hdr *cmd = (const struct bt_hci_cmd_hdr *)hdr;
+	case BT_HCI_H4_ACL:
+		return BT_HCI_ACL_HDR_SIZE;
+	case BT_HCI_H4_SCO:
+		return BT_HCI_SCO_HDR_SIZE;
+	case BT_HCI_H4_EVT:
+		return BT_HCI_EVT_HDR_SIZE;
+	case BT_HCI_H4_ISO:
+		return BT_HCI_ISO_HDR_SIZE;
+	default:
+		return 0;
+	}
+}
 
+/**
+ * @brief Decode the payload length of an HCI H4 packet
+ * @details Decodes packet length according to Bluetooth spec v5.4 Vol 4 Part E
+ * @param type	H4 packet type
+ * @param hdr	Complete HCI packet header
+ * @return Length of the payload following the header in bytes.
+ */
+static size_t h4_payload_len(uint8_t type, const uint8_t *hdr)
+{
+	switch (type) {
+	case BT_HCI_H4_ACL:
+		/* Data Total Length */
+		return sys_le16_to_cpu(((const struct bt_hci_acl_hdr *)hdr)->len);
+	case BT_HCI_H4_SCO:
+		/* Data_Total_Length */
+		return ((const struct bt_hci_sco_hdr *)hdr)->len;
+	case BT_HCI_H4_EVT:
 		/* Parameter Total Length */
-		payload_len = cmd->param_len;
-		header_len += BT_HCI_CMD_HDR_SIZE;
-		break;
+		return ((const struct bt_hci_evt_hdr *)hdr)->len;
+	case BT_HCI_H4_ISO:
+		/* ISO_Data_Load_Length parameter */
+		return bt_iso_hdr_len(sys_le16_to_cpu(((const struct bt_hci_iso_hdr *)hdr)->len));
+	default:
+		return 0;
 	}
-	case BT_HCI_H4_ACL: {
-		if (buf_len < header_len + BT_HCI_ACL_HDR_SIZE) {
-			return 0;
-		}
-		const struct bt_hci_acl_hdr *acl = (const struct bt_hci_acl_hdr *)hdr;
+}
 
-		/* Data Total Length */
-		payload_len = sys_le16_to_cpu(acl->len);
-		header_len += BT_HCI_ACL_HDR_SIZE;
-		break;
+#if defined(CONFIG_BT_H4_RX_LATENCY_STATS)
+static uint64_t h4_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+static void h4_rx_latency_dump(struct h4_data *h4)
+{
+	struct h4_rx_latency *lat = &h4->latency;
+
+	if (lat->count == 0) {
+		return;
 	}
-	case BT_HCI_H4_SCO: {
-		if (buf_len < header_len + BT_HCI_SCO_HDR_SIZE) {
-			return 0;
+
+	LOG_INF("RX poll to dispatch: %u pkts avg %u us max %u us", lat->count,
+		(uint32_t)(lat->total_us / lat->count), lat->max_us);
+
+	for (int i = 0; i < H4_RX_LATENCY_BUCKETS; i++) {
+		if (lat->hist[i] != 0) {
+			LOG_INF("  < %6u us: %u", 1U << i, lat->hist[i]);
 		}
-		const struct bt_hci_sco_hdr *sco = (const struct bt_hci_sco_hdr *)hdr;
+	}
+}
 
-		/* Data_Total_Length */
-		payload_len = sco->len;
-		header_len += BT_HCI_SCO_HDR_SIZE;
-		break;
+static void h4_rx_latency_record(struct h4_data *h4, uint64_t ready_us)
+{
+	struct h4_rx_latency *lat = &h4->latency;
+	uint32_t us = (uint32_t)MIN(h4_now_us() - ready_us, UINT32_MAX);
+	int bucket = 0;
+
+	while (bucket < H4_RX_LATENCY_BUCKETS - 1 && us >= (1U << bucket)) {
+		bucket++;
 	}
-	case BT_HCI_H4_EVT: {
-		if (buf_len < header_len + BT_HCI_EVT_HDR_SIZE) {
-			return 0;
-		}
-		const struct bt_hci_evt_hdr *evt = (const struct bt_hci_evt_hdr *)hdr;
 
-		/* Parameter Total Length */
-		payload_len = evt->len;
-		header_len += BT_HCI_EVT_HDR_SIZE;
-		break;
+	lat->hist[bucket]++;
+	lat->count++;
+	lat->total_us += us;
+	lat->max_us = MAX(lat->max_us, us);
+
+	if (CONFIG_BT_H4_RX_LATENCY_DUMP_INTERVAL > 0 &&
+	    (lat->count % CONFIG_BT_H4_RX_LATENCY_DUMP_INTERVAL) == 0) {
+		h4_rx_latency_dump(h4);
 	}
-	case BT_HCI_H4_ISO: {
-		if (buf_len < header_len + BT_HCI_ISO_HDR_SIZE) {
-			return 0;
-		}
-		const struct bt_hci_iso_hdr *iso = (const struct bt_hci_iso_hdr *)hdr;
+}
+#endif /* CONFIG_BT_H4_RX_LATENCY_STATS */
 
-		/* ISO_Data_Load_Length parameter */
-		payload_len = bt_iso_hdr_len(sys_le16_to_cpu(iso->len));
-		header_len += BT_HCI_ISO_HDR_SIZE;
-		break;
+/**
+ * @brief Block until the UART has data or the driver is being closed
+ * @param h4	Driver instance
+ * @return 1 if data is ready, 0 on poll timeout, -ESHUTDOWN if the wakeup
+ *         pipe was signalled, or a negative errno on failure.
+ */
+static int h4_wait_ready(struct h4_data *h4)
+{
+	struct pollfd pollfds[2] = {
+		{ .fd = h4->fd, .events = POLLIN },
+		{ .fd = h4->wakeup[0], .events = POLLIN },
+	};
+	int ret;
+
+	ret = poll(pollfds, ARRAY_SIZE(pollfds), CONFIG_BT_H4_RX_POLL_TIMEOUT_MS);
+	if (ret < 0) {
+		return errno == EINTR ? 0 : -errno;
 	}
-	/* If no valid packet type found */
-	default:
-		LOG_WRN("Unknown packet type 0x%02x", type);
-		return -1;
+
+	if (h4->shutdown || (pollfds[1].revents & POLLIN)) {
+		return -ESHUTDOWN;
 	}
 
-	/* Request more data */
-	if (buf_len < header_len + payload_len) {
-		return 0;
+	if (pollfds[0].revents & (POLLERR | POLLHUP)) {
+		return -EIO;
 	}
 
-	return (int32_t)header_len + payload_len;
+	return (pollfds[0].revents & POLLIN) ? 1 : 0;
 }
 
-#if 1
-static bool h4_ready(struct h4_data *h4)
+/**
+ * @brief Read from the UART without blocking
+ * @return Number of bytes read, 0 if no data is available right now, or a
+ *         negative errno on failure.
+ */
+static ssize_t h4_read(struct h4_data *h4, void *dst, size_t len)
 {
-	struct pollfd pollfd = { .fd = h4->fd, .events = POLLIN };
+	ssize_t ret;
+
+	do {
+		ret = read(h4->fd, dst, len);
+	} while (ret < 0 && errno == EINTR);
 
-	return (poll(&pollfd, 1, 0) == 1);
+	if (ret < 0) {
+		return errno == EAGAIN ? 0 : -errno;
+	}
+
+	return ret;
 }
-#endif
 
-static void h4_rx_thread(void *p1, void *p2, void *p3)
+static void h4_rx_alloc(struct h4_data *h4)
+{
+	struct h4_rx *rx = &h4->rx;
+	size_t payload_len;
+
+	/* Any bytes read past the base header are already part of the payload */
+	payload_len = h4_payload_len(rx->type, rx->hdr);
+	payload_len -= rx->hdr_len - h4_hdr_len(rx->type);
+
+	rx->remaining = payload_len;
+	rx->buf = get_rx(rx->type, rx->hdr);
+	if (!rx->buf) {
+		LOG_DBG("Discard packet type %u due to insufficient buf", rx->type);
+		rx->state = H4_RX_DISCARD;
+		return;
+	}
+
+	if (net_buf_tailroom(rx->buf) < rx->hdr_len + payload_len) {
+		LOG_ERR("Not enough space in buffer %zu/%zu", rx->hdr_len + payload_len,
+			net_buf_tailroom(rx->buf));
+		net_buf_unref(rx->buf);
+		rx->buf = NULL;
+		rx->state = H4_RX_DISCARD;
+		return;
+	}
+
+	net_buf_add_mem(rx->buf, rx->hdr, rx->hdr_len);
+	rx->state = H4_RX_PAYLOAD;
+}
+
+static void h4_rx_deliver(const struct device *dev)
 {
-	const struct device *dev = p1;
 	struct h4_data *h4 = dev->data;
+	struct net_buf *buf = h4->rx.buf;
 
-	ARG_UNUSED(p2);
-	ARG_UNUSED(p3);
+	h4->rx.buf = NULL;
+	h4->rx.state = H4_RX_TYPE;
 
-	LOG_DBG("started");
+	LOG_DBG("Calling bt_recv(%p)", buf);
 
-	ssize_t frame_size = 0;
+	h4_data_dump("BT RX", h4->rx.type, buf->data, buf->len);
+	h4->recv(dev, buf);
 
-	while (1) {
-		static uint8_t frame[512];
-		struct net_buf *buf;
-		size_t buf_tailroom;
-		size_t buf_add_len;
-		ssize_t len;
-		const uint8_t *frame_start = frame;
-
-#if 1
-		if (!h4_ready(h4)) {
-			usleep(1000);
-			continue;
-		}
+#if defined(CONFIG_BT_H4_RX_LATENCY_STATS)
+	h4_rx_latency_record(h4, h4->rx.ready_us);
 #endif
+}
 
-		LOG_DBG("calling read()");
+/**
+ * @brief Feed the H4 parser with everything the UART has buffered
+ * @details Headers are read into the parser state and payloads straight into
+ *          the tailroom of the net_buf the packet is delivered in.
+ * @param dev	H4 device
+ * @return 0 once the UART has been drained, a negative errno on failure.
+ */
+static int h4_rx_process(const struct device *dev)
+{
+	struct h4_data *h4 = dev->data;
+	struct h4_rx *rx = &h4->rx;
+	uint8_t scratch[64];
+	ssize_t len;
 
-		len = read(h4->fd, frame + frame_size, sizeof(frame) - frame_size);
-		if (len < 0) {
-			if (errno == EINTR) {
-				continue;
+	while (1) {
+		switch (rx->state) {
+		case H4_RX_TYPE:
+			len = h4_read(h4, &rx->type, sizeof(rx->type));
+			if (len <= 0) {
+				return len;
 			}
 
-			if (len == -EAGAIN) {
-				usleep(500);
-				continue;
+			rx->hdr_len = h4_hdr_len(rx->type);
+			if (rx->hdr_len == 0) {
+				LOG_WRN("Unknown packet type 0x%02x", rx->type);
+				break;
 			}
 
-			LOG_ERR("Reading hci failed, errno %d", errno);
-			close(h4->fd);
-			h4->fd = -1;
-			return;
-		}
-
-		frame_size += len;
-
-		while (frame_size > 0) {
-			const uint8_t *buf_add;
-			const uint8_t packet_type = frame_start[0];
-			const int32_t decoded_len = hci_packet_complete(frame_start, frame_size);
+			rx->hdr_read = 0;
+			rx->state = H4_RX_HDR;
+			break;
+		case H4_RX_HDR:
+			len = h4_read(h4, rx->hdr + rx->hdr_read, rx->hdr_len - rx->hdr_read);
+			if (len <= 0) {
+				return len;
+			}
 
-			if (decoded_len == -1) {
-				LOG_ERR("HCI Packet type is invalid, length could not be decoded");
-				frame_size = 0; /* Drop buffer */
+			rx->hdr_read += len;
+			if (rx->hdr_read < rx->hdr_len) {
 				break;
 			}
 
-			if (decoded_len == 0) {
-				if (frame_size == sizeof(frame)) {
-					LOG_ERR("HCI Packet (%d bytes) is too big for frame (%d "
-						"bytes)",
-						decoded_len, sizeof(frame));
-					frame_size = 0; /* Drop buffer */
-					break;
-				}
-				if (frame_start != frame) {
-					memmove(frame, frame_start, frame_size);
-				}
-				/* Read more */
+			/* LE Meta events need the subevent to pick a buffer */
+			if (rx->type == BT_HCI_H4_EVT && rx->hdr_len == BT_HCI_EVT_HDR_SIZE &&
+			    rx->hdr[0] == BT_HCI_EVT_LE_META_EVENT && rx->hdr[1] > 0) {
+				rx->hdr_len++;
 				break;
 			}
 
-			buf_add = frame_start + sizeof(packet_type);
-			buf_add_len = decoded_len - sizeof(packet_type);
-
-			buf = get_rx(frame_start);
-
-			frame_size -= decoded_len;
-			frame_start += decoded_len;
+			h4_rx_alloc(h4);
+			if (rx->state == H4_RX_PAYLOAD && rx->remaining == 0) {
+				h4_rx_deliver(dev);
+			} else if (rx->state == H4_RX_DISCARD && rx->remaining == 0) {
+				rx->state = H4_RX_TYPE;
+			}
+			break;
+		case H4_RX_PAYLOAD:
+			len = h4_read(h4, net_buf_tail(rx->buf), rx->remaining);
+			if (len <= 0) {
+				return len;
+			}
 
-			if (!buf) {
-				LOG_DBG("Discard adv report due to insufficient buf");
-				continue;
+			net_buf_add(rx->buf, len);
+			rx->remaining -= len;
+			if (rx->remaining == 0) {
+				h4_rx_deliver(dev);
+			}
+			break;
+		case H4_RX_DISCARD:
+			len = h4_read(h4, scratch, MIN(rx->remaining, sizeof(scratch)));
+			if (len <= 0) {
+				return len;
 			}
 
-			buf_tailroom = net_buf_tailroom(buf);
-			if (buf_tailroom < buf_add_len) {
-				LOG_ERR("Not enough space in buffer %zu/%zu", buf_add_len,
-					buf_tailroom);
-				net_buf_unref(buf);
-				continue;
+			rx->remaining -= len;
+			if (rx->remaining == 0) {
+				rx->state = H4_RX_TYPE;
 			}
+			break;
+		}
+	}
+}
 
-			net_buf_add_mem(buf, buf_add, buf_add_len);
+static void h4_rx_reset(struct h4_data *h4)
+{
+	if (h4->rx.buf) {
+		net_buf_unref(h4->rx.buf);
+		h4->rx.buf = NULL;
+	}
 
-			LOG_DBG("Calling bt_recv(%p)", buf);
+	h4->rx.state = H4_RX_TYPE;
+}
 
-			h4_data_dump("BT RX", packet_type, buf->data, buf_add_len);
-			h4->recv(dev, buf);
+static void h4_rx_thread(void *p1, void *p2, void *p3)
+{
+	const struct device *dev = p1;
+	struct h4_data *h4 = dev->data;
+	int ret;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	LOG_DBG("started");
+
+	h4_rx_reset(h4);
+
+	while (1) {
+#if defined(CONFIG_BT_H4_RX_LATENCY_STATS)
+		/* Taken before blocking, so that the wakeup counts */
+		h4->rx.ready_us = h4_now_us();
+#endif
+
+		ret = h4_wait_ready(h4);
+		if (ret == 0) {
+			continue;
+		} else if (ret < 0) {
+			if (ret != -ESHUTDOWN) {
+				LOG_ERR("Polling hci failed (err %d)", ret);
+			}
+			break;
+		}
+
+		ret = h4_rx_process(dev);
+		if (ret < 0) {
+			LOG_ERR("Reading hci failed (err %d)", ret);
+			break;
 		}
 	}
+
+	h4_rx_reset(h4);
+
+	LOG_DBG("exiting");
+
+	k_sem_give(&h4->rx_exit);
 }
 
 static int h4_send(const struct device *dev, struct net_buf *buf)
 {
 	struct h4_data *h4 = dev->data;
-	int len;
-	int ret;
+	struct h4_tx_req req = { .buf = buf };
+	bool bulk = false;
 
 	LOG_DBG("buf %p type %u len %u", buf, bt_buf_get_type(buf), buf->len);
 
+	if (h4->fd < 0) {
+		return -ENOTCONN;
+	}
+
 	switch (bt_buf_get_type(buf)) {
 	case BT_BUF_ACL_OUT:
 		net_buf_push_u8(buf, BT_HCI_H4_ACL);
+		bulk = true;
 		break;
 	case BT_BUF_CMD:
 		net_buf_push_u8(buf, BT_HCI_H4_CMD);
@@ -336,6 +691,7 @@ static int h4_send(const struct device *dev, struct net_buf *buf)
 	case BT_BUF_ISO_OUT:
 		if (IS_ENABLED(CONFIG_BT_ISO)) {
 			net_buf_push_u8(buf, BT_HCI_H4_ISO);
+			bulk = true;
 			break;
 		}
 		__fallthrough;
@@ -346,17 +702,48 @@ static int h4_send(const struct device *dev, struct net_buf *buf)
 
 	h4_data_dump("BT TX", buf->data[0], buf->data + 1, buf->len - 1);
 
-	pthread_mutex_lock(&h4->mutex);
-	len = buf->len;
-	ret = h4_send_data(h4, buf->data, buf->len);
-	if (ret != len) {
-		ret = -EINVAL;
+	k_sem_init(&req.done, 0, 1);
+	k_fifo_put(&h4->tx_queue, &req);
+
+	/* Let more data packets queue up, without holding the lock so that
+	 * other senders can queue theirs meanwhile. Commands are not held
+	 * back.
+	 */
+	if (CONFIG_BT_H4_TX_COALESCE_US > 0 && bulk) {
+		k_sleep(K_USEC(CONFIG_BT_H4_TX_COALESCE_US));
 	}
 
-	net_buf_unref(buf);
-	pthread_mutex_unlock(&h4->mutex);
+	/* Whoever holds the lock writes out everything queued so far, so a
+	 * sender that finds it taken can leave its packet to the holder. The
+	 * queue is checked again after unlocking to not strand a packet that
+	 * was queued just before the holder let go.
+	 */
+	while (!k_fifo_is_empty(&h4->tx_queue) && pthread_mutex_trylock(&h4->mutex) == 0) {
+		while (h4_tx_drain(h4) > 0) {
+		}
+
+		pthread_mutex_unlock(&h4->mutex);
+	}
+
+	/* Written by this sender or another one, the result is the packet's */
+	k_sem_take(&req.done, K_FOREVER);
 
-	return ret < 0 ? ret : 0;
+	return req.err;
+}
+
+static void h4_close_fds(struct h4_data *h4)
+{
+	if (h4->wakeup[0] >= 0) {
+		close(h4->wakeup[0]);
+		close(h4->wakeup[1]);
+		h4->wakeup[0] = -1;
+		h4->wakeup[1] = -1;
+	}
+
+	if (h4->fd >= 0) {
+		close(h4->fd);
+		h4->fd = -1;
+	}
 }
 
 static int h4_open(const struct device *dev, bt_hci_recv_t recv)
@@ -364,40 +751,84 @@ static int h4_open(const struct device *dev, bt_hci_recv_t recv)
 	int ret;
 	struct h4_data *h4 = dev->data;
 
-	ret = open(CONFIG_BT_UART_ON_DEV_NAME, O_RDWR | O_BINARY | O_CLOEXEC);
+	ret = open(CONFIG_BT_UART_ON_DEV_NAME, O_RDWR | O_BINARY | O_CLOEXEC | O_NONBLOCK);
 	if (ret < 0) {
+		ret = -errno;
 		goto bail;
 	}
 
 	h4->fd = ret;
 	LOG_DBG("H4: %s opened as fd %d", CONFIG_BT_UART_ON_DEV_NAME, h4->fd);
 
+	ret = pipe2(h4->wakeup, O_CLOEXEC);
+	if (ret < 0) {
+		ret = -errno;
+		goto bail;
+	}
+
+	h4->shutdown = false;
+	h4->recv = recv;
+	k_fifo_init(&h4->tx_queue);
+	k_sem_init(&h4->rx_exit, 0, 1);
+
 	ret = (int)k_thread_create(&rx_thread_data, rx_thread_stack,
 				   K_THREAD_STACK_SIZEOF(rx_thread_stack), h4_rx_thread, (void *)dev, NULL,
 				   NULL, K_PRIO_COOP(CONFIG_BT_RX_PRIO), 0, K_NO_WAIT);
 
 	if (ret < 0) {
 		goto bail;
-	} else {
-		ret = 0;
 	}
 
-	h4->recv = recv;
-
 	k_thread_name_set(&rx_thread_data, "BT Driver");
 	LOG_DBG("returning");
 
 	return 0;
 
 bail:
-	close(h4->fd);
-	h4->fd = -1;
+	h4_close_fds(h4);
 
 	return ret;
 }
 
+static int h4_close(const struct device *dev)
+{
+	struct h4_data *h4 = dev->data;
+	struct h4_tx_req *req;
+	uint8_t wake = 0;
+
+	if (h4->fd < 0) {
+		return -EALREADY;
+	}
+
+	h4->shutdown = true;
+	if (write(h4->wakeup[1], &wake, sizeof(wake)) < 0) {
+		LOG_WRN("Failed to wake RX thread, errno %d", errno);
+	}
+
+	/* Worst case the RX thread notices the flag on its next poll timeout */
+	k_sem_take(&h4->rx_exit, K_FOREVER);
+
+#if defined(CONFIG_BT_H4_RX_LATENCY_STATS)
+	h4_rx_latency_dump(h4);
+#endif
+
+	pthread_mutex_lock(&h4->mutex);
+	h4_close_fds(h4);
+	while ((req = k_fifo_get(&h4->tx_queue, K_NO_WAIT)) != NULL) {
+		h4_tx_complete(req, -ENOTCONN);
+	}
+	pthread_mutex_unlock(&h4->mutex);
+
+#if defined(CONFIG_BT_H4_TX_STATS)
+	h4_tx_stats_dump(h4);
+#endif
+
+	return 0;
+}
+
 static const struct bt_hci_driver_api h4_drv_api = {
 	.open = h4_open,
+	.close = h4_close,
 	.send = h4_send,
 };
 
@@ -409,7 +840,8 @@ static int h4_init(const struct device *dev)
 
 #define H4_DEVICE_INIT(inst)                                                                       \
 	static struct h4_data h4_data_##inst = {                                                   \
-		.fd = -1,                                                                             \
+		.fd = -1,                                                                          \
+		.wakeup = {-1, -1},                                                                \
 		.mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,                                   \
 	};                                                                                         \
 	DEVICE_DT_INST_DEFINE(inst, h4_init, NULL, &h4_data_##inst, NULL, POST_KERNEL,             \
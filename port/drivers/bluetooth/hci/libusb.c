@@ -55,34 +55,78 @@
 #define H4_SCO               0x03
 #define H4_EVT               0x04
 
-#define HCI_BUFSIZE          800
+/* Transfers kept submitted per endpoint. Every ACL IN transfer owns a
+ * net_buf from the host pools while in flight, so at least one ACL buffer
+ * must be left to the host. Event IN transfers receive into driver memory
+ * and only take a buffer once the event is known, from the pool that
+ * bt_buf_get_evt() picks for it.
+ */
+#define USB_EVT_IN_TRANSFERS  2
+#define USB_ACL_IN_TRANSFERS  3
+#define USB_ACL_OUT_TRANSFERS 4
+
+BUILD_ASSERT(USB_ACL_IN_TRANSFERS < CONFIG_BT_BUF_ACL_RX_COUNT,
+	     "ACL IN transfers would hold every ACL RX buffer");
+
+/* Upper bound on how long the event loop sleeps in libusb */
+#define USB_EVENT_TIMEOUT_MS  100
+
+/* An RX slot starved of host buffers is retried this often */
+#define USB_RX_STARVED_MS     2
+
+/* An RX slot whose transfer failed is retried after this, doubled with
+ * every further error in a row, and given up after USB_RX_ERRORS_MAX.
+ */
+#define USB_RX_BACKOFF_MS     10
+#define USB_RX_ERRORS_MAX     8
+
+#define HCI_CMD_BUFSIZE      (LIBUSB_CONTROL_SETUP_SIZE + 3 + 255)
+#define HCI_EVT_BUFSIZE      (BT_HCI_EVT_HDR_SIZE + 255)
 
 //#define HCI_DEBUG
 
 static K_THREAD_STACK_DEFINE(rx_thread_stack, CONFIG_BT_RX_STACK_SIZE);
 static struct k_thread        rx_thread_data;
 
-enum {
-	TRANSFER_INPUT_CMD,
-	TRANSFER_INPUT_ACL,
-	TRANSFER_OUTPUT_CMD,
-	TRANSFER_OUTPUT_ACL,
+struct usb_endpoint {
+	int                     address;
+	enum bt_buf_type        type;
 };
 
-struct usb_handler {
+struct usb_slot {
+	sys_snode_t             node;
 	struct libusb_transfer *transfer;
-	int                     address;
-	sem_t                   sem;
-	int                     type;
+	struct usb_endpoint    *ep;
+	struct net_buf         *buf;
+	/* Event slots receive into data, len is an event not yet delivered */
+	uint8_t                *data;
+	int                     len;
+	bool                    busy;
+	/* RX slots: failed transfers in a row, and when an idle slot is
+	 * submitted again
+	 */
+	int                     errors;
+	uint32_t                retry_at;
 };
-static struct usb_handler      g_uhandle[4];
-static libusb_device_handle   *g_handle;
-static struct libusb_transfer *g_command_transfer;
-static struct libusb_transfer *g_acl_transfer;
 
-static uint8_t hci_command_input_buffer[HCI_BUFSIZE];
-static uint8_t hci_acl_input_buffer[HCI_BUFSIZE];
-static uint8_t hci_command_send_buffer[3 + 256 + LIBUSB_CONTROL_SETUP_SIZE];
+static struct usb_endpoint g_evt_in  = { .type = BT_BUF_EVT };
+static struct usb_endpoint g_acl_in  = { .type = BT_BUF_ACL_IN };
+static struct usb_endpoint g_acl_out = { .type = BT_BUF_ACL_OUT };
+static struct usb_endpoint g_cmd_out = { .type = BT_BUF_CMD };
+
+static struct usb_slot g_rx_slots[USB_EVT_IN_TRANSFERS + USB_ACL_IN_TRANSFERS];
+static struct usb_slot g_tx_slots[USB_ACL_OUT_TRANSFERS];
+static struct usb_slot g_cmd_slot;
+static uint8_t         g_evt_data[USB_EVT_IN_TRANSFERS][HCI_EVT_BUFSIZE];
+
+/* Free ACL out slots, counted by g_tx_sem */
+static sys_slist_t            g_tx_free;
+static struct k_spinlock      g_tx_lock;
+static struct k_sem           g_tx_sem;
+static struct k_sem           g_cmd_sem;
+
+static libusb_device_handle   *g_handle;
+static volatile bool           g_shutdown;
 
 static void usb_data_dump(const char *tag, uint8_t *data, uint32_t len)
 {
@@ -96,28 +140,6 @@ static void usb_data_dump(const char *tag, uint8_t *data, uint32_t len)
 #endif
 }
 
-static void usb_callback(struct libusb_transfer *transfer)
-{
-	struct usb_handler *uhandle = transfer->user_data;
-
-	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
-		if (transfer->endpoint == 0 ||
-				uhandle->type == TRANSFER_OUTPUT_ACL)
-			sem_post(&uhandle->sem);
-		else if (uhandle->type == TRANSFER_INPUT_CMD) {
-			if (g_command_transfer == NULL)
-				g_command_transfer = transfer;
-		} else if (uhandle->type == TRANSFER_INPUT_ACL) {
-			if (g_acl_transfer == NULL)
-				g_acl_transfer = transfer;
-		}
-	} else if (transfer->status == LIBUSB_TRANSFER_STALL) {
-		libusb_clear_halt(transfer->dev_handle, transfer->endpoint);
-		libusb_submit_transfer(transfer);
-	}
-
-}
-
 static int usb_open(libusb_device_handle **handle)
 {
 	struct libusb_device_descriptor desc;
@@ -284,129 +306,381 @@ static int usb_scan(libusb_device_handle *handle)
 		}
 	}
 
-	g_uhandle[TRANSFER_INPUT_CMD].address  = cmd_in_address;
-	g_uhandle[TRANSFER_INPUT_ACL].address  = acl_in_address;
-	g_uhandle[TRANSFER_OUTPUT_ACL].address = acl_out_address;
+	g_evt_in.address  = cmd_in_address;
+	g_acl_in.address  = acl_in_address;
+	g_acl_out.address = acl_out_address;
 
 	libusb_free_config_descriptor(descriptor);
 
 	return 0;
 }
 
-static int usb_alloc(libusb_device_handle *handle)
+static void usb_rx_callback(struct libusb_transfer *transfer);
+
+static int usb_rx_submit(struct usb_slot *slot)
 {
-	struct usb_handler *uhandle;
-	int i, ret;
+	struct usb_endpoint *ep = slot->ep;
+	struct net_buf *buf;
+	int ret;
 
-	for (i = 0; i < ARRAY_SIZE(g_uhandle); i++) {
-		uhandle = &g_uhandle[i];
-		uhandle->transfer = libusb_alloc_transfer(0);
-		if (uhandle->transfer == NULL)
+	if (ep == &g_evt_in) {
+		libusb_fill_interrupt_transfer(slot->transfer, g_handle, ep->address,
+				slot->data, HCI_EVT_BUFSIZE, usb_rx_callback, slot, 0);
+	} else {
+		/* Never block the event loop on the host pools, starved slots
+		 * are retried from rx_thread once buffers have been freed.
+		 */
+		buf = bt_buf_get_rx(ep->type, K_NO_WAIT);
+		if (buf == NULL)
 			return -ENOMEM;
-		sem_init(&uhandle->sem, 0, 1);
-		uhandle->type = i;
-	}
 
-	uhandle = &g_uhandle[TRANSFER_INPUT_CMD];
+		/* The controller writes straight into the buffer handed to the host */
+		libusb_fill_bulk_transfer(slot->transfer, g_handle, ep->address,
+				net_buf_tail(buf), net_buf_tailroom(buf),
+				usb_rx_callback, slot, 0);
 
-	libusb_fill_interrupt_transfer(uhandle->transfer,
-			handle, uhandle->address, hci_command_input_buffer, HCI_BUFSIZE,
-			usb_callback, uhandle, 0);
+		slot->buf = buf;
+	}
 
-	ret = libusb_submit_transfer(uhandle->transfer);
-	if (ret)
-		return ret;
+	slot->busy = true;
 
-	uhandle = &g_uhandle[TRANSFER_INPUT_ACL];
+	ret = libusb_submit_transfer(slot->transfer);
+	if (ret < 0) {
+		slot->busy = false;
 
-	libusb_fill_bulk_transfer(uhandle->transfer,
-			handle, uhandle->address, hci_acl_input_buffer,
-			HCI_BUFSIZE, usb_callback, uhandle, 0) ;
+		if (slot->buf) {
+			net_buf_unref(slot->buf);
+			slot->buf = NULL;
+		}
+	}
 
-	return libusb_submit_transfer(uhandle->transfer);
+	return ret;
 }
 
-static void usb_close(libusb_device_handle *handle)
+/* Copy a received event into a buffer from the pool matching its type.
+ * Returns -ENOMEM and keeps the event if that pool is empty, unless the
+ * event may be discarded.
+ */
+static int usb_evt_deliver(struct usb_slot *slot)
 {
-	struct usb_handler *uhandle;
-	struct timeval tv = {};
-	int i;
+	struct bt_hci_evt_hdr *hdr = (void *)slot->data;
+	bool discardable = false;
+	struct net_buf *buf;
 
-	for (i = 0; i < ARRAY_SIZE(g_uhandle); i++) {
-		uhandle = &g_uhandle[i];
-		if (uhandle->transfer == NULL)
-			continue;
+	if (slot->len < (int)sizeof(*hdr) || slot->len < (int)sizeof(*hdr) + hdr->len) {
+		BT_WARN("Truncated event (len %d)", slot->len);
+		slot->len = 0;
+		return 0;
+	}
+
+	if (hdr->evt == BT_HCI_EVT_LE_META_EVENT && hdr->len > 0 &&
+			(slot->data[sizeof(*hdr)] == BT_HCI_EVT_LE_ADVERTISING_REPORT ||
+			 slot->data[sizeof(*hdr)] == BT_HCI_EVT_LE_EXT_ADVERTISING_REPORT))
+		discardable = true;
 
-		if (uhandle->type == TRANSFER_INPUT_CMD ||
-				uhandle->type == TRANSFER_INPUT_ACL)
-			libusb_cancel_transfer(uhandle->transfer);
-		libusb_free_transfer(uhandle->transfer);
+	buf = bt_buf_get_evt(hdr->evt, discardable, K_NO_WAIT);
+	if (buf == NULL) {
+		if (discardable) {
+			slot->len = 0;
+			return 0;
+		}
+
+		return -ENOMEM;
 	}
 
-	libusb_set_debug(NULL, LIBUSB_LOG_LEVEL_WARNING);
-	libusb_handle_events_timeout(NULL, &tv);
-	libusb_release_interface(handle, 0);
-	libusb_close(handle);
+	net_buf_add_mem(buf, slot->data, sizeof(*hdr) + hdr->len);
+	slot->len = 0;
+
+	bt_recv(buf);
+
+	return 0;
 }
 
-static void rx_thread(void *p1, void *p2, void *p3)
+/* Have rx_thread submit an idle slot again in @p ms */
+static void usb_rx_defer(struct usb_slot *slot, uint32_t ms)
+{
+	slot->retry_at = k_uptime_get_32() + ms;
+}
+
+/* Back off a slot whose transfer failed, give it up if it keeps failing */
+static void usb_rx_error(struct usb_slot *slot, int err)
+{
+	if (++slot->errors >= USB_RX_ERRORS_MAX) {
+		BT_ERR("Endpoint 0x%2.2X failed %d times (err %d), giving up",
+				slot->ep->address, slot->errors, err);
+		return;
+	}
+
+	usb_rx_defer(slot, USB_RX_BACKOFF_MS << (slot->errors - 1));
+}
+
+/* Deliver the event a slot still holds, then submit it again */
+static void usb_rx_resume(struct usb_slot *slot)
 {
-	struct libusb_transfer *transfer;
-	struct bt_hci_evt_hdr *evt;
-	struct timeval tv = {};
-	struct net_buf *buf;
-	uint8_t *data;
-	uint32_t len;
-	uint8_t type;
 	int ret;
 
-	for (;;) {
-		ret = libusb_handle_events_timeout(NULL, &tv);
-		if (g_command_transfer) {
-			transfer = g_command_transfer;
-			g_command_transfer = NULL;
-			type = H4_EVT;
-		} else if (g_acl_transfer) {
-			transfer = g_acl_transfer;
-			g_acl_transfer = NULL;
-			type = H4_ACL;
+	if (slot->len > 0 && usb_evt_deliver(slot) < 0) {
+		usb_rx_defer(slot, USB_RX_STARVED_MS);
+		return;
+	}
+
+	ret = usb_rx_submit(slot);
+	if (ret == -ENOMEM)
+		usb_rx_defer(slot, USB_RX_STARVED_MS);
+	else if (ret < 0)
+		usb_rx_error(slot, ret);
+}
+
+static void usb_rx_callback(struct libusb_transfer *transfer)
+{
+	struct usb_slot *slot = transfer->user_data;
+	struct net_buf *buf = slot->buf;
+
+	slot->buf = NULL;
+	slot->busy = false;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		slot->errors = 0;
+
+		if (transfer->actual_length > 0)
+			usb_data_dump("R", transfer->buffer, transfer->actual_length);
+
+		if (!buf) {
+			slot->len = transfer->actual_length;
+		} else if (transfer->actual_length > 0) {
+			net_buf_add(buf, transfer->actual_length);
+			bt_recv(buf);
 		} else {
-			usleep(1);
-			continue;
+			net_buf_unref(buf);
 		}
 
-		data = transfer->buffer;
-		len = transfer->actual_length;
+		if (!g_shutdown)
+			usb_rx_resume(slot);
+
+		return;
+	}
+
+	if (transfer->status == LIBUSB_TRANSFER_STALL)
+		libusb_clear_halt(transfer->dev_handle, transfer->endpoint);
 
-		usb_data_dump("R", data, len);
+	if (buf)
+		net_buf_unref(buf);
 
-		if (type == H4_EVT) {
-			evt = (struct bt_hci_evt_hdr *)data;
-			buf = bt_buf_get_evt(evt->evt, false, K_FOREVER);
-		} else
-			buf = bt_buf_get_rx(BT_BUF_ACL_IN, K_FOREVER);
+	if (g_shutdown || transfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+		return;
 
-		if (buf == NULL)
+	/* Resubmitting right away would spin on an endpoint that keeps failing */
+	usb_rx_error(slot, transfer->status);
+}
+
+static void usb_tx_callback(struct libusb_transfer *transfer)
+{
+	struct usb_slot *slot = transfer->user_data;
+	k_spinlock_key_t key;
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED)
+		BT_WARN("%s transfer failed (status %d)",
+				slot->ep->type == BT_BUF_CMD ? "CMD" : "ACL",
+				transfer->status);
+
+	if (transfer->status == LIBUSB_TRANSFER_STALL)
+		libusb_clear_halt(transfer->dev_handle, transfer->endpoint);
+
+	if (slot->buf) {
+		net_buf_unref(slot->buf);
+		slot->buf = NULL;
+	}
+
+	slot->busy = false;
+
+	if (slot == &g_cmd_slot) {
+		k_sem_give(&g_cmd_sem);
+		return;
+	}
+
+	key = k_spin_lock(&g_tx_lock);
+	sys_slist_append(&g_tx_free, &slot->node);
+	k_spin_unlock(&g_tx_lock, key);
+
+	k_sem_give(&g_tx_sem);
+}
+
+static int usb_slot_init(struct usb_slot *slot, struct usb_endpoint *ep)
+{
+	slot->transfer = libusb_alloc_transfer(0);
+	if (slot->transfer == NULL)
+		return -ENOMEM;
+
+	slot->ep = ep;
+	slot->buf = NULL;
+	slot->data = NULL;
+	slot->len = 0;
+	slot->busy = false;
+	slot->errors = 0;
+	slot->retry_at = k_uptime_get_32();
+
+	return 0;
+}
+
+static int usb_alloc(libusb_device_handle *handle)
+{
+	uint8_t *cmd_buffer;
+	int i, ret;
+
+	g_handle = handle;
+	g_shutdown = false;
+
+	sys_slist_init(&g_tx_free);
+	k_sem_init(&g_tx_sem, ARRAY_SIZE(g_tx_slots), ARRAY_SIZE(g_tx_slots));
+	k_sem_init(&g_cmd_sem, 1, 1);
+
+	for (i = 0; i < ARRAY_SIZE(g_tx_slots); i++) {
+		ret = usb_slot_init(&g_tx_slots[i], &g_acl_out);
+		if (ret < 0)
+			return ret;
+
+		sys_slist_append(&g_tx_free, &g_tx_slots[i].node);
+	}
+
+	ret = usb_slot_init(&g_cmd_slot, &g_cmd_out);
+	if (ret < 0)
+		return ret;
+
+	/* Commands are copied behind the control setup packet, the buffer is
+	 * released together with the transfer.
+	 */
+	cmd_buffer = malloc(HCI_CMD_BUFSIZE);
+	if (cmd_buffer == NULL)
+		return -ENOMEM;
+
+	g_cmd_slot.transfer->buffer = cmd_buffer;
+	g_cmd_slot.transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+
+	for (i = 0; i < ARRAY_SIZE(g_rx_slots); i++) {
+		ret = usb_slot_init(&g_rx_slots[i],
+				i < USB_EVT_IN_TRANSFERS ? &g_evt_in : &g_acl_in);
+		if (ret < 0)
+			return ret;
+
+		if (i < USB_EVT_IN_TRANSFERS)
+			g_rx_slots[i].data = g_evt_data[i];
+
+		/* Starved slots are left to rx_thread */
+		ret = usb_rx_submit(&g_rx_slots[i]);
+		if (ret < 0 && ret != -ENOMEM)
+			return ret;
+	}
+
+	return 0;
+}
+
+static bool usb_busy(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(g_rx_slots); i++)
+		if (g_rx_slots[i].busy)
+			return true;
+
+	for (i = 0; i < ARRAY_SIZE(g_tx_slots); i++)
+		if (g_tx_slots[i].busy)
+			return true;
+
+	return g_cmd_slot.busy;
+}
+
+static void usb_free_slot(struct usb_slot *slot)
+{
+	if (slot->transfer == NULL)
+		return;
+
+	libusb_free_transfer(slot->transfer);
+	slot->transfer = NULL;
+}
+
+static void usb_close(libusb_device_handle *handle)
+{
+	struct timeval tv = { .tv_usec = USB_EVENT_TIMEOUT_MS * USEC_PER_MSEC };
+	int i;
+
+	g_shutdown = true;
+
+	for (i = 0; i < ARRAY_SIZE(g_rx_slots); i++)
+		if (g_rx_slots[i].busy)
+			libusb_cancel_transfer(g_rx_slots[i].transfer);
+
+	for (i = 0; i < ARRAY_SIZE(g_tx_slots); i++)
+		if (g_tx_slots[i].busy)
+			libusb_cancel_transfer(g_tx_slots[i].transfer);
+
+	if (g_cmd_slot.busy)
+		libusb_cancel_transfer(g_cmd_slot.transfer);
+
+	/* Completion callbacks release the buffers owned by each transfer */
+	while (usb_busy())
+		if (libusb_handle_events_timeout(NULL, &tv) < 0)
 			break;
 
-		if (len > buf->size) {
-			net_buf_unref(buf);
+	for (i = 0; i < ARRAY_SIZE(g_rx_slots); i++)
+		usb_free_slot(&g_rx_slots[i]);
+
+	for (i = 0; i < ARRAY_SIZE(g_tx_slots); i++)
+		usb_free_slot(&g_tx_slots[i]);
+
+	usb_free_slot(&g_cmd_slot);
+
+	libusb_release_interface(handle, 0);
+	libusb_close(handle);
+}
+
+/* Submit the idle RX slots whose retry is due. Returns how long the event
+ * loop may sleep before the next one is.
+ */
+static uint32_t usb_rx_retry(void)
+{
+	uint32_t wait_ms = USB_EVENT_TIMEOUT_MS;
+	uint32_t now = k_uptime_get_32();
+	struct usb_slot *slot;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(g_rx_slots); i++) {
+		slot = &g_rx_slots[i];
+
+		if (slot->busy || slot->errors >= USB_RX_ERRORS_MAX)
 			continue;
+
+		if ((int32_t)(slot->retry_at - now) <= 0) {
+			usb_rx_resume(slot);
+			if (slot->busy)
+				continue;
 		}
 
-		memcpy(buf->data, data, len);
-		net_buf_add(buf, len);
+		wait_ms = MIN(wait_ms, (uint32_t)MAX((int32_t)(slot->retry_at - now), 0));
+	}
 
-		bt_buf_set_type(buf, type == H4_EVT ? BT_BUF_EVT : BT_BUF_ACL_IN);
+	return wait_ms;
+}
 
-		bt_recv(buf);
+static void rx_thread(void *p1, void *p2, void *p3)
+{
+	struct timeval tv;
+	uint32_t wait_ms;
+	int ret;
 
-		ret = libusb_submit_transfer(transfer);
-		if (ret < 0)
+	while (!g_shutdown) {
+		/* Slots starved of host buffers or backing off after an error */
+		wait_ms = usb_rx_retry();
+
+		tv.tv_sec = 0;
+		tv.tv_usec = wait_ms * USEC_PER_MSEC;
+
+		/* Completions are dispatched to the transfer callbacks */
+		ret = libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+		if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+			BT_ERR("Handling usb events failed (err %d)", ret);
 			break;
+		}
 	}
-
-	BT_ERR("INVALID BUF FORMAT\n");
 }
 
 static int h2_open(void)
@@ -457,7 +731,8 @@ bail:
 static int h2_send(struct net_buf *buf)
 {
 	uint8_t type = bt_buf_get_type(buf);
-	struct usb_handler *uhandle;
+	struct usb_slot *slot;
+	k_spinlock_key_t key;
 	uint8_t *data = buf->data;
 	uint32_t len = buf->len;
 	int ret;
@@ -465,35 +740,59 @@ static int h2_send(struct net_buf *buf)
 	usb_data_dump("W", data, len);
 
 	if (type == BT_BUF_CMD) {
-		uhandle = &g_uhandle[TRANSFER_OUTPUT_CMD];
+		if (len > HCI_CMD_BUFSIZE - LIBUSB_CONTROL_SETUP_SIZE)
+			return -EINVAL;
+
+		k_sem_take(&g_cmd_sem, K_FOREVER);
+
+		slot = &g_cmd_slot;
+
+		libusb_fill_control_setup(slot->transfer->buffer,
+				LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE, 0, 0, 0, len);
+		memcpy(slot->transfer->buffer + LIBUSB_CONTROL_SETUP_SIZE, data, len);
+
+		libusb_fill_control_transfer(slot->transfer, g_handle,
+				slot->transfer->buffer, usb_tx_callback, slot, 0);
 	} else if (type == BT_BUF_ACL_OUT) {
-		uhandle = &g_uhandle[TRANSFER_OUTPUT_ACL];
+		/* Up to USB_ACL_OUT_TRANSFERS packets are in flight at once */
+		k_sem_take(&g_tx_sem, K_FOREVER);
+
+		key = k_spin_lock(&g_tx_lock);
+		slot = CONTAINER_OF(sys_slist_get_not_empty(&g_tx_free),
+				struct usb_slot, node);
+		k_spin_unlock(&g_tx_lock, key);
+
+		/* The buffer is sent as is and released on completion */
+		slot->buf = buf;
+
+		libusb_fill_bulk_transfer(slot->transfer, g_handle,
+				g_acl_out.address, data, len, usb_tx_callback, slot, 0);
 	} else
 		return -EINVAL;
 
-	sem_wait(&uhandle->sem);
-
-	if (type == BT_BUF_CMD) {
-		libusb_fill_control_setup(hci_command_send_buffer,
-				LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE, 0, 0, 0, len);
-		memcpy(hci_command_send_buffer + LIBUSB_CONTROL_SETUP_SIZE, data, len);
+	slot->busy = true;
 
-		libusb_fill_control_transfer(uhandle->transfer, g_handle,
-				hci_command_send_buffer, usb_callback, uhandle, 0);
-		uhandle->transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+	ret = libusb_submit_transfer(slot->transfer);
+	if (ret < 0) {
+		slot->buf = NULL;
+		slot->busy = false;
 
-	} else if (type == BT_BUF_ACL_OUT) {
-		libusb_fill_bulk_transfer(uhandle->transfer, g_handle,
-				uhandle->address, data, len, usb_callback, uhandle, 0);
-	}
+		if (type == BT_BUF_CMD) {
+			k_sem_give(&g_cmd_sem);
+		} else {
+			key = k_spin_lock(&g_tx_lock);
+			sys_slist_append(&g_tx_free, &slot->node);
+			k_spin_unlock(&g_tx_lock, key);
+			k_sem_give(&g_tx_sem);
+		}
 
-	ret = libusb_submit_transfer(uhandle->transfer);
-	if (ret < 0)
 		return ret;
+	}
 
-	net_buf_unref(buf);
+	if (type == BT_BUF_CMD)
+		net_buf_unref(buf);
 
-	return ret < 0 ? ret : 0;
+	return 0;
 }
 
 static struct bt_hci_driver driver = {
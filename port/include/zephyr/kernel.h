@@ -1915,6 +1915,8 @@ struct k_queue {
 	sys_sflist_t data_q;
 	struct k_spinlock lock;
 	_wait_q_t wait_q;
+	/* Threads blocked in k_queue_get(), under lock */
+	sys_dlist_t waiters;
 
 	Z_DECL_POLL_EVENT
 
@@ -1930,6 +1932,7 @@ struct k_queue {
 	.data_q = SYS_SFLIST_STATIC_INIT(&obj.data_q), \
 	.lock = { }, \
 	.wait_q = Z_WAIT_Q_INIT(&obj.wait_q),	\
+	.waiters = SYS_DLIST_STATIC_INIT(&obj.waiters), \
 	Z_POLL_EVENT_OBJ_INIT(obj)		\
 	}
 
@@ -3159,6 +3162,10 @@ struct k_sem {
 	sem_t sem;
 	unsigned int count;
 	unsigned int limit;
+	/* Guards waiters, and the count against a taker about to block */
+	struct k_spinlock lock;
+	/* Threads blocked in k_sem_take(), a give wakes the first one */
+	sys_dlist_t waiters;
 
 	Z_DECL_POLL_EVENT
 
@@ -3174,6 +3181,8 @@ struct k_sem {
 	.sem = SEM_INITIALIZER(initial_count), \
 	.count = (initial_count), \
 	.limit = (count_limit), \
+	.lock = { }, \
+	.waiters = SYS_DLIST_STATIC_INIT(&(obj).waiters), \
 	Z_POLL_EVENT_OBJ_INIT(obj) \
 	}
 
@@ -3922,7 +3931,6 @@ enum {
 
 /** @brief A structure used to submit work. */
 struct k_work {
-	struct wdog_s wdog;
 	/* All fields are protected by the work module spinlock.  No fields
 	 * are to be accessed except through kernel API.
 	 */
@@ -5133,7 +5141,14 @@ struct k_mem_slab {
 	_wait_q_t wait_q;
 	struct k_spinlock lock;
 	char *buffer;
-	char *free_list;
+	/* Index + 1 of the first free block in the low word, ABA tag in the
+	 * high word. Updated with compare-and-swap, or under lock where a
+	 * 64-bit compare-and-swap is not lock-free.
+	 */
+	uint64_t free_head;
+	/* Threads blocked in k_mem_slab_alloc(), under lock */
+	sys_dlist_t waiters;
+	uint32_t num_waiters;
 	struct k_mem_slab_info info;
 
 	SYS_PORT_TRACING_TRACKING_FIELD(k_mem_slab)
@@ -5149,7 +5164,9 @@ struct k_mem_slab {
 	.wait_q = Z_WAIT_Q_INIT(&(_slab).wait_q),                     \
 	.lock = {},                                                   \
 	.buffer = _slab_buffer,                                       \
-	.free_list = NULL,                                            \
+	.free_head = 0,                                               \
+	.waiters = SYS_DLIST_STATIC_INIT(&(_slab).waiters),           \
+	.num_waiters = 0,                                             \
 	.info = {_slab_num_blocks, _slab_block_size, 0}               \
 	}
 
@@ -24,6 +24,8 @@
 #include <zephyr/sys/atomic.h>
 #include <zephyr/kernel_structs.h>
 
+#ifdef CONFIG_ATOMIC_OPERATIONS_C
+
 /* Single global spinlock for atomic operations.  This is fallback
  * code, not performance sensitive.  At least by not using irq_lock()
  * in SMP contexts we won't content with legitimate users of the
@@ -340,3 +342,5 @@ atomic_val_t atomic_nand(atomic_t *target, atomic_val_t value)
 }
 
 ATOMIC_SYSCALL_HANDLER_TARGET_VALUE(atomic_nand);
+
+#endif /* CONFIG_ATOMIC_OPERATIONS_C */
@@ -114,4 +114,15 @@ static inline bool z_sched_wake_all(_wait_q_t *wait_q, int swap_retval,
 int z_sched_wait(struct k_spinlock *lock, k_spinlock_key_t key,
 		 _wait_q_t *wait_q, k_timeout_t timeout, void **data);
 
+/**
+ * Give a semaphore without notifying the k_poll() events registered on it
+ *
+ * For kernel objects that wake their own waiters through a private
+ * semaphore nobody polls on. Unlike k_sem_give() it does not take the poll
+ * lock, so it may be called with the poll lock or an object lock held.
+ *
+ * @param sem Address of the semaphore.
+ */
+void z_sem_give_no_poll(struct k_sem *sem);
+
 #endif /* ZEPHYR_KERNEL_INCLUDE_KSCHED_H_ */
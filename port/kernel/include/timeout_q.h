@@ -20,6 +20,20 @@
 extern "C" {
 #endif
 
+/* Ticks left until @p timeout expires, for finite timeouts. Absolute
+ * timeouts are converted against the current tick, expired ones give 0.
+ */
+static inline k_ticks_t z_timeout_delay_ticks(k_timeout_t timeout)
+{
+	k_ticks_t ticks = timeout.ticks;
+
+	if (IS_ENABLED(CONFIG_TIMEOUT_64BIT) && Z_TICK_ABS(ticks) >= 0) {
+		ticks = Z_TICK_ABS(ticks) - sys_clock_tick_get();
+	}
+
+	return MAX(ticks, 0);
+}
+
 #ifdef CONFIG_SYS_CLOCK_EXISTS
 
 static inline void z_init_timeout(struct _timeout *to)
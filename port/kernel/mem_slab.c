@@ -20,7 +20,121 @@
 #include <zephyr/init.h>
 #include <zephyr/sys/check.h>
 
-static struct k_spinlock lock;
+#include <ksched.h>
+
+/* A slab waiter is handed its block directly by k_mem_slab_free() */
+struct slab_waiter {
+	sys_dnode_t node;
+	struct k_sem sem;
+	void *mem;
+};
+
+/* The free list is lock-free where a 64-bit compare-and-swap is, otherwise
+ * it is updated under the slab lock.
+ */
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+#define FREE_LIST_LOCK_FREE 1
+#endif
+
+#define FREE_HEAD_IDX(head) ((uint32_t)(head))
+#define FREE_HEAD_TAG(head) ((uint32_t)((head) >> 32))
+#define FREE_HEAD(tag, idx) (((uint64_t)(tag) << 32) | (uint32_t)(idx))
+
+/* Free blocks are linked by storing the index + 1 of the next free block in
+ * their first word, 0 terminates the list.
+ */
+static inline uint32_t *block_next(struct k_mem_slab *slab, uint32_t idx)
+{
+	return (uint32_t *)(slab->buffer + (size_t)(idx - 1) * slab->info.block_size);
+}
+
+#if defined(FREE_LIST_LOCK_FREE)
+/**
+ * @brief Pop a block from the free list without taking any lock.
+ *
+ * The tag in the high word of the list head is bumped on every update, so a
+ * block that is popped and pushed back between our load and CAS can not be
+ * mistaken for an unchanged list.
+ *
+ * @return Address of the block, NULL if the slab is exhausted.
+ */
+static void *free_list_pop(struct k_mem_slab *slab)
+{
+	uint64_t head = __atomic_load_n(&slab->free_head, __ATOMIC_SEQ_CST);
+	uint64_t next;
+	uint32_t idx;
+
+	do {
+		idx = FREE_HEAD_IDX(head);
+		if (idx == 0) {
+			return NULL;
+		}
+
+		/* May read a block another thread just took, the CAS then fails */
+		next = FREE_HEAD(FREE_HEAD_TAG(head) + 1,
+				 __atomic_load_n(block_next(slab, idx), __ATOMIC_RELAXED));
+	} while (!__atomic_compare_exchange_n(&slab->free_head, &head, next, true,
+					      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	__atomic_fetch_add(&slab->info.num_used, 1, __ATOMIC_RELAXED);
+
+	return block_next(slab, idx);
+}
+
+static void free_list_push(struct k_mem_slab *slab, void *mem)
+{
+	uint32_t idx = ((char *)mem - slab->buffer) / slab->info.block_size + 1;
+	uint64_t head = __atomic_load_n(&slab->free_head, __ATOMIC_RELAXED);
+
+	__atomic_fetch_sub(&slab->info.num_used, 1, __ATOMIC_RELAXED);
+
+	do {
+		__atomic_store_n(block_next(slab, idx), FREE_HEAD_IDX(head), __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&slab->free_head, &head,
+					      FREE_HEAD(FREE_HEAD_TAG(head) + 1, idx), true,
+					      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+}
+
+/* Nothing to lock, the slab lock may or may not be held */
+#define free_list_pop_locked(slab) free_list_pop(slab)
+#else
+/* Pop a block from the free list, the slab lock must be held */
+static void *free_list_pop_locked(struct k_mem_slab *slab)
+{
+	uint32_t idx = FREE_HEAD_IDX(slab->free_head);
+
+	if (idx == 0) {
+		return NULL;
+	}
+
+	slab->free_head = FREE_HEAD(0, *block_next(slab, idx));
+	slab->info.num_used++;
+
+	return block_next(slab, idx);
+}
+
+static void *free_list_pop(struct k_mem_slab *slab)
+{
+	k_spinlock_key_t key = k_spin_lock(&slab->lock);
+	void *mem = free_list_pop_locked(slab);
+
+	k_spin_unlock(&slab->lock, key);
+
+	return mem;
+}
+
+static void free_list_push(struct k_mem_slab *slab, void *mem)
+{
+	uint32_t idx = ((char *)mem - slab->buffer) / slab->info.block_size + 1;
+	k_spinlock_key_t key = k_spin_lock(&slab->lock);
+
+	*block_next(slab, idx) = FREE_HEAD_IDX(slab->free_head);
+	slab->free_head = FREE_HEAD(0, idx);
+	slab->info.num_used--;
+
+	k_spin_unlock(&slab->lock, key);
+}
+#endif /* FREE_LIST_LOCK_FREE */
 
 /**
  * @brief Initialize kernel memory slab subsystem.
@@ -33,25 +147,29 @@ static struct k_spinlock lock;
  */
 static int create_free_list(struct k_mem_slab *slab)
 {
-	char *p;
+	uint32_t idx;
 
-    /* blocks must be word aligned */
-	CHECKIF(((slab->info.block_size | (uintptr_t)slab->buffer) &
-				(sizeof(void *) - 1)) != 0U) {
+	/* blocks must be word aligned and able to hold the next index */
+	CHECKIF((((slab->info.block_size | (uintptr_t)slab->buffer) &
+				(sizeof(void *) - 1)) != 0U) ||
+		slab->info.block_size < sizeof(uint32_t)) {
 		return -EINVAL;
 	}
 
-	slab->free_list = NULL;
-	p = slab->buffer + slab->info.block_size * (slab->info.num_blocks - 1);
+	for (idx = 1; idx < slab->info.num_blocks; idx++) {
+		*block_next(slab, idx) = idx + 1;
+	}
 
-	while (p >= slab->buffer) {
-		*(char **)p = slab->free_list;
-		slab->free_list = p;
-		p -= slab->info.block_size;
+	if (slab->info.num_blocks > 0) {
+		*block_next(slab, slab->info.num_blocks) = 0;
 	}
+
+	slab->free_head = FREE_HEAD(0, slab->info.num_blocks > 0 ? 1 : 0);
+	sys_dlist_init(&slab->waiters);
+	slab->num_waiters = 0;
+
 	return 0;
 }
-
 /**
  * @brief Complete initialization of statically defined memory slabs.
  *
@@ -79,50 +197,87 @@ SYS_INIT(init_mem_slab_obj_core_list, PRE_KERNEL_1,
 
 int k_mem_slab_alloc(struct k_mem_slab *slab, void **mem, k_timeout_t timeout)
 {
-	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct slab_waiter waiter;
+	k_spinlock_key_t key;
 	int result;
 
-	if (slab->free_list != NULL) {
-		/* take a free block */
-		*mem = slab->free_list;
-		slab->free_list = *(char **)(slab->free_list);
-		slab->info.num_used++;
-		result = 0;
+	*mem = free_list_pop(slab);
+	if (*mem != NULL) {
+		return 0;
 	} else if (K_TIMEOUT_EQ(timeout, K_NO_WAIT)) {
 		/* don't wait for a free block to become available */
-		*mem = NULL;
-		result = -ENOMEM;
-	} else {
-		result = z_sched_wait(&lock, key, &slab->wait_q, timeout, NULL);
-		if (result) {
-			return result;
-		}
+		return -ENOMEM;
+	}
 
-		__ASSERT_NO_MSG(slab->free_list != NULL);
+	waiter.mem = NULL;
+	k_sem_init(&waiter.sem, 0, 1);
 
-		key = k_spin_lock(&lock);
+	key = k_spin_lock(&slab->lock);
 
-		*mem = slab->free_list;
-		slab->free_list = *(char **)(slab->free_list);
-		slab->info.num_used++;
+	/* Publish the waiter before looking at the free list again, a free
+	 * racing with us either sees the waiter or left its block for us.
+	 */
+	sys_dlist_append(&slab->waiters, &waiter.node);
+	__atomic_fetch_add(&slab->num_waiters, 1, __ATOMIC_SEQ_CST);
 
-		k_spin_unlock(&lock, key);
+	*mem = free_list_pop_locked(slab);
+	if (*mem != NULL) {
+		sys_dlist_remove(&waiter.node);
+		__atomic_fetch_sub(&slab->num_waiters, 1, __ATOMIC_RELAXED);
+		k_spin_unlock(&slab->lock, key);
+		return 0;
 	}
 
-	k_spin_unlock(&lock, key);
+	k_spin_unlock(&slab->lock, key);
+
+	result = k_sem_take(&waiter.sem, timeout);
+
+	key = k_spin_lock(&slab->lock);
+
+	/* A block may have been handed over right as the wait timed out */
+	if (waiter.mem != NULL) {
+		result = 0;
+	} else {
+		sys_dlist_remove(&waiter.node);
+		__atomic_fetch_sub(&slab->num_waiters, 1, __ATOMIC_RELAXED);
+	}
+
+	k_spin_unlock(&slab->lock, key);
+
+	*mem = waiter.mem;
 
 	return result;
 }
 
 void k_mem_slab_free(struct k_mem_slab *slab, void *mem)
 {
-	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct slab_waiter *waiter;
+	k_spinlock_key_t key;
 
-	*(char **) mem = slab->free_list;
-	slab->free_list = (char *) mem;
-	slab->info.num_used--;
+	free_list_push(slab, mem);
+
+	if (__atomic_load_n(&slab->num_waiters, __ATOMIC_SEQ_CST) == 0) {
+		return;
+	}
+
+	/* Hand blocks to waiters one by one so they can not be stolen by a
+	 * K_NO_WAIT allocation between the wakeup and the waiter running.
+	 */
+	key = k_spin_lock(&slab->lock);
 
-	(void)z_sched_wake(&slab->wait_q, 0, NULL);
+	while (!sys_dlist_is_empty(&slab->waiters)) {
+		mem = free_list_pop_locked(slab);
+		if (mem == NULL) {
+			break;
+		}
+
+		waiter = CONTAINER_OF(sys_dlist_get(&slab->waiters),
+				      struct slab_waiter, node);
+		__atomic_fetch_sub(&slab->num_waiters, 1, __ATOMIC_RELAXED);
+
+		waiter->mem = mem;
+		z_sem_give_no_poll(&waiter->sem);
+	}
 
-	k_spin_unlock(&lock, key);
+	k_spin_unlock(&slab->lock, key);
 }
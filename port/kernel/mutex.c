@@ -18,6 +18,8 @@
 
 #include <zephyr/kernel.h>
 
+#include <timeout_q.h>
+
 int k_mutex_init(struct k_mutex *mutex)
 {
 	pthread_mutexattr_t attr;
@@ -34,26 +36,27 @@ int k_mutex_init(struct k_mutex *mutex)
 
 int k_mutex_lock(struct k_mutex *mutex, k_timeout_t timeout)
 {
-	uint32_t ms;
 	struct timespec abstime;
+	uint64_t ns;
 
 	if (K_TIMEOUT_EQ(timeout, K_FOREVER))
 		return pthread_mutex_lock(&mutex->mutex);
 	else if (K_TIMEOUT_EQ(timeout, K_NO_WAIT))
 		return pthread_mutex_trylock(&mutex->mutex);
 
-	clock_gettime(CLOCK_REALTIME, &abstime);
+	/* Deadline on the monotonic clock, unaffected by wall clock changes */
+	clock_gettime(CLOCK_MONOTONIC, &abstime);
 
-	ms = k_ticks_to_ms_ceil32(timeout.ticks);
+	ns = k_ticks_to_ns_ceil64(z_timeout_delay_ticks(timeout));
 
-	abstime.tv_sec += ms / MSEC_PER_SEC;
-	abstime.tv_nsec += (ms % MSEC_PER_SEC) * NSEC_PER_MSEC;
+	abstime.tv_sec += ns / NSEC_PER_SEC;
+	abstime.tv_nsec += ns % NSEC_PER_SEC;
 	if (abstime.tv_nsec >= NSEC_PER_SEC) {
 		abstime.tv_sec += 1;
 		abstime.tv_nsec -= NSEC_PER_SEC;
 	}
 
-	return pthread_mutex_timedlock(&mutex->mutex, &abstime);
+	return pthread_mutex_clocklock(&mutex->mutex, CLOCK_MONOTONIC, &abstime);
 }
 
 int k_mutex_unlock(struct k_mutex *mutex)
@@ -18,6 +18,8 @@
 
 #include <zephyr/kernel.h>
 
+#include <ksched.h>
+
 static struct k_spinlock lock = {};
 
 static inline void add_event(sys_dlist_t *events, struct k_poll_event *event,
@@ -99,48 +101,19 @@ static inline void register_event(struct k_poll_event *event,
 /* must be called with interrupts locked */
 static inline void clear_event_registration(struct k_poll_event *event)
 {
-	bool remove_event = false;
-
 	event->poller = NULL;
 
-	switch (event->type) {
-	case K_POLL_TYPE_SEM_AVAILABLE:
-		__ASSERT(event->sem != NULL, "invalid semaphore\n");
-		remove_event = true;
-		break;
-	case K_POLL_TYPE_DATA_AVAILABLE:
-		__ASSERT(event->queue != NULL, "invalid queue\n");
-		remove_event = true;
-		break;
-	case K_POLL_TYPE_SIGNAL:
-		__ASSERT(event->signal != NULL, "invalid poll signal\n");
-		remove_event = true;
-		break;
-	case K_POLL_TYPE_MSGQ_DATA_AVAILABLE:
-		__ASSERT(event->msgq != NULL, "invalid message queue\n");
-		remove_event = true;
-		break;
-	case K_POLL_TYPE_IGNORE:
-		/* nothing to do */
-		break;
-	default:
-		__ASSERT(false, "invalid event type\n");
-		break;
-	}
-	if (remove_event && sys_dnode_is_linked(&event->_node)) {
+	if (event->type != K_POLL_TYPE_IGNORE && sys_dnode_is_linked(&event->_node)) {
 		sys_dlist_remove(&event->_node);
 	}
 }
 
 /* must be called with interrupts locked */
 static inline void clear_event_registrations(struct k_poll_event *events,
-					      int num_events,
-					      k_spinlock_key_t key)
+					      int num_events)
 {
 	while (num_events--) {
 		clear_event_registration(&events[num_events]);
-		k_spin_unlock(&lock, key);
-		key = k_spin_lock(&lock);
 	}
 }
 
@@ -163,27 +136,22 @@ static bool event_match(struct k_poll_event *event, uint32_t state)
 	}
 }
 
+/* must be called with interrupts locked */
 static inline void set_event_ready(struct k_poll_event *event, uint32_t state)
 {
 	event->poller = NULL;
 	event->state |= state;
 
-    switch (event->type) {
-		case K_POLL_TYPE_DATA_AVAILABLE:
-			break;
-		case K_POLL_TYPE_SEM_AVAILABLE:
-			if (k_sem_count_get(event->sem) > 0) {
-				k_sem_reset(event->sem);
-			}
-			break;
-		case K_POLL_TYPE_SIGNAL:
-			if (event->signal->signaled != 0) {
-				event->signal->signaled = 0;
-			}
-			break;
+	/* Semaphores and queues are only reported, the caller takes the count
+	 * or the data itself. A raised signal is consumed by the poller that
+	 * sees it.
+	 */
+	if (event->type == K_POLL_TYPE_SIGNAL) {
+		event->signal->signaled = 0;
 	}
 }
 
+/* must be called with interrupts locked */
 static inline int register_events(struct k_poll_event *events,
 				  int num_events,
 				  struct z_poller *poller,
@@ -192,10 +160,8 @@ static inline int register_events(struct k_poll_event *events,
 	int events_registered = 0;
 
 	for (int ii = 0; ii < num_events; ii++) {
-		k_spinlock_key_t key;
 		uint32_t state;
 
-		key = k_spin_lock(&lock);
 		if (is_condition_met(&events[ii], &state)) {
 			set_event_ready(&events[ii], state);
 			poller->is_polling = false;
@@ -209,7 +175,6 @@ static inline int register_events(struct k_poll_event *events,
 			 */
 			;
 		}
-		k_spin_unlock(&lock, key);
 	}
 
 	return events_registered;
@@ -219,21 +184,22 @@ static int signal_poller(struct k_poll_event *event, uint32_t state)
 {
 	struct z_poller *poller = event->poller;
 
-    if (state == K_POLL_STATE_CANCELLED ||
-        event_match(event, state)) {
-        set_event_ready(event, state);
-        k_sem_give(&poller->sem);
-    }
+	if (state == K_POLL_STATE_CANCELLED ||
+	    event_match(event, state)) {
+		set_event_ready(event, state);
+		/* Called with the poll lock held, which k_sem_give() takes */
+		z_sem_give_no_poll(&poller->sem);
+	}
 
-    return 0;
+	return 0;
 }
 
 void k_poll_event_init(struct k_poll_event *event, uint32_t type,
 		       int mode, void *obj)
 {
-    event->type = type;
-    event->state = K_POLL_STATE_NOT_READY;
-    event->obj = obj;
+	event->type = type;
+	event->state = K_POLL_STATE_NOT_READY;
+	event->obj = obj;
 }
 
 int k_poll(struct k_poll_event *events, int num_events,
@@ -242,51 +208,52 @@ int k_poll(struct k_poll_event *events, int num_events,
 	int events_registered;
 	k_spinlock_key_t key;
 	struct z_poller poller;
-
-    k_sem_init(&poller.sem, 0, 1);
-	poller.is_polling = true;
+	int ret;
 
 	__ASSERT(events != NULL, "NULL events\n");
 	__ASSERT(num_events >= 0, "<0 events\n");
 
-	events_registered = register_events(events, num_events, &poller,
-					    K_TIMEOUT_EQ(timeout, K_NO_WAIT));
+	k_sem_init(&poller.sem, 0, 1);
+	poller.is_polling = true;
 
+	/* The whole array is checked and registered in one critical section,
+	 * objects signal the poller semaphore directly from then on.
+	 */
 	key = k_spin_lock(&lock);
 
+	events_registered = register_events(events, num_events, &poller,
+					    K_TIMEOUT_EQ(timeout, K_NO_WAIT));
+
 	/*
 	 * If we're not polling anymore, it means that at least one event
-	 * condition is met, either when looping through the events here or
-	 * because one of the events registered has had its state changed.
+	 * condition is met while looping through the events here.
 	 */
 	if (!poller.is_polling) {
-		clear_event_registrations(events, events_registered, key);
+		clear_event_registrations(events, events_registered);
 		k_spin_unlock(&lock, key);
 
 		return 0;
 	}
 
-	poller.is_polling = false;
+	k_spin_unlock(&lock, key);
 
 	if (K_TIMEOUT_EQ(timeout, K_NO_WAIT)) {
-		k_spin_unlock(&lock, key);
-
 		return -EAGAIN;
 	}
 
-	int ret = k_sem_take(&poller.sem, timeout);
+	ret = k_sem_take(&poller.sem, timeout);
 
 	/*
-	 * Clear all event registrations. If events happen while we're in this
-	 * loop, and we already had one that triggered, that's OK: they will
-	 * end up in the list of events that are ready; if we timed out, and
-	 * events happen while we're in this loop, that is OK as well since
-	 * we've already know the return code (-EAGAIN), and even if they are
-	 * added to the list of events that occurred, the user has to check the
-	 * return code first, which invalidates the whole list of event states.
+	 * Clear all event registrations. An event signaled between the wait
+	 * timing out and the registrations being cleared has already been
+	 * consumed (e.g. a signal was reset), so report it rather than the
+	 * timeout.
 	 */
 	key = k_spin_lock(&lock);
-	clear_event_registrations(events, events_registered, key);
+	clear_event_registrations(events, events_registered);
+	if (ret != 0 && !poller.is_polling) {
+		ret = 0;
+	}
 	k_spin_unlock(&lock, key);
 
 	return ret;
@@ -17,10 +17,22 @@
  *****************************************************************************/
 #include <zephyr/kernel.h>
 
+#include <ksched.h>
+#include <wait_q.h>
+
+/* A thread blocked in k_queue_get(), data is handed to it directly */
+struct queue_waiter {
+	sys_dnode_t node;
+	struct k_sem sem;
+	void *data;
+};
+
 void k_queue_init(struct k_queue *queue)
 {
 	sys_sflist_init(&queue->data_q);
 	queue->lock = (struct k_spinlock) {};
+	z_waitq_init(&queue->wait_q);
+	sys_dlist_init(&queue->waiters);
 	sys_dlist_init(&queue->poll_events);
 }
 
@@ -29,14 +41,45 @@ static void handle_poll_events(struct k_queue *queue, uint32_t state)
 	z_handle_obj_poll_events(&queue->poll_events, state);
 }
 
+/* must be called with the queue locked */
+static bool queue_handoff(struct k_queue *queue, void *data)
+{
+	struct queue_waiter *waiter;
+	sys_dnode_t *node;
+
+	node = sys_dlist_get(&queue->waiters);
+	if (node == NULL) {
+		return false;
+	}
+
+	waiter = CONTAINER_OF(node, struct queue_waiter, node);
+	waiter->data = data;
+	/* Leaves the poll lock out, it is never taken after the queue lock */
+	z_sem_give_no_poll(&waiter->sem);
+
+	return true;
+}
+
 void k_queue_cancel_wait(struct k_queue *queue)
 {
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&queue->lock);
+	(void)queue_handoff(queue, NULL);
+	k_spin_unlock(&queue->lock, key);
+
 	handle_poll_events(queue, K_POLL_STATE_CANCELLED);
 }
 
 void k_queue_insert(struct k_queue *queue, void *prev, void *data)
 {
 	k_spinlock_key_t key = k_spin_lock(&queue->lock);
+
+	if (queue_handoff(queue, data)) {
+		k_spin_unlock(&queue->lock, key);
+		return;
+	}
+
 	sys_sflist_insert(&queue->data_q, prev, data);
 	k_spin_unlock(&queue->lock, key);
 
@@ -48,6 +91,11 @@ void k_queue_append(struct k_queue *queue, void *data)
 	k_spinlock_key_t key;
 
 	key = k_spin_lock(&queue->lock);
+	if (queue_handoff(queue, data)) {
+		k_spin_unlock(&queue->lock, key);
+		return;
+	}
+
 	sys_sflist_append(&queue->data_q, data);
 	k_spin_unlock(&queue->lock, key);
 
@@ -59,50 +107,49 @@ void k_queue_prepend(struct k_queue *queue, void *data)
 	k_spinlock_key_t key;
 
 	key = k_spin_lock(&queue->lock);
+	if (queue_handoff(queue, data)) {
+		k_spin_unlock(&queue->lock, key);
+		return;
+	}
+
 	sys_sflist_prepend(&queue->data_q, data);
 	k_spin_unlock(&queue->lock, key);
 
 	handle_poll_events(queue, K_POLL_STATE_DATA_AVAILABLE);
 }
 
-static void *k_queue_poll(struct k_queue *queue, k_timeout_t timeout)
+void *k_queue_get(struct k_queue *queue, k_timeout_t timeout)
 {
-	struct k_poll_event event;
+	struct queue_waiter waiter;
 	k_spinlock_key_t key;
-	void *data = NULL;
-	int err;
-
-	k_poll_event_init(&event, K_POLL_TYPE_DATA_AVAILABLE,
-			  K_POLL_MODE_NOTIFY_ONLY, queue);
-
-	event.state = K_POLL_STATE_NOT_READY;
-	err = k_poll(&event, 1, timeout);
-	if (err)
-		return NULL;
+	void *data;
 
 	key = k_spin_lock(&queue->lock);
 	data = sys_sflist_get(&queue->data_q);
+	if (data != NULL || K_TIMEOUT_EQ(timeout, K_NO_WAIT)) {
+		k_spin_unlock(&queue->lock, key);
+		return data;
+	}
+
+	/* The list is only ever non-empty while nobody waits, so producers
+	 * hand their item to the first waiter instead of linking it.
+	 */
+	sys_dnode_init(&waiter.node);
+	k_sem_init(&waiter.sem, 0, 1);
+	waiter.data = NULL;
+	sys_dlist_append(&queue->waiters, &waiter.node);
 	k_spin_unlock(&queue->lock, key);
 
-	return data;
-}
+	(void)k_sem_take(&waiter.sem, timeout);
 
-void *k_queue_get(struct k_queue *queue, k_timeout_t timeout)
-{
-	k_spinlock_key_t key;
-	void *data;
-
-	if (sys_sflist_is_empty(&queue->data_q)) {
-		if (K_TIMEOUT_EQ(timeout, K_NO_WAIT))
-			return NULL;
-	} else {
-		key = k_spin_lock(&queue->lock);
-		data = sys_sflist_get(&queue->data_q);
-		k_spin_unlock(&queue->lock, key);
-		return data;
+	/* Timed out, unless a producer dequeued us in the meantime */
+	key = k_spin_lock(&queue->lock);
+	if (sys_dnode_is_linked(&waiter.node)) {
+		sys_dlist_remove(&waiter.node);
 	}
+	k_spin_unlock(&queue->lock, key);
 
-	return k_queue_poll(queue, timeout);
+	return waiter.data;
 }
 
 int k_queue_append_list(struct k_queue *queue, void *head, void *tail)
@@ -110,7 +157,18 @@ int k_queue_append_list(struct k_queue *queue, void *head, void *tail)
 	k_spinlock_key_t key;
 
 	key = k_spin_lock(&queue->lock);
-	sys_sflist_append_list(&queue->data_q, head, tail);
+	while (head != NULL && queue_handoff(queue, head)) {
+		if (head == tail) {
+			k_spin_unlock(&queue->lock, key);
+			return 0;
+		}
+
+		head = sys_sflist_peek_next_no_check(head);
+	}
+
+	if (head != NULL) {
+		sys_sflist_append_list(&queue->data_q, head, tail);
+	}
 	k_spin_unlock(&queue->lock, key);
 
 	handle_poll_events(queue, K_POLL_STATE_DATA_AVAILABLE);
@@ -18,61 +18,126 @@
 
 #include <zephyr/kernel.h>
 
+#include <ksched.h>
+#include <timeout_q.h>
+
+/* A thread blocked in k_sem_take(), woken on its own semaphore */
+struct sem_waiter {
+	sys_dnode_t node;
+	sem_t wake;
+	/* 0 if given the semaphore, -EAGAIN if woken by k_sem_reset() */
+	int ret;
+};
+
+/* must be called with the semaphore locked */
+static bool sem_wake(struct k_sem *sem, int ret)
+{
+	struct sem_waiter *waiter;
+	sys_dnode_t *node;
 
+	node = sys_dlist_get(&sem->waiters);
+	if (node == NULL) {
+		return false;
+	}
 
-#include <sys/time.h>
+	waiter = CONTAINER_OF(node, struct sem_waiter, node);
+	waiter->ret = ret;
+	nxsem_post(&waiter->wake);
+
+	return true;
+}
 
 int k_sem_init(struct k_sem *sem,
 		unsigned int initial_count, unsigned int limit)
 {
 	sem->limit = limit;
+	sem->lock = (struct k_spinlock) {};
+	sys_dlist_init(&sem->waiters);
+#ifdef CONFIG_POLL
+	sys_dlist_init(&sem->poll_events);
+#endif
 	return nxsem_init(&sem->sem, 0, initial_count);
 }
 
-void k_sem_give(struct k_sem *sem)
+void z_sem_give_no_poll(struct k_sem *sem)
 {
+	k_spinlock_key_t key;
 	int semcount;
 
-	nxsem_get_value(&sem->sem, &semcount);
+	key = k_spin_lock(&sem->lock);
+
+	/* Hand the count straight to the first waiter */
+	if (!sem_wake(sem, 0)) {
+		nxsem_get_value(&sem->sem, &semcount);
+
+		if ((uint32_t)semcount < sem->limit)
+			nxsem_post(&sem->sem);
+	}
+
+	k_spin_unlock(&sem->lock, key);
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+	z_sem_give_no_poll(sem);
 
-	if (semcount < 0 || (uint32_t)semcount < sem->limit)
-		nxsem_post(&sem->sem);
+#ifdef CONFIG_POLL
+	z_handle_obj_poll_events(&sem->poll_events, K_POLL_STATE_SEM_AVAILABLE);
+#endif
 }
 
 int k_sem_take(struct k_sem *sem, k_timeout_t timeout)
 {
+	struct sem_waiter waiter;
+	k_spinlock_key_t key;
+	k_ticks_t ticks;
 	int ret;
-	uint32_t ms;
-	struct timespec abstime;
-
-	if (K_TIMEOUT_EQ(timeout, K_FOREVER))
-		return nxsem_wait_uninterruptible(&sem->sem);
-	else if (K_TIMEOUT_EQ(timeout, K_NO_WAIT)) {
-		ret = nxsem_trywait(&sem->sem);
-		if (ret) {
-			return -EBUSY;
-		}
 
+	if (nxsem_trywait(&sem->sem) == 0) {
 		return 0;
 	}
 
-	clock_gettime(CLOCK_REALTIME, &abstime);
+	if (K_TIMEOUT_EQ(timeout, K_NO_WAIT)) {
+		return -EBUSY;
+	}
 
-	ms = k_ticks_to_ms_ceil32(timeout.ticks);
+	/* Look at the count again under the lock, a give either lands
+	 * there before we queue or finds us queued.
+	 */
+	key = k_spin_lock(&sem->lock);
+	if (nxsem_trywait(&sem->sem) == 0) {
+		k_spin_unlock(&sem->lock, key);
+		return 0;
+	}
 
-	abstime.tv_sec += ms / MSEC_PER_SEC;
-	abstime.tv_nsec += (ms % MSEC_PER_SEC) * NSEC_PER_MSEC;
-	if (abstime.tv_nsec >= NSEC_PER_SEC) {
-		abstime.tv_sec += 1;
-		abstime.tv_nsec -= NSEC_PER_SEC;
+	sys_dnode_init(&waiter.node);
+	nxsem_init(&waiter.wake, 0, 0);
+	waiter.ret = -EAGAIN;
+	sys_dlist_append(&sem->waiters, &waiter.node);
+	k_spin_unlock(&sem->lock, key);
+
+	if (K_TIMEOUT_EQ(timeout, K_FOREVER)) {
+		nxsem_wait_uninterruptible(&waiter.wake);
+	} else {
+		/* Kernel ticks are system ticks here, wait on the monotonic
+		 * tick count directly rather than a wall clock deadline in ms.
+		 */
+		ticks = MIN(z_timeout_delay_ticks(timeout), UINT32_MAX);
+
+		nxsem_tickwait_uninterruptible(&waiter.wake, (uint32_t)ticks);
 	}
 
-	ret = nxsem_timedwait_uninterruptible(&sem->sem, &abstime);
-	if (ret) {
-		return -EAGAIN;
+	/* Timed out, unless a give or a reset dequeued us in the meantime */
+	key = k_spin_lock(&sem->lock);
+	if (sys_dnode_is_linked(&waiter.node)) {
+		sys_dlist_remove(&waiter.node);
 	}
+	ret = waiter.ret;
+	k_spin_unlock(&sem->lock, key);
+
+	nxsem_destroy(&waiter.wake);
 
-	return 0;
+	return ret;
 }
 
 unsigned int k_sem_count_get(struct k_sem *sem)
@@ -81,13 +146,25 @@ unsigned int k_sem_count_get(struct k_sem *sem)
 	int ret;
 
 	ret = nxsem_get_value(&sem->sem, &val);
-	if (ret)
-		val = ret;
+	if (ret || val < 0)
+		val = 0;
 
 	return val;
 }
 
 void k_sem_reset(struct k_sem *sem)
 {
-	k_sem_init(sem, 0, 0);
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&sem->lock);
+
+	/* Drop the count but keep the limit */
+	while (nxsem_trywait(&sem->sem) == 0) {
+	}
+
+	/* Then wake the threads waiting right now, and only them */
+	while (sem_wake(sem, -EAGAIN)) {
+	}
+
+	k_spin_unlock(&sem->lock, key);
 }
@@ -15,14 +15,23 @@
  * limitations under the License.
  *
  *****************************************************************************/
+#include <pthread.h>
 #include <sys/prctl.h>
 
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
 
-static sys_dlist_t g_task_list = SYS_DLIST_STATIC_INIT(&g_task_list);
+/* Each thread created by k_thread_create() keeps its k_thread in a
+ * thread-specific slot, so looking up the current thread costs one
+ * pthread_getspecific() and the slot goes away with the thread.
+ */
+static pthread_key_t g_thread_key;
+static pthread_once_t g_thread_key_once = PTHREAD_ONCE_INIT;
+static int g_thread_key_err;
 
 typedef struct
 {
+	struct k_thread *thread;
 	void *argv[4];
 } k_thread_main_t;
 
@@ -31,23 +40,35 @@ bool k_is_in_isr(void)
 	return false;
 }
 
+static void k_thread_key_create(void)
+{
+	int ret;
+
+	ret = pthread_key_create(&g_thread_key, NULL);
+	if (ret != 0) {
+		LOG_ERR("no thread-specific key left (%d)", ret);
+		g_thread_key_err = ret;
+	}
+}
+
 k_tid_t k_thread_current(void)
 {
 	struct k_thread *thread;
-	void *pid = (void *)gettid();
+
+	pthread_once(&g_thread_key_once, k_thread_key_create);
+
+	if (g_thread_key_err == 0) {
+		thread = pthread_getspecific(g_thread_key);
+		if (thread != NULL)
+			return thread;
+	}
 
 #if !defined(CONFIG_ZEPHYR_WORK_QUEUE)
-	if (pid == k_sys_work_q.thread.init_data)
+	if ((void *)gettid() == k_sys_work_q.thread.init_data)
 		return &k_sys_work_q.thread;
 
 #endif /* !CONFIG_ZEPHYR_WORK_QUEUE */
 
-	SYS_DLIST_FOR_EACH_CONTAINER(&g_task_list, thread, base.qnode_dlist) {
-		if (thread->init_data == pid) {
-			return thread;
-		}
-	}
-
 	return NULL;
 }
 
@@ -55,16 +76,22 @@ static void *k_thread_main(void * args)
 {
 	struct sched_param param;
 	k_thread_main_t *_main;
+	struct k_thread *thread;
 	void *_argv[4];
 
 	_main = args;
 	if (_main == NULL)
 		return NULL;
 
+	thread = _main->thread;
 	memcpy(_argv, _main->argv, sizeof(_argv));
 
 	free(_main);
 
+	/* The creator may not have stored our id yet */
+	thread->init_data = (void *)pthread_self();
+	pthread_setspecific(g_thread_key, thread);
+
 	sched_getparam(0, &param);
 	sched_setscheduler(0, SCHED_FIFO, &param);
 
@@ -92,10 +119,16 @@ k_tid_t k_thread_create(struct k_thread *new_thread,
 	};
 	int ret;
 
+	/* Threads that can not be found again are not created */
+	pthread_once(&g_thread_key_once, k_thread_key_create);
+	if (g_thread_key_err != 0)
+		return (k_tid_t)(intptr_t)-g_thread_key_err;
+
 	_main = malloc(sizeof(*_main));
 	if (_main == NULL)
 		return (k_tid_t)(intptr_t)-ENOMEM;
 
+	_main->thread = new_thread;
 	_main->argv[0] = entry;
 	_main->argv[1] = p1;
 	_main->argv[2] = p2;
@@ -120,7 +153,6 @@ k_tid_t k_thread_create(struct k_thread *new_thread,
 #endif /* CONFIG_SMP */
 
 	new_thread->init_data = (void *)pid;
-	sys_dlist_append(&g_task_list, &new_thread->base.qnode_dlist);
 
 	return (k_tid_t)new_thread;
 }
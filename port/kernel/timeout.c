@@ -17,22 +17,31 @@
  *****************************************************************************/
 #include <zephyr/kernel.h>
 
+#include <timeout_q.h>
+
 int64_t sys_clock_tick_get(void)
 {
 #if defined(CONFIG_SYSTEM_TIME64)
 	return clock_systime_ticks();
 #else
-	static int64_t g_tick;
-
-	unsigned int state = enter_critical_section();
+	/* Extend the 32 bit tick counter to 63 bits without a lock. Bits 0-30
+	 * of g_tick_hi count wraps of the low word, bit 31 mirrors the top bit
+	 * of the low word at the last update. Whoever sees the two top bits
+	 * disagree moves the high word on; concurrent callers compute the same
+	 * value. This only needs a call at least once every 2^31 ticks.
+	 */
+	static uint32_t g_tick_hi;
+	uint32_t hi, lo;
 
-	uint32_t tick = clock_systime_ticks();
+	hi = __atomic_load_n(&g_tick_hi, __ATOMIC_ACQUIRE);
+	lo = clock_systime_ticks();
 
-	g_tick += (uint32_t)(tick - (uint32_t)g_tick);
-
-	leave_critical_section(state);
+	if ((int32_t)(hi ^ lo) < 0) {
+		hi = (hi ^ 0x80000000) + (hi >> 31);
+		__atomic_store_n(&g_tick_hi, hi, __ATOMIC_RELEASE);
+	}
 
-	return g_tick;
+	return (int64_t)((((uint64_t)hi << 32) | lo) & INT64_MAX);
 #endif
 }
 
@@ -78,35 +87,359 @@ k_timepoint_t sys_timepoint_calc(k_timeout_t timeout)
 	return timepoint;
 }
 
+/* Hierarchical timer wheel for all _timeout users, driven by one NuttX
+ * watchdog. Level L holds timeouts due 64^L to 64^(L+1) ticks after the
+ * wheel position and is cascaded into the lower levels whenever the
+ * position crosses a 64^L boundary, anything further out waits on the
+ * overflow list. The watchdog is only armed for the next tick something
+ * is due or has to be cascaded, and every timeout due by then is expired
+ * from that single callback.
+ */
+
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+
+#define WHEEL_SPAN(level) (1ULL << (WHEEL_BITS * (level)))
+#define WHEEL_SLOT(level, tick) (((tick) >> (WHEEL_BITS * (level))) & (WHEEL_SLOTS - 1))
+#define WHEEL_ALIGN_UP(tick, span) (((tick) + (span) - 1) & ~((span) - 1))
+
+static struct {
+	/* Next tick to process, everything before it has expired */
+	uint64_t base;
+	/* Tick the watchdog is armed for, UINT64_MAX when idle */
+	uint64_t armed;
+	/* Slot lists are initialized when their bit is first set */
+	uint64_t occupied[WHEEL_LEVELS];
+	sys_dlist_t slots[WHEEL_LEVELS][WHEEL_SLOTS];
+	sys_dlist_t overflow;
+	struct wdog_s wdog;
+} g_wheel = {
+	.armed = UINT64_MAX,
+	.overflow = SYS_DLIST_STATIC_INIT(&g_wheel.overflow),
+};
+
+static struct k_spinlock g_wheel_lock;
+
+static void wheel_expire(wdparm_t arg);
+
+static inline uint64_t timeout_expiry(const struct _timeout *to)
+{
+#ifdef CONFIG_TIMEOUT_64BIT
+	return to->dticks;
+#else
+	/* Only the low 32 bits are stored, pending timeouts are within
+	 * 2^31 ticks of the wheel position.
+	 */
+	return g_wheel.base + (int32_t)((uint32_t)to->dticks - (uint32_t)g_wheel.base);
+#endif
+}
+
+/* must be called with g_wheel_lock held */
+static bool wheel_level_empty(int level)
+{
+	uint64_t bits;
+
+	if (level == WHEEL_LEVELS) {
+		return sys_dlist_is_empty(&g_wheel.overflow);
+	}
+
+	/* Bits are not cleared on abort, drop the stale ones here */
+	bits = g_wheel.occupied[level];
+	while (bits != 0) {
+		int slot = __builtin_ctzll(bits);
+
+		bits &= bits - 1;
+		if (!sys_dlist_is_empty(&g_wheel.slots[level][slot])) {
+			return false;
+		}
+
+		g_wheel.occupied[level] &= ~BIT64(slot);
+	}
+
+	return true;
+}
+
+/* must be called with g_wheel_lock held */
+static void wheel_insert(struct _timeout *to)
+{
+	uint64_t expiry = MAX(timeout_expiry(to), g_wheel.base);
+	uint64_t delta = expiry - g_wheel.base;
+	sys_dlist_t *list;
+	int level;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		if (delta < WHEEL_SPAN(level + 1)) {
+			break;
+		}
+	}
+
+	if (level == WHEEL_LEVELS) {
+		list = &g_wheel.overflow;
+	} else {
+		int slot = WHEEL_SLOT(level, expiry);
+
+		list = &g_wheel.slots[level][slot];
+		if (!(g_wheel.occupied[level] & BIT64(slot))) {
+			g_wheel.occupied[level] |= BIT64(slot);
+			sys_dlist_init(list);
+		}
+	}
+
+	sys_dlist_append(list, &to->node);
+}
+
+/* must be called with g_wheel_lock held */
+static void wheel_cascade(sys_dlist_t *list)
+{
+	sys_dlist_t pending;
+	sys_dnode_t *node;
+
+	sys_dlist_init(&pending);
+	while ((node = sys_dlist_get(list)) != NULL) {
+		sys_dlist_append(&pending, node);
+	}
+
+	while ((node = sys_dlist_get(&pending)) != NULL) {
+		wheel_insert(CONTAINER_OF(node, struct _timeout, node));
+	}
+}
+
+/* Process g_wheel.base, called when the wheel position reaches it.
+ * Expired timeouts are moved to @p expired.
+ *
+ * must be called with g_wheel_lock held
+ */
+static void wheel_advance(sys_dlist_t *expired)
+{
+	uint64_t tick = g_wheel.base;
+	int slot = WHEEL_SLOT(0, tick);
+	sys_dnode_t *node;
+
+	if (slot == 0) {
+		int level;
+
+		for (level = 1; level < WHEEL_LEVELS; level++) {
+			int hslot = WHEEL_SLOT(level, tick);
+
+			if (g_wheel.occupied[level] & BIT64(hslot)) {
+				g_wheel.occupied[level] &= ~BIT64(hslot);
+				wheel_cascade(&g_wheel.slots[level][hslot]);
+			}
+
+			if (hslot != 0) {
+				break;
+			}
+		}
+
+		if (level == WHEEL_LEVELS) {
+			wheel_cascade(&g_wheel.overflow);
+		}
+	}
+
+	if (g_wheel.occupied[0] & BIT64(slot)) {
+		g_wheel.occupied[0] &= ~BIT64(slot);
+		while ((node = sys_dlist_get(&g_wheel.slots[0][slot])) != NULL) {
+			sys_dlist_append(expired, node);
+		}
+	}
+
+	g_wheel.base = tick + 1;
+}
+
+/* Earliest tick at which something is due or must be cascaded
+ *
+ * must be called with g_wheel_lock held
+ */
+static uint64_t wheel_next(void)
+{
+	uint64_t next = UINT64_MAX;
+	uint64_t base = g_wheel.base;
+
+	for (int level = 0; level < WHEEL_LEVELS; level++) {
+		uint64_t span = WHEEL_SPAN(level);
+		uint64_t period = base >> (WHEEL_BITS * level);
+		uint64_t bits;
+
+		if (wheel_level_empty(level)) {
+			continue;
+		}
+
+		bits = g_wheel.occupied[level];
+		while (bits != 0) {
+			int slot = __builtin_ctzll(bits);
+			uint64_t ahead = (slot - period) & (WHEEL_SLOTS - 1);
+			uint64_t tick;
+
+			bits &= bits - 1;
+
+			if (level == 0) {
+				tick = base + ahead;
+			} else {
+				/* The current slot was cascaded on entering this
+				 * period unless the position sits on its boundary.
+				 */
+				if (ahead == 0 && (base & (span - 1)) != 0) {
+					ahead = WHEEL_SLOTS;
+				}
+
+				tick = (period + ahead) * span;
+			}
+
+			next = MIN(next, tick);
+		}
+	}
+
+	if (!wheel_level_empty(WHEEL_LEVELS)) {
+		uint64_t span = WHEEL_SPAN(WHEEL_LEVELS);
+
+		next = MIN(next, WHEEL_ALIGN_UP(base, span));
+	}
+
+	return next;
+}
+
+/* must be called with g_wheel_lock held */
+static void wheel_arm(uint64_t now)
+{
+	uint64_t next = wheel_next();
+
+	if (next == UINT64_MAX) {
+		if (g_wheel.armed != UINT64_MAX) {
+			wd_cancel(&g_wheel.wdog);
+			g_wheel.armed = UINT64_MAX;
+		}
+
+		return;
+	}
+
+	if (next == g_wheel.armed) {
+		return;
+	}
+
+	g_wheel.armed = next;
+	wd_start(&g_wheel.wdog, next > now ? MIN(next - now, INT32_MAX) : 1,
+		 wheel_expire, 0);
+}
+
+static void wheel_expire(wdparm_t arg)
+{
+	k_spinlock_key_t key = k_spin_lock(&g_wheel_lock);
+	uint64_t now = sys_clock_tick_get();
+	sys_dlist_t expired;
+	sys_dnode_t *node;
+
+	sys_dlist_init(&expired);
+	g_wheel.armed = UINT64_MAX;
+
+	while (g_wheel.base <= now) {
+		int level;
+
+		wheel_advance(&expired);
+
+		/* Jump over stretches where nothing can expire or cascade */
+		for (level = 0; level <= WHEEL_LEVELS; level++) {
+			if (!wheel_level_empty(level)) {
+				break;
+			}
+		}
+
+		if (level > WHEEL_LEVELS) {
+			g_wheel.base = now + 1;
+		} else if (level > 0) {
+			uint64_t span = WHEEL_SPAN(level);
+
+			g_wheel.base = MIN(WHEEL_ALIGN_UP(g_wheel.base, span), now + 1);
+		}
+	}
+
+	/* Run the callbacks one at a time without the lock, a timeout still
+	 * on the expired list can be aborted meanwhile.
+	 */
+	while ((node = sys_dlist_get(&expired)) != NULL) {
+		struct _timeout *to = CONTAINER_OF(node, struct _timeout, node);
+
+		k_spin_unlock(&g_wheel_lock, key);
+		to->fn(to);
+		key = k_spin_lock(&g_wheel_lock);
+	}
+
+	wheel_arm(sys_clock_tick_get());
+
+	k_spin_unlock(&g_wheel_lock, key);
+}
+
 k_ticks_t z_timeout_remaining(const struct _timeout *timeout)
 {
-	clock_t qtime, curr, elapsed;
-	struct k_work_delayable *dwork;
+	k_spinlock_key_t key = k_spin_lock(&g_wheel_lock);
+	k_ticks_t ticks = 0;
 
-	dwork = CONTAINER_OF(timeout, struct k_work_delayable, timeout);
+	if (sys_dnode_is_linked(&timeout->node)) {
+		uint64_t expiry = timeout_expiry(timeout);
+		uint64_t now = sys_clock_tick_get();
 
-	return wd_gettime(&dwork->work.wdog);
+		ticks = expiry > now ? expiry - now : 0;
+	}
+
+	k_spin_unlock(&g_wheel_lock, key);
+
+	return ticks;
 }
 
 void z_add_timeout(struct _timeout *to, _timeout_func_t fn,
 		   k_timeout_t timeout)
 {
-	struct k_work_delayable *dwork;
+	k_spinlock_key_t key;
+	uint64_t now;
 
 	if (K_TIMEOUT_EQ(timeout, K_FOREVER)) {
 		return;
 	}
 
-	dwork = CONTAINER_OF(to, struct k_work_delayable, timeout);
+	key = k_spin_lock(&g_wheel_lock);
 
-	(void)wd_start(&dwork->work.wdog, timeout.ticks, (wdentry_t)fn, (wdparm_t)to);
+	if (sys_dnode_is_linked(&to->node)) {
+		sys_dlist_remove(&to->node);
+	}
+
+	now = sys_clock_tick_get();
+
+	/* An idle wheel just moves to the current tick */
+	if (g_wheel.armed == UINT64_MAX) {
+		bool idle = true;
+
+		for (int level = 0; level <= WHEEL_LEVELS; level++) {
+			idle = idle && wheel_level_empty(level);
+		}
+
+		if (idle) {
+			g_wheel.base = MAX(g_wheel.base, now);
+		}
+	}
+
+	to->fn = fn;
+	to->dticks = now + z_timeout_delay_ticks(timeout);
+	wheel_insert(to);
+
+	if (timeout_expiry(to) < g_wheel.armed) {
+		wheel_arm(now);
+	}
+
+	k_spin_unlock(&g_wheel_lock, key);
 }
 
 int z_abort_timeout(struct _timeout *to)
 {
-	struct k_work_delayable *dwork;
+	k_spinlock_key_t key = k_spin_lock(&g_wheel_lock);
+	int ret = -EINVAL;
 
-	dwork = CONTAINER_OF(to, struct k_work_delayable, timeout);
+	/* The watchdog is left armed, an early wakeup finds nothing to do */
+	if (sys_dnode_is_linked(&to->node)) {
+		sys_dlist_remove(&to->node);
+		ret = 0;
+	}
+
+	k_spin_unlock(&g_wheel_lock, key);
 
-	return wd_cancel(&dwork->work.wdog);
-}
\ No newline at end of file
+	return ret;
+}
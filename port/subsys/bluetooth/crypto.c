@@ -7,23 +7,550 @@
 #include <string.h>
 #include <errno.h>
 
-#include <zephyr.h>
-#include <sys/byteorder.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/check.h>
 
-#include <bluetooth/bluetooth.h>
-#include <bluetooth/hci.h>
-#include <bluetooth/conn.h>
-#include <bluetooth/crypto.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/crypto.h>
 
 #include <nuttx/crypto/crypto.h>
 
+#if defined(CONFIG_BT_AES_KEY_SCHEDULE)
+#include <crypto/aes.h>
+#endif
+
 #include "hci_core.h"
 
+#define LOG_LEVEL CONFIG_BT_HCI_CORE_LOG_LEVEL
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bt_port_crypto);
+
+#if defined(CONFIG_BT_RAND_DRBG)
+/* CTR_DRBG with AES-128 and no derivation function, NIST SP 800-90A
+ * section 10.2.1. The controller's HCI_LE_Rand is the entropy source: it is
+ * used once to instantiate, and then to reseed from the system work queue
+ * every CONFIG_BT_RAND_DRBG_RESEED_PERIOD seconds, or once
+ * CONFIG_BT_RAND_DRBG_RESEED_INTERVAL requests have been served. Requests
+ * only wait on the controller if a reseed is overdue by another interval.
+ */
+#define DRBG_KEY_LEN   16
+#define DRBG_BLOCK_LEN 16
+#define DRBG_SEED_LEN  (DRBG_KEY_LEN + DRBG_BLOCK_LEN)
+
+/* Counter blocks encrypted per bt_aes_encrypt_many() call */
+#define DRBG_BATCH     4
+
+/* max_number_of_bits_per_request, 2^19 bits */
+#define DRBG_MAX_REQUEST 65536
+
+struct drbg {
+	struct bt_aes_ctx aes;
+	uint8_t v[DRBG_BLOCK_LEN];
+	uint32_t reseed_counter;
+	bool instantiated;
+};
+
+static struct drbg drbg;
+static K_MUTEX_DEFINE(drbg_lock);
+
+#if defined(CONFIG_BT_RAND_DRBG_STATS)
+static struct bt_rand_stats drbg_stats;
+
+#define DRBG_STATS_ADD(field, n) (drbg_stats.field += (n))
+#else
+#define DRBG_STATS_ADD(field, n)
+#endif /* CONFIG_BT_RAND_DRBG_STATS */
+
+static void drbg_v_inc(uint8_t v[DRBG_BLOCK_LEN])
+{
+	for (int i = DRBG_BLOCK_LEN - 1; i >= 0; i--) {
+		if (++v[i]) {
+			break;
+		}
+	}
+}
+
+/* Encrypt the next @p blocks values of the counter into @p out */
+static int drbg_ctr(struct drbg *d, uint8_t *out, size_t blocks)
+{
+	for (size_t i = 0; i < blocks; i++) {
+		drbg_v_inc(d->v);
+		memcpy(&out[i * DRBG_BLOCK_LEN], d->v, DRBG_BLOCK_LEN);
+	}
+
+	return bt_aes_encrypt_many(&d->aes, out, out, blocks);
+}
+
+/* CTR_DRBG_Update, @p data is DRBG_SEED_LEN bytes or NULL for zeroes */
+static int drbg_update(struct drbg *d, const uint8_t *data)
+{
+	uint8_t temp[DRBG_SEED_LEN];
+	int err;
+
+	err = drbg_ctr(d, temp, DRBG_SEED_LEN / DRBG_BLOCK_LEN);
+	if (err) {
+		return err;
+	}
+
+	if (data) {
+		for (int i = 0; i < DRBG_SEED_LEN; i++) {
+			temp[i] ^= data[i];
+		}
+	}
+
+	memcpy(d->v, &temp[DRBG_KEY_LEN], DRBG_BLOCK_LEN);
+	bt_aes_ctx_clear(&d->aes);
+	err = bt_aes_ctx_init(&d->aes, temp, false);
+
+	memset(temp, 0, sizeof(temp));
+
+	return err;
+}
+
+static int drbg_get_entropy(uint8_t seed[DRBG_SEED_LEN])
+{
+	int err;
+
+	err = bt_hci_le_rand(seed, DRBG_SEED_LEN);
+	if (err) {
+		LOG_ERR("Failed to get entropy from the controller (%d)", err);
+		return err;
+	}
+
+	return 0;
+}
+
+/* CTR_DRBG_Instantiate or CTR_DRBG_Reseed from @p seed, with drbg_lock held */
+static int drbg_seed(struct drbg *d, const uint8_t seed[DRBG_SEED_LEN])
+{
+	int err;
+
+	if (!d->instantiated) {
+		static const uint8_t zero_key[DRBG_KEY_LEN];
+
+		memset(d->v, 0, sizeof(d->v));
+
+		bt_aes_ctx_clear(&d->aes);
+		err = bt_aes_ctx_init(&d->aes, zero_key, false);
+		if (err) {
+			return err;
+		}
+	}
+
+	err = drbg_update(d, seed);
+	if (err) {
+		return err;
+	}
+
+	d->reseed_counter = 1U;
+	d->instantiated = true;
+
+	return 0;
+}
+
+static void drbg_reseed_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(drbg_reseed_work, drbg_reseed_handler);
+
+/* Seed from the controller. Gathering the entropy takes HCI round trips,
+ * so drbg_lock is only taken to reseed with it.
+ */
+static int drbg_reseed(void)
+{
+	uint8_t seed[DRBG_SEED_LEN];
+	bool instantiated;
+	int err;
+
+	err = drbg_get_entropy(seed);
+	if (err) {
+		return err;
+	}
+
+	k_mutex_lock(&drbg_lock, K_FOREVER);
+
+	instantiated = drbg.instantiated;
+
+	err = drbg_seed(&drbg, seed);
+	if (!err) {
+		/* HCI_LE_Rand returns 8 bytes per command */
+		DRBG_STATS_ADD(hci_cmds, DIV_ROUND_UP(DRBG_SEED_LEN, 8));
+		DRBG_STATS_ADD(reseeds, 1);
+	}
+
+	k_mutex_unlock(&drbg_lock);
+
+	memset(seed, 0, sizeof(seed));
+
+#if CONFIG_BT_RAND_DRBG_RESEED_PERIOD > 0
+	if (!err && !instantiated) {
+		k_work_schedule(&drbg_reseed_work, K_SECONDS(CONFIG_BT_RAND_DRBG_RESEED_PERIOD));
+	}
+#else
+	ARG_UNUSED(instantiated);
+#endif
+
+	return err;
+}
+
+static void drbg_reseed_handler(struct k_work *work)
+{
+	int err;
+
+	err = drbg_reseed();
+	if (err) {
+		LOG_WRN("Background reseed failed (%d)", err);
+	}
+
+#if CONFIG_BT_RAND_DRBG_RESEED_PERIOD > 0
+	k_work_reschedule(&drbg_reseed_work, K_SECONDS(CONFIG_BT_RAND_DRBG_RESEED_PERIOD));
+#endif
+}
+
+/* CTR_DRBG_Generate without additional input, with drbg_lock held */
+static int drbg_generate(struct drbg *d, uint8_t *out, size_t len)
+{
+	uint8_t block[DRBG_BATCH * DRBG_BLOCK_LEN];
+	int err;
+
+	while (len) {
+		size_t n = MIN(len, sizeof(block));
+
+		err = drbg_ctr(d, block, DIV_ROUND_UP(n, DRBG_BLOCK_LEN));
+		if (err) {
+			return err;
+		}
+
+		memcpy(out, block, n);
+		out += n;
+		len -= n;
+	}
+
+	memset(block, 0, sizeof(block));
+
+	err = drbg_update(d, NULL);
+	if (err) {
+		return err;
+	}
+
+	d->reseed_counter++;
+
+	return 0;
+}
+
+/* NIST CAVP CTR_DRBG.rsp, AES-128 no df, PredictionResistance = False,
+ * EntropyInputLen = 256, without nonce, personalization string or
+ * additional input, ReturnedBitsLen = 512. Instantiate, generate twice,
+ * and the second output is the returned bits.
+ */
+static const struct {
+	uint8_t entropy[DRBG_SEED_LEN];
+	uint8_t returned[64];
+} drbg_kat[] = {
+	{
+		/* COUNT = 0 */
+		.entropy = {
+			0xce, 0x50, 0xf3, 0x3d, 0xa5, 0xd4, 0xc1, 0xd3,
+			0xd4, 0x00, 0x4e, 0xb3, 0x52, 0x44, 0xb7, 0xf2,
+			0xcd, 0x7f, 0x2e, 0x50, 0x76, 0xfb, 0xf6, 0x78,
+			0x0a, 0x7f, 0xf6, 0x34, 0xb2, 0x49, 0xa5, 0xfc,
+		},
+		.returned = {
+			0x65, 0x45, 0xc0, 0x52, 0x9d, 0x37, 0x24, 0x43,
+			0xb3, 0x92, 0xce, 0xb3, 0xae, 0x3a, 0x99, 0xa3,
+			0x0f, 0x96, 0x3e, 0xaf, 0x31, 0x32, 0x80, 0xf1,
+			0xd1, 0xa1, 0xe8, 0x7f, 0x9d, 0xb3, 0x73, 0xd3,
+			0x61, 0xe7, 0x5d, 0x18, 0x01, 0x82, 0x66, 0x49,
+			0x9c, 0xcc, 0xd6, 0x4d, 0x9b, 0xbb, 0x8d, 0xe0,
+			0x18, 0x5f, 0x21, 0x33, 0x83, 0x08, 0x0f, 0xad,
+			0xde, 0xc4, 0x6b, 0xae, 0x1f, 0x78, 0x4e, 0x5a,
+		},
+	},
+	{
+		/* COUNT = 1 */
+		.entropy = {
+			0xa3, 0x85, 0xf7, 0x0a, 0x4d, 0x45, 0x03, 0x21,
+			0xdf, 0xd1, 0x8d, 0x83, 0x79, 0xef, 0x8e, 0x77,
+			0x36, 0xfe, 0xe5, 0xfb, 0xf0, 0xa0, 0xae, 0xa5,
+			0x3b, 0x76, 0x69, 0x60, 0x94, 0xe8, 0xaa, 0x93,
+		},
+		.returned = {
+			0x1a, 0x06, 0x25, 0x53, 0xab, 0x60, 0x45, 0x7e,
+			0xd1, 0xf1, 0xc5, 0x2f, 0x5a, 0xca, 0x5a, 0x3b,
+			0xe5, 0x64, 0xa2, 0x75, 0x45, 0x35, 0x8c, 0x11,
+			0x2e, 0xd9, 0x2c, 0x6e, 0xae, 0x2c, 0xb7, 0x59,
+			0x7c, 0xfc, 0xc2, 0xe0, 0xa5, 0xdd, 0x81, 0xc5,
+			0xbf, 0xec, 0xc9, 0x41, 0xda, 0x5e, 0x81, 0x52,
+			0xa9, 0x01, 0x0d, 0x48, 0x45, 0x17, 0x07, 0x34,
+			0x67, 0x6c, 0x8c, 0x1b, 0x6b, 0x30, 0x73, 0xa5,
+		},
+	},
+};
+
+/* Known answer health test, SP 800-90A section 11.3, run on the generator
+ * before it is first instantiated. With drbg_lock held.
+ */
+static int drbg_self_test(struct drbg *d)
+{
+	uint8_t out[sizeof(drbg_kat[0].returned)];
+	int err = 0;
+
+	for (int i = 0; !err && i < ARRAY_SIZE(drbg_kat); i++) {
+		d->instantiated = false;
+
+		err = drbg_seed(d, drbg_kat[i].entropy);
+
+		for (int j = 0; !err && j < 2; j++) {
+			err = drbg_generate(d, out, sizeof(out));
+		}
+
+		if (!err && memcmp(out, drbg_kat[i].returned, sizeof(out))) {
+			err = -EIO;
+		}
+	}
+
+	memset(out, 0, sizeof(out));
+	bt_aes_ctx_clear(&d->aes);
+	memset(d, 0, sizeof(*d));
+
+	return err;
+}
+
+static int drbg_rand(void *buf, size_t len, bool prediction_resistance)
+{
+	static int self_test_err = -EAGAIN;
+	uint8_t *out = buf;
+	bool reseed;
+	int err = 0;
+
+	CHECKIF(buf == NULL || len == 0) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&drbg_lock, K_FOREVER);
+
+	if (self_test_err == -EAGAIN) {
+		self_test_err = drbg_self_test(&drbg);
+		if (self_test_err) {
+			LOG_ERR("CTR_DRBG known answer test failed (%d)", self_test_err);
+		}
+	}
+
+	err = self_test_err;
+	reseed = prediction_resistance || !drbg.instantiated ||
+		 drbg.reseed_counter > 2U * CONFIG_BT_RAND_DRBG_RESEED_INTERVAL;
+
+	k_mutex_unlock(&drbg_lock);
+
+	if (err) {
+		return err;
+	}
+
+	if (reseed) {
+		err = drbg_reseed();
+		if (err) {
+			return err;
+		}
+	}
+
+	/* Other requests may be served in between, the fresh entropy still
+	 * goes into this one.
+	 */
+	k_mutex_lock(&drbg_lock, K_FOREVER);
+
+	if (drbg.reseed_counter > CONFIG_BT_RAND_DRBG_RESEED_INTERVAL) {
+		/* Due, let the work queue wait on the controller */
+		k_work_reschedule(&drbg_reseed_work, K_NO_WAIT);
+	}
+
+	while (len) {
+		size_t n = MIN(len, DRBG_MAX_REQUEST);
+
+		err = drbg_generate(&drbg, out, n);
+		if (err) {
+			break;
+		}
+
+		DRBG_STATS_ADD(requests, 1);
+		DRBG_STATS_ADD(bytes, n);
+
+		out += n;
+		len -= n;
+	}
+
+	k_mutex_unlock(&drbg_lock);
+
+	return err;
+}
+
+int bt_rand(void *buf, size_t len)
+{
+	return drbg_rand(buf, len, IS_ENABLED(CONFIG_BT_RAND_DRBG_PREDICTION_RESISTANCE));
+}
+
+int bt_rand_pr(void *buf, size_t len)
+{
+	return drbg_rand(buf, len, true);
+}
+
+#if defined(CONFIG_BT_RAND_DRBG_STATS)
+void bt_rand_stats_get(struct bt_rand_stats *stats)
+{
+	k_mutex_lock(&drbg_lock, K_FOREVER);
+	*stats = drbg_stats;
+	k_mutex_unlock(&drbg_lock);
+}
+
+void bt_rand_stats_reset(void)
+{
+	k_mutex_lock(&drbg_lock, K_FOREVER);
+	memset(&drbg_stats, 0, sizeof(drbg_stats));
+	k_mutex_unlock(&drbg_lock);
+}
+#endif /* CONFIG_BT_RAND_DRBG_STATS */
+#else
 int bt_rand(void *buf, size_t len)
 {
 	return bt_hci_le_rand(buf, len);
 }
 
+int bt_rand_pr(void *buf, size_t len)
+{
+	return bt_hci_le_rand(buf, len);
+}
+#endif /* CONFIG_BT_RAND_DRBG */
+
+#if defined(CONFIG_BT_AES_CTX)
+/* Blocks byte swapped per call for LS byte first contexts */
+#define AES_SWAP_BATCH 4
+
+#if defined(CONFIG_BT_AES_KEY_SCHEDULE)
+struct bt_aes_sched {
+	aes_ctx aes;
+};
+
+/* Expanded keys are kept here rather than in bt_aes_ctx, which often lives
+ * on the stack, as in AES-CCM. A context set up while all are taken goes
+ * without one.
+ */
+K_MEM_SLAB_DEFINE_STATIC(aes_sched_slab, sizeof(struct bt_aes_sched),
+			 CONFIG_BT_AES_KEY_SCHEDULE_COUNT, sizeof(uint32_t));
+#endif /* CONFIG_BT_AES_KEY_SCHEDULE */
+
+static int aes_ecb(struct bt_aes_ctx *ctx, const uint8_t *in, uint8_t *out, size_t blocks)
+{
+#if defined(CONFIG_BT_AES_KEY_SCHEDULE)
+	if (ctx->sched) {
+		for (size_t i = 0; i < blocks * 16; i += 16) {
+			aes_encrypt(&ctx->sched->aes, &in[i], &out[i]);
+		}
+
+		return 0;
+	}
+#endif /* CONFIG_BT_AES_KEY_SCHEDULE */
+
+	/* Engines behind aes_cypher() take all the blocks in one request */
+	return aes_cypher(out, in, blocks * 16, NULL, ctx->key, 16, AES_MODE_ECB, true);
+}
+
+int bt_aes_ctx_init(struct bt_aes_ctx *ctx, const uint8_t key[16], bool le)
+{
+	CHECKIF(ctx == NULL || key == NULL) {
+		return -EINVAL;
+	}
+
+	/* Kept MS byte first, the way the AES implementation takes it */
+	if (le) {
+		sys_memcpy_swap(ctx->key, key, 16);
+	} else {
+		memcpy(ctx->key, key, 16);
+	}
+
+	ctx->le = le;
+
+#if defined(CONFIG_BT_AES_KEY_SCHEDULE)
+	if (k_mem_slab_alloc(&aes_sched_slab, (void **)&ctx->sched, K_NO_WAIT)) {
+		ctx->sched = NULL;
+	} else if (aes_setkey(&ctx->sched->aes, ctx->key, 16)) {
+		bt_aes_ctx_clear(ctx);
+		return -EINVAL;
+	}
+#endif /* CONFIG_BT_AES_KEY_SCHEDULE */
+
+	return 0;
+}
+
+void bt_aes_ctx_clear(struct bt_aes_ctx *ctx)
+{
+	volatile uint8_t *p;
+
+	if (ctx == NULL) {
+		return;
+	}
+
+#if defined(CONFIG_BT_AES_KEY_SCHEDULE)
+	if (ctx->sched) {
+		p = (volatile uint8_t *)ctx->sched;
+
+		for (size_t i = 0; i < sizeof(*ctx->sched); i++) {
+			p[i] = 0U;
+		}
+
+		k_mem_slab_free(&aes_sched_slab, ctx->sched);
+	}
+#endif /* CONFIG_BT_AES_KEY_SCHEDULE */
+
+	/* Keep the compiler from dropping the wipe of a dead object */
+	p = (volatile uint8_t *)ctx;
+
+	for (size_t i = 0; i < sizeof(*ctx); i++) {
+		p[i] = 0U;
+	}
+}
+
+int bt_aes_encrypt_many(struct bt_aes_ctx *ctx, const uint8_t *plaintext,
+			uint8_t *enc_data, size_t blocks)
+{
+	uint8_t in[AES_SWAP_BATCH * 16], out[AES_SWAP_BATCH * 16];
+	int err = 0;
+
+	CHECKIF(ctx == NULL || plaintext == NULL || enc_data == NULL) {
+		return -EINVAL;
+	}
+
+	if (!ctx->le) {
+		return aes_ecb(ctx, plaintext, enc_data, blocks);
+	}
+
+	while (blocks) {
+		size_t n = MIN(blocks, AES_SWAP_BATCH);
+
+		for (size_t i = 0; i < n * 16; i += 16) {
+			sys_memcpy_swap(&in[i], &plaintext[i], 16);
+		}
+
+		err = aes_ecb(ctx, in, out, n);
+		if (err) {
+			break;
+		}
+
+		for (size_t i = 0; i < n * 16; i += 16) {
+			sys_memcpy_swap(&enc_data[i], &out[i], 16);
+		}
+
+		plaintext += n * 16;
+		enc_data += n * 16;
+		blocks -= n;
+	}
+
+	memset(in, 0, sizeof(in));
+	memset(out, 0, sizeof(out));
+
+	return err;
+}
+#endif /* CONFIG_BT_AES_CTX */
+
 int bt_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16],
 		  uint8_t enc_data[16])
 {
@@ -0,0 +1,482 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Minimal in-process controller for the host benchmarks.
+ *
+ * hci_loopback_enable() swaps the API of the chosen HCI device for this one
+ * and enables the host. Commands are answered inline with canned responses,
+ * ACL data from the host is counted (and optionally shown to the test through
+ * lb_acl_tx_cb) and acknowledged with Number Of Completed Packets from a
+ * separate thread, the way a real controller frees its buffers. The test can
+ * play the peer by injecting L2CAP PDUs with hci_loopback_acl_rx(), or
+ * advertisers with hci_loopback_adv_report().
+ */
+
+#ifndef PORT_TESTS_BLUETOOTH_HCI_LOOPBACK_H_
+#define PORT_TESTS_BLUETOOTH_HCI_LOOPBACK_H_
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/buf.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/drivers/bluetooth.h>
+
+#define LB_MAX_CONN    CONFIG_BT_MAX_CONN
+#define LB_ACL_MTU     251
+#define LB_ACL_PKTS    16
+#define LB_HANDLE(idx) (0x0010 + (idx))
+
+/* Fixed channels the peer talks on */
+#define LB_CID_ATT     0x0004
+#define LB_CID_LE_SIG  0x0005
+
+struct hci_loopback {
+	bt_hci_recv_t recv;
+	/* Per-connection packets waiting for a completed packets event */
+	atomic_t unacked[LB_MAX_CONN];
+	struct k_sem ack;
+	/* Packets are kept in the controller while set */
+	atomic_t ack_hold;
+	atomic_t acl_pkts;
+	atomic_t acl_bytes;
+	struct k_sem connected;
+	struct bt_conn *conns[LB_MAX_CONN];
+};
+
+static struct hci_loopback lb;
+
+/* Called for every ACL packet the host sends, from the host TX context */
+static void (*lb_acl_tx_cb)(uint16_t handle, const uint8_t *data, uint16_t len);
+
+/* Called for every HCI command the host sends, before it is answered */
+static void (*lb_cmd_cb)(uint16_t opcode);
+
+static const struct device *const lb_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_bt_hci));
+
+static K_KERNEL_STACK_DEFINE(lb_stack, 2048);
+static struct k_thread lb_thread_data;
+
+static void lb_evt_hdr(struct net_buf *buf, uint8_t evt, uint8_t len)
+{
+	struct bt_hci_evt_hdr *hdr = net_buf_add(buf, sizeof(*hdr));
+
+	hdr->evt = evt;
+	hdr->len = len;
+}
+
+static void lb_cmd_complete(uint16_t opcode, const void *rp, uint8_t len)
+{
+	struct bt_hci_evt_cmd_complete *cc;
+	struct net_buf *buf;
+
+	buf = bt_buf_get_evt(BT_HCI_EVT_CMD_COMPLETE, false, K_FOREVER);
+	lb_evt_hdr(buf, BT_HCI_EVT_CMD_COMPLETE, sizeof(*cc) + len);
+	cc = net_buf_add(buf, sizeof(*cc));
+	cc->ncmd = 1U;
+	cc->opcode = sys_cpu_to_le16(opcode);
+	net_buf_add_mem(buf, rp, len);
+
+	lb.recv(lb_dev, buf);
+}
+
+static void lb_cmd_status(uint16_t opcode)
+{
+	struct bt_hci_evt_cmd_status *cs;
+	struct net_buf *buf;
+
+	buf = bt_buf_get_evt(BT_HCI_EVT_CMD_STATUS, false, K_FOREVER);
+	lb_evt_hdr(buf, BT_HCI_EVT_CMD_STATUS, sizeof(*cs));
+	cs = net_buf_add(buf, sizeof(*cs));
+	cs->status = BT_HCI_ERR_SUCCESS;
+	cs->ncmd = 1U;
+	cs->opcode = sys_cpu_to_le16(opcode);
+
+	lb.recv(lb_dev, buf);
+}
+
+static int lb_conn_index(const bt_addr_le_t *addr)
+{
+	/* Peers are 00:00:00:00:00:<idx + 1>, see hci_loopback_connect() */
+	return addr->a.val[0] - 1;
+}
+
+static void lb_conn_complete(const bt_addr_le_t *peer)
+{
+	struct bt_hci_evt_le_conn_complete *evt;
+	struct bt_hci_evt_le_meta_event *meta;
+	struct net_buf *buf;
+
+	buf = bt_buf_get_evt(BT_HCI_EVT_LE_META_EVENT, false, K_FOREVER);
+	lb_evt_hdr(buf, BT_HCI_EVT_LE_META_EVENT, sizeof(*meta) + sizeof(*evt));
+	meta = net_buf_add(buf, sizeof(*meta));
+	meta->subevent = BT_HCI_EVT_LE_CONN_COMPLETE;
+	evt = net_buf_add(buf, sizeof(*evt));
+	memset(evt, 0, sizeof(*evt));
+	evt->handle = sys_cpu_to_le16(LB_HANDLE(lb_conn_index(peer)));
+	evt->role = BT_HCI_ROLE_CENTRAL;
+	bt_addr_le_copy(&evt->peer_addr, peer);
+	evt->interval = sys_cpu_to_le16(BT_GAP_INIT_CONN_INT_MIN);
+	evt->supv_timeout = sys_cpu_to_le16(400);
+
+	lb.recv(lb_dev, buf);
+}
+
+static void lb_disconn_complete(uint16_t handle, uint8_t reason)
+{
+	struct bt_hci_evt_disconn_complete *evt;
+	struct net_buf *buf;
+
+	buf = bt_buf_get_evt(BT_HCI_EVT_DISCONN_COMPLETE, false, K_FOREVER);
+	lb_evt_hdr(buf, BT_HCI_EVT_DISCONN_COMPLETE, sizeof(*evt));
+	evt = net_buf_add(buf, sizeof(*evt));
+	evt->status = BT_HCI_ERR_SUCCESS;
+	evt->handle = sys_cpu_to_le16(handle);
+	evt->reason = reason;
+
+	lb.recv(lb_dev, buf);
+}
+
+static void lb_handle_cmd(struct net_buf *buf)
+{
+	struct bt_hci_cmd_hdr *hdr = net_buf_pull_mem(buf, sizeof(*hdr));
+	uint16_t opcode = sys_le16_to_cpu(hdr->opcode);
+	uint8_t rp[65] = { BT_HCI_ERR_SUCCESS };
+
+	if (lb_cmd_cb) {
+		lb_cmd_cb(opcode);
+	}
+
+	switch (opcode) {
+	case BT_HCI_OP_READ_LOCAL_FEATURES: {
+		struct bt_hci_rp_read_local_features *r = (void *)rp;
+
+		/* LE supported, BR/EDR not supported */
+		r->features[4] = BIT(6) | BIT(5);
+		lb_cmd_complete(opcode, rp, sizeof(*r));
+		break;
+	}
+	case BT_HCI_OP_READ_LOCAL_VERSION_INFO: {
+		struct bt_hci_rp_read_local_version_info *r = (void *)rp;
+
+		r->hci_version = BT_HCI_VERSION_5_4;
+		r->lmp_version = BT_HCI_VERSION_5_4;
+		lb_cmd_complete(opcode, rp, sizeof(*r));
+		break;
+	}
+	case BT_HCI_OP_READ_BD_ADDR: {
+		struct bt_hci_rp_read_bd_addr *r = (void *)rp;
+
+		memcpy(r->bdaddr.val, "\xc0\xde\x00\x00\x42\x42", sizeof(r->bdaddr.val));
+		lb_cmd_complete(opcode, rp, sizeof(*r));
+		break;
+	}
+	case BT_HCI_OP_LE_READ_BUFFER_SIZE: {
+		struct bt_hci_rp_le_read_buffer_size *r = (void *)rp;
+
+		r->le_max_len = sys_cpu_to_le16(LB_ACL_MTU);
+		r->le_max_num = LB_ACL_PKTS;
+		lb_cmd_complete(opcode, rp, sizeof(*r));
+		break;
+	}
+	case BT_HCI_OP_LE_RAND: {
+		struct bt_hci_rp_le_rand *r = (void *)rp;
+
+		for (size_t i = 0; i < sizeof(r->rand); i++) {
+			r->rand[i] = k_cycle_get_32() >> (i % 4) * 8;
+		}
+
+		lb_cmd_complete(opcode, rp, sizeof(*r));
+		break;
+	}
+	case BT_HCI_OP_LE_CREATE_CONN: {
+		struct bt_hci_cp_le_create_conn *cp = (void *)buf->data;
+
+		lb_cmd_status(opcode);
+		lb_conn_complete(&cp->peer_addr);
+		break;
+	}
+	case BT_HCI_OP_DISCONNECT: {
+		struct bt_hci_cp_disconnect *cp = (void *)buf->data;
+
+		lb_cmd_status(opcode);
+		lb_disconn_complete(sys_le16_to_cpu(cp->handle), BT_HCI_ERR_LOCALHOST_TERM_CONN);
+		break;
+	}
+	case BT_HCI_OP_LE_READ_REMOTE_FEATURES:
+	case BT_HCI_OP_READ_REMOTE_VERSION_INFO:
+	case BT_HCI_OP_LE_CONN_UPDATE:
+	case BT_HCI_OP_LE_SET_PHY:
+		/* Procedures never complete, the host does not wait on them */
+		lb_cmd_status(opcode);
+		break;
+	default:
+		/* Success with zeroed return parameters */
+		lb_cmd_complete(opcode, rp, sizeof(rp));
+		break;
+	}
+}
+
+static int lb_open(const struct device *dev, bt_hci_recv_t recv)
+{
+	lb.recv = recv;
+
+	return 0;
+}
+
+static int lb_send(const struct device *dev, struct net_buf *buf)
+{
+	struct bt_hci_acl_hdr *hdr;
+	uint16_t handle;
+
+	switch (bt_buf_get_type(buf)) {
+	case BT_BUF_CMD:
+		lb_handle_cmd(buf);
+		break;
+	case BT_BUF_ACL_OUT:
+		hdr = net_buf_pull_mem(buf, sizeof(*hdr));
+		handle = bt_acl_handle(sys_le16_to_cpu(hdr->handle));
+
+		atomic_inc(&lb.acl_pkts);
+		atomic_add(&lb.acl_bytes, net_buf_frags_len(buf));
+
+		if (lb_acl_tx_cb != NULL && buf->frags == NULL) {
+			lb_acl_tx_cb(handle, buf->data, buf->len);
+		} else if (lb_acl_tx_cb != NULL) {
+			/* The host chained a shared payload to the headers */
+			uint8_t pkt[LB_ACL_MTU];
+			size_t len = net_buf_linearize(pkt, sizeof(pkt), buf, 0, SIZE_MAX);
+
+			lb_acl_tx_cb(handle, pkt, len);
+		}
+
+		atomic_inc(&lb.unacked[handle - LB_HANDLE(0)]);
+		k_sem_give(&lb.ack);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	net_buf_unref(buf);
+
+	return 0;
+}
+
+static const struct bt_hci_driver_api lb_api = {
+	.open = lb_open,
+	.send = lb_send,
+};
+
+/* Frees controller buffers in batches, like a controller after a connection event */
+static void lb_thread(void *p1, void *p2, void *p3)
+{
+	for (;;) {
+		struct bt_hci_evt_num_completed_packets *evt;
+		struct bt_hci_handle_count hc[LB_MAX_CONN];
+		uint8_t num = 0;
+		struct net_buf *buf;
+
+		k_sem_take(&lb.ack, K_FOREVER);
+
+		if (atomic_get(&lb.ack_hold)) {
+			continue;
+		}
+
+		for (int i = 0; i < LB_MAX_CONN; i++) {
+			atomic_val_t count = atomic_clear(&lb.unacked[i]);
+
+			if (count > 0) {
+				hc[num].handle = sys_cpu_to_le16(LB_HANDLE(i));
+				hc[num].count = sys_cpu_to_le16(count);
+				num++;
+			}
+		}
+
+		if (num == 0) {
+			continue;
+		}
+
+		buf = bt_buf_get_evt(BT_HCI_EVT_NUM_COMPLETED_PACKETS, false, K_FOREVER);
+		lb_evt_hdr(buf, BT_HCI_EVT_NUM_COMPLETED_PACKETS,
+			   sizeof(*evt) + num * sizeof(hc[0]));
+		evt = net_buf_add(buf, sizeof(*evt));
+		evt->num_handles = num;
+		net_buf_add_mem(buf, hc, num * sizeof(hc[0]));
+
+		lb.recv(lb_dev, buf);
+	}
+}
+
+static void lb_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err == 0) {
+		k_sem_give(&lb.connected);
+	}
+}
+
+BT_CONN_CB_DEFINE(lb_conn_cb) = {
+	.connected = lb_connected,
+};
+
+static int hci_loopback_enable(void)
+{
+	k_sem_init(&lb.ack, 0, K_SEM_MAX_LIMIT);
+	k_sem_init(&lb.connected, 0, LB_MAX_CONN);
+
+	k_thread_create(&lb_thread_data, lb_stack, K_KERNEL_STACK_SIZEOF(lb_stack), lb_thread,
+			NULL, NULL, NULL, K_PRIO_COOP(0), 0, K_NO_WAIT);
+	k_thread_name_set(&lb_thread_data, "hci_loopback");
+
+	((struct device *)lb_dev)->api = &lb_api;
+
+	return bt_enable(NULL);
+}
+
+/* Connect to loopback peer @p idx as central, returns the connection */
+static struct bt_conn *hci_loopback_connect(int idx)
+{
+	bt_addr_le_t peer = { .type = BT_ADDR_LE_PUBLIC, .a.val = { idx + 1 } };
+	int err;
+
+	__ASSERT_NO_MSG(idx < LB_MAX_CONN);
+
+	err = bt_conn_le_create(&peer, BT_CONN_LE_CREATE_CONN, BT_LE_CONN_PARAM_DEFAULT,
+				&lb.conns[idx]);
+	__ASSERT_NO_MSG(err == 0);
+
+	err = k_sem_take(&lb.connected, K_SECONDS(5));
+	__ASSERT_NO_MSG(err == 0);
+
+	return lb.conns[idx];
+}
+
+/* Inject an L2CAP PDU from the peer on connection @p idx, cut into ACL
+ * packets of at most @p frag_len bytes.
+ */
+static void hci_loopback_acl_rx_frag(int idx, uint16_t cid, const void *data, uint16_t len,
+				     uint16_t frag_len)
+{
+	const uint8_t *payload = data;
+	uint16_t total = BT_L2CAP_HDR_SIZE + len;
+	uint8_t hdr[BT_L2CAP_HDR_SIZE];
+	uint16_t sent = 0;
+
+	/* Basic L2CAP header: length, channel ID */
+	sys_put_le16(len, &hdr[0]);
+	sys_put_le16(cid, &hdr[2]);
+
+	while (sent < total) {
+		uint8_t flags = sent ? BT_ACL_CONT : BT_ACL_START;
+		uint16_t chunk = MIN(frag_len, total - sent);
+		struct bt_hci_acl_hdr *acl;
+		struct net_buf *buf;
+
+		buf = bt_buf_get_rx(BT_BUF_ACL_IN, K_FOREVER);
+		acl = net_buf_add(buf, sizeof(*acl));
+		acl->handle = sys_cpu_to_le16(bt_acl_handle_pack(LB_HANDLE(idx), flags));
+		acl->len = sys_cpu_to_le16(chunk);
+
+		while (chunk) {
+			uint16_t n;
+
+			if (sent < sizeof(hdr)) {
+				n = MIN(chunk, sizeof(hdr) - sent);
+				net_buf_add_mem(buf, &hdr[sent], n);
+			} else {
+				n = chunk;
+				net_buf_add_mem(buf, &payload[sent - sizeof(hdr)], n);
+			}
+
+			sent += n;
+			chunk -= n;
+		}
+
+		lb.recv(lb_dev, buf);
+	}
+}
+
+/* Inject a single-fragment L2CAP PDU from the peer on connection @p idx */
+static void hci_loopback_acl_rx(int idx, uint16_t cid, const void *data, uint16_t len)
+{
+	hci_loopback_acl_rx_frag(idx, cid, data, len, BT_L2CAP_HDR_SIZE + len);
+}
+
+/* Open an LE credit based channel from the peer on connection @p idx to
+ * @p psm. The peer's CID @p scid doubles as the request identifier, it
+ * offers an MPS of 247 and all the credits it can.
+ */
+static void hci_loopback_coc_connect(int idx, uint16_t psm, uint8_t scid, uint16_t mtu)
+{
+	/* LE Credit Based Connection Request: PSM, SCID, MTU, MPS 247, credits */
+	uint8_t req[] = {
+		0x14, scid, 0x0a, 0x00,
+		psm & 0xff, psm >> 8, scid, 0x00, mtu & 0xff, mtu >> 8, 0xf7, 0x00, 0xff, 0xff,
+	};
+
+	hci_loopback_acl_rx(idx, LB_CID_LE_SIG, req, sizeof(req));
+}
+
+/* Inject a legacy advertising report without data from @p addr */
+static void hci_loopback_adv_report(const bt_addr_le_t *addr, int8_t rssi)
+{
+	struct bt_hci_evt_le_advertising_report *evt;
+	struct bt_hci_evt_le_advertising_info *info;
+	struct bt_hci_evt_le_meta_event *meta;
+	struct net_buf *buf;
+
+	buf = bt_buf_get_evt(BT_HCI_EVT_LE_META_EVENT, false, K_FOREVER);
+	lb_evt_hdr(buf, BT_HCI_EVT_LE_META_EVENT,
+		   sizeof(*meta) + sizeof(*evt) + sizeof(*info) + sizeof(rssi));
+	meta = net_buf_add(buf, sizeof(*meta));
+	meta->subevent = BT_HCI_EVT_LE_ADVERTISING_REPORT;
+	evt = net_buf_add(buf, sizeof(*evt));
+	evt->num_reports = 1U;
+	info = net_buf_add(buf, sizeof(*info));
+	info->evt_type = BT_GAP_ADV_TYPE_ADV_NONCONN_IND;
+	bt_addr_le_copy(&info->addr, addr);
+	info->length = 0U;
+	net_buf_add_u8(buf, rssi);
+
+	lb.recv(lb_dev, buf);
+}
+
+/* Wait until the host has handed at least @p pkts ACL packets to the controller */
+static void hci_loopback_wait_acl(atomic_val_t pkts)
+{
+	while (atomic_get(&lb.acl_pkts) < pkts) {
+		k_sleep(K_MSEC(1));
+	}
+}
+
+/* Keep the packets the host sends in the controller, as on a busy link,
+ * until released with @p hold false.
+ */
+static void hci_loopback_ack_hold(bool hold)
+{
+	atomic_set(&lb.ack_hold, hold);
+
+	if (!hold) {
+		k_sem_give(&lb.ack);
+	}
+}
+
+#endif /* PORT_TESTS_BLUETOOTH_HCI_LOOPBACK_H_ */
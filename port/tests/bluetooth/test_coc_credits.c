@@ -0,0 +1,388 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* L2CAP CoC receive flow control over the loopback controller. The peer
+ * sends up to a few K-frames per connection event, as far as its credits go,
+ * to a channel whose recv callback consumes them at once, then to one that
+ * completes them later at a fixed pace. Prints K-frames per second and the
+ * credit PDUs the host sent per K-frame. Build with and without
+ * CONFIG_BT_L2CAP_CREDIT_TUNING to compare. When enabled its statistics are
+ * printed, and the ACL RX buffers committed to credits are checked against
+ * the credits the peer holds, the pool and the grants cut short by it. A
+ * channel the host opens itself checks that every channel gives its buffers
+ * back on disconnection.
+ *
+ * Usage: test_coc_credits [frames] [drain ms per frame]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+#include "hci_loopback.h"
+
+#define FRAME_LEN 64
+#define PER_EVENT 6
+
+enum {
+	CHAN_FAST,
+	CHAN_SLOW,
+	CHAN_NUM,
+};
+
+static struct bt_conn *conn;
+static struct bt_l2cap_le_chan le_chans[CHAN_NUM];
+static int chans_accepted;
+static K_SEM_DEFINE(chan_connected, 0, CHAN_NUM);
+static K_SEM_DEFINE(chan_disconnected, 0, CHAN_NUM + 1);
+static K_SEM_DEFINE(frame_received, 0, K_SEM_MAX_LIMIT);
+/* Credits the host gave the peer and the credit PDUs it took, per channel */
+static atomic_t peer_credits[CHAN_NUM];
+static atomic_t credit_pdus[CHAN_NUM];
+
+/* The channel the host connects, and the identifier of its request */
+static struct bt_l2cap_le_chan client_chan;
+static atomic_t client_req_ident;
+
+K_MSGQ_DEFINE(slow_frames, sizeof(struct net_buf *), CONFIG_BT_BUF_ACL_RX_COUNT, 4);
+static K_KERNEL_STACK_DEFINE(drain_stack, 2048);
+static struct k_thread drain_thread_data;
+static int drain_ms = 2;
+
+static int fast_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	k_sem_give(&frame_received);
+
+	return 0;
+}
+
+static int slow_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	int err;
+
+	err = k_msgq_put(&slow_frames, &buf, K_NO_WAIT);
+	__ASSERT_NO_MSG(err == 0);
+
+	return -EINPROGRESS;
+}
+
+/* The application of the slow channel, done with a K-frame every drain_ms */
+static void drain_thread(void *p1, void *p2, void *p3)
+{
+	struct net_buf *buf;
+	int err;
+
+	for (;;) {
+		k_msgq_get(&slow_frames, &buf, K_FOREVER);
+		k_sleep(K_MSEC(drain_ms));
+
+		err = bt_l2cap_chan_recv_complete(&le_chans[CHAN_SLOW].chan, buf);
+		__ASSERT_NO_MSG(err == 0);
+
+		k_sem_give(&frame_received);
+	}
+}
+
+static void chan_connected_cb(struct bt_l2cap_chan *chan)
+{
+	k_sem_give(&chan_connected);
+}
+
+static void chan_disconnected_cb(struct bt_l2cap_chan *chan)
+{
+	k_sem_give(&chan_disconnected);
+}
+
+static const struct bt_l2cap_chan_ops fast_ops = {
+	.connected = chan_connected_cb,
+	.disconnected = chan_disconnected_cb,
+	.recv = fast_recv,
+};
+
+static const struct bt_l2cap_chan_ops slow_ops = {
+	.connected = chan_connected_cb,
+	.disconnected = chan_disconnected_cb,
+	.recv = slow_recv,
+};
+
+static int chan_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+		       struct bt_l2cap_chan **chan)
+{
+	struct bt_l2cap_le_chan *le_chan;
+
+	__ASSERT_NO_MSG(chans_accepted < CHAN_NUM);
+	le_chan = &le_chans[chans_accepted];
+	le_chan->chan.ops = chans_accepted == CHAN_SLOW ? &slow_ops : &fast_ops;
+
+	chans_accepted++;
+	*chan = &le_chan->chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server server = {
+	.psm = 0x0080,
+	.accept = chan_accept,
+};
+
+/* Play the peer's side of the credit based flow control */
+static void sniff_credits(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+	uint16_t cid;
+
+	/* Basic L2CAP header, code, identifier, length, then the parameters */
+	if (len < 12 || sys_get_le16(&data[2]) != LB_CID_LE_SIG) {
+		return;
+	}
+
+	switch (data[4]) {
+	case 0x14:
+		/* LE Credit Based Connection Request of the host */
+		atomic_set(&client_req_ident, data[5]);
+		break;
+	case 0x15:
+		/* LE Credit Based Connection Response, identifier is our SCID */
+		if (len >= 18 && data[5] >= 0x40 && data[5] < 0x40 + CHAN_NUM) {
+			atomic_set(&peer_credits[data[5] - 0x40], sys_get_le16(&data[14]));
+		}
+		break;
+	case 0x16:
+		/* LE Flow Control Credit */
+		cid = sys_get_le16(&data[8]);
+
+		for (int i = 0; i < CHAN_NUM; i++) {
+			if (le_chans[i].rx.cid == cid) {
+				atomic_add(&peer_credits[i], sys_get_le16(&data[10]));
+				atomic_inc(&credit_pdus[i]);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+#if defined(CONFIG_BT_L2CAP_CREDIT_TUNING)
+/* ACL RX buffers a K-frame of the channel may take, a fragment of the RX data
+ * length each when they are chained
+ */
+static uint32_t credit_cost(int chan)
+{
+	uint16_t frag_len = BT_GAP_DATA_LEN_DEFAULT;
+
+	if (!IS_ENABLED(CONFIG_BT_CONN_RX_FRAG_CHAIN)) {
+		return 1;
+	}
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+	struct bt_conn_info info;
+	int err;
+
+	err = bt_conn_get_info(conn, &info);
+	__ASSERT_NO_MSG(err == 0);
+	frag_len = MAX(info.le.data_len->rx_max_len, BT_GAP_DATA_LEN_DEFAULT);
+#endif /* CONFIG_BT_USER_DATA_LEN_UPDATE */
+
+	frag_len = MIN(frag_len, CONFIG_BT_BUF_ACL_RX_SIZE);
+
+	return DIV_ROUND_UP(BT_L2CAP_HDR_SIZE + le_chans[chan].rx.mps, frag_len);
+}
+
+static void check_credit_stats(const char *name, int chan)
+{
+	uint32_t pool = CONFIG_BT_BUF_ACL_RX_COUNT - CONFIG_BT_L2CAP_CREDIT_TUNING_RX_RESERVE;
+	uint32_t cost = credit_cost(chan);
+	struct bt_l2cap_credit_stats stats;
+	uint32_t held = 0;
+	int err;
+
+	/* Let the last grant reach the peer */
+	k_sleep(K_MSEC(50));
+
+	err = bt_l2cap_credit_stats_get(&stats);
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("%s: %u grants of %u credits, %u starved, %u pool limited, target max %u, "
+	       "rate max %u frames/s, %u bufs committed, max %u of %u at %u per credit\n", name,
+	       stats.pdus, stats.credits, stats.starved, stats.pool_limited, stats.target_max,
+	       stats.rate_max, stats.bufs, stats.bufs_max, pool, cost);
+
+	/* Every K-frame is consumed, what is left is committed to the credits
+	 * the peer holds, on both channels
+	 */
+	for (int i = 0; i < CHAN_NUM; i++) {
+		__ASSERT_NO_MSG(credit_cost(i) == cost);
+		held += atomic_get(&peer_credits[i]);
+	}
+
+	__ASSERT_NO_MSG(stats.bufs == held * cost);
+
+	/* Within the pool, but for the single credit of a channel that ran dry */
+	__ASSERT_NO_MSG(stats.bufs_max <= pool + CHAN_NUM * cost);
+
+	/* A target the pool can not cover had its grants cut short */
+	if (stats.target_max > pool / cost) {
+		__ASSERT_NO_MSG(stats.pool_limited > 0);
+	}
+}
+#endif /* CONFIG_BT_L2CAP_CREDIT_TUNING */
+
+static void bench(const char *name, int chan, int frames, uint32_t interval_us)
+{
+	uint8_t sdu[BT_L2CAP_SDU_HDR_SIZE + FRAME_LEN] = { 0 };
+	uint32_t start;
+	uint32_t ms;
+	int events = 0;
+	int sent = 0;
+	int err;
+
+	IF_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING, (bt_l2cap_credit_stats_reset();))
+	atomic_clear(&credit_pdus[chan]);
+	sys_put_le16(FRAME_LEN, sdu);
+	start = k_uptime_get_32();
+
+	/* One connection event per interval, as many K-frames as credits allow */
+	while (sent < frames) {
+		int n = MIN(MIN(atomic_get(&peer_credits[chan]), PER_EVENT), frames - sent);
+
+		for (int i = 0; i < n; i++) {
+			atomic_dec(&peer_credits[chan]);
+			hci_loopback_acl_rx(0, le_chans[chan].rx.cid, sdu, sizeof(sdu));
+		}
+
+		sent += n;
+		events++;
+		k_sleep(K_USEC(interval_us));
+	}
+
+	for (int i = 0; i < frames; i++) {
+		err = k_sem_take(&frame_received, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	ms = MAX(k_uptime_get_32() - start, 1U);
+
+	printk("%s: %d frames in %d events, %u ms, %u frames/s, %u.%02u credit pdus per frame\n",
+	       name, frames, events, ms, (uint32_t)((uint64_t)frames * 1000U / ms),
+	       (uint32_t)atomic_get(&credit_pdus[chan]) / frames,
+	       (uint32_t)atomic_get(&credit_pdus[chan]) * 100 / frames % 100);
+
+	IF_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING, (check_credit_stats(name, chan);))
+}
+
+/* Accept the channel the host opens, a client channel has its credits set
+ * up like the others
+ */
+static void test_client(void)
+{
+	uint8_t rsp[] = {
+		/* LE Credit Based Connection Response: DCID, MTU, MPS, credits, result */
+		0x15, 0x00, 0x0a, 0x00,
+		0x50, 0x00, 0xf7, 0x00, 0xf7, 0x00, 0x01, 0x00, 0x00, 0x00,
+	};
+	int err;
+
+	client_chan.chan.ops = &fast_ops;
+	atomic_clear(&client_req_ident);
+
+	err = bt_l2cap_chan_connect(conn, &client_chan.chan, server.psm);
+	__ASSERT_NO_MSG(err == 0);
+
+	for (int i = 0; i < 5000 && !atomic_get(&client_req_ident); i++) {
+		k_sleep(K_MSEC(1));
+	}
+
+	rsp[1] = atomic_get(&client_req_ident);
+	__ASSERT_NO_MSG(rsp[1] != 0);
+	hci_loopback_acl_rx(0, LB_CID_LE_SIG, rsp, sizeof(rsp));
+
+	err = k_sem_take(&chan_connected, K_SECONDS(5));
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("client: connected with %ld credits\n", (long)atomic_get(&client_chan.rx.credits));
+}
+
+int main(int argc, char *argv[])
+{
+	struct bt_conn_info info;
+	uint32_t interval_us;
+	int frames = 300;
+	int err;
+
+	if (argc > 1) {
+		frames = atoi(argv[1]);
+	}
+
+	if (argc > 2) {
+		drain_ms = MAX(atoi(argv[2]), 1);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	err = bt_l2cap_server_register(&server);
+	__ASSERT_NO_MSG(err == 0);
+
+	lb_acl_tx_cb = sniff_credits;
+
+	k_thread_create(&drain_thread_data, drain_stack, K_KERNEL_STACK_SIZEOF(drain_stack),
+			drain_thread, NULL, NULL, NULL, K_PRIO_PREEMPT(1), 0, K_NO_WAIT);
+	k_thread_name_set(&drain_thread_data, "drain");
+
+	conn = hci_loopback_connect(0);
+
+	err = bt_conn_get_info(conn, &info);
+	__ASSERT_NO_MSG(err == 0);
+	interval_us = BT_CONN_INTERVAL_TO_US(info.le.interval);
+
+	for (int i = 0; i < CHAN_NUM; i++) {
+		hci_loopback_coc_connect(0, server.psm, 0x40 + i, 247);
+		err = k_sem_take(&chan_connected, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	printk("connection interval %u us, tuning %d, %d ms per slow frame\n", interval_us,
+	       IS_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING), drain_ms);
+
+	bench("fast", CHAN_FAST, frames, interval_us);
+	bench("slow", CHAN_SLOW, frames, interval_us);
+
+	test_client();
+
+	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+
+	for (int i = 0; i < CHAN_NUM + 1; i++) {
+		err = k_sem_take(&chan_disconnected, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+#if defined(CONFIG_BT_L2CAP_CREDIT_TUNING)
+	struct bt_l2cap_credit_stats stats;
+
+	/* The channels gave their buffers back, the client one too */
+	err = bt_l2cap_credit_stats_get(&stats);
+	__ASSERT_NO_MSG(err == 0 && stats.bufs == 0);
+#endif /* CONFIG_BT_L2CAP_CREDIT_TUNING */
+
+	bt_conn_unref(conn);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,544 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Large L2CAP CoC SDUs received over the loopback controller, once on a
+ * channel that reassembles them with alloc_buf and once on a channel that
+ * receives them into posted buffers, reposted as soon as they are handed
+ * back. Checks every byte received, then prints the time taken, the bytes the
+ * host copied and the credit PDUs it sent per SDU. The same SDUs then go to a
+ * single posted buffer larger than the MPS, which is granted the rest of an
+ * SDU in one go. A fourth channel, with buffers smaller than the MPS, checks
+ * the credits given for them, an SDU spanning several buffers, a K-frame held
+ * until a buffer is posted, and a disconnection with buffers posted. Needs
+ * CONFIG_BT_L2CAP_RX_POST and CONFIG_BT_L2CAP_RX_STATS.
+ *
+ * Usage: test_coc_post [sdus] [fragment length]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+#include "hci_loopback.h"
+
+#define SDU_PDUS   4
+#define SDU_MAX    (SDU_PDUS * BT_L2CAP_RX_MTU)
+#define POST_BUFS  4
+#define SMALL_BUFS 8
+#define SMALL_BUF  40
+/* Four full buffers and half of the fifth */
+#define SMALL_LEN  (4 * SMALL_BUF + SMALL_BUF / 2)
+
+BUILD_ASSERT(SMALL_LEN <= SDU_MAX, "The SDU spanning buffers has to fit the MTU");
+
+enum {
+	CHAN_SEG,
+	CHAN_POST,
+	CHAN_ONE,
+	CHAN_SMALL,
+	CHAN_NUM,
+};
+
+NET_BUF_POOL_FIXED_DEFINE(sdu_pool, 1, BT_L2CAP_SDU_BUF_SIZE(SDU_MAX), 8, NULL);
+
+static struct bt_l2cap_le_chan le_chans[CHAN_NUM];
+static int chans_accepted;
+static K_SEM_DEFINE(chan_connected, 0, CHAN_NUM);
+static K_SEM_DEFINE(chan_disconnected, 0, CHAN_NUM);
+static K_SEM_DEFINE(sdu_received, 0, K_SEM_MAX_LIMIT);
+/* Credits the host gave the peer and the credit PDUs it took, per channel */
+static atomic_t peer_credits[CHAN_NUM];
+static atomic_t credit_pdus[CHAN_NUM];
+/* SDUs the peer sent, per channel */
+static uint8_t tx_seq[CHAN_NUM];
+
+/* What each channel received: SDUs, bytes of the current one, the length
+ * expected and the buffers handed back
+ */
+static struct {
+	uint8_t seq;
+	uint16_t off;
+	uint16_t len;
+	atomic_t bufs;
+} rx_state[CHAN_NUM];
+
+static struct bt_l2cap_rx_buf post_bufs[POST_BUFS];
+static uint8_t post_mem[POST_BUFS][SDU_MAX];
+static struct bt_l2cap_rx_buf one_buf;
+static uint8_t one_mem[SDU_MAX];
+static struct bt_l2cap_rx_buf small_bufs[SMALL_BUFS];
+static uint8_t small_mem[SMALL_BUFS][SMALL_BUF];
+static uint8_t pdu[BT_L2CAP_RX_MTU];
+
+/* Buffers handed back while the application keeps them */
+static bool keep_bufs;
+static struct bt_l2cap_rx_buf *kept_bufs[SMALL_BUFS];
+static int kept;
+
+/* Byte at @p off in the SDU @p seq, so that misplaced data shows */
+static uint8_t sdu_byte(uint8_t seq, uint16_t off)
+{
+	return seq * 13U + off;
+}
+
+static void check_data(int chan, const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		__ASSERT_NO_MSG(data[i] == sdu_byte(rx_state[chan].seq, rx_state[chan].off + i));
+	}
+
+	rx_state[chan].off += len;
+}
+
+static void check_sdu_end(int chan)
+{
+	__ASSERT_NO_MSG(rx_state[chan].off == rx_state[chan].len);
+
+	rx_state[chan].seq++;
+	rx_state[chan].off = 0;
+
+	k_sem_give(&sdu_received);
+}
+
+static int chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	check_data(CHAN_SEG, buf->data, buf->len);
+	check_sdu_end(CHAN_SEG);
+
+	return 0;
+}
+
+static struct net_buf *chan_alloc_buf(struct bt_l2cap_chan *chan)
+{
+	return net_buf_alloc(&sdu_pool, K_NO_WAIT);
+}
+
+static void chan_rx_done(struct bt_l2cap_chan *chan, struct bt_l2cap_rx_buf *buf, bool sdu_end)
+{
+	int idx = BT_L2CAP_LE_CHAN(chan) - le_chans;
+	int err;
+
+	check_data(idx, buf->data, buf->len);
+	atomic_inc(&rx_state[idx].bufs);
+
+	if (sdu_end) {
+		check_sdu_end(idx);
+	} else {
+		/* Only a full buffer comes back before the end of the SDU */
+		__ASSERT_NO_MSG(buf->len == buf->size);
+	}
+
+	if (keep_bufs) {
+		__ASSERT_NO_MSG(kept < SMALL_BUFS);
+		kept_bufs[kept++] = buf;
+		return;
+	}
+
+	err = bt_l2cap_chan_rx_post(chan, buf);
+	__ASSERT_NO_MSG(err == 0);
+}
+
+static void chan_connected_cb(struct bt_l2cap_chan *chan)
+{
+	k_sem_give(&chan_connected);
+}
+
+static void chan_disconnected_cb(struct bt_l2cap_chan *chan)
+{
+	k_sem_give(&chan_disconnected);
+}
+
+static const struct bt_l2cap_chan_ops seg_ops = {
+	.connected = chan_connected_cb,
+	.disconnected = chan_disconnected_cb,
+	.recv = chan_recv,
+	.alloc_buf = chan_alloc_buf,
+};
+
+static const struct bt_l2cap_chan_ops post_ops = {
+	.connected = chan_connected_cb,
+	.disconnected = chan_disconnected_cb,
+	.rx_done = chan_rx_done,
+};
+
+static void post(struct bt_l2cap_chan *chan, struct bt_l2cap_rx_buf *bufs, uint8_t *mem,
+		 size_t size, int count)
+{
+	int err;
+
+	for (int i = 0; i < count; i++) {
+		bufs[i].data = &mem[i * size];
+		bufs[i].size = size;
+
+		err = bt_l2cap_chan_rx_post(chan, &bufs[i]);
+		__ASSERT_NO_MSG(err == 0);
+	}
+}
+
+static int chan_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+		       struct bt_l2cap_chan **chan)
+{
+	struct bt_l2cap_le_chan *le_chan;
+
+	__ASSERT_NO_MSG(chans_accepted < CHAN_NUM);
+	le_chan = &le_chans[chans_accepted];
+	le_chan->rx.mtu = SDU_MAX;
+
+	/* Buffers posted here set the initial credits */
+	switch (chans_accepted) {
+	case CHAN_POST:
+		le_chan->chan.ops = &post_ops;
+		post(&le_chan->chan, post_bufs, &post_mem[0][0], SDU_MAX, POST_BUFS);
+		break;
+	case CHAN_ONE:
+		le_chan->chan.ops = &post_ops;
+		post(&le_chan->chan, &one_buf, one_mem, SDU_MAX, 1);
+		break;
+	case CHAN_SMALL:
+		le_chan->chan.ops = &post_ops;
+		post(&le_chan->chan, small_bufs, &small_mem[0][0], SMALL_BUF, SMALL_BUFS);
+		break;
+	default:
+		le_chan->chan.ops = &seg_ops;
+		break;
+	}
+
+	chans_accepted++;
+	*chan = &le_chan->chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server server = {
+	.psm = 0x0080,
+	.accept = chan_accept,
+};
+
+/* Play the peer's side of the credit based flow control */
+static void sniff_credits(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+	uint16_t cid;
+
+	/* Basic L2CAP header, code, identifier, length, then the parameters */
+	if (len < 12 || sys_get_le16(&data[2]) != LB_CID_LE_SIG) {
+		return;
+	}
+
+	switch (data[4]) {
+	case 0x15:
+		/* LE Credit Based Connection Response, identifier is our SCID */
+		if (len >= 18 && data[5] >= 0x40 && data[5] < 0x40 + CHAN_NUM) {
+			atomic_set(&peer_credits[data[5] - 0x40], sys_get_le16(&data[14]));
+		}
+		break;
+	case 0x16:
+		/* LE Flow Control Credit */
+		cid = sys_get_le16(&data[8]);
+
+		for (int i = 0; i < CHAN_NUM; i++) {
+			if (le_chans[i].rx.cid == cid) {
+				atomic_add(&peer_credits[i], sys_get_le16(&data[10]));
+				atomic_inc(&credit_pdus[i]);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void peer_chan_disconnect(int chan)
+{
+	/* LE Disconnection Request: DCID is ours, SCID the peer's */
+	uint8_t req[] = {
+		0x06, 0x01, 0x04, 0x00,
+		le_chans[chan].rx.cid & 0xff, le_chans[chan].rx.cid >> 8, 0x40 + chan, 0x00,
+	};
+
+	hci_loopback_acl_rx(0, LB_CID_LE_SIG, req, sizeof(req));
+}
+
+/* Credits only cover what the posted buffers take whatever is sent, the peer
+ * is given more by hand to overrun them.
+ */
+static void peer_overrun_credits(int chan, int credits)
+{
+	atomic_add(&le_chans[chan].rx.credits, credits);
+	atomic_add(&peer_credits[chan], credits);
+}
+
+/* Send @p n bytes at @p off of the current SDU of @p len bytes as a K-frame */
+static void peer_send_pdu(int chan, uint16_t len, uint16_t off, uint16_t n, uint16_t frag_len)
+{
+	struct bt_l2cap_le_chan *le_chan = &le_chans[chan];
+	uint16_t hdr = off ? 0 : BT_L2CAP_SDU_HDR_SIZE;
+
+	/* The SDU length only precedes the first PDU */
+	if (hdr) {
+		sys_put_le16(len, pdu);
+	}
+
+	for (int i = 0; i < n; i++) {
+		pdu[hdr + i] = sdu_byte(tx_seq[chan], off + i);
+	}
+
+	while (atomic_get(&peer_credits[chan]) == 0) {
+		k_sleep(K_MSEC(1));
+	}
+
+	atomic_dec(&peer_credits[chan]);
+	hci_loopback_acl_rx_frag(0, le_chan->rx.cid, pdu, hdr + n, frag_len);
+}
+
+/* Send an SDU of @p len bytes in K-frames of the MPS from the peer */
+static void peer_send_sdu(int chan, uint16_t len, uint16_t frag_len)
+{
+	uint16_t mps = le_chans[chan].rx.mps;
+	uint16_t off = 0;
+
+	do {
+		uint16_t n = MIN(len - off, mps - (off ? 0 : BT_L2CAP_SDU_HDR_SIZE));
+
+		peer_send_pdu(chan, len, off, n, frag_len);
+		off += n;
+	} while (off < len);
+
+	tx_seq[chan]++;
+}
+
+static void expect_sdus(int sdus)
+{
+	int err;
+
+	for (int i = 0; i < sdus; i++) {
+		err = k_sem_take(&sdu_received, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+}
+
+static void bench(const char *name, int chan, int sdus, uint16_t sdu_len, uint16_t frag_len)
+{
+	struct bt_l2cap_rx_stats stats;
+	uint32_t start;
+	uint32_t ms;
+	int err;
+
+	bt_l2cap_rx_stats_reset();
+	atomic_clear(&credit_pdus[chan]);
+	rx_state[chan].len = sdu_len;
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < sdus; i++) {
+		peer_send_sdu(chan, sdu_len, frag_len);
+	}
+
+	expect_sdus(sdus);
+
+	ms = MAX(k_uptime_get_32() - start, 1U);
+
+	err = bt_l2cap_rx_stats_get(&stats);
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT_NO_MSG(stats.sdus == sdus);
+
+	printk("%s: %u sdus %llu bytes in %u ms, copied %llu per sdu, %u.%02u credit pdus per sdu\n",
+	       name, stats.sdus, (unsigned long long)stats.bytes, ms,
+	       (unsigned long long)(stats.copied / stats.sdus),
+	       (uint32_t)atomic_get(&credit_pdus[chan]) / sdus,
+	       (uint32_t)atomic_get(&credit_pdus[chan]) * 100 / sdus % 100);
+}
+
+/* The SDU continues in the next buffers, each full one is handed back */
+static void test_span(void)
+{
+	atomic_clear(&rx_state[CHAN_SMALL].bufs);
+	rx_state[CHAN_SMALL].len = SMALL_LEN;
+
+	peer_send_sdu(CHAN_SMALL, SMALL_LEN, 27);
+	expect_sdus(1);
+
+	__ASSERT_NO_MSG(atomic_get(&rx_state[CHAN_SMALL].bufs) == DIV_ROUND_UP(SMALL_LEN, SMALL_BUF));
+
+	printk("span: %d bytes in %d buffers ok\n", SMALL_LEN,
+	       (int)atomic_get(&rx_state[CHAN_SMALL].bufs));
+}
+
+/* With every buffer taken, the next K-frame waits for one to be posted */
+static void test_held(void)
+{
+	int err;
+
+	/* Let the grants for the reposted buffers arrive */
+	k_sleep(K_MSEC(100));
+
+	atomic_clear(&rx_state[CHAN_SMALL].bufs);
+	atomic_clear(&credit_pdus[CHAN_SMALL]);
+	rx_state[CHAN_SMALL].len = 1;
+	keep_bufs = true;
+	kept = 0;
+
+	/* Enough for a K-frame per buffer and one more, the host then has
+	 * nothing to grant
+	 */
+	peer_overrun_credits(CHAN_SMALL, SMALL_BUFS + 1 - atomic_get(&peer_credits[CHAN_SMALL]));
+
+	/* Each SDU takes a buffer of its own */
+	for (int i = 0; i < SMALL_BUFS; i++) {
+		peer_send_sdu(CHAN_SMALL, 1, 27);
+	}
+
+	expect_sdus(SMALL_BUFS);
+	__ASSERT_NO_MSG(kept == SMALL_BUFS);
+
+	peer_send_sdu(CHAN_SMALL, 1, 27);
+
+	err = k_sem_take(&sdu_received, K_MSEC(100));
+	__ASSERT_NO_MSG(err == -EAGAIN);
+
+	/* Nothing was granted while the buffers were taken */
+	__ASSERT_NO_MSG(atomic_get(&credit_pdus[CHAN_SMALL]) == 0);
+
+	/* Posting a buffer places it, the rest come back as they were */
+	keep_bufs = false;
+
+	for (int i = 0; i < kept; i++) {
+		err = bt_l2cap_chan_rx_post(&le_chans[CHAN_SMALL].chan, kept_bufs[i]);
+		__ASSERT_NO_MSG(err == 0);
+
+		if (i == 0) {
+			expect_sdus(1);
+		}
+	}
+
+	__ASSERT_NO_MSG(atomic_get(&rx_state[CHAN_SMALL].bufs) == SMALL_BUFS + 1);
+
+	printk("held: ok\n");
+}
+
+/* The peer leaves in the middle of an SDU. The full buffers were handed
+ * back, the others are the application's again and no longer written to.
+ */
+static void test_disconnect(void)
+{
+	uint16_t mps = le_chans[CHAN_SMALL].rx.mps;
+	uint16_t n = MIN(mps - BT_L2CAP_SDU_HDR_SIZE, 2 * SMALL_BUF + SMALL_BUF / 2);
+	uint16_t cid = le_chans[CHAN_SMALL].rx.cid;
+	int err;
+
+	atomic_clear(&rx_state[CHAN_SMALL].bufs);
+	rx_state[CHAN_SMALL].len = SDU_MAX;
+
+	peer_send_pdu(CHAN_SMALL, SDU_MAX, 0, n, 27);
+
+	for (int i = 0; i < 5000 && atomic_get(&rx_state[CHAN_SMALL].bufs) < n / SMALL_BUF; i++) {
+		k_sleep(K_MSEC(1));
+	}
+
+	__ASSERT_NO_MSG(atomic_get(&rx_state[CHAN_SMALL].bufs) == n / SMALL_BUF);
+
+	peer_chan_disconnect(CHAN_SMALL);
+
+	err = k_sem_take(&chan_disconnected, K_SECONDS(5));
+	__ASSERT_NO_MSG(err == 0);
+
+	/* The rest of the SDU, on the channel that is gone */
+	memset(small_mem, 0, sizeof(small_mem));
+	hci_loopback_acl_rx(0, cid, pdu, mps);
+	k_sleep(K_MSEC(100));
+
+	for (int i = 0; i < SMALL_BUFS; i++) {
+		for (int j = 0; j < SMALL_BUF; j++) {
+			__ASSERT_NO_MSG(small_mem[i][j] == 0);
+		}
+	}
+
+	__ASSERT_NO_MSG(atomic_get(&rx_state[CHAN_SMALL].bufs) == n / SMALL_BUF);
+
+	printk("disconnect: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct bt_conn *conn;
+	uint16_t frag_len = 27;
+	uint16_t sdu_len;
+	uint16_t mps;
+	int sdus = 1000;
+	int err;
+
+	if (argc > 1) {
+		sdus = atoi(argv[1]);
+	}
+
+	if (argc > 2) {
+		frag_len = atoi(argv[2]);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("fragment %u bytes, chained %d\n", frag_len,
+	       IS_ENABLED(CONFIG_BT_CONN_RX_FRAG_CHAIN));
+
+	err = bt_l2cap_server_register(&server);
+	__ASSERT_NO_MSG(err == 0);
+
+	lb_acl_tx_cb = sniff_credits;
+
+	conn = hci_loopback_connect(0);
+
+	for (int i = 0; i < CHAN_NUM; i++) {
+		hci_loopback_coc_connect(0, server.psm, 0x40 + i, 247);
+		err = k_sem_take(&chan_connected, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	/* The channels get the same MPS, the MTU does not limit it */
+	mps = le_chans[CHAN_SEG].rx.mps;
+	__ASSERT_NO_MSG(le_chans[CHAN_POST].rx.mps == mps && le_chans[CHAN_ONE].rx.mps == mps &&
+			le_chans[CHAN_SMALL].rx.mps == mps);
+	__ASSERT_NO_MSG(mps > SMALL_BUF);
+
+	/* A K-frame per buffer of an SDU, a K-frame per buffers making an MPS */
+	__ASSERT_NO_MSG(atomic_get(&peer_credits[CHAN_POST]) == POST_BUFS);
+	__ASSERT_NO_MSG(atomic_get(&peer_credits[CHAN_ONE]) == 1);
+	__ASSERT_NO_MSG(atomic_get(&peer_credits[CHAN_SMALL]) ==
+			SMALL_BUFS / DIV_ROUND_UP(mps, SMALL_BUF));
+
+	sdu_len = SDU_PDUS * mps - BT_L2CAP_SDU_HDR_SIZE;
+
+	bench("alloc_buf", CHAN_SEG, sdus, sdu_len, frag_len);
+	bench("posted", CHAN_POST, sdus, sdu_len, frag_len);
+	bench("posted, one buffer", CHAN_ONE, sdus, sdu_len, frag_len);
+
+	/* A credit for the first K-frame of each SDU, then one grant for the
+	 * rest of it rather than one per K-frame
+	 */
+	__ASSERT_NO_MSG(atomic_get(&credit_pdus[CHAN_ONE]) <= 2 * sdus);
+
+	test_span();
+	test_held();
+	test_disconnect();
+
+	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	bt_conn_unref(conn);
+
+	printk("PASSED\n");
+
+	return 0;
+}
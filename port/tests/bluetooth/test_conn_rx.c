@@ -0,0 +1,277 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Host L2CAP CoC receive over the loopback controller: the peer sends full
+ * MPS PDUs cut into small ACL fragments, on a channel that takes PDUs as
+ * they are and on one that reassembles SDUs of several PDUs. Checks every
+ * received byte, then prints the bytes the host copied per SDU, to compare
+ * CONFIG_BT_CONN_RX_FRAG_CHAIN with the default reassembly. Needs
+ * CONFIG_BT_L2CAP_RX_STATS.
+ *
+ * Usage: test_conn_rx [sdus] [fragment length]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+#include "hci_loopback.h"
+
+#define SEG_SDU_PDUS 4
+
+enum {
+	CHAN_PDU,
+	CHAN_SEG,
+	CHAN_NUM,
+};
+
+NET_BUF_POOL_FIXED_DEFINE(sdu_pool, 1, BT_L2CAP_SDU_BUF_SIZE(SEG_SDU_PDUS * BT_L2CAP_RX_MTU), 8,
+			  NULL);
+
+static struct bt_l2cap_le_chan le_chans[CHAN_NUM];
+static int chans_accepted;
+static K_SEM_DEFINE(chan_connected, 0, CHAN_NUM);
+static K_SEM_DEFINE(sdu_received, 0, K_SEM_MAX_LIMIT);
+/* Credits the host gave the peer, per channel */
+static atomic_t peer_credits[CHAN_NUM];
+/* SDUs sent and received per channel, and the expected SDU length */
+static uint8_t tx_seq[CHAN_NUM];
+static uint8_t rx_seq[CHAN_NUM];
+static uint16_t sdu_lens[CHAN_NUM];
+static atomic_t bad_sdus;
+
+static uint8_t pdu[BT_L2CAP_RX_MTU];
+
+/* SDU byte at @p offset, differs between consecutive SDUs */
+static uint8_t payload_byte(uint8_t seq, size_t offset)
+{
+	return (uint8_t)(seq * 31 + offset);
+}
+
+static int chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	int i = chan == &le_chans[CHAN_SEG].chan ? CHAN_SEG : CHAN_PDU;
+	uint8_t seq = rx_seq[i]++;
+	size_t offset = 0;
+	bool bad = false;
+
+	for (struct net_buf *frag = buf; frag; frag = frag->frags) {
+		for (size_t j = 0; j < frag->len; j++) {
+			bad |= frag->data[j] != payload_byte(seq, offset++);
+		}
+	}
+
+	if (bad || offset != sdu_lens[i]) {
+		printk("SDU %u of %zu bytes, expected %u, %s\n", seq, offset, sdu_lens[i],
+		       bad ? "data differs" : "data matches");
+		atomic_inc(&bad_sdus);
+	}
+
+	k_sem_give(&sdu_received);
+
+	return 0;
+}
+
+static struct net_buf *chan_alloc_buf(struct bt_l2cap_chan *chan)
+{
+	return net_buf_alloc(&sdu_pool, K_NO_WAIT);
+}
+
+static void chan_connected_cb(struct bt_l2cap_chan *chan)
+{
+	k_sem_give(&chan_connected);
+}
+
+static const struct bt_l2cap_chan_ops pdu_ops = {
+	.connected = chan_connected_cb,
+	.recv = chan_recv,
+};
+
+static const struct bt_l2cap_chan_ops seg_ops = {
+	.connected = chan_connected_cb,
+	.recv = chan_recv,
+	.alloc_buf = chan_alloc_buf,
+};
+
+static int chan_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+		       struct bt_l2cap_chan **chan)
+{
+	struct bt_l2cap_le_chan *le_chan;
+
+	__ASSERT_NO_MSG(chans_accepted < CHAN_NUM);
+	le_chan = &le_chans[chans_accepted];
+
+	if (chans_accepted == CHAN_SEG) {
+		le_chan->chan.ops = &seg_ops;
+		le_chan->rx.mtu = SEG_SDU_PDUS * BT_L2CAP_RX_MTU;
+	} else {
+		le_chan->chan.ops = &pdu_ops;
+	}
+
+	chans_accepted++;
+	*chan = &le_chan->chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server server = {
+	.psm = 0x0080,
+	.accept = chan_accept,
+};
+
+/* Play the peer's side of the credit based flow control */
+static void sniff_credits(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+	uint16_t cid;
+
+	/* Basic L2CAP header, code, identifier, length, then the parameters */
+	if (len < 12 || sys_get_le16(&data[2]) != LB_CID_LE_SIG) {
+		return;
+	}
+
+	switch (data[4]) {
+	case 0x15:
+		/* LE Credit Based Connection Response, identifier is our SCID */
+		if (len >= 18 && data[5] >= 0x40 && data[5] < 0x40 + CHAN_NUM) {
+			atomic_set(&peer_credits[data[5] - 0x40], sys_get_le16(&data[14]));
+		}
+		break;
+	case 0x16:
+		/* LE Flow Control Credit */
+		cid = sys_get_le16(&data[8]);
+
+		for (int i = 0; i < CHAN_NUM; i++) {
+			if (le_chans[i].rx.cid == cid) {
+				atomic_add(&peer_credits[i], sys_get_le16(&data[10]));
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* Send an SDU of @p pdus full PDUs from the peer */
+static void peer_send_sdu(int chan, int pdus, uint16_t frag_len)
+{
+	struct bt_l2cap_le_chan *le_chan = &le_chans[chan];
+	uint16_t mps = le_chan->rx.mps;
+	uint16_t sdu_len = pdus * mps - BT_L2CAP_SDU_HDR_SIZE;
+	uint8_t seq = tx_seq[chan]++;
+	size_t offset = 0;
+
+	for (int i = 0; i < pdus; i++) {
+		uint16_t hdr_len = 0;
+
+		/* The SDU length only precedes the first PDU */
+		if (i == 0) {
+			sys_put_le16(sdu_len, pdu);
+			hdr_len = BT_L2CAP_SDU_HDR_SIZE;
+		}
+
+		for (uint16_t j = hdr_len; j < mps; j++) {
+			pdu[j] = payload_byte(seq, offset++);
+		}
+
+		while (atomic_get(&peer_credits[chan]) == 0) {
+			k_sleep(K_MSEC(1));
+		}
+
+		atomic_dec(&peer_credits[chan]);
+		hci_loopback_acl_rx_frag(0, le_chan->rx.cid, pdu, mps, frag_len);
+	}
+}
+
+static void bench(const char *name, int chan, int pdus, int sdus, uint16_t frag_len)
+{
+	struct bt_l2cap_rx_stats stats;
+	uint32_t start;
+	uint32_t ms;
+	int err;
+
+	bt_l2cap_rx_stats_reset();
+	atomic_clear(&bad_sdus);
+	sdu_lens[chan] = pdus * le_chans[chan].rx.mps - BT_L2CAP_SDU_HDR_SIZE;
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < sdus; i++) {
+		peer_send_sdu(chan, pdus, frag_len);
+	}
+
+	for (int i = 0; i < sdus; i++) {
+		err = k_sem_take(&sdu_received, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	ms = MAX(k_uptime_get_32() - start, 1U);
+
+	err = bt_l2cap_rx_stats_get(&stats);
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT_NO_MSG(stats.sdus == sdus);
+	__ASSERT_NO_MSG(atomic_get(&bad_sdus) == 0);
+
+	printk("%s: %u sdus %llu bytes in %u ms, copied %llu bytes, %llu per sdu\n", name,
+	       stats.sdus, (unsigned long long)stats.bytes, ms, (unsigned long long)stats.copied,
+	       (unsigned long long)(stats.copied / stats.sdus));
+}
+
+int main(int argc, char *argv[])
+{
+	struct bt_conn *conn;
+	uint16_t frag_len = 27;
+	int sdus = 1000;
+	int err;
+
+	if (argc > 1) {
+		sdus = atoi(argv[1]);
+	}
+
+	if (argc > 2) {
+		frag_len = atoi(argv[2]);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("fragment %u bytes, chained %d\n", frag_len,
+	       IS_ENABLED(CONFIG_BT_CONN_RX_FRAG_CHAIN));
+
+	err = bt_l2cap_server_register(&server);
+	__ASSERT_NO_MSG(err == 0);
+
+	lb_acl_tx_cb = sniff_credits;
+
+	conn = hci_loopback_connect(0);
+
+	for (int i = 0; i < CHAN_NUM; i++) {
+		hci_loopback_coc_connect(0, server.psm, 0x40 + i, 247);
+		err = k_sem_take(&chan_connected, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	bench("pdu", CHAN_PDU, 1, sdus, frag_len);
+	bench("seg", CHAN_SEG, SEG_SDU_PDUS, sdus / SEG_SDU_PDUS, frag_len);
+
+	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	bt_conn_unref(conn);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,229 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Host TX throughput over the loopback controller: GATT notifications and
+ * L2CAP CoC SDUs on two connections at once, with per-connection packet
+ * counts to show how the TX processor shares the controller buffers.
+ *
+ * Usage: test_conn_tx [count]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "hci_loopback.h"
+
+#define NUM_CONN 2
+#define SDU_LEN  1024
+
+static atomic_t handle_pkts[LB_MAX_CONN];
+
+static void count_acl(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+	atomic_inc(&handle_pkts[handle - LB_HANDLE(0)]);
+}
+
+static void ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+}
+
+BT_GATT_SERVICE_DEFINE(bench_svc,
+	BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_16(0xfff0)),
+	BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_16(0xfff1), BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
+
+static void report(const char *name, uint32_t start, atomic_val_t pkts, atomic_val_t bytes)
+{
+	uint32_t ms = MAX(k_uptime_get_32() - start, 1U);
+
+	printk("%s: %ld pkts %ld bytes in %u ms, %ld pkts/s %ld B/s", name, (long)pkts,
+	       (long)bytes, ms, (long)(pkts * 1000 / ms), (long)(bytes * 1000 / ms));
+
+	for (int i = 0; i < NUM_CONN; i++) {
+		printk(" conn%d %ld", i, (long)atomic_clear(&handle_pkts[i]));
+	}
+
+	printk("\n");
+}
+
+static void peer_subscribe(int idx)
+{
+	/* Exchange MTU Request (247) and Write Request 0x0001 on the CCC */
+	uint16_t ccc = bt_gatt_attr_get_handle(&bench_svc.attrs[3]);
+	uint8_t mtu_req[] = { 0x02, 0xf7, 0x00 };
+	uint8_t write_req[] = { 0x12, ccc & 0xff, ccc >> 8, 0x01, 0x00 };
+
+	hci_loopback_acl_rx(idx, LB_CID_ATT, mtu_req, sizeof(mtu_req));
+	hci_loopback_acl_rx(idx, LB_CID_ATT, write_req, sizeof(write_req));
+}
+
+static void bench_notify(struct bt_conn **conns, int count)
+{
+	static uint8_t data[BT_L2CAP_TX_MTU];
+	atomic_val_t pkts = atomic_get(&lb.acl_pkts);
+	atomic_val_t bytes = atomic_get(&lb.acl_bytes);
+	uint16_t len = MIN(bt_gatt_get_mtu(conns[0]) - 3, sizeof(data));
+	uint32_t start;
+
+	memset(handle_pkts, 0, sizeof(handle_pkts));
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < count; i++) {
+		struct bt_conn *conn = conns[i % NUM_CONN];
+		int err;
+
+		while ((err = bt_gatt_notify(conn, &bench_svc.attrs[2], data, len)) == -ENOMEM) {
+			k_yield();
+		}
+
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	hci_loopback_wait_acl(pkts + count);
+
+	report("notify", start, atomic_get(&lb.acl_pkts) - pkts,
+	       atomic_get(&lb.acl_bytes) - bytes);
+}
+
+#ifdef CONFIG_BT_L2CAP_DYNAMIC_CHANNEL
+NET_BUF_POOL_FIXED_DEFINE(sdu_pool, 2 * NUM_CONN, BT_L2CAP_SDU_BUF_SIZE(SDU_LEN),
+			  CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+
+static struct bt_l2cap_le_chan le_chans[NUM_CONN];
+static K_SEM_DEFINE(chan_connected, 0, NUM_CONN);
+
+static int chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	return 0;
+}
+
+static void chan_connected_cb(struct bt_l2cap_chan *chan)
+{
+	k_sem_give(&chan_connected);
+}
+
+static const struct bt_l2cap_chan_ops chan_ops = {
+	.connected = chan_connected_cb,
+	.recv = chan_recv,
+};
+
+static int chan_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+		       struct bt_l2cap_chan **chan)
+{
+	struct bt_l2cap_le_chan *le_chan = &le_chans[bt_conn_index(conn) % NUM_CONN];
+
+	le_chan->chan.ops = &chan_ops;
+	*chan = &le_chan->chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server server = {
+	.psm = 0x0080,
+	.accept = chan_accept,
+};
+
+static void bench_coc(int count)
+{
+	atomic_val_t pkts = atomic_get(&lb.acl_pkts);
+	atomic_val_t bytes = atomic_get(&lb.acl_bytes);
+	uint32_t start;
+
+	memset(handle_pkts, 0, sizeof(handle_pkts));
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < count; i++) {
+		struct net_buf *buf = net_buf_alloc(&sdu_pool, K_FOREVER);
+		int err;
+
+		net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+		net_buf_add(buf, SDU_LEN);
+
+		err = bt_l2cap_chan_send(&le_chans[i % NUM_CONN].chan, buf);
+		__ASSERT_NO_MSG(err >= 0);
+	}
+
+	/* Wait for the last SDU buffer to come back */
+	for (int i = 0; i < 2 * NUM_CONN; i++) {
+		net_buf_unref(net_buf_alloc(&sdu_pool, K_FOREVER));
+	}
+
+	report("coc", start, atomic_get(&lb.acl_pkts) - pkts, atomic_get(&lb.acl_bytes) - bytes);
+}
+#endif /* CONFIG_BT_L2CAP_DYNAMIC_CHANNEL */
+
+int main(int argc, char *argv[])
+{
+	struct bt_conn *conns[NUM_CONN];
+	int count = 10000;
+	int err;
+
+	if (argc > 1) {
+		count = atoi(argv[1]);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("quantum %d frags %d bytes\n", CONFIG_BT_CONN_TX_QUANTUM,
+	       CONFIG_BT_CONN_TX_QUANTUM_BYTES);
+
+#ifdef CONFIG_BT_L2CAP_DYNAMIC_CHANNEL
+	err = bt_l2cap_server_register(&server);
+	__ASSERT_NO_MSG(err == 0);
+#endif
+
+	for (int i = 0; i < NUM_CONN; i++) {
+		conns[i] = hci_loopback_connect(i);
+		peer_subscribe(i);
+	}
+
+	/* The CCC callback only fires on the first subscriber, ask per connection */
+	for (int i = 0; i < NUM_CONN; i++) {
+		while (!bt_gatt_is_subscribed(conns[i], &bench_svc.attrs[2], BT_GATT_CCC_NOTIFY)) {
+			k_sleep(K_MSEC(1));
+		}
+	}
+
+	lb_acl_tx_cb = count_acl;
+
+	bench_notify(conns, count);
+
+#ifdef CONFIG_BT_L2CAP_DYNAMIC_CHANNEL
+	for (int i = 0; i < NUM_CONN; i++) {
+		hci_loopback_coc_connect(i, server.psm, 0x40, 2048);
+		err = k_sem_take(&chan_connected, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	bench_coc(count / 10);
+#endif
+
+	for (int i = 0; i < NUM_CONN; i++) {
+		bt_conn_disconnect(conns[i], BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		bt_conn_unref(conns[i]);
+	}
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* AES micro benchmark, no controller needed. Checks bt_aes_ctx against the
+ * FIPS-197 AES-128 vector and bt_encrypt_le(), then prints blocks per second
+ * encrypting under one key with bt_encrypt_be() per block, with a context a
+ * block at a time, with a context in batches, and for mesh sized AES-CCM.
+ *
+ * Usage: test_crypto [blocks]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/crypto.h>
+
+#define BATCH 16
+
+static const uint8_t fips_key[16] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+
+static const uint8_t fips_plaintext[16] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+	0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+
+static const uint8_t fips_enc_data[16] = {
+	0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+	0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+};
+
+static uint8_t data[BATCH * 16];
+
+static void check(void)
+{
+	struct bt_aes_ctx ctx;
+	uint8_t ref[BATCH * 16];
+	uint8_t out[BATCH * 16];
+	int err;
+
+	err = bt_aes_ctx_init(&ctx, fips_key, false);
+	__ASSERT_NO_MSG(err == 0);
+
+	err = bt_aes_encrypt(&ctx, fips_plaintext, out);
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT(!memcmp(out, fips_enc_data, 16), "FIPS-197 vector mismatch");
+
+	/* Batched LS byte first blocks match bt_encrypt_le() one by one */
+	for (size_t i = 0; i < sizeof(data); i++) {
+		data[i] = rand();
+	}
+
+	for (size_t i = 0; i < BATCH; i++) {
+		err = bt_encrypt_le(fips_key, &data[i * 16], &ref[i * 16]);
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	bt_aes_ctx_clear(&ctx);
+
+	err = bt_aes_ctx_init(&ctx, fips_key, true);
+	__ASSERT_NO_MSG(err == 0);
+
+	err = bt_aes_encrypt_many(&ctx, data, out, BATCH);
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT(!memcmp(out, ref, sizeof(ref)), "batch mismatch");
+
+	/* In place */
+	err = bt_aes_encrypt_many(&ctx, data, data, BATCH);
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT(!memcmp(data, ref, sizeof(ref)), "in place mismatch");
+
+	bt_aes_ctx_clear(&ctx);
+}
+
+static void report(const char *name, int count, const char *unit, uint32_t start)
+{
+	uint32_t ms = MAX(k_uptime_get_32() - start, 1U);
+
+	printk("%s: %d %s in %u ms, %u %s/s\n", name, count, unit, ms,
+	       (uint32_t)((uint64_t)count * 1000U / ms), unit);
+}
+
+static void bench(int blocks)
+{
+	struct bt_aes_ctx ctx;
+	uint8_t nonce[13] = { 0 };
+	uint8_t pdu[29 + 8];
+	uint32_t start;
+	int err = 0;
+
+	start = k_uptime_get_32();
+	for (int i = 0; i < blocks; i++) {
+		err |= bt_encrypt_be(fips_key, &data[i % BATCH * 16], &data[i % BATCH * 16]);
+	}
+	report("bt_encrypt_be", blocks, "blocks", start);
+
+	err |= bt_aes_ctx_init(&ctx, fips_key, false);
+
+	start = k_uptime_get_32();
+	for (int i = 0; i < blocks; i++) {
+		err |= bt_aes_encrypt(&ctx, &data[i % BATCH * 16], &data[i % BATCH * 16]);
+	}
+	report("ctx single", blocks, "blocks", start);
+
+	start = k_uptime_get_32();
+	for (int i = 0; i < blocks; i += BATCH) {
+		err |= bt_aes_encrypt_many(&ctx, data, data, BATCH);
+	}
+	report("ctx batch", ROUND_UP(blocks, BATCH), "blocks", start);
+
+	bt_aes_ctx_clear(&ctx);
+
+	/* Mesh network PDU sized, 6 AES blocks per message */
+	start = k_uptime_get_32();
+	for (int i = 0; i < blocks / 6; i++) {
+		nonce[12] = i;
+		err |= bt_ccm_encrypt(fips_key, nonce, data, 29, NULL, 0, pdu, 8);
+	}
+	report("ccm 29 bytes", blocks / 6, "msgs", start);
+
+	__ASSERT_NO_MSG(err == 0);
+}
+
+int main(int argc, char *argv[])
+{
+	int blocks = 100000;
+
+	if (argc > 1) {
+		blocks = atoi(argv[1]);
+	}
+
+	check();
+	bench(blocks);
+
+	printk("PASSED\n");
+
+	return 0;
+}
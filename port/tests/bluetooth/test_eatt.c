@@ -0,0 +1,295 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* GATT client transactions over the loopback controller with the unenhanced
+ * bearer only, then with 1 to 5 EATT bearers opened by the peer. The peer
+ * answers the requests it got once per connection event, so transactions
+ * only overlap when the host spreads them over its bearers. Prints reads and
+ * writes per second and the requests each bearer carried. Needs CONFIG_BT_EATT
+ * with CONFIG_BT_EATT_MAX of 5 and CONFIG_BT_GATT_CLIENT.
+ *
+ * Usage: test_eatt [transactions] [connection interval ms]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/att.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "hci_loopback.h"
+
+/* White box: EATT needs an encrypted link, the loopback one is not */
+#include "../../../subsys/bluetooth/host/conn_internal.h"
+
+#define MAX_EATT    MIN(5, CONFIG_BT_EATT_MAX)
+#define PEER_SCID   0x0040
+#define VALUE_LEN   20
+#define WINDOW      8
+
+struct peer_req {
+	uint16_t cid;
+	uint8_t op;
+};
+
+K_MSGQ_DEFINE(peer_reqs, sizeof(struct peer_req), 2 * WINDOW, 4);
+K_MSGQ_DEFINE(free_slots, sizeof(int), WINDOW, 4);
+static K_SEM_DEFINE(done, 0, K_SEM_MAX_LIMIT);
+
+static K_KERNEL_STACK_DEFINE(peer_stack, 2048);
+static struct k_thread peer_thread_data;
+
+/* Host CIDs of the EATT bearers, indexed like the peer's */
+static uint16_t host_cids[MAX_EATT];
+/* Requests per bearer, the unenhanced one first */
+static atomic_t carried[MAX_EATT + 1];
+static int interval_ms = 10;
+
+static struct bt_gatt_read_params reads[WINDOW];
+static struct bt_gatt_write_params writes[WINDOW];
+static uint8_t value[VALUE_LEN];
+
+static void sniff(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+	struct peer_req req;
+
+	/* Basic L2CAP header, then the ATT PDU or the signaling command */
+	if (len < 5) {
+		return;
+	}
+
+	req.cid = sys_get_le16(&data[2]);
+
+	if (req.cid == LB_CID_LE_SIG) {
+		/* Credit Based Connection Response, identifier is our SCID */
+		if (data[4] == 0x18 && len >= 18 && data[5] >= PEER_SCID &&
+		    data[5] < PEER_SCID + MAX_EATT && sys_get_le16(&data[14]) == 0) {
+			host_cids[data[5] - PEER_SCID] = sys_get_le16(&data[16]);
+		}
+
+		return;
+	}
+
+	/* K-frames start with the SDU length */
+	req.op = req.cid == LB_CID_ATT ? data[4] : data[6];
+
+	(void)k_msgq_put(&peer_reqs, &req, K_NO_WAIT);
+}
+
+static void peer_respond(const struct peer_req *req)
+{
+	uint8_t rsp[BT_L2CAP_SDU_HDR_SIZE + 1 + VALUE_LEN];
+	uint16_t cid = LB_CID_ATT;
+	uint16_t off = 0;
+	uint16_t len;
+	int bearer = 0;
+
+	if (req->cid != LB_CID_ATT) {
+		bearer = req->cid - PEER_SCID + 1;
+		cid = host_cids[bearer - 1];
+		off = BT_L2CAP_SDU_HDR_SIZE;
+	}
+
+	switch (req->op) {
+	case 0x0a:
+		/* Read Request, Read Response with a value */
+		rsp[off] = 0x0b;
+		memset(&rsp[off + 1], req->op, VALUE_LEN);
+		len = off + 1 + VALUE_LEN;
+		break;
+	case 0x12:
+		/* Write Request, Write Response */
+		rsp[off] = 0x13;
+		len = off + 1;
+		break;
+	default:
+		return;
+	}
+
+	if (off) {
+		sys_put_le16(len - off, rsp);
+	}
+
+	atomic_inc(&carried[bearer]);
+	hci_loopback_acl_rx(0, cid, rsp, len);
+}
+
+/* Answer everything that arrived during a connection event at its end */
+static void peer_thread(void *p1, void *p2, void *p3)
+{
+	struct peer_req req;
+
+	for (;;) {
+		k_msgq_get(&peer_reqs, &req, K_FOREVER);
+		k_sleep(K_MSEC(interval_ms));
+
+		do {
+			peer_respond(&req);
+		} while (k_msgq_get(&peer_reqs, &req, K_NO_WAIT) == 0);
+	}
+}
+
+static void peer_eatt_connect(uint8_t scid)
+{
+	/* Credit Based Connection Request: PSM, MTU, MPS 247, credits, SCID */
+	uint8_t req[] = {
+		0x17, scid, 0x0a, 0x00,
+		0x27, 0x00, 0xf7, 0x00, 0xf7, 0x00, 0xff, 0xff, scid, 0x00,
+	};
+
+	hci_loopback_acl_rx(0, LB_CID_LE_SIG, req, sizeof(req));
+}
+
+static void complete(int slot)
+{
+	(void)k_msgq_put(&free_slots, &slot, K_NO_WAIT);
+	k_sem_give(&done);
+}
+
+static uint8_t read_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_read_params *params,
+		       const void *data, uint16_t length)
+{
+	__ASSERT_NO_MSG(err == 0);
+
+	complete(params - reads);
+
+	return BT_GATT_ITER_STOP;
+}
+
+static void write_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+	__ASSERT_NO_MSG(err == 0);
+
+	complete(params - writes);
+}
+
+static uint32_t run(struct bt_conn *conn, int count, bool write)
+{
+	uint32_t start;
+	int err;
+
+	k_msgq_purge(&free_slots);
+	for (int i = 0; i < WINDOW; i++) {
+		(void)k_msgq_put(&free_slots, &i, K_NO_WAIT);
+	}
+
+	k_sem_reset(&done);
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < count; i++) {
+		int slot;
+
+		k_msgq_get(&free_slots, &slot, K_FOREVER);
+
+		if (write) {
+			writes[slot] = (struct bt_gatt_write_params) {
+				.func = write_cb,
+				.handle = 0x0001 + i % 16,
+				.data = value,
+				.length = sizeof(value),
+			};
+			err = bt_gatt_write(conn, &writes[slot]);
+		} else {
+			reads[slot] = (struct bt_gatt_read_params) {
+				.func = read_cb,
+				.handle_count = 1,
+				.single.handle = 0x0001 + i % 16,
+			};
+			err = bt_gatt_read(conn, &reads[slot]);
+		}
+
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	for (int i = 0; i < count; i++) {
+		err = k_sem_take(&done, K_SECONDS(30));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	return (uint32_t)((uint64_t)count * 1000U / MAX(k_uptime_get_32() - start, 1U));
+}
+
+static void bench(struct bt_conn *conn, int bearers, int count)
+{
+	uint32_t reads_ps;
+	uint32_t writes_ps;
+
+	for (int i = 0; i <= MAX_EATT; i++) {
+		atomic_clear(&carried[i]);
+	}
+
+	reads_ps = run(conn, count, false);
+	writes_ps = run(conn, count, true);
+
+	printk("%d eatt bearers: %u reads/s, %u writes/s, requests per bearer:", bearers,
+	       reads_ps, writes_ps);
+
+	for (int i = 0; i <= bearers; i++) {
+		printk(" %ld", atomic_get(&carried[i]));
+	}
+
+	printk("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct bt_conn *conn;
+	int count = 200;
+	int err;
+
+	if (argc > 1) {
+		count = atoi(argv[1]);
+	}
+
+	if (argc > 2) {
+		interval_ms = MAX(atoi(argv[2]), 1);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	lb_acl_tx_cb = sniff;
+
+	k_thread_create(&peer_thread_data, peer_stack, K_KERNEL_STACK_SIZEOF(peer_stack),
+			peer_thread, NULL, NULL, NULL, K_PRIO_COOP(1), 0, K_NO_WAIT);
+	k_thread_name_set(&peer_thread_data, "peer");
+
+	conn = hci_loopback_connect(0);
+	conn->sec_level = BT_SECURITY_L2;
+
+	printk("connection interval %d ms, %d requests in flight\n", interval_ms, WINDOW);
+
+	bench(conn, 0, count);
+
+	for (int i = 0; i < MAX_EATT; i++) {
+		peer_eatt_connect(PEER_SCID + i);
+
+		while (bt_eatt_count(conn) < i + 1 || host_cids[i] == 0) {
+			k_sleep(K_MSEC(1));
+		}
+
+		bench(conn, i + 1, count);
+	}
+
+	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	bt_conn_unref(conn);
+
+	printk("PASSED\n");
+
+	return 0;
+}
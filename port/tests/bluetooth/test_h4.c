@@ -0,0 +1,164 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Drive the H:4 driver RX parser through a FIFO standing in for the UART. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/buf.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/drivers/bluetooth.h>
+
+/* Larger than the 512-byte frame the parser used to reassemble into */
+#define ACL_LEN 600
+
+BUILD_ASSERT(CONFIG_BT_BUF_ACL_RX_SIZE >= ACL_LEN,
+	     "CONFIG_BT_BUF_ACL_RX_SIZE must take the test's ACL packets");
+
+static const struct device *const hci_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_bt_hci));
+
+static K_FIFO_DEFINE(rx_fifo);
+
+static int uart_fd = -1;
+
+static int test_recv(const struct device *dev, struct net_buf *buf)
+{
+	k_fifo_put(&rx_fifo, buf);
+
+	return 0;
+}
+
+/* Write @p len bytes in @p chunk sized pieces so the parser sees partial reads */
+static void uart_write(const uint8_t *data, size_t len, size_t chunk)
+{
+	while (len > 0) {
+		size_t n = MIN(len, chunk);
+		ssize_t ret;
+
+		ret = write(uart_fd, data, n);
+		__ASSERT_NO_MSG(ret == n);
+		data += n;
+		len -= n;
+
+		if (len > 0) {
+			k_sleep(K_MSEC(1));
+		}
+	}
+}
+
+static void expect_rx(enum bt_buf_type type, const uint8_t *data, size_t len)
+{
+	struct net_buf *buf;
+
+	buf = k_fifo_get(&rx_fifo, K_MSEC(1000));
+	__ASSERT_NO_MSG(buf != NULL);
+	__ASSERT_NO_MSG(bt_buf_get_type(buf) == type);
+	__ASSERT_NO_MSG(buf->len == len);
+	__ASSERT_NO_MSG(memcmp(buf->data, data, len) == 0);
+
+	net_buf_unref(buf);
+}
+
+static void test_events(void)
+{
+	/* Two events back to back in a single write */
+	static const uint8_t frame[] = {
+		BT_HCI_H4_EVT, BT_HCI_EVT_LE_META_EVENT, 0x03,
+		BT_HCI_EVT_LE_ADVERTISING_REPORT, 0x00, 0x00,
+		BT_HCI_H4_EVT, BT_HCI_EVT_VENDOR, 0x00,
+	};
+
+	printk("%s\n", __func__);
+
+	uart_write(frame, sizeof(frame), sizeof(frame));
+
+	expect_rx(BT_BUF_EVT, &frame[1], 5);
+	expect_rx(BT_BUF_EVT, &frame[7], 2);
+}
+
+static void test_acl(size_t chunk)
+{
+	static uint8_t frame[1 + BT_HCI_ACL_HDR_SIZE + ACL_LEN];
+	struct bt_hci_acl_hdr *hdr = (void *)&frame[1];
+	size_t len = ACL_LEN;
+
+	printk("%s chunk %zu len %zu\n", __func__, chunk, len);
+
+	frame[0] = BT_HCI_H4_ACL;
+	hdr->handle = sys_cpu_to_le16(0x0001);
+	hdr->len = sys_cpu_to_le16(len);
+	for (size_t i = 0; i < len; i++) {
+		frame[1 + sizeof(*hdr) + i] = (uint8_t)i;
+	}
+
+	uart_write(frame, sizeof(frame), chunk);
+
+	expect_rx(BT_BUF_ACL_IN, &frame[1], sizeof(frame) - 1);
+}
+
+static void test_resync(void)
+{
+	/* Junk type byte is skipped, the event after it still arrives */
+	static const uint8_t frame[] = {
+		0xff, BT_HCI_H4_EVT, BT_HCI_EVT_VENDOR, 0x01, 0x5a,
+	};
+
+	printk("%s\n", __func__);
+
+	uart_write(frame, sizeof(frame), sizeof(frame));
+
+	expect_rx(BT_BUF_EVT, &frame[2], 3);
+}
+
+int main(int argc, char *argv[])
+{
+	int err;
+
+	if (access(CONFIG_BT_UART_ON_DEV_NAME, F_OK) != 0) {
+		err = mkfifo(CONFIG_BT_UART_ON_DEV_NAME, 0666);
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	uart_fd = open(CONFIG_BT_UART_ON_DEV_NAME, O_RDWR);
+	__ASSERT_NO_MSG(uart_fd >= 0);
+
+	err = bt_hci_open(hci_dev, test_recv);
+	__ASSERT_NO_MSG(err == 0);
+
+	test_events();
+	test_acl(ACL_LEN + 5);
+	test_acl(7);
+	test_acl(1);
+	test_resync();
+
+	err = bt_hci_close(hci_dev);
+	__ASSERT_NO_MSG(err == 0);
+
+	close(uart_fd);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,336 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Per-type HCI RX queues over the loopback controller. The RX work is held
+ * on the system work queue while the peer's ATT Write Commands, advertising
+ * reports and connection events are injected, then released. Checks that
+ * events changing connection state are never reordered with the packets
+ * around them, that ACL data and reports are served round robin with their
+ * weights, and that the RX work handles at most a batch per run. Needs
+ * CONFIG_BT_RECV_WORKQ_SYS and CONFIG_BT_RECV_STATS.
+ *
+ * Usage: test_hci_rx
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "hci_loopback.h"
+
+#define ROUND_WRITES  MIN(CONFIG_BT_BUF_ACL_RX_COUNT, 8)
+#define ROUND_REPORTS MIN(CONFIG_BT_BUF_EVT_RX_COUNT - 2, 8)
+#define LOG_MAX       (ROUND_WRITES + ROUND_REPORTS)
+
+BUILD_ASSERT(IS_ENABLED(CONFIG_BT_RECV_WORKQ_SYS), "The RX work is held on the system work queue");
+BUILD_ASSERT(CONFIG_BT_BUF_ACL_RX_COUNT >= 4, "Four Write Commands are queued at once");
+
+/* What the RX work handled, in order: 'W' or 'R' and a sequence number, or
+ * 'U' for a connection update
+ */
+static struct {
+	char kind;
+	uint8_t seq;
+} rx_log[LOG_MAX];
+static int rx_logged;
+
+static K_SEM_DEFINE(rx_handled, 0, K_SEM_MAX_LIMIT);
+static K_SEM_DEFINE(rx_held, 0, 1);
+static K_SEM_DEFINE(rx_release, 0, 1);
+static K_SEM_DEFINE(disconnected, 0, 1);
+static atomic_t writes;
+
+static void log_rx(char kind, uint8_t seq)
+{
+	__ASSERT_NO_MSG(rx_logged < LOG_MAX);
+	rx_log[rx_logged].kind = kind;
+	rx_log[rx_logged].seq = seq;
+	rx_logged++;
+
+	k_sem_give(&rx_handled);
+}
+
+static ssize_t write_cmd(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+			 uint16_t len, uint16_t offset, uint8_t flags)
+{
+	atomic_inc(&writes);
+	log_rx('W', *(const uint8_t *)buf);
+
+	return len;
+}
+
+BT_GATT_SERVICE_DEFINE(rx_svc,
+	BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_16(0xfff0)),
+	BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_16(0xfff1), BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+			       BT_GATT_PERM_WRITE, NULL, write_cmd, NULL),
+);
+
+static void scan_recv(const bt_addr_le_t *addr, int8_t rssi, uint8_t adv_type,
+		      struct net_buf_simple *buf)
+{
+	log_rx('R', addr->a.val[0]);
+}
+
+static void param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+			  uint16_t timeout)
+{
+	log_rx('U', 0);
+}
+
+static void disconnected_cb(struct bt_conn *conn, uint8_t reason)
+{
+	k_sem_give(&disconnected);
+}
+
+BT_CONN_CB_DEFINE(rx_conn_cb) = {
+	.le_param_updated = param_updated,
+	.disconnected = disconnected_cb,
+};
+
+/* Keeps the RX work queued behind it until released */
+static void rx_hold_handler(struct k_work *work)
+{
+	k_sem_give(&rx_held);
+	k_sem_take(&rx_release, K_FOREVER);
+}
+
+static K_WORK_DEFINE(rx_hold, rx_hold_handler);
+
+static void rx_hold_start(void)
+{
+	int err;
+
+	k_work_submit(&rx_hold);
+
+	err = k_sem_take(&rx_held, K_SECONDS(5));
+	__ASSERT_NO_MSG(err == 0);
+
+	rx_logged = 0;
+	bt_hci_rx_stats_reset();
+}
+
+/* Release the RX work and wait for @p count logged packets */
+static void rx_hold_release(int count)
+{
+	int err;
+
+	k_sem_give(&rx_release);
+
+	for (int i = 0; i < count; i++) {
+		err = k_sem_take(&rx_handled, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+}
+
+static void peer_write_cmd(uint8_t seq)
+{
+	/* Write Command on the characteristic value, the sequence as value */
+	uint16_t handle = bt_gatt_attr_get_handle(&rx_svc.attrs[2]);
+	uint8_t cmd[] = { 0x52, handle & 0xff, handle >> 8, seq };
+
+	hci_loopback_acl_rx(0, LB_CID_ATT, cmd, sizeof(cmd));
+}
+
+static void peer_report(uint8_t seq)
+{
+	bt_addr_le_t addr = { .type = BT_ADDR_LE_RANDOM, .a.val = { seq, 0, 0, 0, 0, 0xc0 } };
+
+	hci_loopback_adv_report(&addr, -40);
+}
+
+static void peer_conn_update(void)
+{
+	struct bt_hci_evt_le_conn_update_complete *evt;
+	struct bt_hci_evt_le_meta_event *meta;
+	struct net_buf *buf;
+
+	buf = bt_buf_get_evt(BT_HCI_EVT_LE_META_EVENT, false, K_FOREVER);
+	lb_evt_hdr(buf, BT_HCI_EVT_LE_META_EVENT, sizeof(*meta) + sizeof(*evt));
+	meta = net_buf_add(buf, sizeof(*meta));
+	meta->subevent = BT_HCI_EVT_LE_CONN_UPDATE_COMPLETE;
+	evt = net_buf_add(buf, sizeof(*evt));
+	evt->status = BT_HCI_ERR_SUCCESS;
+	evt->handle = sys_cpu_to_le16(LB_HANDLE(0));
+	evt->interval = sys_cpu_to_le16(BT_GAP_INIT_CONN_INT_MAX);
+	evt->latency = 0U;
+	evt->supv_timeout = sys_cpu_to_le16(400);
+
+	lb.recv(lb_dev, buf);
+}
+
+/* A report and Write Commands, a connection update, then a report and a
+ * Write Command that must wait for the update.
+ */
+static void test_event_order(void)
+{
+	int writes_before = 0;
+	int reports_before = 0;
+
+	rx_hold_start();
+
+	peer_report(1);
+	peer_write_cmd(1);
+	peer_write_cmd(2);
+	peer_write_cmd(3);
+	peer_conn_update();
+	peer_report(2);
+	peer_write_cmd(4);
+
+	rx_hold_release(7);
+
+	/* The Write Commands before the update in order, with the report */
+	for (int i = 0; i < 4; i++) {
+		if (rx_log[i].kind == 'W') {
+			__ASSERT_NO_MSG(rx_log[i].seq == ++writes_before);
+		} else {
+			__ASSERT_NO_MSG(rx_log[i].kind == 'R' && rx_log[i].seq == 1);
+			reports_before++;
+		}
+	}
+
+	__ASSERT_NO_MSG(writes_before == 3 && reports_before == 1);
+
+	/* Everything after it in arrival order */
+	__ASSERT_NO_MSG(rx_log[4].kind == 'U');
+	__ASSERT_NO_MSG(rx_log[5].kind == 'R' && rx_log[5].seq == 2);
+	__ASSERT_NO_MSG(rx_log[6].kind == 'W' && rx_log[6].seq == 4);
+
+	printk("event order: ok\n");
+}
+
+/* Write Commands, then the peer's Disconnection Complete. Any of them
+ * handled after it would find no connection and be dropped.
+ */
+static void test_disconnect_order(struct bt_conn *conn)
+{
+	int err;
+
+	rx_hold_start();
+	atomic_clear(&writes);
+
+	for (int i = 0; i < 3; i++) {
+		peer_write_cmd(i + 1);
+	}
+
+	lb_disconn_complete(LB_HANDLE(0), BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+
+	rx_hold_release(3);
+
+	err = k_sem_take(&disconnected, K_SECONDS(5));
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT_NO_MSG(atomic_get(&writes) == 3);
+
+	bt_conn_unref(conn);
+
+	printk("disconnect order: ok\n");
+}
+
+/* Both queues filled, then served round robin in batches */
+static void test_weights(void)
+{
+	struct bt_hci_rx_stats stats;
+	int total = ROUND_WRITES + ROUND_REPORTS;
+	int start = 0;
+	int err;
+
+	rx_hold_start();
+
+	for (int i = 0; i < ROUND_WRITES; i++) {
+		peer_write_cmd(i);
+	}
+
+	for (int i = 0; i < ROUND_REPORTS; i++) {
+		peer_report(i);
+	}
+
+	rx_hold_release(total);
+
+	/* Each type in runs of its weight, while the other one has packets
+	 * left. Only the first run may be cut short by the previous round.
+	 */
+	for (int i = 1; i <= total; i++) {
+		char kind = rx_log[start].kind;
+		int weight = kind == 'W' ? CONFIG_BT_RECV_WEIGHT_ACL : CONFIG_BT_RECV_WEIGHT_EVT;
+		bool more = false;
+		int run = i - start;
+
+		if (i < total && rx_log[i].kind == kind) {
+			continue;
+		}
+
+		for (int j = i; j < total; j++) {
+			more |= rx_log[j].kind == kind;
+		}
+
+		if (start == 0 || !more) {
+			__ASSERT_NO_MSG(run <= weight || i == total);
+		} else {
+			__ASSERT_NO_MSG(run == weight);
+		}
+
+		start = i;
+	}
+
+	err = bt_hci_rx_stats_get(&stats);
+	__ASSERT_NO_MSG(err == 0);
+
+	__ASSERT_NO_MSG(stats.queue[BT_HCI_RX_ACL].pkts == ROUND_WRITES);
+	__ASSERT_NO_MSG(stats.queue[BT_HCI_RX_EVT].pkts == ROUND_REPORTS);
+	__ASSERT_NO_MSG(stats.queue[BT_HCI_RX_ACL].max_depth == ROUND_WRITES);
+	__ASSERT_NO_MSG(stats.queue[BT_HCI_RX_EVT].max_depth == ROUND_REPORTS);
+	__ASSERT_NO_MSG(stats.queue[BT_HCI_RX_ACL].depth == 0);
+	__ASSERT_NO_MSG(stats.queue[BT_HCI_RX_EVT].depth == 0);
+	__ASSERT_NO_MSG(stats.runs == DIV_ROUND_UP(total, CONFIG_BT_RECV_BATCH));
+
+	printk("weights: %d writes %d reports in %u runs, acl wait max %u us, evt wait max %u us\n",
+	       ROUND_WRITES, ROUND_REPORTS, stats.runs, stats.queue[BT_HCI_RX_ACL].max_wait_us,
+	       stats.queue[BT_HCI_RX_EVT].max_wait_us);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bt_le_scan_param param = {
+		.type = BT_LE_SCAN_TYPE_PASSIVE,
+		.options = BT_LE_SCAN_OPT_NONE,
+		.interval = BT_GAP_SCAN_FAST_INTERVAL,
+		.window = BT_GAP_SCAN_FAST_WINDOW,
+	};
+	struct bt_conn *conn;
+	int err;
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	err = bt_le_scan_start(&param, scan_recv);
+	__ASSERT_NO_MSG(err == 0);
+
+	conn = hci_loopback_connect(0);
+
+	/* Let the connection setup settle before holding the RX work */
+	k_sleep(K_MSEC(100));
+
+	test_event_order();
+	test_weights();
+	test_disconnect_order(conn);
+
+	err = bt_le_scan_stop();
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,211 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Notification fan-out over the loopback controller: peers subscribe one by
+ * one, and at 1, 2, 4, ... subscribers the value is notified to all of them
+ * with bt_gatt_notify_cb(NULL, ...). Prints buffer allocations, copied bytes,
+ * skipped subscribers and cycles per notify. Then checks the bytes every
+ * subscriber got on the wire. Build with and without
+ * CONFIG_BT_GATT_NOTIFY_SHARED to compare, needs CONFIG_BT_GATT_NOTIFY_STATS.
+ *
+ * Usage: test_notify_fanout [count] [value length]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "hci_loopback.h"
+
+/* White box: notification statistics */
+#include "../../../subsys/bluetooth/host/gatt_internal.h"
+
+static void ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+}
+
+BT_GATT_SERVICE_DEFINE(fanout_svc,
+	BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_16(0xfff0)),
+	BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_16(0xfff1), BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
+
+/* Last ACL packet sent to each peer */
+static uint8_t wire_pkt[LB_MAX_CONN][LB_ACL_MTU];
+static uint16_t wire_len[LB_MAX_CONN];
+static K_SEM_DEFINE(wire_sent, 0, K_SEM_MAX_LIMIT);
+
+static void wire_capture(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+	int idx = handle - LB_HANDLE(0);
+
+	__ASSERT_NO_MSG(len <= sizeof(wire_pkt[idx]));
+	memcpy(wire_pkt[idx], data, len);
+	wire_len[idx] = len;
+
+	k_sem_give(&wire_sent);
+}
+
+static void peer_subscribe(struct bt_conn *conn, int idx)
+{
+	/* Write Request 0x0001 on the CCC */
+	uint16_t ccc = bt_gatt_attr_get_handle(&fanout_svc.attrs[3]);
+	uint8_t write_req[] = { 0x12, ccc & 0xff, ccc >> 8, 0x01, 0x00 };
+
+	hci_loopback_acl_rx(idx, LB_CID_ATT, write_req, sizeof(write_req));
+
+	while (!bt_gatt_is_subscribed(conn, &fanout_svc.attrs[2], BT_GATT_CCC_NOTIFY)) {
+		k_sleep(K_MSEC(1));
+	}
+}
+
+static void bench(int subs, int count, uint16_t len)
+{
+	static uint8_t value[BT_L2CAP_TX_MTU];
+	struct bt_gatt_notify_params params = {
+		.attr = &fanout_svc.attrs[2],
+		.data = value,
+		.len = len,
+	};
+	struct bt_gatt_notify_stats stats;
+	atomic_val_t pkts = atomic_get(&lb.acl_pkts);
+	uint64_t cycles = 0;
+	int sent = 0;
+
+	bt_gatt_notify_stats_reset();
+
+	for (int i = 0; i < count; i++) {
+		uint32_t start;
+		int err;
+
+		value[0] = i;
+
+		start = k_cycle_get_32();
+		err = bt_gatt_notify_cb(NULL, &params);
+		cycles += k_cycle_get_32() - start;
+
+		if (err == 0) {
+			sent++;
+		}
+
+		/* Let the TX path keep up, as a sensor sampling would */
+		if (i % 8 == 7) {
+			k_yield();
+		}
+	}
+
+	bt_gatt_notify_stats_get(&stats);
+
+	/* Every PDU the host queued goes out, the skipped ones never do */
+	hci_loopback_wait_acl(pkts + stats.pdus);
+
+	printk("%2d subscribers: %d notifies (%d ok), per notify %u.%02u allocs, %u.%02u bytes "
+	       "copied, %u.%02u skipped, %u cycles\n",
+	       subs, count, sent,
+	       (stats.pdus + stats.values) / count, (stats.pdus + stats.values) * 100 / count % 100,
+	       stats.copied / count, stats.copied * 100 / count % 100,
+	       stats.backpressure / count, stats.backpressure * 100 / count % 100,
+	       (uint32_t)(cycles / count));
+}
+
+/* One notification to every subscriber, each must get the whole PDU */
+static void check_wire(int subs, uint16_t len)
+{
+	static uint8_t value[BT_L2CAP_TX_MTU];
+	struct bt_gatt_notify_params params = {
+		.attr = &fanout_svc.attrs[2],
+		.data = value,
+		.len = len,
+	};
+	uint16_t handle = bt_gatt_attr_get_handle(&fanout_svc.attrs[2]);
+	int err;
+
+	for (int i = 0; i < len; i++) {
+		value[i] = 0xa0 + i;
+	}
+
+	/* Let the benchmark traffic drain first */
+	k_sleep(K_MSEC(100));
+	k_sem_reset(&wire_sent);
+	memset(wire_len, 0, sizeof(wire_len));
+	lb_acl_tx_cb = wire_capture;
+
+	err = bt_gatt_notify_cb(NULL, &params);
+	__ASSERT_NO_MSG(err == 0);
+
+	for (int i = 0; i < subs; i++) {
+		err = k_sem_take(&wire_sent, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	lb_acl_tx_cb = NULL;
+
+	/* Basic L2CAP header, then Handle Value Notification */
+	for (int i = 0; i < subs; i++) {
+		const uint8_t *pkt = wire_pkt[i];
+
+		__ASSERT_NO_MSG(wire_len[i] == BT_L2CAP_HDR_SIZE + 3 + len);
+		__ASSERT_NO_MSG(sys_get_le16(&pkt[0]) == 3 + len);
+		__ASSERT_NO_MSG(sys_get_le16(&pkt[2]) == LB_CID_ATT);
+		__ASSERT_NO_MSG(pkt[4] == 0x1b);
+		__ASSERT_NO_MSG(sys_get_le16(&pkt[5]) == handle);
+		__ASSERT_NO_MSG(!memcmp(&pkt[7], value, len));
+	}
+
+	printk("wire: %d subscribers ok\n", subs);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bt_conn *conns[LB_MAX_CONN];
+	int count = 1000;
+	uint16_t len = 20;
+	int err;
+
+	if (argc > 1) {
+		count = atoi(argv[1]);
+	}
+
+	if (argc > 2) {
+		/* Default ATT MTU of 23, the peers do not exchange it */
+		len = CLAMP(atoi(argv[2]), 1, 20);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("shared values %s, value %u bytes\n",
+	       IS_ENABLED(CONFIG_BT_GATT_NOTIFY_SHARED) ? "on" : "off", len);
+
+	for (int i = 0; i < LB_MAX_CONN; i++) {
+		conns[i] = hci_loopback_connect(i);
+		peer_subscribe(conns[i], i);
+
+		if (is_power_of_two(i + 1) || i + 1 == LB_MAX_CONN) {
+			bench(i + 1, count, len);
+		}
+	}
+
+	check_wire(LB_MAX_CONN, len);
+
+	printk("PASSED\n");
+
+	return 0;
+}
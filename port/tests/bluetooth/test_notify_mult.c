@@ -0,0 +1,294 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Notification batching over the loopback controller, with a peer that
+ * supports Multiple Handle Value Notifications. Checks that a notification
+ * on an idle link goes out on its own, that one held back while the link is
+ * busy leaves once it is idle again, that a full PDU is not held back, and
+ * that the latency budget is kept, along with the statistics of each.
+ * Needs CONFIG_BT_GATT_NOTIFY_MULTIPLE and CONFIG_BT_GATT_NOTIFY_STATS.
+ *
+ * Usage: test_notify_mult
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "hci_loopback.h"
+
+/* White box: notification statistics */
+#include "../../../subsys/bluetooth/host/gatt_internal.h"
+
+#define VALUE_LEN 4
+
+static void ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+}
+
+BT_GATT_SERVICE_DEFINE(mult_svc,
+	BT_GATT_PRIMARY_SERVICE(BT_UUID_DECLARE_16(0xfff0)),
+	BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_16(0xfff1), BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_DECLARE_16(0xfff2), BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+);
+
+#define ATTR_A (&mult_svc.attrs[2])
+#define ATTR_B (&mult_svc.attrs[5])
+
+static struct bt_conn *conn;
+
+static K_SEM_DEFINE(write_rsp, 0, 1);
+static K_SEM_DEFINE(nfy_sent, 0, K_SEM_MAX_LIMIT);
+/* Last notification PDU: opcode, handles carried and when it was sent */
+static uint8_t last_op;
+static int last_handles;
+static uint32_t last_time;
+
+static void peer_capture(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+	uint16_t off;
+
+	if (len < 5 || sys_get_le16(&data[2]) != LB_CID_ATT) {
+		return;
+	}
+
+	switch (data[4]) {
+	case 0x13:
+		/* Write Response */
+		k_sem_give(&write_rsp);
+		break;
+	case 0x1b:
+		last_op = data[4];
+		last_handles = 1;
+		last_time = k_uptime_get_32();
+		k_sem_give(&nfy_sent);
+		break;
+	case 0x23:
+		/* Handle, length and value tuples */
+		last_op = data[4];
+		last_handles = 0;
+
+		for (off = 5; off + 4 <= len; off += 4 + sys_get_le16(&data[off + 2])) {
+			__ASSERT_NO_MSG(sys_get_le16(&data[off + 2]) == VALUE_LEN);
+			last_handles++;
+		}
+
+		last_time = k_uptime_get_32();
+		k_sem_give(&nfy_sent);
+		break;
+	default:
+		break;
+	}
+}
+
+static void peer_write(uint16_t handle, const uint8_t *value, uint8_t len)
+{
+	uint8_t req[3 + 2] = { 0x12, handle & 0xff, handle >> 8 };
+	int err;
+
+	__ASSERT_NO_MSG(len <= 2);
+	memcpy(&req[3], value, len);
+
+	hci_loopback_acl_rx(0, LB_CID_ATT, req, 3 + len);
+
+	err = k_sem_take(&write_rsp, K_SECONDS(5));
+	__ASSERT_NO_MSG(err == 0);
+}
+
+static void peer_setup(void)
+{
+	const struct bt_gatt_attr *cf;
+	uint8_t notify_multi = BIT(2);
+	uint8_t ccc[] = { 0x01, 0x00 };
+
+	/* Client Supported Features: Multiple Handle Value Notifications */
+	cf = bt_gatt_find_by_uuid(NULL, 0, BT_UUID_GATT_CLIENT_FEATURES);
+	__ASSERT_NO_MSG(cf != NULL);
+	peer_write(bt_gatt_attr_get_handle(cf), &notify_multi, sizeof(notify_multi));
+
+	peer_write(bt_gatt_attr_get_handle(&mult_svc.attrs[3]), ccc, sizeof(ccc));
+	peer_write(bt_gatt_attr_get_handle(&mult_svc.attrs[6]), ccc, sizeof(ccc));
+}
+
+static void notify(const struct bt_gatt_attr *attr)
+{
+	static uint8_t value[VALUE_LEN];
+	struct bt_gatt_notify_params params = {
+		.attr = attr,
+		.data = value,
+		.len = sizeof(value),
+	};
+	int err;
+
+	value[0]++;
+
+	err = bt_gatt_notify_cb(conn, &params);
+	__ASSERT_NO_MSG(err == 0);
+}
+
+static void expect_pdu(uint8_t op, int handles)
+{
+	int err;
+
+	err = k_sem_take(&nfy_sent, K_SECONDS(1));
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT_NO_MSG(last_op == op && last_handles == handles);
+}
+
+static void expect_none(uint32_t ms)
+{
+	int err;
+
+	err = k_sem_take(&nfy_sent, K_MSEC(ms));
+	__ASSERT_NO_MSG(err == -EAGAIN);
+}
+
+static void policy_set(uint16_t latency_ms, uint8_t flags)
+{
+	struct bt_gatt_notify_mult_policy policy = {
+		.latency_ms = latency_ms,
+		.flags = flags,
+	};
+	int err;
+
+	err = bt_gatt_notify_mult_policy_set(conn, &policy);
+	__ASSERT_NO_MSG(err == 0);
+
+	/* Let what was in flight be acknowledged */
+	k_sleep(K_MSEC(50));
+	k_sem_reset(&nfy_sent);
+	bt_gatt_notify_stats_reset();
+}
+
+/* Nothing is held back on an idle link, only while it is busy */
+static void test_flush_idle(void)
+{
+	struct bt_gatt_notify_stats stats;
+
+	policy_set(1000, BT_GATT_NOTIFY_MULT_FLUSH_IDLE);
+
+	notify(ATTR_A);
+	expect_pdu(0x1b, 1);
+
+	/* The first one stays in the controller, the others wait for it */
+	k_sleep(K_MSEC(50));
+	hci_loopback_ack_hold(true);
+
+	notify(ATTR_A);
+	expect_pdu(0x1b, 1);
+
+	notify(ATTR_B);
+	notify(ATTR_A);
+	expect_none(100);
+
+	hci_loopback_ack_hold(false);
+	expect_pdu(0x23, 2);
+
+	bt_gatt_notify_stats_get(&stats);
+	__ASSERT_NO_MSG(stats.pdus == 3);
+	__ASSERT_NO_MSG(stats.mult_pdus == 1 && stats.mult_handles == 2);
+	__ASSERT_NO_MSG(stats.mult_idle == 1);
+	__ASSERT_NO_MSG(stats.mult_full == 0 && stats.mult_budget == 0);
+
+	printk("flush idle: ok\n");
+}
+
+/* A PDU that can not take another value leaves right away */
+static void test_flush_full(void)
+{
+	struct bt_gatt_notify_stats stats;
+	int per_pdu = (bt_gatt_get_mtu(conn) - 1) / (4 + VALUE_LEN);
+
+	policy_set(1000, BT_GATT_NOTIFY_MULT_FLUSH_FULL);
+
+	for (int i = 0; i < per_pdu; i++) {
+		notify(i % 2 ? ATTR_B : ATTR_A);
+	}
+
+	expect_pdu(0x23, per_pdu);
+
+	/* A single value is held back */
+	notify(ATTR_A);
+	expect_none(100);
+
+	bt_gatt_notify_stats_get(&stats);
+	__ASSERT_NO_MSG(stats.pdus == 2);
+	__ASSERT_NO_MSG(stats.mult_pdus == 1 && stats.mult_handles == per_pdu);
+	__ASSERT_NO_MSG(stats.mult_full == 1);
+
+	/* The new policy sends it, as a plain notification */
+	policy_set(1000, 0);
+	__ASSERT_NO_MSG(last_op == 0x1b && last_handles == 1);
+
+	printk("flush full: %d values per pdu ok\n", per_pdu);
+}
+
+/* Without flush flags a batch is held for the latency budget */
+static void test_latency(void)
+{
+	struct bt_gatt_notify_stats stats;
+	uint32_t start;
+
+	policy_set(50, 0);
+
+	start = k_uptime_get_32();
+	notify(ATTR_A);
+	notify(ATTR_B);
+
+	expect_none(20);
+	expect_pdu(0x23, 2);
+	__ASSERT_NO_MSG(last_time - start >= 50);
+
+	bt_gatt_notify_stats_get(&stats);
+	__ASSERT_NO_MSG(stats.pdus == 1);
+	__ASSERT_NO_MSG(stats.mult_pdus == 1 && stats.mult_handles == 2);
+	__ASSERT_NO_MSG(stats.mult_budget == 1);
+	__ASSERT_NO_MSG(stats.mult_latency_max_ms >= 50);
+	__ASSERT_NO_MSG(stats.mult_latency_ms == stats.mult_latency_max_ms);
+
+	printk("latency: held %u ms ok\n", stats.mult_latency_max_ms);
+}
+
+int main(int argc, char *argv[])
+{
+	int err;
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	lb_acl_tx_cb = peer_capture;
+
+	conn = hci_loopback_connect(0);
+	peer_setup();
+
+	test_flush_idle();
+	test_flush_full();
+	test_latency();
+
+	lb_acl_tx_cb = NULL;
+
+	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	bt_conn_unref(conn);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Checks that the first bt_rand() passes the CTR_DRBG known answer test and
+ * that bt_rand_pr() reseeds from the controller. Then replays the bt_rand()
+ * request patterns of LE Secure Connections pairing and mesh provisioning
+ * over the loopback controller, once straight through HCI_LE_Rand and once
+ * through bt_rand(). Prints the HCI_LE_Rand commands sent and the time taken
+ * for each. Needs CONFIG_BT_RAND_DRBG.
+ *
+ * Usage: test_rand [rounds]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/crypto.h>
+
+#include "hci_loopback.h"
+
+/* Approximate sizes: private key, confirm nonce, passkey */
+static const uint8_t pairing[] = { 32, 16, 3 };
+
+/* Approximate sizes: private key, random, device key, nonces, IV */
+static const uint8_t provisioning[] = { 32, 16, 16, 16, 8 };
+
+static atomic_t le_rand_cmds;
+
+static void cmd_cb(uint16_t opcode)
+{
+	if (opcode == BT_HCI_OP_LE_RAND) {
+		atomic_inc(&le_rand_cmds);
+	}
+}
+
+/* LE Rand commands to gather a seed, 8 bytes each */
+#define SEED_CMDS 4
+
+static void check_reseed(void)
+{
+	uint8_t key[16];
+	int err;
+
+	/* Fails if the known answer test did */
+	err = bt_rand(key, sizeof(key));
+	__ASSERT_NO_MSG(err == 0);
+
+	atomic_clear(&le_rand_cmds);
+	err = bt_rand_pr(key, sizeof(key));
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT_NO_MSG(atomic_get(&le_rand_cmds) == SEED_CMDS);
+
+	atomic_clear(&le_rand_cmds);
+	err = bt_rand(key, sizeof(key));
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT_NO_MSG(atomic_get(&le_rand_cmds) ==
+			(IS_ENABLED(CONFIG_BT_RAND_DRBG_PREDICTION_RESISTANCE) ? SEED_CMDS : 0));
+
+	printk("reseed: ok\n");
+}
+
+static void bench(const char *name, const uint8_t *sizes, size_t num, int rounds,
+		  int (*rand_func)(void *buf, size_t len))
+{
+	uint8_t buf[32];
+	uint32_t start;
+	uint32_t ms;
+	int err;
+
+	atomic_clear(&le_rand_cmds);
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < rounds; i++) {
+		for (size_t j = 0; j < num; j++) {
+			err = rand_func(buf, sizes[j]);
+			__ASSERT_NO_MSG(err == 0);
+		}
+	}
+
+	ms = MAX(k_uptime_get_32() - start, 1U);
+
+	printk("%s: %d rounds in %u ms, %ld LE Rand commands\n", name, rounds, ms,
+	       atomic_get(&le_rand_cmds));
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = 1000;
+	int err;
+
+	if (argc > 1) {
+		rounds = atoi(argv[1]);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	lb_cmd_cb = cmd_cb;
+
+	check_reseed();
+
+	bench("pairing hci", pairing, ARRAY_SIZE(pairing), rounds, bt_hci_le_rand);
+	bench("pairing drbg", pairing, ARRAY_SIZE(pairing), rounds, bt_rand);
+	bench("provisioning hci", provisioning, ARRAY_SIZE(provisioning), rounds,
+	      bt_hci_le_rand);
+	bench("provisioning drbg", provisioning, ARRAY_SIZE(provisioning), rounds, bt_rand);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,229 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* RPA cache checks, then a scan storm over the loopback controller.
+ *
+ * The checks resolve RPAs made from a known IRK: a miss is remembered until
+ * an IRK is added, a match is remembered after the bond has moved on to
+ * another RPA, and both are resolved again once they expire. The expiry is
+ * only waited for when CONFIG_BT_KEYS_RPA_CACHE_TIMEOUT is a few seconds.
+ *
+ * The storm has CONFIG_BT_MAX_PAIRED bonds with an IRK, and a crowd of
+ * advertisers with unknown RPAs sending reports round robin. Prints the IRK
+ * checks (AES operations) the host did per report, with a crowd that fits
+ * the RPA cache and with one that does not. Needs CONFIG_BT_PRIVACY and
+ * CONFIG_BT_KEYS_RPA_STATS.
+ *
+ * Usage: test_rpa_cache [reports] [crowd]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+
+#include "hci_loopback.h"
+
+/* White box: bonds are added straight to the key pool */
+#include "../../../subsys/bluetooth/host/keys.h"
+/* White box: RPAs made from a known IRK */
+#include "../../../subsys/bluetooth/common/rpa.h"
+
+#define MAX_CROWD 64
+
+/* Longest expiry the checks wait for */
+#define EXPIRY_WAIT_MAX 5
+
+BUILD_ASSERT(CONFIG_BT_KEYS_RPA_CACHE_SIZE >= 3, "The checks remember three RPAs at once");
+
+static bt_addr_le_t crowd[MAX_CROWD];
+static atomic_t reports;
+
+static void scan_cb(const bt_addr_le_t *addr, int8_t rssi, uint8_t adv_type,
+		    struct net_buf_simple *buf)
+{
+	atomic_inc(&reports);
+}
+
+static void rand_fill(uint8_t *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = rand();
+	}
+}
+
+/* Look @p rpa up, expecting @p expected and whether the cache answered */
+static void check_lookup(const bt_addr_t *rpa, struct bt_keys *expected, bool hit)
+{
+	bt_addr_le_t addr = { .type = BT_ADDR_LE_RANDOM };
+	struct bt_keys_rpa_stats stats;
+	struct bt_keys *keys;
+
+	bt_addr_copy(&addr.a, rpa);
+	bt_keys_rpa_stats_reset();
+
+	keys = bt_keys_find_irk(BT_ID_DEFAULT, &addr);
+	bt_keys_rpa_stats_get(&stats);
+
+	__ASSERT_NO_MSG(keys == expected);
+	__ASSERT_NO_MSG(stats.lookups == 1);
+
+	if (hit) {
+		__ASSERT_NO_MSG(stats.cache_hits == 1 && stats.irk_checks == 0);
+	} else {
+		__ASSERT_NO_MSG(stats.cache_hits == 0);
+	}
+}
+
+static void test_cache(void)
+{
+	bt_addr_le_t bond = { .type = BT_ADDR_LE_PUBLIC, .a.val = { 0x01, 0xa0 } };
+	uint8_t irk[16];
+	bt_addr_t rpa[2];
+	bt_addr_t other;
+	struct bt_keys *keys;
+	int err;
+
+	rand_fill(irk, sizeof(irk));
+
+	for (int i = 0; i < ARRAY_SIZE(rpa); i++) {
+		err = bt_rpa_create(irk, &rpa[i]);
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	rand_fill(other.val, sizeof(other.val));
+	BT_ADDR_SET_RPA(&other);
+
+	/* No bond yet, the miss is remembered */
+	check_lookup(&rpa[0], NULL, false);
+	check_lookup(&rpa[0], NULL, true);
+
+	/* Adding the IRK flushes it */
+	keys = bt_keys_get_type(BT_KEYS_IRK, BT_ID_DEFAULT, &bond);
+	__ASSERT_NO_MSG(keys != NULL);
+	memcpy(keys->irk.val, irk, sizeof(irk));
+	bt_keys_add_type(keys, BT_KEYS_IRK);
+
+	check_lookup(&rpa[0], keys, false);
+
+	/* The bond remembers its last RPA, the cache the one before */
+	check_lookup(&rpa[1], keys, false);
+	check_lookup(&rpa[0], keys, true);
+
+	check_lookup(&other, NULL, false);
+	check_lookup(&other, NULL, true);
+
+	if (CONFIG_BT_KEYS_RPA_CACHE_TIMEOUT <= EXPIRY_WAIT_MAX) {
+		k_sleep(K_SECONDS(CONFIG_BT_KEYS_RPA_CACHE_TIMEOUT));
+
+		/* rpa[0] is the bond's last RPA now, rpa[1] is only cached */
+		check_lookup(&rpa[1], keys, false);
+		check_lookup(&other, NULL, false);
+
+		printk("rpa cache: ok\n");
+	} else {
+		printk("rpa cache: ok, expiry after %d s not waited for\n",
+		       CONFIG_BT_KEYS_RPA_CACHE_TIMEOUT);
+	}
+
+	bt_keys_clear(keys);
+}
+
+static void add_bonds(void)
+{
+	for (int i = 0; i < CONFIG_BT_MAX_PAIRED; i++) {
+		bt_addr_le_t addr = { .type = BT_ADDR_LE_PUBLIC, .a.val = { i + 1, 0xb0 } };
+		struct bt_keys *keys;
+
+		keys = bt_keys_get_type(BT_KEYS_IRK, BT_ID_DEFAULT, &addr);
+		__ASSERT_NO_MSG(keys != NULL);
+
+		rand_fill(keys->irk.val, sizeof(keys->irk.val));
+	}
+}
+
+static void new_crowd(int size)
+{
+	for (int i = 0; i < size; i++) {
+		crowd[i].type = BT_ADDR_LE_RANDOM;
+		rand_fill(crowd[i].a.val, sizeof(crowd[i].a.val));
+		BT_ADDR_SET_RPA(&crowd[i].a);
+	}
+}
+
+static void bench(const char *name, int size, int count)
+{
+	struct bt_keys_rpa_stats stats;
+	uint32_t start;
+	uint32_t ms;
+
+	new_crowd(size);
+	atomic_clear(&reports);
+	bt_keys_rpa_stats_reset();
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < count; i++) {
+		hci_loopback_adv_report(&crowd[i % size], -60);
+	}
+
+	while (atomic_get(&reports) < count) {
+		k_sleep(K_MSEC(1));
+	}
+
+	ms = MAX(k_uptime_get_32() - start, 1U);
+	bt_keys_rpa_stats_get(&stats);
+
+	printk("%s: %d reports from %d devices in %u ms, %u lookups %u cache hits "
+	       "%u irk checks, %u.%02u per report\n",
+	       name, count, size, ms, stats.lookups, stats.cache_hits, stats.irk_checks,
+	       stats.irk_checks / count, stats.irk_checks * 100 / count % 100);
+}
+
+int main(int argc, char *argv[])
+{
+	int crowd_size = MAX_CROWD;
+	int count = 10000;
+	int err;
+
+	if (argc > 1) {
+		count = atoi(argv[1]);
+	}
+
+	if (argc > 2) {
+		crowd_size = CLAMP(atoi(argv[2]), 1, MAX_CROWD);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	test_cache();
+	add_bonds();
+
+	err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, scan_cb);
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("%d bonds, rpa cache %d\n", CONFIG_BT_MAX_PAIRED, CONFIG_BT_KEYS_RPA_CACHE_SIZE);
+
+	bench("fits", MIN(crowd_size, MAX(CONFIG_BT_KEYS_RPA_CACHE_SIZE, 1)), count);
+	bench("crowd", crowd_size, count);
+
+	bt_le_scan_stop();
+
+	printk("PASSED\n");
+
+	return 0;
+}
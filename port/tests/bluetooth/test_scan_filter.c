@@ -0,0 +1,261 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Host filtering of advertising reports over the loopback controller.
+ * Checks that duplicates are dropped within the window and that the next
+ * delivered report carries their strongest RSSI, that a new scan starts
+ * with an empty filter, that reports no listener accepts are dropped, and
+ * that the accept answers follow their listener when a callback changes
+ * the listeners. Needs CONFIG_BT_SCAN_DUP_FILTER and CONFIG_BT_SCAN_STATS.
+ *
+ * Usage: test_scan_filter
+ */
+
+#include <zephyr/kernel.h>
+
+#include "hci_loopback.h"
+
+static const struct bt_le_scan_param scan_param = {
+	.type = BT_LE_SCAN_TYPE_PASSIVE,
+	.options = BT_LE_SCAN_OPT_FILTER_DUPLICATE,
+	.interval = BT_GAP_SCAN_FAST_INTERVAL,
+	.window = BT_GAP_SCAN_FAST_WINDOW,
+};
+
+static K_SEM_DEFINE(found, 0, K_SEM_MAX_LIMIT);
+static int8_t found_rssi;
+static struct bt_le_scan_cb *unregister_on_found;
+
+static atomic_t picky_reports;
+static atomic_t eager_reports;
+
+static void scan_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t adv_type,
+		       struct net_buf_simple *buf)
+{
+	found_rssi = rssi;
+
+	if (unregister_on_found) {
+		bt_le_scan_cb_unregister(unregister_on_found);
+		unregister_on_found = NULL;
+	}
+
+	k_sem_give(&found);
+}
+
+/* Only wants advertiser 00:00:00:00:00:02 */
+static bool picky_accept(const struct bt_le_scan_recv_info *info,
+			 const struct net_buf_simple *buf)
+{
+	return info->addr->a.val[0] == 2;
+}
+
+static void picky_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+	__ASSERT_NO_MSG(info->addr->a.val[0] == 2);
+	atomic_inc(&picky_reports);
+}
+
+static bool eager_accept(const struct bt_le_scan_recv_info *info,
+			 const struct net_buf_simple *buf)
+{
+	return true;
+}
+
+static void eager_recv(const struct bt_le_scan_recv_info *info, struct net_buf_simple *buf)
+{
+	atomic_inc(&eager_reports);
+}
+
+static struct bt_le_scan_cb picky_cb = {
+	.recv = picky_recv,
+	.accept = picky_accept,
+};
+
+static struct bt_le_scan_cb eager_cb = {
+	.recv = eager_recv,
+	.accept = eager_accept,
+};
+
+static void report(uint8_t idx, int8_t rssi)
+{
+	bt_addr_le_t addr = { .type = BT_ADDR_LE_PUBLIC, .a.val = { idx } };
+
+	hci_loopback_adv_report(&addr, rssi);
+}
+
+/* Wait until the host has seen @p count reports since the last reset */
+static struct bt_le_scan_stats wait_received(uint32_t count)
+{
+	struct bt_le_scan_stats stats;
+	int err;
+
+	for (int i = 0; i < 5000; i++) {
+		err = bt_le_scan_stats_get(&stats);
+		__ASSERT_NO_MSG(err == 0);
+
+		if (stats.received >= count) {
+			break;
+		}
+
+		k_sleep(K_MSEC(1));
+	}
+
+	__ASSERT_NO_MSG(stats.received == count);
+
+	return stats;
+}
+
+static void expect_found(int8_t rssi)
+{
+	int err;
+
+	err = k_sem_take(&found, K_SECONDS(5));
+	__ASSERT_NO_MSG(err == 0);
+	__ASSERT_NO_MSG(found_rssi == rssi);
+}
+
+static void scan_restart(bt_le_scan_cb_t cb)
+{
+	int err;
+
+	err = bt_le_scan_stop();
+	__ASSERT_NO_MSG(err == 0);
+
+	err = bt_le_scan_start(&scan_param, cb);
+	__ASSERT_NO_MSG(err == 0);
+
+	bt_le_scan_stats_reset();
+}
+
+static void test_duplicates(void)
+{
+	struct bt_le_scan_stats stats;
+	int err;
+
+	err = bt_le_scan_start(&scan_param, scan_found);
+	__ASSERT_NO_MSG(err == 0);
+
+	bt_le_scan_stats_reset();
+
+	report(1, -70);
+	expect_found(-70);
+
+	/* Dropped, their RSSI is kept for the next delivery */
+	report(1, -50);
+	report(1, -60);
+
+	/* Another advertiser is no duplicate */
+	report(3, -65);
+	expect_found(-65);
+
+	stats = wait_received(4);
+	__ASSERT_NO_MSG(stats.duplicates == 2 && stats.delivered == 2);
+	__ASSERT_NO_MSG(k_sem_count_get(&found) == 0);
+
+	k_sleep(K_MSEC(CONFIG_BT_SCAN_DUP_FILTER_WINDOW));
+
+	report(1, -80);
+	expect_found(-50);
+
+	/* A new scan forgets both the report and the RSSI */
+	report(1, -40);
+	wait_received(6);
+
+	scan_restart(scan_found);
+
+	report(1, -75);
+	expect_found(-75);
+
+	printk("duplicates: ok\n");
+}
+
+static void test_accept(void)
+{
+	struct bt_le_scan_stats stats;
+	int err;
+
+	/* Only the listener decides */
+	scan_restart(NULL);
+
+	err = bt_le_scan_cb_register(&picky_cb);
+	__ASSERT_NO_MSG(err == 0);
+
+	report(1, -60);
+	report(2, -60);
+
+	stats = wait_received(2);
+	__ASSERT_NO_MSG(stats.uninterested == 1 && stats.delivered == 1);
+	__ASSERT_NO_MSG(atomic_get(&picky_reports) == 1);
+
+	printk("accept: ok\n");
+}
+
+/* The first listener accepts and is unregistered by the scan callback
+ * before delivery, the second one must not inherit its answer.
+ */
+static void test_accept_unregister(void)
+{
+	int err;
+
+	bt_le_scan_cb_unregister(&picky_cb);
+	atomic_clear(&picky_reports);
+
+	err = bt_le_scan_cb_register(&eager_cb);
+	__ASSERT_NO_MSG(err == 0);
+
+	err = bt_le_scan_cb_register(&picky_cb);
+	__ASSERT_NO_MSG(err == 0);
+
+	scan_restart(scan_found);
+
+	unregister_on_found = &eager_cb;
+	report(1, -60);
+	expect_found(-60);
+
+	__ASSERT_NO_MSG(atomic_get(&eager_reports) == 0);
+	__ASSERT_NO_MSG(atomic_get(&picky_reports) == 0);
+
+	/* The remaining listener still gets what it asks for */
+	report(2, -60);
+	expect_found(-60);
+
+	__ASSERT_NO_MSG(atomic_get(&picky_reports) == 1);
+
+	bt_le_scan_cb_unregister(&picky_cb);
+
+	printk("accept after unregister: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int err;
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	test_duplicates();
+	test_accept();
+	test_accept_unregister();
+
+	err = bt_le_scan_stop();
+	__ASSERT_NO_MSG(err == 0);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,211 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* A bulk and an interactive L2CAP CoC channel share one connection over the
+ * loopback controller. Prints the per class TX latency with the round robin
+ * and the QoS scheduler, and checks that QoS cuts the interactive one.
+ *
+ * Usage: test_tx_sched [sdus]
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/bluetooth/tx_sched.h>
+
+#include "hci_loopback.h"
+
+#define BULK_SDU_LEN 2000
+#define CTRL_SDU_LEN 8
+
+enum {
+	CHAN_CTRL,
+	CHAN_BULK,
+	CHAN_NUM,
+};
+
+static const struct bt_tx_qos chan_qos[CHAN_NUM] = {
+	[CHAN_CTRL] = { .prio = 0, .weight = 1, .latency_ms = 10 },
+	[CHAN_BULK] = { .prio = 1, .weight = 1 },
+};
+
+static const struct bt_tx_qos conn_qos = { .prio = CHAN_NUM };
+
+NET_BUF_POOL_FIXED_DEFINE(bulk_pool, 4, BT_L2CAP_SDU_BUF_SIZE(BULK_SDU_LEN),
+			  CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+NET_BUF_POOL_FIXED_DEFINE(ctrl_pool, 2, BT_L2CAP_SDU_BUF_SIZE(CTRL_SDU_LEN),
+			  CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+
+static struct bt_l2cap_le_chan le_chans[CHAN_NUM];
+static int chans_accepted;
+static K_SEM_DEFINE(chan_connected, 0, CHAN_NUM);
+
+static volatile bool bulk_run;
+static K_SEM_DEFINE(bulk_start, 0, 1);
+static K_SEM_DEFINE(bulk_done, 0, 1);
+static K_KERNEL_STACK_DEFINE(bulk_stack, 2048);
+static struct k_thread bulk_thread_data;
+
+static int chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	return 0;
+}
+
+static void chan_connected_cb(struct bt_l2cap_chan *chan)
+{
+	k_sem_give(&chan_connected);
+}
+
+static const struct bt_l2cap_chan_ops chan_ops = {
+	.connected = chan_connected_cb,
+	.recv = chan_recv,
+};
+
+static int chan_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+		       struct bt_l2cap_chan **chan)
+{
+	struct bt_l2cap_le_chan *le_chan;
+	int err;
+
+	__ASSERT_NO_MSG(chans_accepted < CHAN_NUM);
+	le_chan = &le_chans[chans_accepted];
+
+	le_chan->chan.ops = &chan_ops;
+	err = bt_tx_sched_chan_qos_set(&le_chan->chan, &chan_qos[chans_accepted]);
+	__ASSERT_NO_MSG(err == 0);
+
+	chans_accepted++;
+	*chan = &le_chan->chan;
+
+	return 0;
+}
+
+static struct bt_l2cap_server server = {
+	.psm = 0x0080,
+	.accept = chan_accept,
+};
+
+static void send_sdu(struct net_buf_pool *pool, int chan, size_t len)
+{
+	struct net_buf *buf = net_buf_alloc(pool, K_FOREVER);
+	int err;
+
+	net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+	net_buf_add(buf, len);
+
+	err = bt_l2cap_chan_send(&le_chans[chan].chan, buf);
+	__ASSERT_NO_MSG(err >= 0);
+}
+
+static void bulk_thread(void *p1, void *p2, void *p3)
+{
+	for (;;) {
+		k_sem_take(&bulk_start, K_FOREVER);
+
+		while (bulk_run) {
+			send_sdu(&bulk_pool, CHAN_BULK, BULK_SDU_LEN);
+		}
+
+		k_sem_give(&bulk_done);
+	}
+}
+
+/* Returns the average TX latency of the interactive class, in us */
+static uint32_t run(const char *name, const struct bt_tx_sched *sched, int sdus)
+{
+	uint32_t ctrl_avg_us = 0;
+
+	bt_tx_sched_set(sched);
+	bt_tx_sched_stats_reset();
+
+	bulk_run = true;
+	k_sem_give(&bulk_start);
+
+	for (int i = 0; i < sdus; i++) {
+		send_sdu(&ctrl_pool, CHAN_CTRL, CTRL_SDU_LEN);
+		k_sleep(K_MSEC(5));
+	}
+
+	bulk_run = false;
+	k_sem_take(&bulk_done, K_FOREVER);
+
+	for (uint8_t prio = 0; prio < CHAN_NUM; prio++) {
+		struct bt_tx_sched_stats stats;
+		int err = bt_tx_sched_stats_get(prio, &stats);
+		uint32_t avg_us;
+
+		__ASSERT_NO_MSG(err == 0);
+		avg_us = stats.count ? (uint32_t)(stats.total_us / stats.count) : 0U;
+		printk("%s: class %u served %u avg %u us max %u us\n", name, prio, stats.count,
+		       avg_us, stats.max_us);
+
+		if (prio == chan_qos[CHAN_CTRL].prio) {
+			__ASSERT_NO_MSG(stats.count > 0);
+			ctrl_avg_us = avg_us;
+		}
+	}
+
+	return ctrl_avg_us;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t rr_us, qos_us;
+	struct bt_conn *conn;
+	int sdus = 200;
+	int err;
+
+	if (argc > 1) {
+		sdus = atoi(argv[1]);
+	}
+
+	err = hci_loopback_enable();
+	__ASSERT_NO_MSG(err == 0);
+
+	err = bt_l2cap_server_register(&server);
+	__ASSERT_NO_MSG(err == 0);
+
+	conn = hci_loopback_connect(0);
+
+	/* Keep the connection's own waits out of the channel classes */
+	err = bt_tx_sched_conn_qos_set(conn, &conn_qos);
+	__ASSERT_NO_MSG(err == 0);
+
+	for (int i = 0; i < CHAN_NUM; i++) {
+		hci_loopback_coc_connect(0, server.psm, 0x40 + i, 2048);
+		err = k_sem_take(&chan_connected, K_SECONDS(5));
+		__ASSERT_NO_MSG(err == 0);
+	}
+
+	k_thread_create(&bulk_thread_data, bulk_stack, K_KERNEL_STACK_SIZEOF(bulk_stack),
+			bulk_thread, NULL, NULL, NULL, K_PRIO_COOP(1), 0, K_NO_WAIT);
+
+	rr_us = run("rr", &bt_tx_sched_rr, sdus);
+	qos_us = run("qos", &bt_tx_sched_qos, sdus);
+
+	/* The interactive channel must not wait behind bulk data with QoS */
+	__ASSERT_NO_MSG(qos_us < rr_us);
+
+	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	bt_conn_unref(conn);
+
+	printk("PASSED\n");
+
+	return 0;
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2024 Xiaomi Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *****************************************************************************/
+
+/* Contention benchmarks shared by the kernel tests: a worker runs on a
+ * number of threads released at once, and the round is timed until the
+ * last of them is done.
+ */
+
+#ifndef PORT_TESTS_KERNEL_BENCH_H_
+#define PORT_TESTS_KERNEL_BENCH_H_
+
+#include <kernel.h>
+
+#define BENCH_MAX_THREADS 8
+
+/* Runs the iterations of one thread, index is 0..nthreads - 1 */
+typedef void (*bench_worker_t)(int index, int iterations);
+
+static K_KERNEL_STACK_ARRAY_DEFINE(bench_stacks, BENCH_MAX_THREADS, 1024);
+static struct k_thread bench_threads[BENCH_MAX_THREADS];
+static struct k_sem bench_start[BENCH_MAX_THREADS];
+static K_SEM_DEFINE(bench_done, 0, BENCH_MAX_THREADS);
+static bench_worker_t bench_worker;
+static int bench_iterations;
+
+static void bench_thread(void *p1, void *p2, void *p3)
+{
+	int index = (int)(intptr_t)p1;
+
+	for (;;) {
+		k_sem_take(&bench_start[index], K_FOREVER);
+		bench_worker(index, bench_iterations);
+		k_sem_give(&bench_done);
+	}
+}
+
+/**
+ * @brief Run a worker on several threads at once
+ *
+ * The threads are created on first use and kept for later rounds.
+ *
+ * @param worker	Worker run by every thread
+ * @param nthreads	Number of threads, at most BENCH_MAX_THREADS
+ * @param iterations	Passed to the worker
+ *
+ * @return Time from releasing the threads to the last one finishing, in ms,
+ *         at least 1.
+ */
+static inline uint32_t bench_run(bench_worker_t worker, int nthreads, int iterations)
+{
+	static bool started;
+	uint32_t start;
+
+	__ASSERT_NO_MSG(nthreads <= BENCH_MAX_THREADS);
+
+	if (!started) {
+		for (int i = 0; i < BENCH_MAX_THREADS; i++) {
+			k_sem_init(&bench_start[i], 0, 1);
+			k_thread_create(&bench_threads[i], bench_stacks[i],
+					K_KERNEL_STACK_SIZEOF(bench_stacks[i]),
+					(k_thread_entry_t)bench_thread, (void *)(intptr_t)i,
+					NULL, NULL, K_PRIO_COOP(0), 0, K_NO_WAIT);
+			k_thread_name_set(&bench_threads[i], "bench");
+		}
+
+		started = true;
+	}
+
+	bench_worker = worker;
+	bench_iterations = iterations;
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < nthreads; i++) {
+		k_sem_give(&bench_start[i]);
+	}
+
+	for (int i = 0; i < nthreads; i++) {
+		k_sem_take(&bench_done, K_FOREVER);
+	}
+
+	return MAX(k_uptime_get_32() - start, 1);
+}
+
+#endif /* PORT_TESTS_KERNEL_BENCH_H_ */
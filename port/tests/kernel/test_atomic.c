@@ -0,0 +1,169 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2024 Xiaomi InC. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <kernel.h>
+#include <logging/log.h>
+
+#include "bench.h"
+
+/* Compare the configured atomic_* backend against the lock based
+ * pattern used by atomic_c.c, with 1..BENCH_MAX_THREADS threads
+ * updating the same word and the same flag bitmap.
+ */
+
+static struct k_spinlock bench_lock;
+static atomic_t bench_counter;
+static atomic_t bench_errors;
+static ATOMIC_DEFINE(bench_flags, BENCH_MAX_THREADS);
+
+static atomic_val_t locked_inc(atomic_t *target)
+{
+	k_spinlock_key_t key = k_spin_lock(&bench_lock);
+	atomic_val_t ret = *target;
+
+	*target = ret + 1;
+	k_spin_unlock(&bench_lock, key);
+
+	return ret;
+}
+
+static bool locked_test_and_set_bit(atomic_t *target, int bit)
+{
+	atomic_val_t mask = ATOMIC_MASK(bit);
+	k_spinlock_key_t key = k_spin_lock(&bench_lock);
+	atomic_val_t old = target[ATOMIC_ELEM(bit)];
+
+	target[ATOMIC_ELEM(bit)] = old | mask;
+	k_spin_unlock(&bench_lock, key);
+
+	return (old & mask) != 0;
+}
+
+static bool locked_test_and_clear_bit(atomic_t *target, int bit)
+{
+	atomic_val_t mask = ATOMIC_MASK(bit);
+	k_spinlock_key_t key = k_spin_lock(&bench_lock);
+	atomic_val_t old = target[ATOMIC_ELEM(bit)];
+
+	target[ATOMIC_ELEM(bit)] = old & ~mask;
+	k_spin_unlock(&bench_lock, key);
+
+	return (old & mask) != 0;
+}
+
+/* Each thread owns one bit, which must read clear before being set and
+ * set before being cleared.
+ */
+static void bench_atomic(int bit, int iterations)
+{
+	int errors = 0;
+	bool was_set;
+	bool was_cleared;
+
+	for (int i = 0; i < iterations; i++) {
+		atomic_inc(&bench_counter);
+		was_set = atomic_test_and_set_bit(bench_flags, bit);
+		was_cleared = atomic_test_and_clear_bit(bench_flags, bit);
+
+		if (was_set || !was_cleared) {
+			errors++;
+		}
+	}
+
+	atomic_add(&bench_errors, errors);
+}
+
+static void bench_locked(int bit, int iterations)
+{
+	int errors = 0;
+	bool was_set;
+	bool was_cleared;
+
+	for (int i = 0; i < iterations; i++) {
+		locked_inc(&bench_counter);
+		was_set = locked_test_and_set_bit(bench_flags, bit);
+		was_cleared = locked_test_and_clear_bit(bench_flags, bit);
+
+		if (was_set || !was_cleared) {
+			errors++;
+		}
+	}
+
+	atomic_add(&bench_errors, errors);
+}
+
+static void bench(int iterations)
+{
+	static const struct {
+		const char *name;
+		bench_worker_t worker;
+	} modes[] = {
+#ifdef CONFIG_ATOMIC_OPERATIONS_C
+		{ "atomic (atomic_c.c)", bench_atomic },
+#else
+		{ "atomic (builtin)", bench_atomic },
+#endif
+		{ "spinlock", bench_locked },
+	};
+
+	for (int mode = 0; mode < ARRAY_SIZE(modes); mode++) {
+		for (int nthreads = 1; nthreads <= BENCH_MAX_THREADS; nthreads *= 2) {
+			uint32_t elapsed;
+
+			atomic_clear(&bench_counter);
+			atomic_clear(&bench_errors);
+
+			elapsed = bench_run(modes[mode].worker, nthreads, iterations);
+
+			/* An increment, a set and a clear per iteration */
+			printk("%s, %d threads: %d ops in %lums, %lu ops/ms\n", modes[mode].name,
+			       nthreads, 3 * nthreads * iterations, elapsed,
+			       3 * nthreads * iterations / elapsed);
+
+			__ASSERT_NO_MSG(atomic_get(&bench_counter) == nthreads * iterations);
+			__ASSERT_NO_MSG(atomic_get(&bench_errors) == 0);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	bench(argc == 2 ? atoi(argv[1]) : 100000);
+
+	printk("PASSED\n");
+
+	return 0;
+}
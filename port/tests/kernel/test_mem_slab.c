@@ -33,9 +33,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <kernel.h>
 #include <logging/log.h>
 
+#include "bench.h"
+
 static K_KERNEL_STACK_DEFINE(stack1, 1024);
 static K_KERNEL_STACK_DEFINE(stack2, 1024);
 
@@ -65,7 +68,7 @@ static void thread1(void *p1, void *p2, void *p3)
 		k_sleep(K_MSEC(200));
 
 		printk("%s, #%d Test mem slab free\n", __FUNCTION__, i);
-		k_mem_slab_free(&mslab1, &mem);
+		k_mem_slab_free(&mslab1, mem);
 
 		k_yield();
 	}
@@ -98,8 +101,8 @@ static void thread2(void *p1, void *p2, void *p3)
 		__ASSERT_NO_MSG(err == 0);
 
 		printk("%s, #%d Test mem slab free\n", __FUNCTION__, i);
-		k_mem_slab_free(&mslab1, &mem);
-		k_mem_slab_free(&mslab1, &mem1);
+		k_mem_slab_free(&mslab1, mem);
+		k_mem_slab_free(&mslab1, mem1);
 
 		k_yield();
 	}
@@ -109,10 +112,62 @@ static void thread2(void *p1, void *p2, void *p3)
 	printk("PASSED\n");
 }
 
+K_MEM_SLAB_DEFINE(bench_slab, 32, 4 * BENCH_MAX_THREADS, 4);
+static atomic_t bench_errors;
+
+static void bench_slab_worker(int index, int iterations)
+{
+	void *mem[2];
+	int errors = 0;
+
+	for (int i = 0; i < iterations; i++) {
+		if (k_mem_slab_alloc(&bench_slab, &mem[0], K_NO_WAIT) != 0) {
+			errors++;
+			continue;
+		}
+
+		if (k_mem_slab_alloc(&bench_slab, &mem[1], K_NO_WAIT) != 0) {
+			errors++;
+		} else {
+			k_mem_slab_free(&bench_slab, mem[1]);
+		}
+
+		k_mem_slab_free(&bench_slab, mem[0]);
+	}
+
+	atomic_add(&bench_errors, errors);
+}
+
+/* Alloc/free throughput with 1..BENCH_MAX_THREADS threads hammering one slab */
+static void bench(int iterations)
+{
+	for (int nthreads = 1; nthreads <= BENCH_MAX_THREADS; nthreads *= 2) {
+		uint32_t elapsed;
+
+		atomic_clear(&bench_errors);
+
+		elapsed = bench_run(bench_slab_worker, nthreads, iterations);
+
+		printk("%d threads: %d alloc/free pairs in %lums, %lu pairs/ms\n", nthreads,
+		       2 * nthreads * iterations, elapsed,
+		       2 * nthreads * iterations / elapsed);
+
+		__ASSERT_NO_MSG(atomic_get(&bench_errors) == 0);
+		__ASSERT_NO_MSG(k_mem_slab_num_used_get(&bench_slab) == 0);
+	}
+
+	printk("PASSED\n");
+}
+
 int main(int argc, char *argv[])
 {
 	K_SEM_DEFINE(wait, 0, 1);
 
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		bench(argc == 3 ? atoi(argv[2]) : 100000);
+		return 0;
+	}
+
 	if (argc == 2) {
 		count = atoi(argv[1]);
 	}
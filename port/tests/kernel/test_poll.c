@@ -33,6 +33,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <kernel.h>
 #include <logging/log.h>
 
@@ -162,10 +163,178 @@ static void thread2(void *p1, void *p2, void *p3)
 	}
 }
 
+/* Ping-pong between main and one peer thread, one message each way per round */
+enum bench_mode {
+	BENCH_FIFO_GET,
+	BENCH_POLL_FIFO,
+	BENCH_POLL_SEM,
+};
+
+static const char *const bench_names[] = {
+	"k_fifo_get", "k_poll fifo", "k_poll sem",
+};
+
+static K_KERNEL_STACK_DEFINE(bench_stack, 1024);
+static struct k_thread bench_thread_data;
+
+static K_FIFO_DEFINE(bench_ping);
+static K_FIFO_DEFINE(bench_pong);
+static K_SEM_DEFINE(bench_ping_sem, 0, 1);
+static K_SEM_DEFINE(bench_pong_sem, 0, 1);
+
+static struct bench_msg {
+	void *fifo_reserved;
+} bench_msgs[2];
+
+static K_SEM_DEFINE(bench_start, 0, 1);
+static enum bench_mode bench_mode;
+static int bench_iterations;
+
+static void *bench_wait(struct k_fifo *fifo, struct k_sem *sem)
+{
+	struct k_poll_event event;
+	int err;
+
+	switch (bench_mode) {
+	case BENCH_FIFO_GET:
+		return k_fifo_get(fifo, K_FOREVER);
+	case BENCH_POLL_FIFO:
+		k_poll_event_init(&event, K_POLL_TYPE_FIFO_DATA_AVAILABLE,
+				  K_POLL_MODE_NOTIFY_ONLY, fifo);
+		err = k_poll(&event, 1, K_FOREVER);
+		__ASSERT_NO_MSG(err == 0);
+		return k_fifo_get(fifo, K_NO_WAIT);
+	case BENCH_POLL_SEM:
+		k_poll_event_init(&event, K_POLL_TYPE_SEM_AVAILABLE,
+				  K_POLL_MODE_NOTIFY_ONLY, sem);
+		err = k_poll(&event, 1, K_FOREVER);
+		__ASSERT_NO_MSG(err == 0);
+		err = k_sem_take(sem, K_NO_WAIT);
+		__ASSERT_NO_MSG(err == 0);
+		return &bench_msgs[0];
+	}
+
+	return NULL;
+}
+
+static void bench_post(struct k_fifo *fifo, struct k_sem *sem, void *msg)
+{
+	if (bench_mode == BENCH_POLL_SEM) {
+		k_sem_give(sem);
+	} else {
+		k_fifo_put(fifo, msg);
+	}
+}
+
+static void bench_thread(void *p1, void *p2, void *p3)
+{
+	void *msg;
+
+	for (;;) {
+		k_sem_take(&bench_start, K_FOREVER);
+
+		for (int i = 0; i < bench_iterations; i++) {
+			msg = bench_wait(&bench_ping, &bench_ping_sem);
+			__ASSERT_NO_MSG(msg != NULL);
+			bench_post(&bench_pong, &bench_pong_sem, msg);
+		}
+	}
+}
+
+static void bench(int iterations)
+{
+	bench_iterations = iterations;
+
+	k_thread_create(&bench_thread_data, bench_stack, K_KERNEL_STACK_SIZEOF(bench_stack),
+			(k_thread_entry_t)bench_thread, NULL, NULL, NULL, K_PRIO_COOP(0), 0,
+			K_NO_WAIT);
+	k_thread_name_set(&bench_thread_data, "bench");
+
+	for (int mode = 0; mode < ARRAY_SIZE(bench_names); mode++) {
+		uint32_t start, elapsed;
+		void *msg;
+
+		bench_mode = mode;
+		start = k_uptime_get_32();
+		k_sem_give(&bench_start);
+
+		for (int i = 0; i < iterations; i++) {
+			bench_post(&bench_ping, &bench_ping_sem, &bench_msgs[i & 1]);
+			msg = bench_wait(&bench_pong, &bench_pong_sem);
+			__ASSERT_NO_MSG(msg != NULL);
+		}
+
+		elapsed = MAX(k_uptime_get_32() - start, 1);
+
+		printk("%s: %d round trips in %lums, %lluns per round trip\n",
+		       bench_names[mode], iterations, elapsed,
+		       (unsigned long long)elapsed * NSEC_PER_MSEC / iterations);
+	}
+
+	printk("PASSED\n");
+}
+
+static K_KERNEL_STACK_DEFINE(reset_stack, 1024);
+static struct k_thread reset_thread_data;
+
+static K_SEM_DEFINE(reset_sem, 0, 1);
+static K_SEM_DEFINE(reset_done, 0, 1);
+static int reset_ret;
+
+static void reset_thread(void *p1, void *p2, void *p3)
+{
+	for (;;) {
+		reset_ret = k_sem_take(&reset_sem, K_FOREVER);
+		k_sem_give(&reset_done);
+	}
+}
+
+static void reset(void)
+{
+	k_thread_create(&reset_thread_data, reset_stack, K_KERNEL_STACK_SIZEOF(reset_stack),
+			(k_thread_entry_t)reset_thread, NULL, NULL, NULL, K_PRIO_COOP(0), 0,
+			K_NO_WAIT);
+	k_thread_name_set(&reset_thread_data, "reset");
+
+	/* A reset before the taker blocks must not eat a later give */
+	k_sem_reset(&reset_sem);
+	k_sleep(K_MSEC(10));
+	k_sem_give(&reset_sem);
+	k_sem_take(&reset_done, K_FOREVER);
+	__ASSERT_NO_MSG(reset_ret == 0);
+
+	/* A reset fails the taker it finds waiting */
+	k_sleep(K_MSEC(10));
+	k_sem_reset(&reset_sem);
+	k_sem_take(&reset_done, K_FOREVER);
+	__ASSERT_NO_MSG(reset_ret == -EAGAIN);
+
+	/* And leaves nothing behind for the next one */
+	k_sleep(K_MSEC(10));
+	__ASSERT_NO_MSG(k_sem_take(&reset_done, K_NO_WAIT) == -EBUSY);
+	k_sem_give(&reset_sem);
+	k_sem_take(&reset_done, K_FOREVER);
+	__ASSERT_NO_MSG(reset_ret == 0);
+
+	k_thread_abort(&reset_thread_data);
+
+	printk("PASSED\n");
+}
+
 int main(int argc, char *argv[])
 {
 	K_SEM_DEFINE(wait, 0, 1);
 
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		bench(argc == 3 ? atoi(argv[2]) : 100000);
+		return 0;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "reset")) {
+		reset();
+		return 0;
+	}
+
 	if (argc == 2) {
 		count = atoi(argv[1]);
 	}
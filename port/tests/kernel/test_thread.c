@@ -33,6 +33,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <kernel.h>
 #include <logging/log.h>
 
@@ -118,10 +119,80 @@ static void thread3(void *p1, void *p2, void *p3)
 	k_sleep(K_FOREVER);
 }
 
+#define BENCH_THREADS 32
+
+static K_KERNEL_STACK_ARRAY_DEFINE(bench_stacks, BENCH_THREADS, 1024);
+static struct k_thread bench_threads[BENCH_THREADS];
+static K_SEM_DEFINE(bench_go, 0, BENCH_THREADS);
+static K_SEM_DEFINE(bench_done, 0, BENCH_THREADS);
+static int bench_iterations;
+
+/* k_current_get() is declared const, call the port lookup so it is not hoisted */
+extern k_tid_t k_thread_current(void);
+
+static void bench_thread(void *p1, void *p2, void *p3)
+{
+	struct k_thread *self = p1;
+	int misses = 0;
+
+	k_sem_take(&bench_go, K_FOREVER);
+
+	for (int i = 0; i < bench_iterations; i++) {
+		if (k_thread_current() != self) {
+			misses++;
+		}
+	}
+
+	__ASSERT_NO_MSG(misses == 0);
+
+	k_sem_give(&bench_done);
+}
+
+/* Current thread lookup cost with BENCH_THREADS threads registered, all looking up at once */
+static void bench(int iterations)
+{
+	uint32_t start, elapsed;
+
+	bench_iterations = iterations;
+
+	for (int i = 0; i < BENCH_THREADS; i++) {
+		k_thread_create(&bench_threads[i], bench_stacks[i],
+				K_KERNEL_STACK_SIZEOF(bench_stacks[i]),
+				(k_thread_entry_t)bench_thread, &bench_threads[i], NULL, NULL,
+				K_PRIO_COOP(0), 0, K_NO_WAIT);
+		k_thread_name_set(&bench_threads[i], "bench");
+	}
+
+	start = k_uptime_get_32();
+
+	for (int i = 0; i < BENCH_THREADS; i++) {
+		k_sem_give(&bench_go);
+	}
+
+	for (int i = 0; i < BENCH_THREADS; i++) {
+		k_sem_take(&bench_done, K_FOREVER);
+	}
+
+	elapsed = MAX(k_uptime_get_32() - start, 1);
+
+	printk("%d threads: %d lookups in %lums, %lu lookups/ms\n", BENCH_THREADS,
+	       BENCH_THREADS * iterations, elapsed, BENCH_THREADS * iterations / elapsed);
+
+	/* Not a k_thread_create() thread */
+	__ASSERT_NO_MSG(k_thread_current() == NULL);
+
+	printk("PASSED\n");
+}
+
 int main(int argc, char *argv[])
 {
 	K_SEM_DEFINE(wait, 0, 1);
 
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		bench(argc == 3 ? atoi(argv[2]) : 100000);
+		return 0;
+	}
+
 	if (argc == 2) {
 		count = atoi(argv[1]);
 	}
@@ -36,6 +36,23 @@
 #include <kernel.h>
 #include <logging/log.h>
 
+/* Timed k_sem_take() must not return before the requested number of ticks */
+static void test_sem_timeout(k_timeout_t timeout, k_ticks_t expect)
+{
+	K_SEM_DEFINE(sem, 0, 1);
+	int64_t start, elapsed;
+	int err;
+
+	start = k_uptime_ticks();
+	err = k_sem_take(&sem, timeout);
+	elapsed = k_uptime_ticks() - start;
+
+	printk("sem timeout %lld ticks, waited %lld\n", expect, elapsed);
+
+	__ASSERT_NO_MSG(err == -EAGAIN);
+	__ASSERT_NO_MSG(elapsed >= expect);
+}
+
 int main(int argc, char *argv[])
 {
 	int count = 1;
@@ -64,6 +81,12 @@ int main(int argc, char *argv[])
 		__ASSERT_NO_MSG(end_timestamps >= 100);
 	}
 
+	test_sem_timeout(K_TICKS(1), 1);
+	test_sem_timeout(K_MSEC(15), k_ms_to_ticks_ceil32(15));
+#ifdef CONFIG_TIMEOUT_64BIT
+	test_sem_timeout(K_TIMEOUT_ABS_TICKS(k_uptime_ticks() + 5), 4);
+#endif
+
 	printk("PASSED\n");
 
 	return 0;
@@ -33,8 +33,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <kernel.h>
 #include <logging/log.h>
+#include <timeout_q.h>
 
 static K_SEM_DEFINE(sem, 0 ,1);
 
@@ -47,11 +49,164 @@ static void k_work_handler_1(struct k_work *work)
 
 static K_WORK_DELAYABLE_DEFINE(work1, k_work_handler_1);
 
+#define JITTER_WORKS 64
+
+static struct jitter_work {
+	struct k_work_delayable dwork;
+	int64_t expected;
+	int64_t late;
+} jitter_works[JITTER_WORKS];
+
+static K_SEM_DEFINE(jitter_done, 0, JITTER_WORKS);
+
+static void jitter_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct jitter_work *jw = CONTAINER_OF(dwork, struct jitter_work, dwork);
+
+	jw->late = k_uptime_ticks() - jw->expected;
+
+	k_sem_give(&jitter_done);
+}
+
+/* Schedule JITTER_WORKS delayable items at once and report how late each
+ * one ran relative to its deadline, in ticks.
+ */
+static void jitter(int rounds)
+{
+	int64_t total = 0, worst = 0;
+
+	for (int i = 0; i < JITTER_WORKS; i++) {
+		k_work_init_delayable(&jitter_works[i].dwork, jitter_handler);
+	}
+
+	for (int round = 0; round < rounds; round++) {
+		for (int i = 0; i < JITTER_WORKS; i++) {
+			k_ticks_t delay = k_ms_to_ticks_ceil32(1 + (i * 37 + round * 11) % 500);
+
+			jitter_works[i].expected = k_uptime_ticks() + delay;
+			k_work_schedule(&jitter_works[i].dwork, K_TICKS(delay));
+		}
+
+		for (int i = 0; i < JITTER_WORKS; i++) {
+			k_sem_take(&jitter_done, K_FOREVER);
+		}
+
+		for (int i = 0; i < JITTER_WORKS; i++) {
+			__ASSERT_NO_MSG(jitter_works[i].late >= 0);
+			total += jitter_works[i].late;
+			worst = MAX(worst, jitter_works[i].late);
+		}
+	}
+
+	printk("%d expiries: avg %lld.%02lld ticks late, worst %lld ticks\n",
+	       rounds * JITTER_WORKS, total / (rounds * JITTER_WORKS),
+	       total * 100 / (rounds * JITTER_WORKS) % 100, worst);
+	printk("PASSED\n");
+}
+
+#define WHEEL_TIMEOUTS 2000
+
+/* Random delays reach the third wheel level, so cascades are covered */
+#define WHEEL_DELAY_BITS 14
+
+static struct wheel_timeout {
+	struct _timeout to;
+	int64_t expected;
+} wheel_timeouts[WHEEL_TIMEOUTS];
+
+static atomic_t wheel_pending;
+static atomic_t wheel_fired;
+static atomic_t wheel_bad;
+static int64_t wheel_worst;
+
+static void wheel_fire(struct _timeout *to)
+{
+	struct wheel_timeout *wt = CONTAINER_OF(to, struct wheel_timeout, to);
+	int64_t late = k_uptime_ticks() - wt->expected;
+
+	if (late < 0 || late > 1) {
+		atomic_inc(&wheel_bad);
+	}
+
+	wheel_worst = MAX(wheel_worst, late);
+	atomic_inc(&wheel_fired);
+	atomic_dec(&wheel_pending);
+}
+
+/* Drive the timer wheel directly with random add, re-add, abort and
+ * advance steps over WHEEL_TIMEOUTS timeouts. Every timeout that is not
+ * aborted must fire, and none may fire early or more than a tick late.
+ */
+static void wheel(int steps)
+{
+	int adds = 0, aborts = 0;
+	int64_t deadline;
+
+	srand(k_uptime_get_32());
+
+	for (int i = 0; i < WHEEL_TIMEOUTS; i++) {
+		z_init_timeout(&wheel_timeouts[i].to);
+	}
+
+	for (int step = 0; step < steps; step++) {
+		struct wheel_timeout *wt = &wheel_timeouts[rand() % WHEEL_TIMEOUTS];
+		int op = rand() % 64;
+		k_ticks_t delay;
+
+		if (op == 0) {
+			/* Let time pass so that timeouts fire and levels cascade */
+			k_sleep(K_TICKS(rand() % 4));
+			continue;
+		}
+
+		/* Adding a pending timeout moves it, so abort it either way */
+		if (z_abort_timeout(&wt->to) == 0) {
+			atomic_dec(&wheel_pending);
+			aborts++;
+		}
+
+		if (op <= 20) {
+			continue;
+		}
+
+		delay = rand() % (1 << (rand() % WHEEL_DELAY_BITS));
+		wt->expected = k_uptime_ticks() + delay;
+		atomic_inc(&wheel_pending);
+		adds++;
+		z_add_timeout(&wt->to, wheel_fire, K_TICKS(delay));
+	}
+
+	deadline = k_uptime_ticks() + (1 << WHEEL_DELAY_BITS) + 2;
+	while (atomic_get(&wheel_pending) > 0 && k_uptime_ticks() < deadline) {
+		k_sleep(K_MSEC(10));
+	}
+
+	printk("%d steps: %d added, %d aborted, %ld fired, worst %lld ticks late\n",
+	       steps, adds, aborts, (long)atomic_get(&wheel_fired), wheel_worst);
+
+	__ASSERT_NO_MSG(atomic_get(&wheel_pending) == 0);
+	__ASSERT_NO_MSG(atomic_get(&wheel_fired) == adds - aborts);
+	__ASSERT_NO_MSG(atomic_get(&wheel_bad) == 0);
+
+	printk("PASSED\n");
+}
+
 int main(int argc, char *argv[])
 {
 	int count = 1;
 	int err;
 
+	if (argc >= 2 && !strcmp(argv[1], "jitter")) {
+		jitter(argc == 3 ? atoi(argv[2]) : 10);
+		return 0;
+	}
+
+	if (argc >= 2 && !strcmp(argv[1], "wheel")) {
+		wheel(argc == 3 ? atoi(argv[2]) : 100000);
+		return 0;
+	}
+
 	if (argc == 2) {
 		count = atoi(argv[1]);
 	}
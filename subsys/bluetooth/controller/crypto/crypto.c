@@ -20,6 +20,11 @@ int bt_rand(void *buf, size_t len)
 	return lll_csrand_get(buf, len);
 }
 
+int bt_rand_pr(void *buf, size_t len)
+{
+	return lll_csrand_get(buf, len);
+}
+
 int bt_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16],
 		  uint8_t enc_data[16])
 {
@@ -17,6 +17,9 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(bt_aes_ccm);
 
+/* Counter blocks encrypted per bt_aes_encrypt_many() call */
+#define CCM_CTR_BATCH 4
+
 static inline void xor16(uint8_t *dst, const uint8_t *a, const uint8_t *b)
 {
 	dst[0] = a[0] ^ b[0];
@@ -38,7 +41,7 @@ static inline void xor16(uint8_t *dst, const uint8_t *a, const uint8_t *b)
 }
 
 /* b field is assumed to have the nonce already present in bytes 1-13 */
-static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t aad_len,
+static int ccm_calculate_X0(struct bt_aes_ctx *aes, const uint8_t *aad, uint8_t aad_len,
 			    size_t mic_size, uint16_t msg_len, uint8_t b[16],
 			    uint8_t X0[16])
 {
@@ -49,7 +52,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 
 	sys_put_be16(msg_len, b + 14);
 
-	err = bt_encrypt_be(key, b, X0);
+	err = bt_aes_encrypt(aes, b, X0);
 	if (err) {
 		return err;
 	}
@@ -73,7 +76,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 			aad_len -= 16;
 			i = 0;
 
-			err = bt_encrypt_be(key, b, X0);
+			err = bt_aes_encrypt(aes, b, X0);
 			if (err) {
 				return err;
 			}
@@ -87,7 +90,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 			b[i] = X0[i];
 		}
 
-		err = bt_encrypt_be(key, b, X0);
+		err = bt_aes_encrypt(aes, b, X0);
 		if (err) {
 			return err;
 		}
@@ -96,7 +99,7 @@ static int ccm_calculate_X0(const uint8_t key[16], const uint8_t *aad, uint8_t a
 	return 0;
 }
 
-static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
+static int ccm_auth(struct bt_aes_ctx *aes, uint8_t nonce[13],
 		    const uint8_t *cleartext_msg, uint16_t msg_len, const uint8_t *aad,
 		    size_t aad_len, uint8_t *mic, size_t mic_size)
 {
@@ -116,12 +119,12 @@ static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
 	/* S[0] = e(AppKey, 0x01 || nonce || 0x0000) */
 	sys_put_be16(0x0000, &b[14]);
 
-	err = bt_encrypt_be(key, b, s0);
+	err = bt_aes_encrypt(aes, b, s0);
 	if (err) {
 		return err;
 	}
 
-	ccm_calculate_X0(key, aad, aad_len, mic_size, msg_len, b, Xn);
+	ccm_calculate_X0(aes, aad, aad_len, mic_size, msg_len, b, Xn);
 
 	for (j = 0; j < blk_cnt; j++) {
 		/* X_1 = e(AppKey, X_0 ^ Payload[0-15]) */
@@ -135,7 +138,7 @@ static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
 			xor16(b, Xn, &cleartext_msg[j * 16]);
 		}
 
-		err = bt_encrypt_be(key, b, Xn);
+		err = bt_aes_encrypt(aes, b, Xn);
 		if (err) {
 			return err;
 		}
@@ -149,42 +152,44 @@ static int ccm_auth(const uint8_t key[16], uint8_t nonce[13],
 	return 0;
 }
 
-static int ccm_crypt(const uint8_t key[16], const uint8_t nonce[13],
+static int ccm_crypt(struct bt_aes_ctx *aes, const uint8_t nonce[13],
 		     const uint8_t *in_msg, uint8_t *out_msg, uint16_t msg_len)
 {
-	uint8_t a_i[16], s_i[16];
-	uint16_t last_blk, blk_cnt;
-	size_t i, j;
+	uint8_t a_i[CCM_CTR_BATCH * 16], s_i[CCM_CTR_BATCH * 16];
+	size_t i, j, n;
 	int err;
 
-	last_blk = msg_len % 16;
-	blk_cnt = (msg_len + 15) / 16;
-	if (!last_blk) {
-		last_blk = 16U;
+	/* A_i = 0x01 || nonce || i, encrypted a batch at a time */
+	for (i = 0; i < CCM_CTR_BATCH; i++) {
+		a_i[i * 16] = 0x01;
+		memcpy(&a_i[i * 16 + 1], nonce, 13);
 	}
 
-	a_i[0] = 0x01;
-	memcpy(&a_i[1], nonce, 13);
+	for (j = 0; j < msg_len; j += n) {
+		size_t blocks;
 
-	for (j = 0; j < blk_cnt; j++) {
-		/* S_1 = e(AppKey, 0x01 || nonce || 0x0001) */
-		sys_put_be16(j + 1, &a_i[14]);
+		n = MIN(msg_len - j, sizeof(s_i));
+		blocks = DIV_ROUND_UP(n, 16);
 
-		err = bt_encrypt_be(key, a_i, s_i);
+		for (i = 0; i < blocks; i++) {
+			sys_put_be16(j / 16 + i + 1, &a_i[i * 16 + 14]);
+		}
+
+		err = bt_aes_encrypt_many(aes, a_i, s_i, blocks);
 		if (err) {
 			return err;
 		}
 
-		/* Encrypted = Payload[0-15] ^ C_1 */
-		if (j < blk_cnt - 1) {
-			xor16(&out_msg[j * 16], s_i, &in_msg[j * 16]);
-		} else {
-			for (i = 0; i < last_blk; i++) {
-				out_msg[(j * 16) + i] =
-					in_msg[(j * 16) + i] ^ s_i[i];
-			}
+		/* Encrypted = Payload ^ S_1 || S_2 || ... */
+		for (i = 0; i + 16 <= n; i += 16) {
+			xor16(&out_msg[j + i], &s_i[i], &in_msg[j + i]);
+		}
+
+		for (; i < n; i++) {
+			out_msg[j + i] = in_msg[j + i] ^ s_i[i];
 		}
 	}
+
 	return 0;
 }
 
@@ -192,15 +197,24 @@ int bt_ccm_decrypt(const uint8_t key[16], uint8_t nonce[13],
 		   const uint8_t *enc_data, size_t len, const uint8_t *aad,
 		   size_t aad_len, uint8_t *plaintext, size_t mic_size)
 {
+	struct bt_aes_ctx aes;
 	uint8_t mic[16];
+	int err;
 
 	if (aad_len >= 0xff00 || mic_size > sizeof(mic) || len > UINT16_MAX) {
 		return -EINVAL;
 	}
 
-	ccm_crypt(key, nonce, enc_data, plaintext, len);
+	err = bt_aes_ctx_init(&aes, key, false);
+	if (err) {
+		return err;
+	}
+
+	ccm_crypt(&aes, nonce, enc_data, plaintext, len);
+
+	ccm_auth(&aes, nonce, plaintext, len, aad, aad_len, mic, mic_size);
 
-	ccm_auth(key, nonce, plaintext, len, aad, aad_len, mic, mic_size);
+	bt_aes_ctx_clear(&aes);
 
 	if (memcmp(mic, enc_data + len, mic_size)) {
 		return -EBADMSG;
@@ -214,6 +228,8 @@ int bt_ccm_encrypt(const uint8_t key[16], uint8_t nonce[13],
 		   size_t aad_len, uint8_t *enc_data, size_t mic_size)
 {
 	uint8_t *mic = enc_data + len;
+	struct bt_aes_ctx aes;
+	int err;
 
 	LOG_DBG("key %s", bt_hex(key, 16));
 	LOG_DBG("nonce %s", bt_hex(nonce, 13));
@@ -225,9 +241,16 @@ int bt_ccm_encrypt(const uint8_t key[16], uint8_t nonce[13],
 		return -EINVAL;
 	}
 
-	ccm_auth(key, nonce, plaintext, len, aad, aad_len, mic, mic_size);
+	err = bt_aes_ctx_init(&aes, key, false);
+	if (err) {
+		return err;
+	}
+
+	ccm_auth(&aes, nonce, plaintext, len, aad, aad_len, mic, mic_size);
+
+	ccm_crypt(&aes, nonce, plaintext, enc_data, len);
 
-	ccm_crypt(key, nonce, plaintext, enc_data, len);
+	bt_aes_ctx_clear(&aes);
 
 	return 0;
 }
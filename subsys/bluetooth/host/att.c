@@ -93,6 +93,10 @@ struct bt_att_tx_meta_data {
 	bt_gatt_complete_func_t func;
 	void *user_data;
 	enum bt_att_chan_opt chan_opt;
+#if defined(CONFIG_BT_EATT)
+	/* Order of bt_att_send() calls, see process_shared_queues() */
+	uint32_t seq;
+#endif /* CONFIG_BT_EATT */
 };
 
 struct bt_att_tx_meta {
@@ -109,6 +113,8 @@ struct bt_att_chan {
 	struct k_fifo		tx_queue;
 	struct k_work_delayable	timeout_work;
 	sys_snode_t		node;
+	/* Dispatch order, breaks ties between equally loaded bearers */
+	uint32_t		last_dispatch;
 };
 
 static bool bt_att_is_enhanced(struct bt_att_chan *chan)
@@ -142,11 +148,18 @@ struct bt_att {
 	/* Shared request queue */
 	sys_slist_t		reqs;
 	struct k_fifo		tx_queue;
+#if defined(CONFIG_BT_EATT)
+	/* PDUs restricted to one kind of bearer, see att_tx_queue() */
+	struct k_fifo		tx_queue_uatt;
+	struct k_fifo		tx_queue_eatt;
+	atomic_t		tx_seq;
+#endif /* CONFIG_BT_EATT */
 #if CONFIG_BT_ATT_PREPARE_COUNT > 0
 	sys_slist_t		prep_queue;
 #endif
 	/* Contains bt_att_chan instance(s) */
 	sys_slist_t		chans;
+	uint32_t		dispatches;
 #if defined(CONFIG_BT_EATT)
 	struct {
 		struct k_work_delayable connection_work;
@@ -371,6 +384,21 @@ static int chan_send(struct bt_att_chan *chan, struct net_buf *buf)
 			return -EAGAIN;
 		}
 
+		/* Segmentation on dynamic channels needs the PDU in one
+		 * buffer, pull in a value chained by GATT (the PDU was
+		 * allocated for the ATT MTU, so it fits).
+		 */
+		if (buf->frags) {
+			if (net_buf_frags_len(buf->frags) > net_buf_tailroom(buf)) {
+				return -EMSGSIZE;
+			}
+
+			while (buf->frags) {
+				net_buf_add_mem(buf, buf->frags->data, buf->frags->len);
+				net_buf_frag_del(buf, buf->frags);
+			}
+		}
+
 		atomic_set_bit(chan->flags, ATT_PENDING_SENT);
 		data->att_chan = chan;
 
@@ -438,38 +466,20 @@ static bool att_chan_matches_chan_opt(struct bt_att_chan *chan, enum bt_att_chan
 	}
 }
 
-static struct net_buf *get_first_buf_matching_chan(struct k_fifo *fifo, struct bt_att_chan *chan)
+/* Shared queue for PDUs sent with `chan_opt` */
+static struct k_fifo *att_tx_queue(struct bt_att *att, enum bt_att_chan_opt chan_opt)
 {
-	if (IS_ENABLED(CONFIG_BT_EATT)) {
-		struct k_fifo skipped;
-		struct net_buf *buf;
-		struct net_buf *ret = NULL;
-		struct bt_att_tx_meta_data *meta;
-
-		k_fifo_init(&skipped);
-
-		while ((buf = k_fifo_get(fifo, K_NO_WAIT))) {
-			meta = bt_att_get_tx_meta_data(buf);
-			if (!ret &&
-			    att_chan_matches_chan_opt(chan, meta->chan_opt)) {
-				ret = buf;
-			} else {
-				k_fifo_put(&skipped, buf);
-			}
-		}
-
-		__ASSERT_NO_MSG(k_fifo_is_empty(fifo));
-
-		while ((buf = k_fifo_get(&skipped, K_NO_WAIT))) {
-			k_fifo_put(fifo, buf);
-		}
-
-		__ASSERT_NO_MSG(k_fifo_is_empty(&skipped));
+#if defined(CONFIG_BT_EATT)
+	if (chan_opt & BT_ATT_CHAN_OPT_ENHANCED_ONLY) {
+		return &att->tx_queue_eatt;
+	}
 
-		return ret;
-	} else {
-		return k_fifo_get(fifo, K_NO_WAIT);
+	if (chan_opt & BT_ATT_CHAN_OPT_UNENHANCED_ONLY) {
+		return &att->tx_queue_uatt;
 	}
+#endif /* CONFIG_BT_EATT */
+
+	return &att->tx_queue;
 }
 
 static struct bt_att_req *get_first_req_matching_chan(sys_slist_t *reqs, struct bt_att_chan *chan)
@@ -510,7 +520,7 @@ static int process_queue(struct bt_att_chan *chan, struct k_fifo *queue)
 	struct net_buf *buf;
 	int err;
 
-	buf = get_first_buf_matching_chan(queue, chan);
+	buf = k_fifo_get(queue, K_NO_WAIT);
 	if (buf) {
 		err = bt_att_chan_send(chan, buf);
 		if (err) {
@@ -525,6 +535,39 @@ static int process_queue(struct bt_att_chan *chan, struct k_fifo *queue)
 	return -ENOENT;
 }
 
+#if defined(CONFIG_BT_EATT)
+/* `a` was passed to bt_att_send() before `b` */
+static bool att_tx_older(struct net_buf *a, struct net_buf *b)
+{
+	return (int32_t)(bt_att_get_tx_meta_data(a)->seq - bt_att_get_tx_meta_data(b)->seq) < 0;
+}
+#endif /* CONFIG_BT_EATT */
+
+/* Send the oldest PDU of the shared queues `chan` may carry: the heads of
+ * the queue of its kind of bearer and of the unrestricted one.
+ */
+static int process_shared_queues(struct bt_att_chan *chan)
+{
+	struct bt_att *att = chan->att;
+	struct k_fifo *queue = &att->tx_queue;
+
+#if defined(CONFIG_BT_EATT)
+	struct k_fifo *restricted;
+	struct net_buf *head;
+	struct net_buf *other;
+
+	restricted = bt_att_is_enhanced(chan) ? &att->tx_queue_eatt : &att->tx_queue_uatt;
+	head = k_fifo_peek_head(restricted);
+	other = k_fifo_peek_head(&att->tx_queue);
+
+	if (head && (!other || att_tx_older(head, other))) {
+		queue = restricted;
+	}
+#endif /* CONFIG_BT_EATT */
+
+	return process_queue(chan, queue);
+}
+
 /* Send requests without taking tx_sem */
 static int chan_req_send(struct bt_att_chan *chan, struct bt_att_req *req)
 {
@@ -598,7 +641,13 @@ static void bt_att_sent(struct bt_l2cap_chan *ch)
 	}
 
 	/* Process global queue */
-	(void)process_queue(chan, &att->tx_queue);
+	err = process_shared_queues(chan);
+	if (!err) {
+		return;
+	}
+
+	/* Nothing left to send on this bearer */
+	bt_gatt_notify_mult_sent(att->conn);
 }
 
 static void chan_rebegin_att_timeout(struct bt_att_tx_meta_data *user_data)
@@ -687,12 +736,12 @@ static void att_on_sent_cb(struct bt_att_tx_meta_data *meta)
 	}
 }
 
-static struct net_buf *bt_att_chan_create_pdu(struct bt_att_chan *chan, uint8_t op, size_t len)
+static struct net_buf *att_chan_create_pdu(struct bt_att_chan *chan, uint8_t op, size_t len,
+					   k_timeout_t timeout)
 {
 	struct bt_att_hdr *hdr;
 	struct net_buf *buf;
 	struct bt_att_tx_meta_data *data;
-	k_timeout_t timeout;
 
 	if (len + sizeof(op) > bt_att_mtu(chan)) {
 		LOG_WRN("ATT MTU exceeded, max %u, wanted %zu", bt_att_mtu(chan),
@@ -700,16 +749,6 @@ static struct net_buf *bt_att_chan_create_pdu(struct bt_att_chan *chan, uint8_t
 		return NULL;
 	}
 
-	switch (att_op_get_type(op)) {
-	case ATT_RESPONSE:
-	case ATT_CONFIRMATION:
-		/* Use a timeout only when responding/confirming */
-		timeout = BT_ATT_TIMEOUT;
-		break;
-	default:
-		timeout = K_FOREVER;
-	}
-
 	/* This will reserve headspace for lower layers */
 	buf = bt_l2cap_create_pdu_timeout(&att_pool, 0, timeout);
 	if (!buf) {
@@ -734,6 +773,23 @@ static struct net_buf *bt_att_chan_create_pdu(struct bt_att_chan *chan, uint8_t
 	return buf;
 }
 
+static struct net_buf *bt_att_chan_create_pdu(struct bt_att_chan *chan, uint8_t op, size_t len)
+{
+	k_timeout_t timeout;
+
+	switch (att_op_get_type(op)) {
+	case ATT_RESPONSE:
+	case ATT_CONFIRMATION:
+		/* Use a timeout only when responding/confirming */
+		timeout = BT_ATT_TIMEOUT;
+		break;
+	default:
+		timeout = K_FOREVER;
+	}
+
+	return att_chan_create_pdu(chan, op, len, timeout);
+}
+
 static int bt_att_chan_send(struct bt_att_chan *chan, struct net_buf *buf)
 {
 	LOG_DBG("chan %p flags %lu code 0x%02x", chan, atomic_get(chan->flags),
@@ -747,28 +803,93 @@ static int bt_att_chan_send(struct bt_att_chan *chan, struct net_buf *buf)
 	return chan_send(chan, buf);
 }
 
-static void att_send_process(struct bt_att *att)
+/* Load of a bearer, lower is better: an enhanced bearer with TX credits,
+ * the more the better, then the unenhanced bearer with nothing queued on
+ * L2CAP, the unenhanced bearer with a backlog and last an enhanced bearer
+ * waiting for credits from the peer.
+ */
+static int att_chan_load(struct bt_att_chan *chan)
 {
-	struct bt_att_chan *chan, *tmp, *prev = NULL;
-	int err = 0;
+	if (bt_att_is_enhanced(chan)) {
+		atomic_val_t credits = atomic_get(&chan->chan.tx.credits);
 
-	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&att->chans, chan, tmp, node) {
-		if (err == -ENOENT && prev &&
-		    (bt_att_is_enhanced(chan) == bt_att_is_enhanced(prev))) {
-			/* If there was nothing to send for the previous channel and the current
-			 * channel has the same "enhancedness", there will be nothing to send for
-			 * this channel either.
-			 */
+		return credits ? -(int)MIN(credits, INT16_MAX) : 2;
+	}
+
+	return k_fifo_is_empty(&chan->chan.tx_queue) ? 0 : 1;
+}
+
+static bool att_chan_less_loaded(struct bt_att_chan *chan, int load,
+				 struct bt_att_chan *other, int other_load)
+{
+	if (load != other_load) {
+		return load < other_load;
+	}
+
+	/* Least recently used first, wraps around safely */
+	return (int32_t)(chan->last_dispatch - other->last_dispatch) < 0;
+}
+
+/* Bearers of `att` that can take a PDU now, least loaded first. With `req`
+ * only those without an outstanding request.
+ */
+static size_t att_chans_by_load(struct bt_att *att, bool req,
+				struct bt_att_chan *chans[ATT_CHAN_MAX])
+{
+	struct bt_att_chan *chan;
+	int load[ATT_CHAN_MAX];
+	size_t count = 0;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&att->chans, chan, node) {
+		size_t i;
+		int l;
+
+		if (count == ATT_CHAN_MAX) {
+			break;
+		}
+
+		if (!atomic_test_bit(chan->flags, ATT_CONNECTED) || (req && chan->req)) {
 			continue;
 		}
 
-		err = process_queue(chan, &att->tx_queue);
-		if (!err) {
-			/* Success */
-			return;
+		/* Still sending an SDU, chan_send() would refuse */
+		if (bt_att_is_enhanced(chan) && atomic_test_bit(chan->flags, ATT_PENDING_SENT)) {
+			continue;
+		}
+
+		l = att_chan_load(chan);
+
+		for (i = count; i > 0 && att_chan_less_loaded(chan, l, chans[i - 1], load[i - 1]);
+		     i--) {
+			chans[i] = chans[i - 1];
+			load[i] = load[i - 1];
 		}
 
-		prev = chan;
+		chans[i] = chan;
+		load[i] = l;
+		count++;
+	}
+
+	return count;
+}
+
+static void att_chan_dispatched(struct bt_att *att, struct bt_att_chan *chan)
+{
+	chan->last_dispatch = ++att->dispatches;
+}
+
+static void att_send_process(struct bt_att *att)
+{
+	struct bt_att_chan *chans[ATT_CHAN_MAX];
+	size_t count;
+
+	count = att_chans_by_load(att, false, chans);
+
+	for (size_t i = 0; i < count; i++) {
+		if (!process_shared_queues(chans[i])) {
+			att_chan_dispatched(att, chans[i]);
+			return;
+		}
 	}
 }
 
@@ -884,33 +1005,24 @@ static int bt_att_chan_req_send(struct bt_att_chan *chan,
 
 static void att_req_send_process(struct bt_att *att)
 {
-	struct bt_att_req *req = NULL;
-	struct bt_att_chan *chan, *tmp, *prev = NULL;
-
-	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&att->chans, chan, tmp, node) {
-		/* If there is an ongoing transaction, do not use the channel */
-		if (chan->req) {
-			continue;
-		}
+	struct bt_att_chan *chans[ATT_CHAN_MAX];
+	size_t count;
 
-		if (!req && prev && (bt_att_is_enhanced(chan) == bt_att_is_enhanced(prev))) {
-			/* If there was nothing to send for the previous channel and the current
-			 * channel has the same "enhancedness", there will be nothing to send for
-			 * this channel either.
-			 */
-			continue;
-		}
+	count = att_chans_by_load(att, true, chans);
 
-		prev = chan;
+	/* Requests are independent, one can be outstanding on every bearer */
+	for (size_t i = 0; i < count && !sys_slist_is_empty(&att->reqs); i++) {
+		struct bt_att_req *req;
 
 		/* Pull next request from the list */
-		req = get_first_req_matching_chan(&att->reqs, chan);
+		req = get_first_req_matching_chan(&att->reqs, chans[i]);
 		if (!req) {
 			continue;
 		}
 
-		if (bt_att_chan_req_send(chan, req) >= 0) {
-			return;
+		if (bt_att_chan_req_send(chans[i], req) >= 0) {
+			att_chan_dispatched(att, chans[i]);
+			continue;
 		}
 
 		/* Prepend back to the list as it could not be sent */
@@ -1133,6 +1245,9 @@ struct find_type_data {
 	const void *value;
 	uint8_t value_len;
 	uint8_t err;
+	/* Only primary services are visited, group ends come from GATT */
+	bool indexed;
+	uint16_t end_handle;
 };
 
 static uint8_t find_type_cb(const struct bt_gatt_attr *attr, uint16_t handle,
@@ -1222,6 +1337,11 @@ static uint8_t find_type_cb(const struct bt_gatt_attr *attr, uint16_t handle,
 	data->group->start_handle = sys_cpu_to_le16(handle);
 	data->group->end_handle = sys_cpu_to_le16(handle);
 
+	if (data->indexed) {
+		data->group->end_handle =
+			sys_cpu_to_le16(bt_gatt_service_end_handle(handle, data->end_handle));
+	}
+
 	/* continue to find the end_handle */
 	return BT_GATT_ITER_CONTINUE;
 
@@ -1247,11 +1367,18 @@ static uint8_t att_find_type_rsp(struct bt_att_chan *chan, uint16_t start_handle
 	data.group = NULL;
 	data.value = value;
 	data.value_len = value_len;
+	data.end_handle = end_handle;
 
 	/* Pre-set error in case no service will be found */
 	data.err = BT_ATT_ERR_ATTRIBUTE_NOT_FOUND;
 
-	bt_gatt_foreach_attr(start_handle, end_handle, find_type_cb, &data);
+	data.indexed = !bt_gatt_foreach_attr_uuid(start_handle, end_handle,
+						  BT_UUID_GATT_PRIMARY,
+						  find_type_cb, &data);
+	if (!data.indexed) {
+		bt_gatt_foreach_attr(start_handle, end_handle, find_type_cb,
+				     &data);
+	}
 
 	/* If error has not been cleared, no service has been found */
 	if (data.err) {
@@ -1501,7 +1628,11 @@ static uint8_t att_read_type_rsp(struct bt_att_chan *chan, struct bt_uuid *uuid,
 	/* Pre-set error if no attr will be found in handle */
 	data.err = BT_ATT_ERR_ATTRIBUTE_NOT_FOUND;
 
-	bt_gatt_foreach_attr(start_handle, end_handle, read_type_cb, &data);
+	if (bt_gatt_foreach_attr_uuid(start_handle, end_handle, uuid,
+				      read_type_cb, &data)) {
+		bt_gatt_foreach_attr(start_handle, end_handle, read_type_cb,
+				     &data);
+	}
 
 	if (data.err) {
 		net_buf_unref(data.buf);
@@ -1851,6 +1982,9 @@ struct read_group_data {
 	struct net_buf *buf;
 	struct bt_att_read_group_rsp *rsp;
 	struct bt_att_group_data *group;
+	/* Only services of the requested type are visited */
+	bool indexed;
+	uint16_t end_handle;
 };
 
 static bool attr_read_group_cb(struct net_buf *frag, ssize_t read,
@@ -1909,6 +2043,11 @@ static uint8_t read_group_cb(const struct bt_gatt_attr *attr, uint16_t handle,
 	data->group->start_handle = sys_cpu_to_le16(handle);
 	data->group->end_handle = sys_cpu_to_le16(handle);
 
+	if (data->indexed) {
+		data->group->end_handle =
+			sys_cpu_to_le16(bt_gatt_service_end_handle(handle, data->end_handle));
+	}
+
 	/* Read attribute value and store in the buffer */
 	read = att_chan_read(chan, attr, data->buf, 0, attr_read_group_cb,
 			     data);
@@ -1942,8 +2081,14 @@ static uint8_t att_read_group_rsp(struct bt_att_chan *chan, struct bt_uuid *uuid
 	data.rsp = net_buf_add(data.buf, sizeof(*data.rsp));
 	data.rsp->len = 0U;
 	data.group = NULL;
+	data.end_handle = end_handle;
 
-	bt_gatt_foreach_attr(start_handle, end_handle, read_group_cb, &data);
+	data.indexed = !bt_gatt_foreach_attr_uuid(start_handle, end_handle, uuid,
+						  read_group_cb, &data);
+	if (!data.indexed) {
+		bt_gatt_foreach_attr(start_handle, end_handle, read_group_cb,
+				     &data);
+	}
 
 	if (!data.rsp->len) {
 		net_buf_unref(data.buf);
@@ -2934,6 +3079,14 @@ static int bt_att_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
 	uint8_t err;
 	size_t i;
 
+	/* PDUs of enhanced bearers may still be a chain of ACL fragments,
+	 * handlers expect them in one piece.
+	 */
+	if (buf->frags && bt_l2cap_rx_linearize(buf)) {
+		LOG_ERR("Too large ATT PDU received");
+		return 0;
+	}
+
 	if (buf->len < sizeof(*hdr)) {
 		LOG_ERR("Too small ATT PDU received");
 		return 0;
@@ -3010,7 +3163,7 @@ static struct bt_att *att_get(struct bt_conn *conn)
 	return att_chan->att;
 }
 
-struct net_buf *bt_att_create_pdu(struct bt_conn *conn, uint8_t op, size_t len)
+static struct bt_att_chan *att_chan_for_pdu(struct bt_conn *conn, uint8_t op, size_t len)
 {
 	struct bt_att *att;
 	struct bt_att_chan *chan, *tmp;
@@ -3020,13 +3173,12 @@ struct net_buf *bt_att_create_pdu(struct bt_conn *conn, uint8_t op, size_t len)
 		return NULL;
 	}
 
-	/* This allocator should _not_ be used for RSPs. */
 	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&att->chans, chan, tmp, node) {
 		if (len + sizeof(op) > bt_att_mtu(chan)) {
 			continue;
 		}
 
-		return bt_att_chan_create_pdu(chan, op, len);
+		return chan;
 	}
 
 	LOG_WRN("No ATT channel for MTU %zu", len + sizeof(op));
@@ -3034,6 +3186,32 @@ struct net_buf *bt_att_create_pdu(struct bt_conn *conn, uint8_t op, size_t len)
 	return NULL;
 }
 
+struct net_buf *bt_att_create_pdu(struct bt_conn *conn, uint8_t op, size_t len)
+{
+	struct bt_att_chan *chan;
+
+	/* This allocator should _not_ be used for RSPs. */
+	chan = att_chan_for_pdu(conn, op, len);
+	if (!chan) {
+		return NULL;
+	}
+
+	return bt_att_chan_create_pdu(chan, op, len);
+}
+
+struct net_buf *bt_att_create_pdu_timeout(struct bt_conn *conn, uint8_t op, size_t len,
+					  k_timeout_t timeout)
+{
+	struct bt_att_chan *chan;
+
+	chan = att_chan_for_pdu(conn, op, len);
+	if (!chan) {
+		return NULL;
+	}
+
+	return att_chan_create_pdu(chan, op, len, timeout);
+}
+
 struct net_buf *bt_att_create_rsp_pdu(struct bt_att_chan *chan, uint8_t op)
 {
 	size_t headroom;
@@ -3085,6 +3263,16 @@ static void att_reset(struct bt_att *att)
 		net_buf_unref(buf);
 	}
 
+#if defined(CONFIG_BT_EATT)
+	while ((buf = k_fifo_get(&att->tx_queue_uatt, K_NO_WAIT))) {
+		net_buf_unref(buf);
+	}
+
+	while ((buf = k_fifo_get(&att->tx_queue_eatt, K_NO_WAIT))) {
+		net_buf_unref(buf);
+	}
+#endif /* CONFIG_BT_EATT */
+
 	/* Notify pending requests */
 	while (!sys_slist_is_empty(&att->reqs)) {
 		struct bt_att_req *req;
@@ -3178,6 +3366,10 @@ static void att_chan_attach(struct bt_att *att, struct bt_att_chan *chan)
 	if (sys_slist_is_empty(&att->chans)) {
 		/* Init general queues when attaching the first channel */
 		k_fifo_init(&att->tx_queue);
+#if defined(CONFIG_BT_EATT)
+		k_fifo_init(&att->tx_queue_uatt);
+		k_fifo_init(&att->tx_queue_eatt);
+#endif /* CONFIG_BT_EATT */
 #if CONFIG_BT_ATT_PREPARE_COUNT > 0
 		sys_slist_init(&att->prep_queue);
 #endif
@@ -3956,7 +4148,11 @@ int bt_att_send(struct bt_conn *conn, struct net_buf *buf)
 		return -ENOTCONN;
 	}
 
-	k_fifo_put(&att->tx_queue, buf);
+#if defined(CONFIG_BT_EATT)
+	bt_att_get_tx_meta_data(buf)->seq = atomic_inc(&att->tx_seq);
+#endif /* CONFIG_BT_EATT */
+
+	k_fifo_put(att_tx_queue(att, bt_att_get_tx_meta_data(buf)->chan_opt), buf);
 	att_send_process(att);
 
 	return 0;
@@ -4065,6 +4261,32 @@ bool bt_att_fixed_chan_only(struct bt_conn *conn)
 #endif /* CONFIG_BT_EATT */
 }
 
+bool bt_att_tx_idle(struct bt_conn *conn)
+{
+	struct bt_att *att = att_get(conn);
+	struct bt_att_chan *chan;
+
+	if (!att || !k_fifo_is_empty(&att->tx_queue)) {
+		return false;
+	}
+
+#if defined(CONFIG_BT_EATT)
+	if (!k_fifo_is_empty(&att->tx_queue_uatt) || !k_fifo_is_empty(&att->tx_queue_eatt)) {
+		return false;
+	}
+#endif /* CONFIG_BT_EATT */
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&att->chans, chan, node) {
+		if (atomic_test_bit(chan->flags, ATT_PENDING_SENT) ||
+		    !k_fifo_is_empty(&chan->tx_queue) ||
+		    !k_fifo_is_empty(&chan->chan.tx_queue)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 void bt_att_clear_out_of_sync_sent(struct bt_conn *conn)
 {
 	struct bt_att *att = att_get(conn);
@@ -298,6 +298,10 @@ uint16_t bt_att_get_uatt_mtu(struct bt_conn *conn);
 struct net_buf *bt_att_create_pdu(struct bt_conn *conn, uint8_t op,
 				  size_t len);
 
+/* Same as bt_att_create_pdu(), waiting at most @p timeout for a buffer */
+struct net_buf *bt_att_create_pdu_timeout(struct bt_conn *conn, uint8_t op,
+					  size_t len, k_timeout_t timeout);
+
 /* Allocate a new request */
 struct bt_att_req *bt_att_req_alloc(k_timeout_t timeout);
 
@@ -326,6 +330,9 @@ struct bt_att_req *bt_att_find_req_by_user_data(struct bt_conn *conn, const void
 /* Checks if only the fixed ATT channel is connected */
 bool bt_att_fixed_chan_only(struct bt_conn *conn);
 
+/* Checks that no ATT PDU is queued or being sent on any bearer */
+bool bt_att_tx_idle(struct bt_conn *conn);
+
 /* Clear the out of sync flag on all channels */
 void bt_att_clear_out_of_sync_sent(struct bt_conn *conn);
 
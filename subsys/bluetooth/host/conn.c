@@ -44,6 +44,7 @@
 #include "att_internal.h"
 #include "iso_internal.h"
 #include "direction_internal.h"
+#include "tx_sched_internal.h"
 #include "classic/sco_internal.h"
 
 #define LOG_LEVEL CONFIG_BT_CONN_LOG_LEVEL
@@ -377,9 +378,42 @@ void bt_conn_reset_rx_state(struct bt_conn *conn)
 	conn->rx = NULL;
 }
 
+#if defined(CONFIG_BT_CONN_RX_FRAG_CHAIN)
+/* Bytes kept contiguous at the start of a frame: the basic L2CAP header and
+ * the SDU length of the first K-frame of an SDU.
+ */
+#define ACL_RX_HEAD_LEN (sizeof(struct bt_l2cap_hdr) + sizeof(uint16_t))
+
+/* Chain a continuation fragment to the frame being reassembled. Returns false
+ * if the fragment was small enough to be copied in whole instead, in which
+ * case the caller still owns it.
+ */
+static bool acl_rx_chain(struct bt_conn *conn, struct net_buf *buf)
+{
+	if (conn->rx->len < ACL_RX_HEAD_LEN) {
+		size_t len = MIN(ACL_RX_HEAD_LEN - conn->rx->len, buf->len);
+
+		net_buf_add_mem(conn->rx, net_buf_pull_mem(buf, len), len);
+		bt_l2cap_rx_copied(len);
+
+		if (!buf->len) {
+			return false;
+		}
+	}
+
+	/* The fragment is only freed, and its completed packet reported to
+	 * the controller, once the whole frame has been consumed.
+	 */
+	net_buf_frag_add(conn->rx, buf);
+
+	return true;
+}
+#endif /* CONFIG_BT_CONN_RX_FRAG_CHAIN */
+
 static void bt_acl_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags)
 {
 	uint16_t acl_total_len;
+	size_t rx_len;
 
 	bt_acl_set_ncp_sent(buf, false);
 
@@ -410,6 +444,12 @@ static void bt_acl_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags
 			return;
 		}
 
+#if defined(CONFIG_BT_CONN_RX_FRAG_CHAIN)
+		if (acl_rx_chain(conn, buf)) {
+			/* Now owned by the frame */
+			buf = NULL;
+		}
+#else
 		if (buf->len > net_buf_tailroom(conn->rx)) {
 			LOG_ERR("Not enough buffer space for L2CAP data");
 
@@ -424,6 +464,8 @@ static void bt_acl_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags
 		}
 
 		net_buf_add_mem(conn->rx, buf->data, buf->len);
+		bt_l2cap_rx_copied(buf->len);
+#endif /* CONFIG_BT_CONN_RX_FRAG_CHAIN */
 		break;
 	default:
 		/* BT_ACL_START_NO_FLUSH and BT_ACL_COMPLETE are not allowed on
@@ -436,7 +478,9 @@ static void bt_acl_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags
 		return;
 	}
 
-	if (conn->rx->len < sizeof(uint16_t)) {
+	rx_len = net_buf_frags_len(conn->rx);
+
+	if (rx_len < sizeof(uint16_t)) {
 		/* Still not enough data received to retrieve the L2CAP header
 		 * length field.
 		 */
@@ -449,19 +493,23 @@ static void bt_acl_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags
 
 	acl_total_len = sys_get_le16(conn->rx->data) + sizeof(struct bt_l2cap_hdr);
 
-	if (conn->rx->len < acl_total_len) {
+	if (rx_len < acl_total_len) {
 		/* L2CAP frame not complete. */
-		bt_send_one_host_num_completed_packets(conn->handle);
-		bt_acl_set_ncp_sent(buf, true);
-		net_buf_unref(buf);
+		if (buf) {
+			bt_send_one_host_num_completed_packets(conn->handle);
+			bt_acl_set_ncp_sent(buf, true);
+			net_buf_unref(buf);
+		}
 
 		return;
 	}
 
-	net_buf_unref(buf);
+	if (buf) {
+		net_buf_unref(buf);
+	}
 
-	if (conn->rx->len > acl_total_len) {
-		LOG_ERR("ACL len mismatch (%u > %u)", conn->rx->len, acl_total_len);
+	if (rx_len > acl_total_len) {
+		LOG_ERR("ACL len mismatch (%zu > %u)", rx_len, acl_total_len);
 		bt_conn_reset_rx_state(conn);
 		return;
 	}
@@ -472,7 +520,7 @@ static void bt_acl_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags
 
 	__ASSERT(buf->ref == 1, "buf->ref %d", buf->ref);
 
-	LOG_DBG("Successfully parsed %u byte L2CAP packet", buf->len);
+	LOG_DBG("Successfully parsed %zu byte L2CAP packet", rx_len);
 	bt_l2cap_recv(conn, buf, true);
 }
 
@@ -538,7 +586,7 @@ static int send_acl(struct bt_conn *conn, struct net_buf *buf, uint8_t flags)
 
 	hdr = net_buf_push(buf, sizeof(*hdr));
 	hdr->handle = sys_cpu_to_le16(bt_acl_handle_pack(conn->handle, flags));
-	hdr->len = sys_cpu_to_le16(buf->len - sizeof(*hdr));
+	hdr->len = sys_cpu_to_le16(net_buf_frags_len(buf) - sizeof(*hdr));
 
 	bt_buf_set_type(buf, BT_BUF_ACL_OUT);
 
@@ -694,9 +742,21 @@ static int send_buf(struct bt_conn *conn, struct net_buf *buf,
 	tx->user_data = ud;
 
 	uint16_t frag_len = MIN(conn_mtu(conn), len);
+	struct net_buf *chain = NULL;
 
 	__ASSERT_NO_MSG(buf->ref == 1);
 
+	/* A payload chained by L2CAP goes out with the headers in `buf` as a
+	 * single packet, the view only covers `buf` and takes over the chain.
+	 */
+	if (buf->frags) {
+		__ASSERT_NO_MSG(len <= conn_mtu(conn));
+
+		chain = buf->frags;
+		buf->frags = NULL;
+		frag_len = buf->len;
+	}
+
 	if (buf->len > frag_len) {
 		LOG_DBG("keep %p around", buf);
 		frag = get_data_frag(net_buf_ref(buf), frag_len);
@@ -711,6 +771,10 @@ static int send_buf(struct bt_conn *conn, struct net_buf *buf,
 	/* Caller is supposed to check we have all resources to send */
 	__ASSERT_NO_MSG(frag != NULL);
 
+	if (chain) {
+		net_buf_frag_add(frag, chain);
+	}
+
 	/* If the current buffer doesn't fit a controller buffer */
 	if (len > conn_mtu(conn)) {
 		flags = conn->next_is_frag ? FRAG_CONT : FRAG_START;
@@ -856,6 +920,9 @@ void bt_conn_data_ready(struct bt_conn *conn)
 		 * the list (in `get_conn_ready`).
 		 */
 		bt_conn_ref(conn);
+#if defined(CONFIG_BT_TX_SCHED)
+		bt_tx_sched_ready(&conn->_tx_sched);
+#endif
 		sys_slist_append(&bt_dev.le.conn_ready,
 				 &conn->_conn_ready);
 		LOG_DBG("raised");
@@ -909,6 +976,12 @@ struct bt_conn *get_conn_ready(void)
 		return NULL;
 	}
 
+#if defined(CONFIG_BT_TX_SCHED)
+	/* Let the scheduler bring the connection it wants served to the head */
+	node = bt_tx_sched_pick(&bt_dev.le.conn_ready,
+				BT_TX_SCHED_OFFSET(struct bt_conn, _conn_ready, _tx_sched));
+#endif
+
 	/* `conn` borrows from the list node. That node is _not_ popped yet.
 	 *
 	 * If we end up not popping that conn off the list, we have to make sure
@@ -1013,48 +1086,17 @@ void bt_conn_suspend_tx(bool suspend)
 }
 #endif	/* CONFIG_BT_TESTING */
 
-void bt_conn_tx_processor(void)
+/* Pull one fragment from the upper layer and send it. Returns the number of
+ * bytes sent, 0 if there was nothing to pull, or a negative error if the
+ * connection had to be torn down.
+ */
+static int conn_tx_one(struct bt_conn *conn)
 {
-	LOG_DBG("start");
-	struct bt_conn *conn;
 	struct net_buf *buf;
 	bt_conn_tx_cb_t cb = NULL;
 	size_t buf_len;
 	void *ud = NULL;
 
-	if (!IS_ENABLED(CONFIG_BT_CONN_TX)) {
-		/* Mom, can we have a real compiler? */
-		return;
-	}
-
-	if (IS_ENABLED(CONFIG_BT_TESTING) && _suspend_tx) {
-		return;
-	}
-
-	conn = get_conn_ready();
-
-	if (!conn) {
-		LOG_DBG("no connection wants to do stuff");
-		return;
-	}
-
-	LOG_DBG("processing conn %p", conn);
-
-	if (conn->state != BT_CONN_CONNECTED) {
-		LOG_WRN("conn %p: not connected", conn);
-
-		/* Call the user callbacks & destroy (final-unref) the buffers
-		 * we were supposed to send.
-		 */
-		buf = conn->tx_data_pull(conn, SIZE_MAX, &buf_len);
-		while (buf) {
-			destroy_and_callback(conn, buf, cb, ud);
-			buf = conn->tx_data_pull(conn, SIZE_MAX, &buf_len);
-		}
-
-		goto exit;
-	}
-
 	/* now that we are guaranteed resources, we can pull data from the upper
 	 * layer (L2CAP or ISO).
 	 */
@@ -1067,10 +1109,11 @@ void bt_conn_tx_processor(void)
 		 */
 		LOG_DBG("no buf returned");
 
-		goto exit;
+		return 0;
 	}
 
 	bool last_buf = conn_mtu(conn) >= buf_len;
+	size_t frag_len = MIN(conn_mtu(conn), buf_len);
 
 	if (last_buf) {
 		/* Only pull the callback info from the last buffer.
@@ -1102,9 +1145,131 @@ void bt_conn_tx_processor(void)
 		destroy_and_callback(conn, buf, cb, ud);
 		bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 
+		return err;
+	}
+
+	return frag_len;
+}
+
+/* Move `conn` from the head to the back of the ready list once it has used
+ * up its quantum, so the next connection gets its turn.
+ */
+static void conn_tx_rotate(struct bt_conn *conn)
+{
+	if (sys_slist_peek_head(&bt_dev.le.conn_ready) != &conn->_conn_ready) {
+		/* Already rotated by `get_conn_ready()` */
+		return;
+	}
+
+	(void)sys_slist_get(&bt_dev.le.conn_ready);
+	(void)atomic_set(&conn->_conn_ready_lock, 0);
+
+	if (conn->has_data(conn)) {
+		LOG_DBG("quantum used, appending %p to back of TX queue", conn);
+		bt_conn_data_ready(conn);
+	}
+
+	/* Give back the ref held by the list node */
+	bt_conn_unref(conn);
+}
+
+static bool conn_tx_quantum_used(size_t frags, size_t bytes)
+{
+	if (frags >= CONFIG_BT_CONN_TX_QUANTUM) {
+		return true;
+	}
+
+	return CONFIG_BT_CONN_TX_QUANTUM_BYTES > 0 &&
+	       bytes >= CONFIG_BT_CONN_TX_QUANTUM_BYTES;
+}
+
+void bt_conn_tx_processor(void)
+{
+	LOG_DBG("start");
+	struct bt_conn *conn;
+	struct net_buf *buf;
+	size_t buf_len;
+	size_t frags = 0;
+	size_t bytes = 0;
+
+	if (!IS_ENABLED(CONFIG_BT_CONN_TX)) {
+		/* Mom, can we have a real compiler? */
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_BT_TESTING) && _suspend_tx) {
+		return;
+	}
+
+	conn = get_conn_ready();
+
+	if (!conn) {
+		LOG_DBG("no connection wants to do stuff");
+		return;
+	}
+
+	LOG_DBG("processing conn %p", conn);
+
+	if (conn->state != BT_CONN_CONNECTED) {
+		LOG_WRN("conn %p: not connected", conn);
+
+		/* Call the user callbacks & destroy (final-unref) the buffers
+		 * we were supposed to send.
+		 */
+		buf = conn->tx_data_pull(conn, SIZE_MAX, &buf_len);
+		while (buf) {
+			destroy_and_callback(conn, buf, NULL, NULL);
+			buf = conn->tx_data_pull(conn, SIZE_MAX, &buf_len);
+		}
+
 		goto exit;
 	}
 
+	/* Send up to the quantum for this connection in one go, instead of
+	 * going through the work queue for every fragment. Each extra round
+	 * re-runs the same resource checks as the first one.
+	 */
+	while (true) {
+		struct bt_conn *next;
+		int sent = conn_tx_one(conn);
+
+		if (sent <= 0) {
+			goto exit;
+		}
+
+		frags++;
+		bytes += sent;
+
+#if defined(CONFIG_BT_TX_SCHED)
+		bt_tx_sched_served(&conn->_tx_sched, sent);
+#endif
+
+		if (conn_tx_quantum_used(frags, bytes)) {
+			conn_tx_rotate(conn);
+			break;
+		}
+
+		/* `get_conn_ready()` rotated it already, or it is not ours */
+		if (sys_slist_peek_head(&bt_dev.le.conn_ready) != &conn->_conn_ready) {
+			break;
+		}
+
+		next = get_conn_ready();
+		if (!next) {
+			/* Out of resources. We will be kicked when they are freed. */
+			goto exit;
+		}
+
+		/* We already hold a ref on `conn`, drop the new one */
+		bt_conn_unref(next);
+
+		if (next != conn) {
+			/* The scheduler wants another connection served first */
+			__ASSERT_NO_MSG(IS_ENABLED(CONFIG_BT_TX_SCHED));
+			break;
+		}
+	}
+
 	/* Always kick the TX work. It will self-suspend if it doesn't get
 	 * resources or there is nothing left to send.
 	 */
@@ -10,6 +10,7 @@
  */
 
 #include <zephyr/bluetooth/iso.h>
+#include <zephyr/bluetooth/tx_sched.h>
 
 typedef enum __packed {
 	BT_CONN_DISCONNECTED,         /* Disconnected, conn is completely down */
@@ -317,6 +318,11 @@ struct bt_conn {
 	sys_snode_t		_conn_ready;
 	atomic_t		_conn_ready_lock;
 
+#if defined(CONFIG_BT_TX_SCHED)
+	/* QoS and scheduler state for picking the next ready connection */
+	struct bt_tx_sched_entity _tx_sched;
+#endif /* CONFIG_BT_TX_SCHED */
+
 	/* Holds the number of packets that have been sent to the controller but
 	 * not yet ACKd (by receiving an Number of Completed Packets). This
 	 * variable can be used for deriving a QoS or waterlevel scheme in order
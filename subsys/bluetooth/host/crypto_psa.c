@@ -55,6 +55,12 @@ int bt_rand(void *buf, size_t len)
 }
 #endif /* CONFIG_BT_HOST_CRYPTO_PRNG */
 
+int bt_rand_pr(void *buf, size_t len)
+{
+	/* No reseed on demand, same output as bt_rand() */
+	return bt_rand(buf, len);
+}
+
 int bt_encrypt_le(const uint8_t key[16], const uint8_t plaintext[16],
 		  uint8_t enc_data[16])
 {
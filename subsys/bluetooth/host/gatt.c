@@ -88,6 +88,20 @@ static sys_slist_t callback_list = SYS_SLIST_STATIC_INIT(&callback_list);
 
 #if defined(CONFIG_BT_GATT_DYNAMIC_DB)
 static sys_slist_t db;
+
+/* Dynamic services in handle order, mirrors `db` while it fits */
+struct db_index_entry {
+	struct bt_gatt_service *svc;
+	uint16_t start_handle;
+	uint16_t end_handle;
+	/* Attribute i has handle start_handle + i */
+	bool contiguous;
+};
+
+static struct db_index_entry db_index[CONFIG_BT_GATT_DYNAMIC_DB_INDEX_SIZE];
+static size_t db_index_count;
+/* Number of services in `db`, the index is only used if they all fit */
+static size_t db_count;
 #endif /* CONFIG_BT_GATT_DYNAMIC_DB */
 
 enum gatt_global_flags {
@@ -1243,6 +1257,152 @@ BT_GATT_SERVICE_DEFINE(_1_gatt_svc,
 #endif /* CONFIG_BT_GATT_SERVICE_CHANGED */
 );
 
+#if CONFIG_BT_GATT_UUID_INDEX_SIZE > 0
+/* All attributes sorted by type, then handle, while they fit */
+struct uuid_index_entry {
+	const struct bt_gatt_attr *attr;
+	uint16_t handle;
+};
+
+static struct uuid_index_entry uuid_index[CONFIG_BT_GATT_UUID_INDEX_SIZE];
+static size_t uuid_index_count;
+/* Number of attributes in the database */
+static size_t uuid_index_attrs;
+
+/* UUIDs are ordered by their 128-bit form so that a 16-bit UUID and the
+ * equivalent 128-bit one sort together.
+ */
+static void uuid_index_key(const struct bt_uuid *uuid, struct bt_uuid_128 *key)
+{
+	static const uint8_t base[16] = {
+		BT_UUID_128_ENCODE(0x00000000, 0x0000, 0x1000, 0x8000, 0x00805F9B34FB)
+	};
+
+	switch (uuid->type) {
+	case BT_UUID_TYPE_16:
+		memcpy(key->val, base, sizeof(base));
+		sys_put_le16(BT_UUID_16(uuid)->val, &key->val[12]);
+		break;
+	case BT_UUID_TYPE_32:
+		memcpy(key->val, base, sizeof(base));
+		sys_put_le32(BT_UUID_32(uuid)->val, &key->val[12]);
+		break;
+	default:
+		memcpy(key->val, BT_UUID_128(uuid)->val, sizeof(key->val));
+		break;
+	}
+}
+
+/* Position of the first entry at or after (`key`, `handle`) */
+static size_t uuid_index_lookup(const struct bt_uuid_128 *key, uint16_t handle)
+{
+	size_t lo = 0;
+	size_t hi = uuid_index_count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct bt_uuid_128 mid_key;
+		int cmp;
+
+		uuid_index_key(uuid_index[mid].attr->uuid, &mid_key);
+		cmp = memcmp(mid_key.val, key->val, sizeof(key->val));
+		if (cmp < 0 || (cmp == 0 && uuid_index[mid].handle < handle)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static bool uuid_index_valid(void)
+{
+	return uuid_index_count == uuid_index_attrs;
+}
+
+static void uuid_index_insert(const struct bt_gatt_attr *attr, uint16_t handle)
+{
+	struct bt_uuid_128 key;
+	size_t pos;
+
+	uuid_index_key(attr->uuid, &key);
+	pos = uuid_index_lookup(&key, handle);
+
+	memmove(&uuid_index[pos + 1], &uuid_index[pos],
+		(uuid_index_count - pos) * sizeof(uuid_index[0]));
+	uuid_index[pos].attr = attr;
+	uuid_index[pos].handle = handle;
+	uuid_index_count++;
+}
+
+static uint8_t uuid_index_add_cb(const struct bt_gatt_attr *attr, uint16_t handle,
+				 void *user_data)
+{
+	uuid_index_insert(attr, handle);
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void uuid_index_rebuild(void)
+{
+	uuid_index_count = 0;
+
+	if (uuid_index_attrs <= ARRAY_SIZE(uuid_index)) {
+		bt_gatt_foreach_attr(0x0001, 0xffff, uuid_index_add_cb, NULL);
+	}
+}
+
+#if defined(CONFIG_BT_GATT_DYNAMIC_DB)
+static void uuid_index_add_svc(const struct bt_gatt_service *svc)
+{
+	bool valid = uuid_index_valid();
+
+	uuid_index_attrs += svc->attr_count;
+
+	if (!valid || uuid_index_attrs > ARRAY_SIZE(uuid_index)) {
+		/* Requests walk the database until it fits again */
+		return;
+	}
+
+	for (size_t i = 0; i < svc->attr_count; i++) {
+		uuid_index_insert(&svc->attrs[i], svc->attrs[i].handle);
+	}
+}
+
+static void uuid_index_remove_svc(const struct bt_gatt_service *svc)
+{
+	const struct bt_gatt_attr *first = &svc->attrs[0];
+	const struct bt_gatt_attr *last = &svc->attrs[svc->attr_count - 1];
+	bool valid = uuid_index_valid();
+	size_t count = 0;
+
+	uuid_index_attrs -= svc->attr_count;
+
+	if (!valid) {
+		uuid_index_rebuild();
+		return;
+	}
+
+	for (size_t i = 0; i < uuid_index_count; i++) {
+		if (uuid_index[i].attr < first || uuid_index[i].attr > last) {
+			uuid_index[count++] = uuid_index[i];
+		}
+	}
+
+	uuid_index_count = count;
+}
+#endif /* CONFIG_BT_GATT_DYNAMIC_DB */
+#elif defined(CONFIG_BT_GATT_DYNAMIC_DB)
+static inline void uuid_index_add_svc(const struct bt_gatt_service *svc)
+{
+}
+
+static inline void uuid_index_remove_svc(const struct bt_gatt_service *svc)
+{
+}
+#endif /* CONFIG_BT_GATT_UUID_INDEX_SIZE > 0 */
+
 #if defined(CONFIG_BT_GATT_DYNAMIC_DB)
 static uint8_t found_attr(const struct bt_gatt_attr *attr, uint16_t handle,
 			  void *user_data)
@@ -1263,6 +1423,102 @@ static const struct bt_gatt_attr *find_attr(uint16_t handle)
 	return attr;
 }
 
+/* Position of the first indexed service ending at or after `handle` */
+static size_t db_index_lookup(uint16_t handle)
+{
+	size_t lo = 0;
+	size_t hi = db_index_count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (db_index[mid].end_handle < handle) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static bool db_index_valid(void)
+{
+	return db_count == db_index_count;
+}
+
+static void db_index_entry_set(struct db_index_entry *entry, struct bt_gatt_service *svc)
+{
+	uint16_t start_handle = svc->attrs[0].handle;
+	uint16_t end_handle = start_handle;
+	bool contiguous = true;
+
+	for (uint16_t i = 1; i < svc->attr_count; i++) {
+		uint16_t handle = svc->attrs[i].handle;
+
+		end_handle = MAX(end_handle, handle);
+		contiguous = contiguous && handle == start_handle + i;
+	}
+
+	entry->svc = svc;
+	entry->start_handle = start_handle;
+	entry->end_handle = end_handle;
+	entry->contiguous = contiguous;
+}
+
+static void db_index_rebuild(void)
+{
+	struct bt_gatt_service *svc;
+
+	db_index_count = 0;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&db, svc, node) {
+		__ASSERT_NO_MSG(db_index_count < ARRAY_SIZE(db_index));
+		db_index_entry_set(&db_index[db_index_count++], svc);
+	}
+}
+
+static void db_index_insert(struct bt_gatt_service *svc)
+{
+	size_t pos;
+
+	db_count++;
+
+	if (db_count > ARRAY_SIZE(db_index)) {
+		/* Does not fit, lookups walk `db` from now on */
+		return;
+	}
+
+	pos = db_index_lookup(svc->attrs[0].handle);
+	memmove(&db_index[pos + 1], &db_index[pos],
+		(db_index_count - pos) * sizeof(db_index[0]));
+	db_index_entry_set(&db_index[pos], svc);
+	db_index_count++;
+}
+
+static void db_index_remove(struct bt_gatt_service *svc)
+{
+	size_t pos;
+
+	db_count--;
+
+	if (db_count + 1 > ARRAY_SIZE(db_index)) {
+		if (db_count == ARRAY_SIZE(db_index)) {
+			/* Fits again */
+			db_index_rebuild();
+		}
+
+		return;
+	}
+
+	pos = db_index_lookup(svc->attrs[0].handle);
+	__ASSERT_NO_MSG(pos < db_index_count && db_index[pos].svc == svc);
+
+	db_index_count--;
+	memmove(&db_index[pos], &db_index[pos + 1],
+		(db_index_count - pos) * sizeof(db_index[0]));
+}
+
 static void gatt_insert(struct bt_gatt_service *svc, uint16_t last_handle)
 {
 	struct bt_gatt_service *tmp, *prev = NULL;
@@ -1324,6 +1580,8 @@ populate:
 	}
 
 	gatt_insert(svc, last_handle);
+	db_index_insert(svc);
+	uuid_index_add_svc(svc);
 
 	return 0;
 }
@@ -1546,8 +1804,17 @@ static void bt_gatt_service_init(void)
 	STRUCT_SECTION_FOREACH(bt_gatt_service_static, svc) {
 		last_static_handle += svc->attr_count;
 	}
+
+#if CONFIG_BT_GATT_UUID_INDEX_SIZE > 0
+	uuid_index_attrs = last_static_handle;
+	uuid_index_rebuild();
+#endif
 }
 
+#if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE)
+static void notify_mult_init(void);
+#endif /* CONFIG_BT_GATT_NOTIFY_MULTIPLE */
+
 void bt_gatt_init(void)
 {
 	if (atomic_test_and_set_bit(gatt_flags, GATT_INITIALIZED)) {
@@ -1556,6 +1823,10 @@ void bt_gatt_init(void)
 
 	bt_gatt_service_init();
 
+#if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE)
+	notify_mult_init();
+#endif /* CONFIG_BT_GATT_NOTIFY_MULTIPLE */
+
 #if defined(CONFIG_BT_GATT_CACHING)
 	k_work_init_delayable(&db_hash.work, db_hash_process);
 
@@ -1721,6 +1992,9 @@ static int gatt_unregister(struct bt_gatt_service *svc)
 		return -ENOENT;
 	}
 
+	db_index_remove(svc);
+	uuid_index_remove_svc(svc);
+
 	for (uint16_t i = 0; i < svc->attr_count; i++) {
 		struct bt_gatt_attr *attr = &svc->attrs[i];
 
@@ -2062,6 +2336,41 @@ static void foreach_attr_type_dyndb(uint16_t start_handle, uint16_t end_handle,
 	size_t i;
 	struct bt_gatt_service *svc;
 
+	if (db_index_valid()) {
+		/* Binary search for the first service in range, then jump
+		 * straight to the start handle within it.
+		 */
+		for (size_t pos = db_index_lookup(start_handle); pos < db_index_count; pos++) {
+			const struct db_index_entry *entry = &db_index[pos];
+
+			if (entry->start_handle > end_handle) {
+				return;
+			}
+
+			svc = entry->svc;
+			i = 0;
+			if (entry->contiguous && start_handle > entry->start_handle) {
+				i = start_handle - entry->start_handle;
+			}
+
+			for (; i < svc->attr_count; i++) {
+				struct bt_gatt_attr *attr = &svc->attrs[i];
+
+				if (gatt_foreach_iter(attr, attr->handle,
+						      start_handle,
+						      end_handle,
+						      uuid, attr_data,
+						      &num_matches,
+						      func, user_data) ==
+				    BT_GATT_ITER_STOP) {
+					return;
+				}
+			}
+		}
+
+		return;
+	}
+
 	SYS_SLIST_FOR_EACH_CONTAINER(&db, svc, node) {
 		struct bt_gatt_service *next;
 
@@ -2111,7 +2420,14 @@ void bt_gatt_foreach_attr_type(uint16_t start_handle, uint16_t end_handle,
 				continue;
 			}
 
-			for (i = 0; i < static_svc->attr_count; i++, handle++) {
+			/* Static handles are contiguous, jump to the start */
+			i = 0;
+			if (start_handle > handle) {
+				i = start_handle - handle;
+				handle = start_handle;
+			}
+
+			for (; i < static_svc->attr_count; i++, handle++) {
 				if (gatt_foreach_iter(&static_svc->attrs[i],
 						      handle, start_handle,
 						      end_handle, uuid,
@@ -2129,6 +2445,151 @@ void bt_gatt_foreach_attr_type(uint16_t start_handle, uint16_t end_handle,
 				num_matches, func, user_data);
 }
 
+#if CONFIG_BT_GATT_UUID_INDEX_SIZE > 0
+static bool uuid_index_usable(void)
+{
+#if defined(CONFIG_BT_GATT_DYNAMIC_DB)
+	/* Group ends are found through the handle index */
+	if (!db_index_valid()) {
+		return false;
+	}
+#endif /* CONFIG_BT_GATT_DYNAMIC_DB */
+
+	return uuid_index_valid();
+}
+
+/* Handle of the first attribute of type `uuid` after `handle`, 0 if none */
+static uint16_t uuid_index_next(const struct bt_uuid *uuid, uint16_t handle)
+{
+	struct bt_uuid_128 key;
+	size_t pos;
+
+	if (handle == 0xffff) {
+		return 0;
+	}
+
+	uuid_index_key(uuid, &key);
+	pos = uuid_index_lookup(&key, handle + 1);
+	if (pos == uuid_index_count || bt_uuid_cmp(uuid_index[pos].attr->uuid, uuid)) {
+		return 0;
+	}
+
+	return uuid_index[pos].handle;
+}
+
+/* Largest attribute handle below `handle` */
+static uint16_t gatt_prev_handle(uint16_t handle)
+{
+	uint16_t prev = handle - 1;
+
+	if (prev <= last_static_handle) {
+		/* Static handles are contiguous */
+		return prev;
+	}
+
+#if defined(CONFIG_BT_GATT_DYNAMIC_DB)
+	size_t pos = db_index_lookup(prev);
+
+	if (pos < db_index_count && db_index[pos].start_handle <= prev) {
+		const struct db_index_entry *entry = &db_index[pos];
+		uint16_t found = entry->start_handle;
+
+		if (entry->contiguous) {
+			return prev;
+		}
+
+		for (size_t i = 0; i < entry->svc->attr_count; i++) {
+			uint16_t attr_handle = entry->svc->attrs[i].handle;
+
+			if (attr_handle <= prev && attr_handle > found) {
+				found = attr_handle;
+			}
+		}
+
+		return found;
+	}
+
+	/* In the gap after the previous service */
+	return pos > 0 ? db_index[pos - 1].end_handle : last_static_handle;
+#else
+	return prev;
+#endif /* CONFIG_BT_GATT_DYNAMIC_DB */
+}
+
+static uint16_t gatt_last_handle(void)
+{
+#if defined(CONFIG_BT_GATT_DYNAMIC_DB)
+	if (db_index_count > 0) {
+		return db_index[db_index_count - 1].end_handle;
+	}
+#endif /* CONFIG_BT_GATT_DYNAMIC_DB */
+
+	return last_static_handle;
+}
+
+int bt_gatt_foreach_attr_uuid(uint16_t start_handle, uint16_t end_handle,
+			      const struct bt_uuid *uuid,
+			      bt_gatt_attr_func_t func, void *user_data)
+{
+	struct bt_uuid_128 key;
+
+	if (!uuid_index_usable()) {
+		return -ENOTSUP;
+	}
+
+	uuid_index_key(uuid, &key);
+
+	for (size_t pos = uuid_index_lookup(&key, start_handle); pos < uuid_index_count;
+	     pos++) {
+		const struct uuid_index_entry *entry = &uuid_index[pos];
+
+		if (entry->handle > end_handle || bt_uuid_cmp(entry->attr->uuid, uuid)) {
+			break;
+		}
+
+		if (func(entry->attr, entry->handle, user_data) == BT_GATT_ITER_STOP) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+uint16_t bt_gatt_service_end_handle(uint16_t handle, uint16_t end_handle)
+{
+	uint16_t primary = uuid_index_next(BT_UUID_GATT_PRIMARY, handle);
+	uint16_t secondary = uuid_index_next(BT_UUID_GATT_SECONDARY, handle);
+	uint16_t next = MIN(primary ? primary : UINT16_MAX,
+			    secondary ? secondary : UINT16_MAX);
+	uint16_t last;
+
+	if (!primary && !secondary) {
+		last = gatt_last_handle();
+	} else {
+		last = gatt_prev_handle(next);
+	}
+
+	if (last > end_handle) {
+		/* Clip to the last attribute within the requested range */
+		last = gatt_prev_handle(end_handle + 1);
+	}
+
+	return last;
+}
+#else
+int bt_gatt_foreach_attr_uuid(uint16_t start_handle, uint16_t end_handle,
+			      const struct bt_uuid *uuid,
+			      bt_gatt_attr_func_t func, void *user_data)
+{
+	return -ENOTSUP;
+}
+
+uint16_t bt_gatt_service_end_handle(uint16_t handle, uint16_t end_handle)
+{
+	return handle;
+}
+#endif /* CONFIG_BT_GATT_UUID_INDEX_SIZE > 0 */
+
 static uint8_t find_next(const struct bt_gatt_attr *attr, uint16_t handle,
 			 void *user_data)
 {
@@ -2356,11 +2817,147 @@ struct notify_data {
 		struct bt_gatt_notify_params *nfy_params;
 		struct bt_gatt_indicate_params *ind_params;
 	};
+#if defined(CONFIG_BT_GATT_NOTIFY_SHARED)
+	/* Value shared by the subscribers, NULL to copy it */
+	struct net_buf *shared;
+#endif /* CONFIG_BT_GATT_NOTIFY_SHARED */
 };
 
+#if defined(CONFIG_BT_GATT_NOTIFY_STATS)
+static struct bt_gatt_notify_stats nfy_stats;
+
+void bt_gatt_notify_stats_get(struct bt_gatt_notify_stats *stats)
+{
+	*stats = nfy_stats;
+}
+
+void bt_gatt_notify_stats_reset(void)
+{
+	(void)memset(&nfy_stats, 0, sizeof(nfy_stats));
+}
+
+#define NFY_STATS_ADD(field, n) (nfy_stats.field += (n))
+#else
+#define NFY_STATS_ADD(field, n)
+#endif /* CONFIG_BT_GATT_NOTIFY_STATS */
+
+#define NFY_STATS_INC(field) NFY_STATS_ADD(field, 1)
+
+#if defined(CONFIG_BT_GATT_NOTIFY_SHARED)
+/* Values are never written once shared, no user data needed */
+NET_BUF_POOL_FIXED_DEFINE(nfy_shared_pool, CONFIG_BT_GATT_NOTIFY_SHARED_COUNT,
+			  BT_L2CAP_TX_MTU, 0, NULL);
+
+static struct net_buf *nfy_shared_alloc(const struct bt_gatt_notify_params *params)
+{
+	struct net_buf *buf;
+
+	/* The PDU is sent as a single ACL packet, see bt_l2cap_send_pdu() */
+	if (!params->len ||
+	    BT_L2CAP_HDR_SIZE + sizeof(struct bt_att_hdr) + sizeof(struct bt_att_notify) +
+	    params->len > bt_dev.le.acl_mtu) {
+		return NULL;
+	}
+
+	buf = net_buf_alloc(&nfy_shared_pool, K_NO_WAIT);
+	if (!buf) {
+		return NULL;
+	}
+
+	if (params->len > net_buf_tailroom(buf)) {
+		net_buf_unref(buf);
+		return NULL;
+	}
+
+	net_buf_add_mem(buf, params->data, params->len);
+
+	NFY_STATS_INC(values);
+	NFY_STATS_ADD(copied, params->len);
+
+	return buf;
+}
+
+static struct net_buf *nfy_shared_get(struct bt_conn *conn, struct notify_data *data)
+{
+	/* Only the LE fixed channel sends chained PDUs */
+	if (conn->type != BT_CONN_TYPE_LE) {
+		return NULL;
+	}
+
+#if defined(CONFIG_BT_EATT)
+	/* Segmentation on EATT bearers needs the PDU in one buffer */
+	if (bt_eatt_count(conn)) {
+		return NULL;
+	}
+#endif /* CONFIG_BT_EATT */
+
+	return data->shared;
+}
+
+static int gatt_notify_shared(struct bt_conn *conn, uint16_t handle,
+			      struct bt_gatt_notify_params *params, struct net_buf *value)
+{
+	struct bt_att_notify *nfy;
+	struct net_buf *buf;
+
+	/* Do not hold up the other subscribers waiting on a backed up link */
+	buf = bt_att_create_pdu_timeout(conn, BT_ATT_OP_NOTIFY, sizeof(*nfy) + params->len,
+					K_NO_WAIT);
+	if (!buf) {
+		NFY_STATS_INC(backpressure);
+		return -ENOMEM;
+	}
+
+	NFY_STATS_INC(pdus);
+	NFY_STATS_INC(shared);
+
+	LOG_DBG("conn %p handle 0x%04x shared %p", conn, handle, value);
+
+	nfy = net_buf_add(buf, sizeof(*nfy));
+	nfy->handle = sys_cpu_to_le16(handle);
+
+	net_buf_frag_add(buf, net_buf_ref(value));
+
+	bt_att_set_tx_meta_data(buf, params->func, params->user_data, BT_ATT_CHAN_OPT(params));
+	return bt_att_send(conn, buf);
+}
+#endif /* CONFIG_BT_GATT_NOTIFY_SHARED */
+
 #if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE)
 
-static struct net_buf *nfy_mult[CONFIG_BT_MAX_CONN];
+#define NFY_MULT_DEFAULT_FLAGS \
+	((IS_ENABLED(CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_FULL) ? \
+	  BT_GATT_NOTIFY_MULT_FLUSH_FULL : 0) | \
+	 (IS_ENABLED(CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_IDLE) ? \
+	  BT_GATT_NOTIFY_MULT_FLUSH_IDLE : 0))
+
+enum {
+	NFY_MULT_FULL,
+	NFY_MULT_BUDGET,
+	NFY_MULT_IDLE,
+	NFY_MULT_OTHER,
+};
+
+static struct nfy_mult {
+	/* Taken by the notifying threads, the flush work and the ATT sent
+	 * hook, never while sending or allocating
+	 */
+	struct k_spinlock lock;
+	/* PDU being filled, NULL if nothing is held back */
+	struct net_buf *buf;
+	/* Uptime of the oldest notification in `buf` */
+	uint32_t start;
+	uint16_t handles;
+	/* Latency budget expired or the link went idle */
+	struct k_work_delayable work;
+	bool idle;
+	struct bt_gatt_notify_mult_policy policy;
+} nfy_mult[CONFIG_BT_MAX_CONN];
+
+static struct bt_gatt_notify_mult_policy nfy_mult_policy = {
+	.latency_ms = CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_MS,
+	.flags = NFY_MULT_DEFAULT_FLAGS,
+};
 
 static int gatt_notify_mult_send(struct bt_conn *conn, struct net_buf *buf)
 {
@@ -2395,25 +2992,119 @@ static int gatt_notify_mult_send(struct bt_conn *conn, struct net_buf *buf)
 	return ret;
 }
 
+/* Detach the PDU held back, if any, to be sent once the lock is released */
+static struct net_buf *nfy_mult_take(struct nfy_mult *mult, int reason)
+{
+	struct net_buf *buf = mult->buf;
+
+	if (!buf) {
+		return NULL;
+	}
+
+	mult->buf = NULL;
+	mult->idle = false;
+	(void)k_work_cancel_delayable(&mult->work);
+
+#if defined(CONFIG_BT_GATT_NOTIFY_STATS)
+	uint32_t latency = k_uptime_get_32() - mult->start;
+
+	NFY_STATS_INC(mult_pdus);
+	NFY_STATS_ADD(mult_handles, mult->handles);
+	NFY_STATS_ADD(mult_latency_ms, latency);
+	nfy_stats.mult_latency_max_ms = MAX(nfy_stats.mult_latency_max_ms, latency);
+
+	switch (reason) {
+	case NFY_MULT_FULL:
+		NFY_STATS_INC(mult_full);
+		break;
+	case NFY_MULT_BUDGET:
+		NFY_STATS_INC(mult_budget);
+		break;
+	case NFY_MULT_IDLE:
+		NFY_STATS_INC(mult_idle);
+		break;
+	default:
+		break;
+	}
+#endif /* CONFIG_BT_GATT_NOTIFY_STATS */
+
+	LOG_DBG("%u handles reason %d", mult->handles, reason);
+
+	return buf;
+}
+
+/* Send the PDU held back for `conn`, if any */
+static int nfy_mult_flush(struct bt_conn *conn, int reason)
+{
+	struct nfy_mult *mult = &nfy_mult[bt_conn_index(conn)];
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&mult->lock);
+	buf = nfy_mult_take(mult, reason);
+	k_spin_unlock(&mult->lock, key);
+
+	if (!buf) {
+		return 0;
+	}
+
+	return gatt_notify_mult_send(conn, buf);
+}
+
 static void notify_mult_process(struct k_work *work)
 {
-	int i;
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct nfy_mult *mult = CONTAINER_OF(dwork, struct nfy_mult, work);
+	struct bt_conn *conn;
+	struct net_buf *buf;
+	k_spinlock_key_t key;
 
-	/* Send to any connection with an allocated buffer */
-	for (i = 0; i < ARRAY_SIZE(nfy_mult); i++) {
-		struct net_buf **buf = &nfy_mult[i];
+	conn = bt_conn_lookup_index(ARRAY_INDEX(nfy_mult, mult));
+	if (!conn) {
+		return;
+	}
 
-		if (*buf) {
-			struct bt_conn *conn = bt_conn_lookup_index(i);
+	key = k_spin_lock(&mult->lock);
+	buf = nfy_mult_take(mult, mult->idle ? NFY_MULT_IDLE : NFY_MULT_BUDGET);
+	k_spin_unlock(&mult->lock, key);
 
-			gatt_notify_mult_send(conn, *buf);
-			*buf = NULL;
-			bt_conn_unref(conn);
-		}
+	if (buf) {
+		(void)gatt_notify_mult_send(conn, buf);
 	}
+
+	bt_conn_unref(conn);
 }
 
-K_WORK_DELAYABLE_DEFINE(nfy_mult_work, notify_mult_process);
+static void notify_mult_init(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(nfy_mult); i++) {
+		k_work_init_delayable(&nfy_mult[i].work, notify_mult_process);
+		nfy_mult[i].policy = nfy_mult_policy;
+	}
+}
+
+/* Nothing of the connection is queued in the host or in the controller */
+static bool nfy_mult_link_idle(struct bt_conn *conn)
+{
+	return !atomic_get(&conn->in_ll) && bt_att_tx_idle(conn);
+}
+
+void bt_gatt_notify_mult_sent(struct bt_conn *conn)
+{
+	struct nfy_mult *mult = &nfy_mult[bt_conn_index(conn)];
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&mult->lock);
+
+	if (mult->buf && (mult->policy.flags & BT_GATT_NOTIFY_MULT_FLUSH_IDLE) &&
+	    nfy_mult_link_idle(conn)) {
+		/* Don't send from within the sent callback of the bearer */
+		mult->idle = true;
+		k_work_reschedule(&mult->work, K_NO_WAIT);
+	}
+
+	k_spin_unlock(&mult->lock, key);
+}
 
 static bool gatt_cf_notify_multi(struct bt_conn *conn)
 {
@@ -2429,24 +3120,28 @@ static bool gatt_cf_notify_multi(struct bt_conn *conn)
 
 static int gatt_notify_flush(struct bt_conn *conn)
 {
-	int err = 0;
-	struct net_buf **buf = &nfy_mult[bt_conn_index(conn)];
-
-	if (*buf) {
-		err = gatt_notify_mult_send(conn, *buf);
-		*buf = NULL;
-	}
-
-	return err;
+	return nfy_mult_flush(conn, NFY_MULT_OTHER);
 }
 
 static void cleanup_notify(struct bt_conn *conn)
 {
-	struct net_buf **buf = &nfy_mult[bt_conn_index(conn)];
+	struct nfy_mult *mult = &nfy_mult[bt_conn_index(conn)];
+	struct net_buf *buf;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&mult->lock);
+
+	(void)k_work_cancel_delayable(&mult->work);
+
+	buf = mult->buf;
+	mult->buf = NULL;
+	mult->idle = false;
+	mult->policy = nfy_mult_policy;
+
+	k_spin_unlock(&mult->lock, key);
 
-	if (*buf) {
-		net_buf_unref(*buf);
-		*buf = NULL;
+	if (buf) {
+		net_buf_unref(buf);
 	}
 }
 
@@ -2464,59 +3159,219 @@ static void gatt_add_nfy_to_buf(struct net_buf *buf,
 	(void)memcpy(nfy->value, params->data, params->len);
 }
 
-#if (CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_MS != 0)
+/* Room left in the PDU, bounded by the ATT MTU rather than the buffer size */
+static size_t nfy_mult_room(struct bt_conn *conn, struct net_buf *buf)
+{
+	uint16_t mtu = bt_att_get_mtu(conn);
+
+	if (buf->len >= mtu) {
+		return 0;
+	}
+
+	return MIN(net_buf_tailroom(buf), mtu - buf->len);
+}
+
 static int gatt_notify_mult(struct bt_conn *conn, uint16_t handle,
 			    struct bt_gatt_notify_params *params)
 {
-	struct net_buf **buf = &nfy_mult[bt_conn_index(conn)];
+	struct nfy_mult *mult = &nfy_mult[bt_conn_index(conn)];
+	size_t len = sizeof(struct bt_att_notify_mult) + params->len;
+	struct net_buf *flush = NULL;
+	struct net_buf *buf = NULL;
+	k_spinlock_key_t key;
+	int err;
 
-	/* Check if we can fit more data into it, in case it doesn't fit send
-	 * the existing buffer and proceed to create a new one
-	 */
-	if (*buf && ((net_buf_tailroom(*buf) < sizeof(struct bt_att_notify_mult) + params->len) ||
-	    !bt_att_tx_meta_data_match(*buf, params->func, params->user_data,
-				       BT_ATT_CHAN_OPT(params)))) {
-		int ret;
+	key = k_spin_lock(&mult->lock);
 
-		ret = gatt_notify_mult_send(conn, *buf);
-		*buf = NULL;
-		if (ret < 0) {
-			return ret;
+	for (;;) {
+		/* Check if we can fit more data into it, in case it doesn't fit
+		 * send the existing buffer and proceed to create a new one
+		 */
+		if (mult->buf && (nfy_mult_room(conn, mult->buf) < len ||
+		    !bt_att_tx_meta_data_match(mult->buf, params->func, params->user_data,
+					       BT_ATT_CHAN_OPT(params)))) {
+			flush = nfy_mult_take(mult, nfy_mult_room(conn, mult->buf) < len ?
+					      NFY_MULT_FULL : NFY_MULT_OTHER);
 		}
-	}
 
-	if (!*buf) {
-		*buf = bt_att_create_pdu(conn, BT_ATT_OP_NOTIFY_MULT,
-					 sizeof(struct bt_att_notify_mult) + params->len);
-		if (!*buf) {
-			return -ENOMEM;
+		if (!flush && (mult->buf || buf)) {
+			break;
+		}
+
+		/* Sending and allocating may block, release the lock and look
+		 * again at what other notifiers did meanwhile.
+		 */
+		k_spin_unlock(&mult->lock, key);
+
+		if (flush) {
+			err = gatt_notify_mult_send(conn, flush);
+			flush = NULL;
+
+			if (err < 0) {
+				if (buf) {
+					net_buf_unref(buf);
+				}
+
+				return err;
+			}
+		}
+
+		if (!buf) {
+			buf = bt_att_create_pdu(conn, BT_ATT_OP_NOTIFY_MULT, len);
+			if (!buf) {
+				return -ENOMEM;
+			}
+
+			bt_att_set_tx_meta_data(buf, params->func, params->user_data,
+						BT_ATT_CHAN_OPT(params));
 		}
 
-		bt_att_set_tx_meta_data(*buf, params->func, params->user_data,
-					BT_ATT_CHAN_OPT(params));
+		key = k_spin_lock(&mult->lock);
+	}
+
+	if (!mult->buf) {
+		mult->buf = buf;
+		buf = NULL;
+		NFY_STATS_INC(pdus);
+
+		mult->start = k_uptime_get_32();
+		mult->handles = 0;
 	} else {
 		/* Increment the number of handles, ensuring the notify callback
 		 * gets called once for every attribute.
 		 */
-		bt_att_increment_tx_meta_data_attr_count(*buf, 1);
+		bt_att_increment_tx_meta_data_attr_count(mult->buf, 1);
 	}
 
 	LOG_DBG("handle 0x%04x len %u", handle, params->len);
-	gatt_add_nfy_to_buf(*buf, handle, params);
+	gatt_add_nfy_to_buf(mult->buf, handle, params);
+	NFY_STATS_ADD(copied, params->len);
+	mult->handles++;
+
+	if ((mult->policy.flags & BT_GATT_NOTIFY_MULT_FLUSH_FULL) &&
+	    nfy_mult_room(conn, mult->buf) < len) {
+		/* Another value of the same size would not fit, don't wait for it */
+		flush = nfy_mult_take(mult, NFY_MULT_FULL);
+	} else if ((mult->policy.flags & BT_GATT_NOTIFY_MULT_FLUSH_IDLE) &&
+		   nfy_mult_link_idle(conn)) {
+		/* Nothing in flight: holding back only adds latency */
+		flush = nfy_mult_take(mult, NFY_MULT_IDLE);
+	} else {
+		/* Use `k_work_schedule` to keep the original deadline, instead
+		 * of re-setting the timeout whenever a new notification is
+		 * appended.
+		 */
+		k_work_schedule(&mult->work, K_MSEC(mult->policy.latency_ms));
+	}
 
-	/* Use `k_work_schedule` to keep the original deadline, instead of
-	 * re-setting the timeout whenever a new notification is appended.
-	 */
-	k_work_schedule(&nfy_mult_work,
-			K_MSEC(CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_MS));
+	k_spin_unlock(&mult->lock, key);
+
+	/* Another notifier set up the PDU first */
+	if (buf) {
+		net_buf_unref(buf);
+	}
+
+	if (flush) {
+		return gatt_notify_mult_send(conn, flush);
+	}
+
+	return 0;
+}
+
+/* Batch the notification when the peer supports Multiple Handle Value
+ * Notifications. While nothing is held back and the link is idle, a
+ * plain Handle Value Notification goes out right away instead.
+ */
+static bool nfy_mult_batch(struct bt_conn *conn)
+{
+	struct nfy_mult *mult = &nfy_mult[bt_conn_index(conn)];
+	k_spinlock_key_t key;
+	bool batch;
+
+	if (!gatt_cf_notify_multi(conn)) {
+		return false;
+	}
+
+	key = k_spin_lock(&mult->lock);
+	batch = mult->policy.latency_ms &&
+		(mult->buf || !(mult->policy.flags & BT_GATT_NOTIFY_MULT_FLUSH_IDLE) ||
+		 !nfy_mult_link_idle(conn));
+	k_spin_unlock(&mult->lock, key);
+
+	return batch;
+}
+
+static void nfy_mult_policy_apply(struct nfy_mult *mult,
+				  const struct bt_gatt_notify_mult_policy *policy)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&mult->lock);
+	mult->policy = *policy;
+	k_spin_unlock(&mult->lock, key);
+}
+
+int bt_gatt_notify_mult_policy_set(struct bt_conn *conn,
+				   const struct bt_gatt_notify_mult_policy *policy)
+{
+	CHECKIF(policy == NULL) {
+		return -EINVAL;
+	}
+
+	if (conn) {
+		if (conn->state != BT_CONN_CONNECTED) {
+			return -ENOTCONN;
+		}
+
+		nfy_mult_policy_apply(&nfy_mult[bt_conn_index(conn)], policy);
+
+		/* Don't hold back what the new policy would have sent */
+		return gatt_notify_flush(conn);
+	}
+
+	nfy_mult_policy = *policy;
+
+	for (size_t i = 0; i < ARRAY_SIZE(nfy_mult); i++) {
+		nfy_mult_policy_apply(&nfy_mult[i], policy);
+
+		conn = bt_conn_lookup_index(i);
+		if (conn) {
+			(void)gatt_notify_flush(conn);
+			bt_conn_unref(conn);
+		}
+	}
+
+	return 0;
+}
+
+int bt_gatt_notify_mult_policy_get(struct bt_conn *conn,
+				   struct bt_gatt_notify_mult_policy *policy)
+{
+	CHECKIF(policy == NULL) {
+		return -EINVAL;
+	}
+
+	if (conn) {
+		if (conn->state != BT_CONN_CONNECTED) {
+			return -ENOTCONN;
+		}
+
+		struct nfy_mult *mult = &nfy_mult[bt_conn_index(conn)];
+		k_spinlock_key_t key;
+
+		key = k_spin_lock(&mult->lock);
+		*policy = mult->policy;
+		k_spin_unlock(&mult->lock, key);
+	} else {
+		*policy = nfy_mult_policy;
+	}
 
 	return 0;
 }
-#endif /* CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_MS != 0 */
 #endif /* CONFIG_BT_GATT_NOTIFY_MULTIPLE */
 
 static int gatt_notify(struct bt_conn *conn, uint16_t handle,
-		       struct bt_gatt_notify_params *params)
+		       struct bt_gatt_notify_params *params, struct net_buf *shared)
 {
 	struct net_buf *buf;
 	struct bt_att_notify *nfy;
@@ -2556,12 +3411,18 @@ static int gatt_notify(struct bt_conn *conn, uint16_t handle,
 		return -EINVAL;
 	}
 
-#if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE) && (CONFIG_BT_GATT_NOTIFY_MULTIPLE_FLUSH_MS != 0)
-	if (gatt_cf_notify_multi(conn)) {
+#if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE)
+	if (nfy_mult_batch(conn)) {
 		return gatt_notify_mult(conn, handle, params);
 	}
 #endif /* CONFIG_BT_GATT_NOTIFY_MULTIPLE */
 
+#if defined(CONFIG_BT_GATT_NOTIFY_SHARED)
+	if (shared) {
+		return gatt_notify_shared(conn, handle, params, shared);
+	}
+#endif /* CONFIG_BT_GATT_NOTIFY_SHARED */
+
 	buf = bt_att_create_pdu(conn, BT_ATT_OP_NOTIFY,
 				sizeof(*nfy) + params->len);
 	if (!buf) {
@@ -2569,6 +3430,9 @@ static int gatt_notify(struct bt_conn *conn, uint16_t handle,
 		return -ENOMEM;
 	}
 
+	NFY_STATS_INC(pdus);
+	NFY_STATS_ADD(copied, params->len);
+
 	LOG_DBG("conn %p handle 0x%04x", conn, handle);
 
 	nfy = net_buf_add(buf, sizeof(*nfy));
@@ -2846,7 +3710,28 @@ static uint8_t notify_cb(const struct bt_gatt_attr *attr, uint16_t handle,
 			}
 		} else if ((data->type == BT_GATT_CCC_NOTIFY) &&
 			   (cfg->value & BT_GATT_CCC_NOTIFY)) {
-			err = gatt_notify(conn, data->handle, data->nfy_params);
+#if defined(CONFIG_BT_GATT_NOTIFY_SHARED)
+			struct bt_gatt_notify_params *params = data->nfy_params;
+
+			err = gatt_notify(conn, data->handle, params, nfy_shared_get(conn, data));
+
+			if (params->result) {
+				params->result(conn, err, params->user_data);
+			}
+
+			bt_conn_unref(conn);
+
+			/* Carry on with the other subscribers, succeed if
+			 * any of them got it.
+			 */
+			if (err == 0 || data->err != 0) {
+				data->err = err;
+			}
+
+			continue;
+#else
+			err = gatt_notify(conn, data->handle, data->nfy_params, NULL);
+#endif /* CONFIG_BT_GATT_NOTIFY_SHARED */
 		} else {
 			err = 0;
 		}
@@ -2944,16 +3829,29 @@ int bt_gatt_notify_cb(struct bt_conn *conn,
 	}
 
 	if (conn) {
-		return gatt_notify(conn, data.handle, params);
+		return gatt_notify(conn, data.handle, params, NULL);
 	}
 
 	data.err = -ENOTCONN;
 	data.type = BT_GATT_CCC_NOTIFY;
 	data.nfy_params = params;
 
+	NFY_STATS_INC(fanouts);
+
+#if defined(CONFIG_BT_GATT_NOTIFY_SHARED)
+	data.shared = nfy_shared_alloc(params);
+#endif /* CONFIG_BT_GATT_NOTIFY_SHARED */
+
 	bt_gatt_foreach_attr_type(data.handle, 0xffff, BT_UUID_GATT_CCC, NULL,
 				  1, notify_cb, &data);
 
+#if defined(CONFIG_BT_GATT_NOTIFY_SHARED)
+	/* The PDUs keep their own references */
+	if (data.shared) {
+		net_buf_unref(data.shared);
+	}
+#endif /* CONFIG_BT_GATT_NOTIFY_SHARED */
+
 	return data.err;
 }
 
@@ -8,6 +8,8 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <zephyr/bluetooth/gatt.h>
+
 #define BT_GATT_CENTRAL_ADDR_RES_NOT_SUPP	0
 #define BT_GATT_CENTRAL_ADDR_RES_SUPP		1
 
@@ -61,6 +63,62 @@ static inline void bt_gatt_mult_notification(struct bt_conn *conn,
 
 struct bt_gatt_attr;
 
+/* Iterate attributes of type `uuid` within the handle range through the UUID
+ * index. Returns -ENOTSUP without iterating if the index does not cover the
+ * whole database, callers then fall back to bt_gatt_foreach_attr().
+ */
+int bt_gatt_foreach_attr_uuid(uint16_t start_handle, uint16_t end_handle,
+			      const struct bt_uuid *uuid,
+			      bt_gatt_attr_func_t func, void *user_data);
+
+/* Handle of the last attribute of the service declared at `handle`, no
+ * further than `end_handle`. Only valid after bt_gatt_foreach_attr_uuid()
+ * succeeded.
+ */
+uint16_t bt_gatt_service_end_handle(uint16_t handle, uint16_t end_handle);
+
+struct bt_gatt_notify_stats {
+	/* bt_gatt_notify_cb() calls notifying all subscribers */
+	uint32_t fanouts;
+	/* Notification PDUs allocated */
+	uint32_t pdus;
+	/* Of which carrying a shared value */
+	uint32_t shared;
+	/* Shared value buffers allocated */
+	uint32_t values;
+	/* Value bytes copied into buffers */
+	uint32_t copied;
+	/* Subscribers skipped as their connection was backed up */
+	uint32_t backpressure;
+#if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE)
+	/* Batched PDUs sent and the handles they carried */
+	uint32_t mult_pdus;
+	uint32_t mult_handles;
+	/* Of which sent as the MTU was full, the latency budget expired or
+	 * the link was idle, the rest were flushed by the API
+	 */
+	uint32_t mult_full;
+	uint32_t mult_budget;
+	uint32_t mult_idle;
+	/* Time the oldest notification of a batch was held back, in ms */
+	uint32_t mult_latency_ms;
+	uint32_t mult_latency_max_ms;
+#endif /* CONFIG_BT_GATT_NOTIFY_MULTIPLE */
+};
+
+/* Requires CONFIG_BT_GATT_NOTIFY_STATS */
+void bt_gatt_notify_stats_get(struct bt_gatt_notify_stats *stats);
+void bt_gatt_notify_stats_reset(void);
+
+#if defined(CONFIG_BT_GATT_NOTIFY_MULTIPLE)
+/* An ATT bearer of `conn` finished sending a PDU */
+void bt_gatt_notify_mult_sent(struct bt_conn *conn);
+#else
+static inline void bt_gatt_notify_mult_sent(struct bt_conn *conn)
+{
+}
+#endif /* CONFIG_BT_GATT_NOTIFY_MULTIPLE */
+
 /* Check attribute permission */
 uint8_t bt_gatt_check_perm(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 			uint16_t mask);
@@ -4067,10 +4067,41 @@ static int hci_init(void)
 	return 0;
 }
 
+#if !DT_HAS_CHOSEN(zephyr_bt_hci)
+/* Old-style drivers send buf->data only, pull in a payload chained by the
+ * host (see CONFIG_BT_GATT_NOTIFY_SHARED). The headers were allocated for
+ * the whole PDU, so it fits.
+ */
+static int send_frags_pull(struct net_buf *buf)
+{
+	if (net_buf_frags_len(buf->frags) > net_buf_tailroom(buf)) {
+		LOG_ERR("Chained buf %p does not fit its head", buf);
+		return -EMSGSIZE;
+	}
+
+	while (buf->frags) {
+		net_buf_add_mem(buf, buf->frags->data, buf->frags->len);
+		net_buf_frag_del(buf, buf->frags);
+	}
+
+	return 0;
+}
+#endif /* !DT_HAS_CHOSEN(zephyr_bt_hci) */
+
 int bt_send(struct net_buf *buf)
 {
 	LOG_DBG("buf %p len %u type %u", buf, buf->len, bt_buf_get_type(buf));
 
+#if !DT_HAS_CHOSEN(zephyr_bt_hci)
+	if (buf->frags) {
+		int err = send_frags_pull(buf);
+
+		if (err) {
+			return err;
+		}
+	}
+#endif /* !DT_HAS_CHOSEN(zephyr_bt_hci) */
+
 	bt_monitor_send(bt_monitor_opcode(buf), buf->data, buf->len);
 
 	if (IS_ENABLED(CONFIG_BT_TINYCRYPT_ECC)) {
@@ -4130,10 +4161,185 @@ void hci_event_prio(struct net_buf *buf)
 	}
 }
 
-static void rx_queue_put(struct net_buf *buf)
+/* Buffers waiting for rx_work, kept per type so that a burst of one type
+ * (typically advertising reports) does not hold back the others. Each run of
+ * rx_work serves the types round robin, up to their weight in a row.
+ *
+ * Only buffers the host may handle in any order relative to the other types
+ * are put on the per-type queues: ACL data, ISO data and reports of
+ * connectionless traffic. Any other event can change the state the data is
+ * handled against (connection or CIS established, encryption change,
+ * disconnection), so it goes to the ordered queue, and so does everything
+ * received after it until it has been handled. The ordered queue is served
+ * in arrival order once the per-type queues, holding what was received
+ * before it, are empty.
+ */
+#if defined(CONFIG_BT_RECV_STATS)
+#define RX_STAMPS 32
+
+/* Arrival times of the oldest queued buffers of one type. Buffers that arrive
+ * while the ring is full are not timed, they are counted in unstamped and come
+ * out after the stamped ones.
+ */
+struct rx_stamps {
+	uint32_t cyc[RX_STAMPS];
+	uint8_t head;
+	uint8_t count;
+	uint16_t unstamped;
+};
+#endif /* CONFIG_BT_RECV_STATS */
+
+static const uint8_t rx_weight[BT_HCI_RX_NUM] = {
+	[BT_HCI_RX_ISO] = CONFIG_BT_RECV_WEIGHT_ISO,
+	[BT_HCI_RX_ACL] = CONFIG_BT_RECV_WEIGHT_ACL,
+	[BT_HCI_RX_EVT] = CONFIG_BT_RECV_WEIGHT_EVT,
+};
+
+static struct {
+	struct k_spinlock lock;
+	sys_slist_t q[BT_HCI_RX_NUM];
+	sys_slist_t ordered;
+	/* Queue being served and what is left of its weight */
+	uint8_t cur;
+	uint8_t credit;
+#if defined(CONFIG_BT_RECV_STATS)
+	struct bt_hci_rx_stats stats;
+	struct rx_stamps stamps[BT_HCI_RX_NUM];
+#endif /* CONFIG_BT_RECV_STATS */
+} rx = {
+	/* Start the first round with ISO */
+	.cur = BT_HCI_RX_NUM - 1,
+};
+
+static enum bt_hci_rx_type rx_buf_type(struct net_buf *buf)
+{
+	switch (bt_buf_get_type(buf)) {
+	case BT_BUF_ISO_IN:
+		return BT_HCI_RX_ISO;
+	case BT_BUF_ACL_IN:
+		return BT_HCI_RX_ACL;
+	default:
+		return BT_HCI_RX_EVT;
+	}
+}
+
+static bool rx_buf_is_ordered(struct net_buf *buf)
+{
+	struct bt_hci_evt_hdr *hdr;
+	struct bt_hci_evt_le_meta_event *meta;
+
+	if (bt_buf_get_type(buf) != BT_BUF_EVT) {
+		return false;
+	}
+
+	hdr = (void *)buf->data;
+
+	switch (hdr->evt) {
+	case BT_HCI_EVT_INQUIRY_RESULT_WITH_RSSI:
+	case BT_HCI_EVT_EXTENDED_INQUIRY_RESULT:
+		return false;
+	case BT_HCI_EVT_LE_META_EVENT:
+		if (buf->len < sizeof(*hdr) + sizeof(*meta)) {
+			return true;
+		}
+
+		meta = (void *)&buf->data[sizeof(*hdr)];
+
+		switch (meta->subevent) {
+		case BT_HCI_EVT_LE_ADVERTISING_REPORT:
+		case BT_HCI_EVT_LE_DIRECT_ADV_REPORT:
+		case BT_HCI_EVT_LE_EXT_ADVERTISING_REPORT:
+		case BT_HCI_EVT_LE_PER_ADVERTISING_REPORT:
+		case BT_HCI_EVT_LE_PER_ADVERTISING_REPORT_V2:
+		case BT_HCI_EVT_LE_CONNECTIONLESS_IQ_REPORT:
+		case BT_HCI_EVT_LE_BIGINFO_ADV_REPORT:
+			return false;
+		default:
+			return true;
+		}
+	default:
+		return true;
+	}
+}
+
+#if defined(CONFIG_BT_RECV_STATS)
+static void rx_stats_put(enum bt_hci_rx_type type)
+{
+	struct bt_hci_rx_queue_stats *qs = &rx.stats.queue[type];
+	struct rx_stamps *st = &rx.stamps[type];
+
+	qs->depth++;
+	qs->max_depth = MAX(qs->max_depth, qs->depth);
+
+	if (st->unstamped || st->count == RX_STAMPS) {
+		st->unstamped++;
+	} else {
+		st->cyc[(st->head + st->count) % RX_STAMPS] = k_cycle_get_32();
+		st->count++;
+	}
+}
+
+static void rx_stats_get(enum bt_hci_rx_type type)
+{
+	struct bt_hci_rx_queue_stats *qs = &rx.stats.queue[type];
+	struct rx_stamps *st = &rx.stamps[type];
+	uint32_t wait_us;
+
+	qs->depth--;
+	qs->pkts++;
+
+	if (!st->count) {
+		st->unstamped--;
+		return;
+	}
+
+	wait_us = k_cyc_to_us_floor32(k_cycle_get_32() - st->cyc[st->head]);
+	st->head = (st->head + 1) % RX_STAMPS;
+	st->count--;
+
+	qs->timed++;
+	qs->total_wait_us += wait_us;
+	qs->max_wait_us = MAX(qs->max_wait_us, wait_us);
+}
+
+int bt_hci_rx_stats_get(struct bt_hci_rx_stats *stats)
+{
+	k_spinlock_key_t key;
+
+	if (!stats) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&rx.lock);
+	*stats = rx.stats;
+	k_spin_unlock(&rx.lock, key);
+
+	return 0;
+}
+
+void bt_hci_rx_stats_reset(void)
 {
-	net_buf_slist_put(&bt_dev.rx_queue, buf);
+	k_spinlock_key_t key = k_spin_lock(&rx.lock);
+
+	/* Queue depths describe buffers still queued, keep them */
+	for (int i = 0; i < BT_HCI_RX_NUM; i++) {
+		uint16_t depth = rx.stats.queue[i].depth;
 
+		memset(&rx.stats.queue[i], 0, sizeof(rx.stats.queue[i]));
+		rx.stats.queue[i].depth = depth;
+		rx.stats.queue[i].max_depth = depth;
+	}
+
+	rx.stats.runs = 0;
+	k_spin_unlock(&rx.lock, key);
+}
+#else
+#define rx_stats_put(type)
+#define rx_stats_get(type)
+#endif /* CONFIG_BT_RECV_STATS */
+
+static void rx_work_submit(void)
+{
 #if defined(CONFIG_BT_RECV_WORKQ_SYS)
 	const int err = k_work_submit(&rx_work);
 #elif defined(CONFIG_BT_RECV_WORKQ_BT)
@@ -4144,6 +4350,67 @@ static void rx_queue_put(struct net_buf *buf)
 	}
 }
 
+static void rx_queue_put(struct net_buf *buf)
+{
+	enum bt_hci_rx_type type = rx_buf_type(buf);
+	k_spinlock_key_t key = k_spin_lock(&rx.lock);
+
+	if (!sys_slist_is_empty(&rx.ordered) || rx_buf_is_ordered(buf)) {
+		net_buf_slist_put(&rx.ordered, buf);
+	} else {
+		net_buf_slist_put(&rx.q[type], buf);
+	}
+
+	rx_stats_put(type);
+	k_spin_unlock(&rx.lock, key);
+
+	rx_work_submit();
+}
+
+static struct net_buf *rx_queue_get(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&rx.lock);
+	struct net_buf *buf = NULL;
+
+	/* Visit every queue once with a fresh weight, current one included */
+	for (int i = 0; i <= BT_HCI_RX_NUM; i++) {
+		if (rx.credit && !sys_slist_is_empty(&rx.q[rx.cur])) {
+			rx.credit--;
+			buf = net_buf_slist_get(&rx.q[rx.cur]);
+			break;
+		}
+
+		rx.cur = (rx.cur + 1) % BT_HCI_RX_NUM;
+		rx.credit = rx_weight[rx.cur];
+	}
+
+	if (!buf) {
+		buf = net_buf_slist_get(&rx.ordered);
+	}
+
+	if (buf) {
+		rx_stats_get(rx_buf_type(buf));
+	}
+
+	k_spin_unlock(&rx.lock, key);
+
+	return buf;
+}
+
+static bool rx_queue_is_empty(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&rx.lock);
+	bool empty = sys_slist_is_empty(&rx.ordered);
+
+	for (int i = 0; empty && i < BT_HCI_RX_NUM; i++) {
+		empty = sys_slist_is_empty(&rx.q[i]);
+	}
+
+	k_spin_unlock(&rx.lock, key);
+
+	return empty;
+}
+
 static int bt_recv_unsafe(struct net_buf *buf)
 {
 	bt_monitor_send(bt_monitor_opcode(buf), buf->data, buf->len);
@@ -4280,18 +4547,8 @@ static void init_work(struct k_work *work)
 	}
 }
 
-static void rx_work_handler(struct k_work *work)
+static void rx_dispatch(struct net_buf *buf)
 {
-	int err;
-
-	struct net_buf *buf;
-
-	LOG_DBG("Getting net_buf from queue");
-	buf = net_buf_slist_get(&bt_dev.rx_queue);
-	if (!buf) {
-		return;
-	}
-
 	LOG_DBG("buf %p type %u len %u", buf, bt_buf_get_type(buf), buf->len);
 
 	switch (bt_buf_get_type(buf)) {
@@ -4313,22 +4570,38 @@ static void rx_work_handler(struct k_work *work)
 		net_buf_unref(buf);
 		break;
 	}
+}
+
+static void rx_work_handler(struct k_work *work)
+{
+	struct net_buf *buf;
+
+	LOG_DBG("Getting net_buf from queue");
+
+#if defined(CONFIG_BT_RECV_STATS)
+	k_spinlock_key_t key = k_spin_lock(&rx.lock);
+
+	rx.stats.runs++;
+	k_spin_unlock(&rx.lock, key);
+#endif /* CONFIG_BT_RECV_STATS */
+
+	for (int i = 0; i < CONFIG_BT_RECV_BATCH; i++) {
+		buf = rx_queue_get();
+		if (!buf) {
+			return;
+		}
+
+		rx_dispatch(buf);
+	}
 
 	/* Schedule the work handler to be executed again if there are
-	 * additional items in the queue. This allows for other users of the
-	 * work queue to get a chance at running, which wouldn't be possible if
-	 * we used a while() loop with a k_yield() statement.
+	 * additional items in the queue. Handling at most a batch per run
+	 * allows for other users of the work queue to get a chance at
+	 * running, which wouldn't be possible if we drained the queues in a
+	 * while() loop.
 	 */
-	if (!sys_slist_is_empty(&bt_dev.rx_queue)) {
-
-#if defined(CONFIG_BT_RECV_WORKQ_SYS)
-		err = k_work_submit(&rx_work);
-#elif defined(CONFIG_BT_RECV_WORKQ_BT)
-		err = k_work_submit_to_queue(&bt_workq, &rx_work);
-#endif
-		if (err < 0) {
-			LOG_ERR("Could not submit rx_work: %d", err);
-		}
+	if (!rx_queue_is_empty()) {
+		rx_work_submit();
 	}
 }
 
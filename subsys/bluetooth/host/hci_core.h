@@ -397,9 +397,6 @@ struct bt_dev {
 	/* Last sent HCI command */
 	struct net_buf		*sent_cmd;
 
-	/* Queue for incoming HCI events & ACL data */
-	sys_slist_t rx_queue;
-
 	/* Queue for outgoing HCI commands */
 	struct k_fifo		cmd_tx_queue;
 
@@ -80,9 +80,102 @@ static bool key_is_in_use(uint8_t id)
 }
 #endif /* CONFIG_BT_KEYS_OVERWRITE_OLDEST */
 
+#if CONFIG_BT_KEYS_RPA_CACHE_SIZE > 0
+/* Outcome of recent RPA resolutions, so that a device seen again does not
+ * cost one AES operation per bonded IRK. Entries are replaced least recently
+ * used first. Every change to the bonded IRKs flushes the cache, and entries
+ * expire after the RPA timeout recommended by the specification, after which
+ * the peer will have moved on to a new RPA anyway.
+ */
+#define RPA_CACHE_NO_MATCH UINT8_MAX
+
+BUILD_ASSERT(CONFIG_BT_MAX_PAIRED < RPA_CACHE_NO_MATCH);
+
+struct rpa_cache_entry {
+	bt_addr_t rpa;
+	uint8_t id;
+	/* Index into key_pool, or RPA_CACHE_NO_MATCH */
+	uint8_t keys;
+	/* Last use, 0 for a free entry */
+	uint32_t used;
+	uint32_t added_ms;
+};
+
+static struct rpa_cache_entry rpa_cache[CONFIG_BT_KEYS_RPA_CACHE_SIZE];
+static uint32_t rpa_cache_clock;
+
+static void rpa_cache_flush(void)
+{
+	(void)memset(rpa_cache, 0, sizeof(rpa_cache));
+}
+
+static struct rpa_cache_entry *rpa_cache_find(uint8_t id, const bt_addr_t *rpa)
+{
+	for (int i = 0; i < ARRAY_SIZE(rpa_cache); i++) {
+		struct rpa_cache_entry *entry = &rpa_cache[i];
+
+		if (!entry->used || entry->id != id || !bt_addr_eq(&entry->rpa, rpa)) {
+			continue;
+		}
+
+		if (k_uptime_get_32() - entry->added_ms >=
+		    CONFIG_BT_KEYS_RPA_CACHE_TIMEOUT * MSEC_PER_SEC) {
+			entry->used = 0U;
+			return NULL;
+		}
+
+		entry->used = ++rpa_cache_clock;
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+static void rpa_cache_add(uint8_t id, const bt_addr_t *rpa, const struct bt_keys *keys)
+{
+	struct rpa_cache_entry *entry = &rpa_cache[0];
+
+	for (int i = 1; i < ARRAY_SIZE(rpa_cache) && entry->used; i++) {
+		if (rpa_cache[i].used < entry->used) {
+			entry = &rpa_cache[i];
+		}
+	}
+
+	bt_addr_copy(&entry->rpa, rpa);
+	entry->id = id;
+	entry->keys = keys ? keys - key_pool : RPA_CACHE_NO_MATCH;
+	entry->used = ++rpa_cache_clock;
+	entry->added_ms = k_uptime_get_32();
+}
+#else
+static inline void rpa_cache_flush(void)
+{
+}
+#endif /* CONFIG_BT_KEYS_RPA_CACHE_SIZE > 0 */
+
+#if defined(CONFIG_BT_KEYS_RPA_STATS)
+static struct bt_keys_rpa_stats rpa_stats;
+
+void bt_keys_rpa_stats_get(struct bt_keys_rpa_stats *stats)
+{
+	*stats = rpa_stats;
+}
+
+void bt_keys_rpa_stats_reset(void)
+{
+	(void)memset(&rpa_stats, 0, sizeof(rpa_stats));
+}
+
+#define RPA_STATS_INC(field) (rpa_stats.field++)
+#else
+#define RPA_STATS_INC(field)
+#endif /* CONFIG_BT_KEYS_RPA_STATS */
+
 void bt_keys_reset(void)
 {
 	memset(key_pool, 0, sizeof(key_pool));
+	rpa_cache_flush();
 }
 
 struct bt_keys *bt_keys_get_addr(uint8_t id, const bt_addr_le_t *addr)
@@ -216,6 +309,11 @@ struct bt_keys *bt_keys_get_type(enum bt_keys_type type, uint8_t id, const bt_ad
 
 	LOG_DBG("type %d %s", type, bt_addr_le_str(addr));
 
+	if (type & BT_KEYS_IRK) {
+		/* The caller is about to store a (new) IRK */
+		rpa_cache_flush();
+	}
+
 	keys = bt_keys_find(type, id, addr);
 	if (keys) {
 		return keys;
@@ -243,6 +341,8 @@ struct bt_keys *bt_keys_find_irk(uint8_t id, const bt_addr_le_t *addr)
 		return NULL;
 	}
 
+	RPA_STATS_INC(lookups);
+
 	for (i = 0; i < ARRAY_SIZE(key_pool); i++) {
 		if (!(key_pool[i].keys & BT_KEYS_IRK)) {
 			continue;
@@ -252,10 +352,28 @@ struct bt_keys *bt_keys_find_irk(uint8_t id, const bt_addr_le_t *addr)
 		    bt_addr_eq(&addr->a, &key_pool[i].irk.rpa)) {
 			LOG_DBG("cached RPA %s for %s", bt_addr_str(&key_pool[i].irk.rpa),
 				bt_addr_le_str(&key_pool[i].addr));
+			RPA_STATS_INC(cache_hits);
 			return &key_pool[i];
 		}
 	}
 
+#if CONFIG_BT_KEYS_RPA_CACHE_SIZE > 0
+	struct rpa_cache_entry *entry = rpa_cache_find(id, &addr->a);
+
+	if (entry) {
+		RPA_STATS_INC(cache_hits);
+
+		if (entry->keys == RPA_CACHE_NO_MATCH) {
+			LOG_DBG("No IRK for %s (cached)", bt_addr_le_str(addr));
+			return NULL;
+		}
+
+		bt_addr_copy(&key_pool[entry->keys].irk.rpa, &addr->a);
+
+		return &key_pool[entry->keys];
+	}
+#endif /* CONFIG_BT_KEYS_RPA_CACHE_SIZE > 0 */
+
 	for (i = 0; i < ARRAY_SIZE(key_pool); i++) {
 		if (!(key_pool[i].keys & BT_KEYS_IRK)) {
 			continue;
@@ -265,17 +383,25 @@ struct bt_keys *bt_keys_find_irk(uint8_t id, const bt_addr_le_t *addr)
 			continue;
 		}
 
+		RPA_STATS_INC(irk_checks);
+
 		if (bt_rpa_irk_matches(key_pool[i].irk.val, &addr->a)) {
 			LOG_DBG("RPA %s matches %s", bt_addr_str(&key_pool[i].irk.rpa),
 				bt_addr_le_str(&key_pool[i].addr));
 
 			bt_addr_copy(&key_pool[i].irk.rpa, &addr->a);
+#if CONFIG_BT_KEYS_RPA_CACHE_SIZE > 0
+			rpa_cache_add(id, &addr->a, &key_pool[i]);
+#endif
 
 			return &key_pool[i];
 		}
 	}
 
 	LOG_DBG("No IRK for %s", bt_addr_le_str(addr));
+#if CONFIG_BT_KEYS_RPA_CACHE_SIZE > 0
+	rpa_cache_add(id, &addr->a, NULL);
+#endif
 
 	return NULL;
 }
@@ -302,6 +428,11 @@ void bt_keys_add_type(struct bt_keys *keys, enum bt_keys_type type)
 {
 	__ASSERT_NO_MSG(keys != NULL);
 
+	if (type & BT_KEYS_IRK) {
+		/* RPAs that matched no IRK so far may match this one */
+		rpa_cache_flush();
+	}
+
 	keys->keys |= type;
 }
 
@@ -321,6 +452,7 @@ void bt_keys_clear(struct bt_keys *keys)
 	}
 
 	(void)memset(keys, 0, sizeof(*keys));
+	rpa_cache_flush();
 }
 
 #if defined(CONFIG_BT_SETTINGS)
@@ -391,6 +523,7 @@ static int keys_set(const char *name, size_t len_rd, settings_read_cb read_cb,
 		keys = bt_keys_find(BT_KEYS_ALL, id, &addr);
 		if (keys) {
 			(void)memset(keys, 0, sizeof(*keys));
+			rpa_cache_flush();
 			LOG_DBG("Cleared keys for %s", bt_addr_le_str(&addr));
 		} else {
 			LOG_WRN("Unable to find deleted keys for %s", bt_addr_le_str(&addr));
@@ -422,6 +555,8 @@ static int keys_set(const char *name, size_t len_rd, settings_read_cb read_cb,
 		memcpy(keys->storage_start, val, len);
 	}
 
+	rpa_cache_flush();
+
 	LOG_DBG("Successfully restored keys for %s", bt_addr_le_str(&addr));
 #if defined(CONFIG_BT_KEYS_OVERWRITE_OLDEST)
 	if (aging_counter_val < keys->aging_counter) {
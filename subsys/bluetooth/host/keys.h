@@ -162,6 +162,32 @@ struct bt_keys *bt_keys_find(enum bt_keys_type type, uint8_t id, const bt_addr_l
  */
 struct bt_keys *bt_keys_find_irk(uint8_t id, const bt_addr_le_t *addr);
 
+/** RPA resolution statistics */
+struct bt_keys_rpa_stats {
+	/** Number of RPAs looked up with bt_keys_find_irk() */
+	uint32_t lookups;
+	/** Lookups answered from the RPA cache, without any IRK check */
+	uint32_t cache_hits;
+	/** Number of IRKs checked against an RPA, one AES operation each */
+	uint32_t irk_checks;
+};
+
+/**
+ * @brief Get the RPA resolution statistics
+ *
+ * Requires CONFIG_BT_KEYS_RPA_STATS.
+ *
+ * @param stats Statistics.
+ */
+void bt_keys_rpa_stats_get(struct bt_keys_rpa_stats *stats);
+
+/**
+ * @brief Reset the RPA resolution statistics
+ *
+ * Requires CONFIG_BT_KEYS_RPA_STATS.
+ */
+void bt_keys_rpa_stats_reset(void);
+
 /**
  * @brief Find a key by ID and address
  *
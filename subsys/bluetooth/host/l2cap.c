@@ -32,6 +32,7 @@
 #include "conn_internal.h"
 #include "l2cap_internal.h"
 #include "keys.h"
+#include "tx_sched_internal.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(bt_l2cap, CONFIG_BT_L2CAP_LOG_LEVEL);
@@ -61,6 +62,73 @@ LOG_MODULE_REGISTER(bt_l2cap, CONFIG_BT_L2CAP_LOG_LEVEL);
 #define L2CAP_DISC_TIMEOUT	K_SECONDS(2)
 #define L2CAP_RTX_TIMEOUT	K_SECONDS(2)
 
+#if defined(CONFIG_BT_L2CAP_RX_STATS)
+static struct k_spinlock rx_stats_lock;
+static struct bt_l2cap_rx_stats rx_stats;
+
+void bt_l2cap_rx_copied(size_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&rx_stats_lock);
+
+	rx_stats.copied += len;
+	k_spin_unlock(&rx_stats_lock, key);
+}
+
+static void rx_stats_sdu(size_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&rx_stats_lock);
+
+	rx_stats.sdus++;
+	rx_stats.bytes += len;
+	k_spin_unlock(&rx_stats_lock, key);
+}
+
+int bt_l2cap_rx_stats_get(struct bt_l2cap_rx_stats *stats)
+{
+	k_spinlock_key_t key;
+
+	CHECKIF(stats == NULL) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&rx_stats_lock);
+	*stats = rx_stats;
+	k_spin_unlock(&rx_stats_lock, key);
+
+	return 0;
+}
+
+void bt_l2cap_rx_stats_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&rx_stats_lock);
+
+	memset(&rx_stats, 0, sizeof(rx_stats));
+	k_spin_unlock(&rx_stats_lock, key);
+}
+#else
+static inline void rx_stats_sdu(size_t len)
+{
+	ARG_UNUSED(len);
+}
+#endif /* CONFIG_BT_L2CAP_RX_STATS */
+
+int bt_l2cap_rx_linearize(struct net_buf *buf)
+{
+	if (net_buf_frags_len(buf->frags) > net_buf_tailroom(buf)) {
+		return -EMSGSIZE;
+	}
+
+	while (buf->frags) {
+		struct net_buf *frag = buf->frags;
+
+		net_buf_add_mem(buf, frag->data, frag->len);
+		bt_l2cap_rx_copied(frag->len);
+		net_buf_frag_del(buf, frag);
+	}
+
+	return 0;
+}
+
 #if defined(CONFIG_BT_L2CAP_DYNAMIC_CHANNEL)
 /* Dedicated pool for disconnect buffers so they are guaranteed to be send
  * even in case of data congestion due to flooding.
@@ -308,11 +376,22 @@ static void l2cap_rtx_timeout(struct k_work *work)
 static void l2cap_chan_le_recv(struct bt_l2cap_le_chan *chan,
 			       struct net_buf *buf);
 
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+static void l2cap_chan_rx_post_process(struct bt_l2cap_le_chan *chan);
+#endif /* CONFIG_BT_L2CAP_RX_POST */
+
 static void l2cap_rx_process(struct k_work *work)
 {
 	struct bt_l2cap_le_chan *ch = CHAN_RX(work);
 	struct net_buf *buf;
 
+	IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, (
+		if (ch->chan.ops->rx_done) {
+			l2cap_chan_rx_post_process(ch);
+			return;
+		}
+	))
+
 	while ((buf = k_fifo_get(&ch->rx_queue, K_NO_WAIT))) {
 		LOG_DBG("ch %p buf %p", ch, buf);
 		l2cap_chan_le_recv(ch, buf);
@@ -332,6 +411,236 @@ void bt_l2cap_chan_add(struct bt_conn *conn, struct bt_l2cap_chan *chan,
 	LOG_DBG("conn %p chan %p", conn, chan);
 }
 
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+/* Protects the posted buffers, which the application adds to while the
+ * channel's RX work consumes them.
+ */
+static struct k_spinlock rx_post_lock;
+
+/* Credits the posted buffers can take whatever the remote sends. The rest of
+ * an SDU under way fills them back to back, so it is granted the K-frames of
+ * the MPS it still needs. Past its end every K-frame is counted as a full MPS
+ * ending an SDU, which loses the rest of the buffer it ends in. Smaller
+ * K-frames, or ones that do not end an SDU, only leave more room for the next.
+ */
+static uint16_t l2cap_chan_rx_post_credits_max(struct bt_l2cap_le_chan *chan)
+{
+	size_t sdu_left = chan->_sdu_len - chan->_sdu_len_done;
+	struct bt_l2cap_rx_buf *rx_buf;
+	k_spinlock_key_t key;
+	uint32_t credits = 0;
+	size_t need = chan->rx.mps;
+	size_t sdu_room = 0;
+
+	key = k_spin_lock(&rx_post_lock);
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&chan->_rx_bufs, rx_buf, node) {
+		size_t room = rx_buf->size - rx_buf->len;
+
+		if (sdu_left) {
+			if (room < sdu_left) {
+				sdu_room += room;
+				sdu_left -= room;
+				continue;
+			}
+
+			/* The SDU ends in this buffer, however it is cut */
+			credits += DIV_ROUND_UP(sdu_room + sdu_left, chan->rx.mps);
+			sdu_left = 0;
+			continue;
+		}
+
+		if (room < need) {
+			/* The K-frame continues in the next buffer */
+			need -= room;
+			continue;
+		}
+
+		credits++;
+		need = chan->rx.mps;
+	}
+
+	/* The buffers run out before the SDU ends */
+	if (sdu_left) {
+		credits += sdu_room / chan->rx.mps;
+	}
+
+	k_spin_unlock(&rx_post_lock, key);
+
+	return MIN(credits, UINT16_MAX);
+}
+
+/* Let the channel's RX work give the credits of the buffers posted before it
+ * was connected.
+ */
+static void l2cap_chan_rx_post_connected(struct bt_l2cap_le_chan *chan)
+{
+	if (chan->chan.ops->rx_done) {
+		k_work_submit(&chan->rx_work);
+	}
+}
+
+/* Drop the held K-frame and forget the posted buffers, which go back to the
+ * application with the channel.
+ */
+static void l2cap_chan_rx_post_clear(struct bt_l2cap_le_chan *chan)
+{
+	k_spinlock_key_t key;
+
+	if (chan->_rx_held) {
+		net_buf_unref(chan->_rx_held);
+		chan->_rx_held = NULL;
+	}
+
+	key = k_spin_lock(&rx_post_lock);
+	sys_slist_init(&chan->_rx_bufs);
+	k_spin_unlock(&rx_post_lock, key);
+}
+#endif /* CONFIG_BT_L2CAP_RX_POST */
+
+#if defined(CONFIG_BT_L2CAP_CREDIT_TUNING)
+/* Shortest window the drain rate is measured over */
+#define CREDIT_TUNE_WINDOW_MIN_MS 10U
+
+/* Protects the tuning state of the channels, the ACL RX buffers their credits
+ * commit and the statistics.
+ */
+static struct k_spinlock credit_tune_lock;
+static uint32_t credit_tune_bufs;
+static struct bt_l2cap_credit_stats credit_stats;
+
+int bt_l2cap_credit_stats_get(struct bt_l2cap_credit_stats *stats)
+{
+	k_spinlock_key_t key;
+
+	CHECKIF(stats == NULL) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&credit_tune_lock);
+	*stats = credit_stats;
+	stats->bufs = credit_tune_bufs;
+	k_spin_unlock(&credit_tune_lock, key);
+
+	return 0;
+}
+
+void bt_l2cap_credit_stats_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&credit_tune_lock);
+
+	memset(&credit_stats, 0, sizeof(credit_stats));
+	k_spin_unlock(&credit_tune_lock, key);
+}
+
+/* Commit ACL RX buffers to credits, with the tuning lock held */
+static void credit_tune_commit(uint32_t bufs)
+{
+	credit_tune_bufs += bufs;
+	credit_stats.bufs_max = MAX(credit_stats.bufs_max, credit_tune_bufs);
+}
+
+/* Channels that hold a K-frame, and its ACL buffers, per credit until their
+ * recv callback has consumed it.
+ */
+static bool l2cap_chan_credit_tuned(struct bt_l2cap_le_chan *chan)
+{
+	return chan->chan.ops->recv && !chan->chan.ops->alloc_buf;
+}
+
+/* ACL RX buffers a K-frame of the channel can take. With fragment chains
+ * every controller fragment is a buffer of its own, and fragments are only
+ * known to be as long as the RX data length of the connection, at least 27
+ * bytes. Before the channel is added to a connection the minimum is assumed.
+ */
+static uint16_t l2cap_chan_credit_cost(struct bt_l2cap_le_chan *chan)
+{
+	uint16_t frag_len = BT_GAP_DATA_LEN_DEFAULT;
+
+	if (!IS_ENABLED(CONFIG_BT_CONN_RX_FRAG_CHAIN)) {
+		return 1;
+	}
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+	if (chan->chan.conn) {
+		frag_len = MAX(chan->chan.conn->le.data_len.rx_max_len, BT_GAP_DATA_LEN_DEFAULT);
+	}
+#endif /* CONFIG_BT_USER_DATA_LEN_UPDATE */
+
+	frag_len = MIN(frag_len, CONFIG_BT_BUF_ACL_RX_SIZE);
+
+	return DIV_ROUND_UP(BT_L2CAP_HDR_SIZE + chan->rx.mps, frag_len);
+}
+
+/* Follow the cost of the channel's K-frames, with the tuning lock held. When
+ * the data length shrinks the credits already given commit the buffers at the
+ * new cost, a lower cost waits until they are all consumed.
+ */
+static uint16_t l2cap_chan_credit_cost_update(struct bt_l2cap_le_chan *chan)
+{
+	uint16_t cost = l2cap_chan_credit_cost(chan);
+
+	if (cost > chan->_rx_cost || !chan->_rx_committed) {
+		credit_tune_bufs -= chan->_rx_committed * chan->_rx_cost;
+		credit_tune_commit(chan->_rx_committed * cost);
+		chan->_rx_cost = cost;
+	}
+
+	return chan->_rx_cost;
+}
+
+/* Credits the channel can be given before the remotes could fill the ACL RX
+ * buffers outside the reserve, with the tuning lock held.
+ */
+static uint16_t l2cap_chan_credit_room(struct bt_l2cap_le_chan *chan)
+{
+	uint32_t used = credit_tune_bufs + CONFIG_BT_L2CAP_CREDIT_TUNING_RX_RESERVE;
+
+	if (used >= CONFIG_BT_BUF_ACL_RX_COUNT) {
+		return 0;
+	}
+
+	return MIN((CONFIG_BT_BUF_ACL_RX_COUNT - used) / chan->_rx_cost, UINT16_MAX);
+}
+
+/* Give back the ACL RX buffers committed to the channel */
+static void l2cap_chan_credit_tune_release(struct bt_l2cap_le_chan *chan)
+{
+	k_spinlock_key_t key = k_spin_lock(&credit_tune_lock);
+
+	credit_tune_bufs -= chan->_rx_committed * chan->_rx_cost;
+	chan->_rx_committed = 0;
+	k_spin_unlock(&credit_tune_lock, key);
+}
+
+static void l2cap_chan_credit_tune_init(struct bt_l2cap_le_chan *chan)
+{
+	k_spinlock_key_t key;
+	uint16_t credits;
+
+	l2cap_chan_credit_tune_release(chan);
+
+	key = k_spin_lock(&credit_tune_lock);
+
+	/* Nothing is committed, the cost is set anew */
+	(void)l2cap_chan_credit_cost_update(chan);
+
+	/* The remote cannot send anything without a credit */
+	credits = CLAMP(l2cap_chan_credit_room(chan), 1, CONFIG_BT_L2CAP_CREDIT_TUNING_INIT);
+
+	chan->_rx_committed = credits;
+	chan->_rx_target = credits;
+	chan->_rx_drained = 0;
+	chan->_rx_drain_start = k_uptime_get_32();
+	chan->_rx_drain_rate = 0;
+	credit_tune_commit(credits * chan->_rx_cost);
+
+	k_spin_unlock(&credit_tune_lock, key);
+
+	atomic_set(&chan->rx.credits, credits);
+}
+#endif /* CONFIG_BT_L2CAP_CREDIT_TUNING */
+
 static void init_le_chan_private(struct bt_l2cap_le_chan *le_chan)
 {
 	/* Initialize private members of the struct. We can't "just memset" as
@@ -340,9 +649,16 @@ static void init_le_chan_private(struct bt_l2cap_le_chan *le_chan)
 #if defined(CONFIG_BT_L2CAP_DYNAMIC_CHANNEL)
 	le_chan->_sdu = NULL;
 	le_chan->_sdu_len = 0;
-#if defined(CONFIG_BT_L2CAP_SEG_RECV)
+#if defined(CONFIG_BT_L2CAP_SEG_RECV) || defined(CONFIG_BT_L2CAP_RX_POST)
 	le_chan->_sdu_len_done = 0;
-#endif /* CONFIG_BT_L2CAP_SEG_RECV */
+#endif /* CONFIG_BT_L2CAP_SEG_RECV || CONFIG_BT_L2CAP_RX_POST */
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+	/* Posted buffers are kept, they may be posted before connecting */
+	le_chan->_rx_held = NULL;
+#endif /* CONFIG_BT_L2CAP_RX_POST */
+#if defined(CONFIG_BT_L2CAP_CREDIT_TUNING)
+	le_chan->_rx_committed = 0;
+#endif /* CONFIG_BT_L2CAP_CREDIT_TUNING */
 #endif /* CONFIG_BT_L2CAP_DYNAMIC_CHANNEL */
 	memset(&le_chan->_pdu_ready, 0, sizeof(le_chan->_pdu_ready));
 	le_chan->_pdu_ready_lock = 0;
@@ -680,6 +996,9 @@ struct net_buf *bt_l2cap_create_pdu_timeout(struct net_buf_pool *pool,
 static void raise_data_ready(struct bt_l2cap_le_chan *le_chan)
 {
 	if (!atomic_set(&le_chan->_pdu_ready_lock, 1)) {
+#if defined(CONFIG_BT_TX_SCHED)
+		bt_tx_sched_ready(&le_chan->_tx_sched);
+#endif
 		sys_slist_append(&le_chan->chan.conn->l2cap_data_ready,
 				 &le_chan->_pdu_ready);
 		LOG_DBG("data ready raised %p", le_chan);
@@ -732,6 +1051,15 @@ int bt_l2cap_send_pdu(struct bt_l2cap_le_chan *le_chan, struct net_buf *pdu,
 		return -EINVAL;
 	}
 
+	/* A chained payload is sent along with the PDU in a single ACL
+	 * packet, the chain is shared and never written to.
+	 */
+	if (pdu->frags &&
+	    BT_L2CAP_HDR_SIZE + net_buf_frags_len(pdu) > bt_dev.le.acl_mtu) {
+		LOG_ERR("Chained PDU does not fit an ACL packet");
+		return -EMSGSIZE;
+	}
+
 	if (pdu->user_data_size < sizeof(struct closure)) {
 		LOG_DBG("not enough room in user_data %d < %d pool %u",
 			pdu->user_data_size,
@@ -799,7 +1127,7 @@ static void chan_take_credit(struct bt_l2cap_le_chan *lechan)
 #endif
 }
 
-static struct bt_l2cap_le_chan *get_ready_chan(struct bt_conn *conn)
+static struct bt_l2cap_le_chan *get_first_ready_chan(struct bt_conn *conn)
 {
 	struct bt_l2cap_le_chan *lechan;
 
@@ -825,6 +1153,38 @@ static struct bt_l2cap_le_chan *get_ready_chan(struct bt_conn *conn)
 	return NULL;
 }
 
+static struct bt_l2cap_le_chan *get_ready_chan(struct bt_conn *conn)
+{
+#if defined(CONFIG_BT_TX_SCHED)
+	struct bt_l2cap_le_chan *lechan;
+
+	while ((lechan = get_first_ready_chan(conn)) != NULL) {
+		sys_snode_t *node;
+
+		/* The fragments of a PDU go out back to back */
+		if (lechan->_pdu_remaining != 0) {
+			return lechan;
+		}
+
+		node = bt_tx_sched_pick(&conn->l2cap_data_ready,
+					BT_TX_SCHED_OFFSET(struct bt_l2cap_le_chan, _pdu_ready,
+							   _tx_sched));
+		lechan = CONTAINER_OF(node, struct bt_l2cap_le_chan, _pdu_ready);
+		if (chan_has_data(lechan)) {
+			return lechan;
+		}
+
+		/* Now at the head, so it can be dropped like the others */
+		LOG_DBG("chan %p has no data", lechan);
+		lower_data_ready(lechan);
+	}
+
+	return NULL;
+#else
+	return get_first_ready_chan(conn);
+#endif /* CONFIG_BT_TX_SCHED */
+}
+
 static void l2cap_chan_sdu_sent(struct bt_conn *conn, void *user_data, int err)
 {
 	struct bt_l2cap_chan *chan;
@@ -854,8 +1214,10 @@ static uint16_t get_pdu_len(struct bt_l2cap_le_chan *lechan,
 			    struct net_buf *buf)
 {
 	if (!L2CAP_LE_CID_IS_DYN(lechan->tx.cid)) {
-		/* No segmentation shenanigans on static channels */
-		return buf->len;
+		/* No segmentation shenanigans on static channels, the PDU
+		 * may have a chained payload, see bt_l2cap_send_pdu().
+		 */
+		return net_buf_frags_len(buf);
 	}
 
 	return MIN(buf->len, lechan->tx.mps);
@@ -949,6 +1311,10 @@ struct net_buf *l2cap_data_pull(struct bt_conn *conn,
 
 		lechan->_pdu_remaining = pdu_len + sizeof(*hdr);
 		chan_take_credit(lechan);
+
+#if defined(CONFIG_BT_TX_SCHED)
+		bt_tx_sched_served(&lechan->_tx_sched, pdu_len);
+#endif
 	}
 
 	/* Whether the data to be pulled is the last ACL fragment */
@@ -958,7 +1324,7 @@ struct net_buf *l2cap_data_pull(struct bt_conn *conn,
 	 * static channels, this variable will always be true, even though
 	 * static channels don't have the concept of L2CAP segments.
 	 */
-	bool last_seg = lechan->_pdu_remaining == pdu->len;
+	bool last_seg = lechan->_pdu_remaining == net_buf_frags_len(pdu);
 
 	if (last_frag && last_seg) {
 		LOG_DBG("last frag of last seg, dequeuing %p", pdu);
@@ -984,9 +1350,8 @@ struct net_buf *l2cap_data_pull(struct bt_conn *conn,
 		 * fair scheduling of channels on an ACL link: the channel is
 		 * marked as "ready to send" by adding a reference to it on a
 		 * FIFO on `conn`. Adding it again will send it to the back of
-		 * the queue.
-		 *
-		 * TODO: add a user-controlled QoS function.
+		 * the queue. With CONFIG_BT_TX_SCHED the scheduler picks the
+		 * next channel instead, see `get_ready_chan()`.
 		 */
 		LOG_DBG("chan %p done", lechan);
 		lower_data_ready(lechan);
@@ -1204,6 +1569,30 @@ static void l2cap_chan_seg_recv_rx_init(struct bt_l2cap_le_chan *chan)
 }
 #endif /* CONFIG_BT_L2CAP_SEG_RECV */
 
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+static void l2cap_chan_rx_post_init(struct bt_l2cap_le_chan *chan)
+{
+	if (!chan->rx.mtu) {
+		chan->rx.mtu = BT_L2CAP_SDU_RX_MTU;
+	}
+
+	if (!chan->rx.mps) {
+		chan->rx.mps = MIN(chan->rx.mtu + BT_L2CAP_SDU_HDR_SIZE, BT_L2CAP_RX_MTU);
+	}
+
+	/* Without fragment chains a K-frame has to fit one stack buffer */
+	if (!IS_ENABLED(CONFIG_BT_CONN_RX_FRAG_CHAIN) && chan->rx.mps > BT_L2CAP_RX_MTU) {
+		LOG_ERR("Limiting RX MPS by stack buffer size.");
+		chan->rx.mps = BT_L2CAP_RX_MTU;
+	}
+
+	chan->_sdu_len = 0;
+	chan->_sdu_len_done = 0;
+
+	atomic_set(&chan->rx.credits, l2cap_chan_rx_post_credits_max(chan));
+}
+#endif /* CONFIG_BT_L2CAP_RX_POST */
+
 static void l2cap_chan_rx_init(struct bt_l2cap_le_chan *chan)
 {
 	LOG_DBG("chan %p", chan);
@@ -1216,6 +1605,13 @@ static void l2cap_chan_rx_init(struct bt_l2cap_le_chan *chan)
 		}
 	}))
 
+	IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, ({
+		if (chan->chan.ops->rx_done) {
+			l2cap_chan_rx_post_init(chan);
+			return;
+		}
+	}))
+
 	/* Use existing MTU if defined */
 	if (!chan->rx.mtu) {
 		/* If application has not provide the incoming L2CAP SDU MTU use
@@ -1239,6 +1635,13 @@ static void l2cap_chan_rx_init(struct bt_l2cap_le_chan *chan)
 		chan->rx.mtu = chan->rx.mps - BT_L2CAP_SDU_HDR_SIZE;
 	}
 
+	IF_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING, ({
+		if (l2cap_chan_credit_tuned(chan)) {
+			l2cap_chan_credit_tune_init(chan);
+			return;
+		}
+	}))
+
 	atomic_set(&chan->rx.credits, 1);
 }
 
@@ -1318,6 +1721,20 @@ static void l2cap_chan_destroy(struct bt_l2cap_chan *chan)
 		le_chan->_sdu = NULL;
 		le_chan->_sdu_len = 0U;
 	}
+
+	IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, (l2cap_chan_rx_post_clear(le_chan);))
+	IF_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING, (l2cap_chan_credit_tune_release(le_chan);))
+}
+
+/* Number of receive callbacks set, channels need exactly one */
+static int l2cap_chan_rx_callbacks(const struct bt_l2cap_chan_ops *ops)
+{
+	int count = ops->recv ? 1 : 0;
+
+	IF_ENABLED(CONFIG_BT_L2CAP_SEG_RECV, (count += ops->seg_recv ? 1 : 0;))
+	IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, (count += ops->rx_done ? 1 : 0;))
+
+	return count;
 }
 
 static uint16_t le_err_to_result(int err)
@@ -1367,17 +1784,10 @@ static uint16_t l2cap_chan_accept(struct bt_conn *conn,
 		return le_err_to_result(err);
 	}
 
-#if defined(CONFIG_BT_L2CAP_SEG_RECV)
-	if (!(*chan)->ops->recv == !(*chan)->ops->seg_recv) {
-		LOG_ERR("Exactly one of 'recv' or 'seg_recv' must be set");
+	if (l2cap_chan_rx_callbacks((*chan)->ops) != 1) {
+		LOG_ERR("Exactly one of 'recv', 'seg_recv' or 'rx_done' must be set");
 		return BT_L2CAP_LE_ERR_UNACCEPT_PARAMS;
 	}
-#else
-	if (!(*chan)->ops->recv) {
-		LOG_ERR("Mandatory callback 'recv' missing");
-		return BT_L2CAP_LE_ERR_UNACCEPT_PARAMS;
-	}
-#endif
 
 	le_chan = BT_L2CAP_LE_CHAN(*chan);
 
@@ -2000,6 +2410,7 @@ static void le_ecred_conn_rsp(struct bt_l2cap *l2cap, uint8_t ident,
 
 			/* Give credits */
 			l2cap_chan_tx_give_credits(chan, credits);
+			IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, (l2cap_chan_rx_post_connected(chan);))
 
 			succeeded++;
 		}
@@ -2075,6 +2486,7 @@ static void le_conn_rsp(struct bt_l2cap *l2cap, uint8_t ident,
 
 		/* Give credits */
 		l2cap_chan_tx_give_credits(chan, credits);
+		IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, (l2cap_chan_rx_post_connected(chan);))
 
 		break;
 	case BT_L2CAP_LE_ERR_AUTHENTICATION:
@@ -2267,6 +2679,9 @@ static void l2cap_chan_shutdown(struct bt_l2cap_chan *chan)
 		le_chan->_sdu_len = 0U;
 	}
 
+	IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, (l2cap_chan_rx_post_clear(le_chan);))
+	IF_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING, (l2cap_chan_credit_tune_release(le_chan);))
+
 	/* Remove buffers on the TX queue */
 	while ((buf = k_fifo_get(&le_chan->tx_queue, K_NO_WAIT))) {
 		l2cap_tx_buf_destroy(chan->conn, buf, -ESHUTDOWN);
@@ -2314,7 +2729,8 @@ static void l2cap_chan_send_credits(struct bt_l2cap_le_chan *chan,
 	LOG_DBG("chan %p credits %lu", chan, atomic_get(&chan->rx.credits));
 }
 
-#if defined(CONFIG_BT_L2CAP_SEG_RECV)
+#if defined(CONFIG_BT_L2CAP_SEG_RECV) || defined(CONFIG_BT_L2CAP_RX_POST) || \
+	defined(CONFIG_BT_L2CAP_CREDIT_TUNING)
 static int l2cap_chan_send_credits_pdu(struct bt_conn *conn, uint16_t cid, uint16_t credits)
 {
 	struct net_buf *buf;
@@ -2333,7 +2749,114 @@ static int l2cap_chan_send_credits_pdu(struct bt_conn *conn, uint16_t cid, uint1
 
 	return l2cap_send_sig(conn, buf);
 }
+#endif /* CONFIG_BT_L2CAP_SEG_RECV || CONFIG_BT_L2CAP_RX_POST || CONFIG_BT_L2CAP_CREDIT_TUNING */
 
+#if defined(CONFIG_BT_L2CAP_CREDIT_TUNING)
+/* Account for a consumed K-frame and top up the remote's credits. The target
+ * is what the channel drains while a grant reaches the remote and its data
+ * comes back, about two connection intervals. While the remote runs dry the
+ * measured rate is bounded by the credits, so the target doubles instead.
+ * Grants wait until the remote is down to half of the target, so that they
+ * go out in few PDUs, and never commit ACL RX buffers outside the reserve.
+ */
+static void l2cap_chan_credit_tune(struct bt_l2cap_le_chan *chan)
+{
+	uint32_t interval_us = BT_CONN_INTERVAL_TO_US(chan->chan.conn->le.interval);
+	uint32_t now = k_uptime_get_32();
+	uint32_t window = now - chan->_rx_drain_start;
+	k_spinlock_key_t key;
+	uint16_t credits;
+	uint16_t grant;
+	uint32_t target;
+	uint16_t cost;
+	int err;
+
+	key = k_spin_lock(&credit_tune_lock);
+
+	if (chan->_rx_committed) {
+		chan->_rx_committed--;
+		credit_tune_bufs -= chan->_rx_cost;
+	}
+
+	cost = l2cap_chan_credit_cost_update(chan);
+
+	/* Drain rate over windows of a few connection intervals */
+	chan->_rx_drained++;
+
+	if (window >= MAX(4U * interval_us / USEC_PER_MSEC, CREDIT_TUNE_WINDOW_MIN_MS)) {
+		uint32_t rate = chan->_rx_drained * MSEC_PER_SEC / window;
+
+		chan->_rx_drain_rate = chan->_rx_drain_rate ?
+				       (3U * chan->_rx_drain_rate + rate) / 4U : rate;
+		chan->_rx_drained = 0;
+		chan->_rx_drain_start = now;
+		credit_stats.rate_max = MAX(credit_stats.rate_max, chan->_rx_drain_rate);
+	}
+
+	credits = atomic_get(&chan->rx.credits);
+	if (credits > chan->_rx_target / 2U) {
+		k_spin_unlock(&credit_tune_lock, key);
+		return;
+	}
+
+	target = DIV_ROUND_UP((uint64_t)chan->_rx_drain_rate * 2U * interval_us, USEC_PER_SEC) + 1U;
+
+	if (!credits) {
+		target = MAX(2U * chan->_rx_target, target);
+		credit_stats.starved++;
+	}
+
+	chan->_rx_target = CLAMP(target, 1U, CONFIG_BT_L2CAP_CREDIT_TUNING_MAX);
+	credit_stats.target_max = MAX(credit_stats.target_max, chan->_rx_target);
+
+	grant = chan->_rx_target > credits ? chan->_rx_target - credits : 0U;
+	if (grant > l2cap_chan_credit_room(chan)) {
+		grant = l2cap_chan_credit_room(chan);
+		credit_stats.pool_limited++;
+	}
+
+	/* Never leave the remote without credits, as the host without tuning */
+	if (!credits && !grant) {
+		grant = 1U;
+	}
+
+	if (!grant) {
+		k_spin_unlock(&credit_tune_lock, key);
+		return;
+	}
+
+	chan->_rx_committed += grant;
+	credit_tune_commit(grant * cost);
+	credit_stats.pdus++;
+	credit_stats.credits += grant;
+	atomic_add(&chan->rx.credits, grant);
+
+	k_spin_unlock(&credit_tune_lock, key);
+
+	LOG_DBG("chan %p credits %u target %u", chan, credits + grant, chan->_rx_target);
+
+	err = l2cap_chan_send_credits_pdu(chan->chan.conn, chan->rx.cid, grant);
+	if (err) {
+		LOG_ERR("Unable to send credits update (err %d)", err);
+		l2cap_chan_shutdown(&chan->chan);
+	}
+}
+#endif /* CONFIG_BT_L2CAP_CREDIT_TUNING */
+
+/* Give back the credit of a K-frame the channel has consumed */
+static void l2cap_chan_rx_consumed(struct bt_l2cap_le_chan *chan)
+{
+	IF_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING, ({
+		if (l2cap_chan_credit_tuned(chan)) {
+			l2cap_chan_credit_tune(chan);
+			return;
+		}
+	}))
+
+	l2cap_chan_send_credits(chan, 1);
+}
+
+#if defined(CONFIG_BT_L2CAP_SEG_RECV)
 /**
  * Combination of @ref atomic_add and @ref u16_add_overflow. Leaves @p
  * target unchanged if an overflow would occur. Assumes the current
@@ -2417,7 +2940,7 @@ int bt_l2cap_chan_recv_complete(struct bt_l2cap_chan *chan, struct net_buf *buf)
 	LOG_DBG("chan %p buf %p", chan, buf);
 
 	if (bt_l2cap_chan_get_state(&le_chan->chan) == BT_L2CAP_CONNECTED) {
-		l2cap_chan_send_credits(le_chan, 1);
+		l2cap_chan_rx_consumed(le_chan);
 	}
 
 	return 0;
@@ -2448,6 +2971,8 @@ static void l2cap_chan_le_recv_sdu(struct bt_l2cap_le_chan *chan,
 	__ASSERT_NO_MSG(bt_l2cap_chan_get_state(&chan->chan) == BT_L2CAP_CONNECTED);
 	__ASSERT_NO_MSG(atomic_get(&chan->rx.credits) == 0);
 
+	rx_stats_sdu(buf->len);
+
 	/* Receiving complete SDU, notify channel and reset SDU buf */
 	err = chan->chan.ops->recv(&chan->chan, buf);
 	if (err < 0) {
@@ -2467,6 +2992,7 @@ static void l2cap_chan_le_recv_sdu(struct bt_l2cap_le_chan *chan,
 static void l2cap_chan_le_recv_seg(struct bt_l2cap_le_chan *chan,
 				   struct net_buf *buf)
 {
+	size_t pdu_len = net_buf_frags_len(buf);
 	uint16_t len;
 	uint16_t seg = 0U;
 
@@ -2475,7 +3001,7 @@ static void l2cap_chan_le_recv_seg(struct bt_l2cap_le_chan *chan,
 		memcpy(&seg, net_buf_user_data(chan->_sdu), sizeof(seg));
 	}
 
-	if (len + buf->len > chan->_sdu_len) {
+	if (len + pdu_len > chan->_sdu_len) {
 		LOG_ERR("SDU length mismatch");
 		bt_l2cap_chan_disconnect(&chan->chan);
 		return;
@@ -2485,15 +3011,20 @@ static void l2cap_chan_le_recv_seg(struct bt_l2cap_le_chan *chan,
 	/* Store received segments in user_data */
 	memcpy(net_buf_user_data(chan->_sdu), &seg, sizeof(seg));
 
-	LOG_DBG("chan %p seg %d len %zu", chan, seg, buf->len);
+	LOG_DBG("chan %p seg %d len %zu", chan, seg, pdu_len);
 
-	/* Append received segment to SDU */
-	len = net_buf_append_bytes(chan->_sdu, buf->len, buf->data, K_NO_WAIT,
-				   l2cap_alloc_frag, chan);
-	if (len != buf->len) {
-		LOG_ERR("Unable to store SDU");
-		bt_l2cap_chan_disconnect(&chan->chan);
-		return;
+	/* Append received segment to SDU, straight from the ACL fragments
+	 * if the PDU is still a chain.
+	 */
+	for (struct net_buf *frag = buf; frag; frag = frag->frags) {
+		len = net_buf_append_bytes(chan->_sdu, frag->len, frag->data, K_NO_WAIT,
+					   l2cap_alloc_frag, chan);
+		bt_l2cap_rx_copied(len);
+		if (len != frag->len) {
+			LOG_ERR("Unable to store SDU");
+			bt_l2cap_chan_disconnect(&chan->chan);
+			return;
+		}
 	}
 
 	if (chan->_sdu->len < chan->_sdu_len) {
@@ -2559,11 +3090,205 @@ static void l2cap_chan_le_recv_seg_direct(struct bt_l2cap_le_chan *chan, struct
 	/* Commit receive. */
 	chan->_sdu_len_done += seg->len;
 
+	if (chan->_sdu_len_done == chan->_sdu_len) {
+		rx_stats_sdu(chan->_sdu_len);
+	}
+
 	/* Tail call. */
 	chan->chan.ops->seg_recv(&chan->chan, chan->_sdu_len, seg_offset, &seg->b);
 }
 #endif /* CONFIG_BT_L2CAP_SEG_RECV */
 
+static bool l2cap_chan_rx_post_mode(struct bt_l2cap_le_chan *chan)
+{
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+	return chan->chan.ops->rx_done != NULL;
+#else
+	return false;
+#endif /* CONFIG_BT_L2CAP_RX_POST */
+}
+
+#if defined(CONFIG_BT_L2CAP_RX_POST)
+/* Move @p len bytes from the front of the K-frame @p buf to @p dst */
+static void l2cap_rx_post_pull(struct net_buf *buf, uint8_t *dst, size_t len)
+{
+	for (struct net_buf *frag = buf; len; frag = frag->frags) {
+		size_t frag_len = MIN(len, frag->len);
+
+		memcpy(dst, net_buf_pull_mem(frag, frag_len), frag_len);
+		dst += frag_len;
+		len -= frag_len;
+	}
+}
+
+/* Write the rest of the K-frame @p buf to the posted buffers, handing them
+ * back as they fill up or the SDU ends. Returns false if it ran out of
+ * buffers, what is left of the K-frame then waits for more.
+ */
+static bool l2cap_chan_rx_post_place(struct bt_l2cap_le_chan *chan, struct net_buf *buf)
+{
+	size_t remaining = net_buf_frags_len(buf);
+
+	/* Loop at least once, an empty SDU still takes a buffer */
+	do {
+		struct bt_l2cap_rx_buf *rx_buf;
+		k_spinlock_key_t key;
+		size_t len;
+		bool sdu_end;
+
+		key = k_spin_lock(&rx_post_lock);
+		rx_buf = SYS_SLIST_PEEK_HEAD_CONTAINER(&chan->_rx_bufs, rx_buf, node);
+		k_spin_unlock(&rx_post_lock, key);
+
+		if (!rx_buf) {
+			return false;
+		}
+
+		/* Only this work removes buffers, the head stays valid */
+		len = MIN(remaining, rx_buf->size - rx_buf->len);
+		l2cap_rx_post_pull(buf, &rx_buf->data[rx_buf->len], len);
+		bt_l2cap_rx_copied(len);
+
+		rx_buf->len += len;
+		chan->_sdu_len_done += len;
+		remaining -= len;
+
+		sdu_end = chan->_sdu_len_done == chan->_sdu_len;
+
+		if (rx_buf->len < rx_buf->size && !sdu_end) {
+			continue;
+		}
+
+		/* The space left after the end of the SDU is lost with it */
+		key = k_spin_lock(&rx_post_lock);
+		(void)sys_slist_get(&chan->_rx_bufs);
+		k_spin_unlock(&rx_post_lock, key);
+
+		if (sdu_end) {
+			rx_stats_sdu(chan->_sdu_len);
+		}
+
+		chan->chan.ops->rx_done(&chan->chan, rx_buf, sdu_end);
+	} while (remaining);
+
+	return true;
+}
+
+static void l2cap_chan_le_recv_post(struct bt_l2cap_le_chan *chan, struct net_buf *buf)
+{
+	if (chan->_sdu_len_done == chan->_sdu_len) {
+		/* This is the first PDU in a SDU. */
+		if (buf->len < BT_L2CAP_SDU_HDR_SIZE) {
+			LOG_WRN("Missing SDU header");
+			bt_l2cap_chan_disconnect(&chan->chan);
+			return;
+		}
+
+		chan->_sdu_len = net_buf_pull_le16(buf);
+		chan->_sdu_len_done = 0;
+
+		if (chan->_sdu_len > chan->rx.mtu) {
+			LOG_WRN("SDU exceeds MTU");
+			bt_l2cap_chan_disconnect(&chan->chan);
+			return;
+		}
+	}
+
+	if (net_buf_frags_len(buf) > chan->_sdu_len - chan->_sdu_len_done) {
+		LOG_WRN("L2CAP RX PDU total exceeds SDU");
+		bt_l2cap_chan_disconnect(&chan->chan);
+		return;
+	}
+
+	if (!l2cap_chan_rx_post_place(chan, buf)) {
+		LOG_DBG("chan %p waiting for buffers", chan);
+		chan->_rx_held = net_buf_ref(buf);
+	}
+}
+
+/* Give the remote the credits the posted buffers allow. Grants wait until the
+ * remote is down to half of them, so that they go out in few PDUs, and while
+ * a K-frame is held the buffers are taken by what is left of it.
+ */
+static void l2cap_chan_rx_post_credits(struct bt_l2cap_le_chan *chan)
+{
+	uint16_t credits_max;
+	uint16_t credits;
+	int err;
+
+	if (chan->_rx_held || bt_l2cap_chan_get_state(&chan->chan) != BT_L2CAP_CONNECTED) {
+		return;
+	}
+
+	credits_max = l2cap_chan_rx_post_credits_max(chan);
+	credits = atomic_get(&chan->rx.credits);
+
+	if (credits >= credits_max || credits > credits_max / 2) {
+		return;
+	}
+
+	/* Credits are only used up by this work, no grant can race it */
+	atomic_add(&chan->rx.credits, credits_max - credits);
+
+	err = l2cap_chan_send_credits_pdu(chan->chan.conn, chan->rx.cid, credits_max - credits);
+	if (err) {
+		LOG_ERR("Unable to send credits update (err %d)", err);
+		l2cap_chan_shutdown(&chan->chan);
+	}
+}
+
+static void l2cap_chan_rx_post_process(struct bt_l2cap_le_chan *chan)
+{
+	struct net_buf *buf = chan->_rx_held;
+
+	if (buf) {
+		if (!l2cap_chan_rx_post_place(chan, buf)) {
+			return;
+		}
+
+		chan->_rx_held = NULL;
+		net_buf_unref(buf);
+	}
+
+	while (!chan->_rx_held && (buf = k_fifo_get(&chan->rx_queue, K_NO_WAIT))) {
+		LOG_DBG("ch %p buf %p", chan, buf);
+		l2cap_chan_le_recv(chan, buf);
+		net_buf_unref(buf);
+	}
+
+	l2cap_chan_rx_post_credits(chan);
+}
+
+int bt_l2cap_chan_rx_post(struct bt_l2cap_chan *chan, struct bt_l2cap_rx_buf *buf)
+{
+	struct bt_l2cap_le_chan *le_chan = BT_L2CAP_LE_CHAN(chan);
+	k_spinlock_key_t key;
+
+	if (!chan || !chan->ops || !chan->ops->rx_done) {
+		LOG_ERR("%s: Available only with rx_done.", __func__);
+		return -EINVAL;
+	}
+
+	if (!buf || !buf->data || !buf->size) {
+		LOG_ERR("%s: Refusing empty buffer.", __func__);
+		return -EINVAL;
+	}
+
+	buf->len = 0;
+
+	key = k_spin_lock(&rx_post_lock);
+	sys_slist_append(&le_chan->_rx_bufs, &buf->node);
+	k_spin_unlock(&rx_post_lock, key);
+
+	/* Place the held K-frame and top up the remote's credits */
+	if (bt_l2cap_chan_get_state(chan) == BT_L2CAP_CONNECTED) {
+		k_work_submit(&le_chan->rx_work);
+	}
+
+	return 0;
+}
+#endif /* CONFIG_BT_L2CAP_RX_POST */
+
 static void l2cap_chan_le_recv(struct bt_l2cap_le_chan *chan,
 			       struct net_buf *buf)
 {
@@ -2577,15 +3302,28 @@ static void l2cap_chan_le_recv(struct bt_l2cap_le_chan *chan,
 		return;
 	}
 
-	if (buf->len > chan->rx.mps) {
-		LOG_WRN("PDU size > MPS (%u > %u)", buf->len, chan->rx.mps);
+	if (net_buf_frags_len(buf) > chan->rx.mps) {
+		LOG_WRN("PDU size > MPS (%zu > %u)", net_buf_frags_len(buf), chan->rx.mps);
 		bt_l2cap_chan_disconnect(&chan->chan);
 		return;
 	}
 
+	IF_ENABLED(CONFIG_BT_L2CAP_RX_POST, (
+		if (chan->chan.ops->rx_done) {
+			l2cap_chan_le_recv_post(chan, buf);
+			return;
+		}
+	))
+
 	/* Redirect to experimental API. */
 	IF_ENABLED(CONFIG_BT_L2CAP_SEG_RECV, (
 		if (chan->chan.ops->seg_recv) {
+			/* Segments are handed over as a single buffer, the MPS
+			 * is limited so that they always fit one.
+			 */
+			err = bt_l2cap_rx_linearize(buf);
+			__ASSERT_NO_MSG(err == 0);
+
 			l2cap_chan_le_recv_seg_direct(chan, buf);
 			return;
 		}
@@ -2603,9 +3341,10 @@ static void l2cap_chan_le_recv(struct bt_l2cap_le_chan *chan,
 		return;
 	}
 
+	/* The SDU length is always in the first fragment */
 	sdu_len = net_buf_pull_le16(buf);
 
-	LOG_DBG("chan %p len %u sdu_len %u", chan, buf->len, sdu_len);
+	LOG_DBG("chan %p len %zu sdu_len %u", chan, net_buf_frags_len(buf), sdu_len);
 
 	if (sdu_len > chan->rx.mtu) {
 		LOG_ERR("Invalid SDU length");
@@ -2625,14 +3364,14 @@ static void l2cap_chan_le_recv(struct bt_l2cap_le_chan *chan,
 
 		/* Send sdu_len/mps worth of credits */
 		uint16_t credits = DIV_ROUND_UP(
-			MIN(sdu_len - buf->len, net_buf_tailroom(chan->_sdu)),
+			MIN(sdu_len - net_buf_frags_len(buf), net_buf_tailroom(chan->_sdu)),
 			chan->rx.mps);
 
 		if (credits) {
-			LOG_DBG("sending %d extra credits (sdu_len %d buf_len %d mps %d)",
+			LOG_DBG("sending %d extra credits (sdu_len %d buf_len %zu mps %d)",
 				credits,
 				sdu_len,
-				buf->len,
+				net_buf_frags_len(buf),
 				chan->rx.mps);
 			l2cap_chan_send_credits(chan, credits);
 		}
@@ -2641,6 +3380,8 @@ static void l2cap_chan_le_recv(struct bt_l2cap_le_chan *chan,
 		return;
 	}
 
+	rx_stats_sdu(net_buf_frags_len(buf));
+
 	owned_ref = net_buf_ref(buf);
 	err = chan->chan.ops->recv(&chan->chan, owned_ref);
 	if (err != -EINPROGRESS) {
@@ -2660,7 +3401,7 @@ static void l2cap_chan_le_recv(struct bt_l2cap_le_chan *chan,
 	 * in the recv() callback above
 	 */
 	if (bt_l2cap_chan_get_state(&chan->chan) == BT_L2CAP_CONNECTED) {
-		l2cap_chan_send_credits(chan, 1);
+		l2cap_chan_rx_consumed(chan);
 	}
 }
 
@@ -2679,7 +3420,8 @@ static void l2cap_chan_recv_queue(struct bt_l2cap_le_chan *chan,
 		return;
 	}
 
-	if (!L2CAP_LE_PSM_IS_DYN(chan->psm)) {
+	/* Posted buffers are only ever consumed from the RX work */
+	if (!L2CAP_LE_PSM_IS_DYN(chan->psm) && !l2cap_chan_rx_post_mode(chan)) {
 		l2cap_chan_le_recv(chan, buf);
 		net_buf_unref(buf);
 		return;
@@ -2711,8 +3453,16 @@ static void l2cap_chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf,
 	}
 #endif /* CONFIG_BT_L2CAP_DYNAMIC_CHANNEL */
 
+	if (buf->frags && bt_l2cap_rx_linearize(buf)) {
+		LOG_ERR("Not enough buffer space for L2CAP data");
+		net_buf_unref(buf);
+		return;
+	}
+
 	LOG_DBG("chan %p len %u", chan, buf->len);
 
+	rx_stats_sdu(buf->len);
+
 	chan->ops->recv(chan, buf);
 	net_buf_unref(buf);
 }
@@ -2725,6 +3475,12 @@ void bt_l2cap_recv(struct bt_conn *conn, struct net_buf *buf, bool complete)
 
 	if (IS_ENABLED(CONFIG_BT_CLASSIC) &&
 	    conn->type == BT_CONN_TYPE_BR) {
+		if (buf->frags && bt_l2cap_rx_linearize(buf)) {
+			LOG_ERR("Not enough buffer space for L2CAP data");
+			net_buf_unref(buf);
+			return;
+		}
+
 		bt_l2cap_br_recv(conn, buf);
 		return;
 	}
@@ -2840,12 +3596,16 @@ static int l2cap_le_connect(struct bt_conn *conn, struct bt_l2cap_le_chan *ch,
 	}
 
 	l2cap_chan_tx_init(ch);
-	l2cap_chan_rx_init(ch);
 
 	if (!l2cap_chan_add(conn, &ch->chan, l2cap_chan_destroy)) {
 		return -ENOMEM;
 	}
 
+	/* Once added, so that the credits are costed for the connection and
+	 * not reset by the add
+	 */
+	l2cap_chan_rx_init(ch);
+
 	ch->psm = psm;
 
 	if (conn->sec_level < ch->required_sec_level) {
@@ -2883,12 +3643,16 @@ static int l2cap_ecred_init(struct bt_conn *conn,
 	}
 
 	l2cap_chan_tx_init(ch);
-	l2cap_chan_rx_init(ch);
 
 	if (!l2cap_chan_add(conn, &ch->chan, l2cap_chan_destroy)) {
 		return -ENOMEM;
 	}
 
+	/* Once added, so that the credits are costed for the connection and
+	 * not reset by the add
+	 */
+	l2cap_chan_rx_init(ch);
+
 	ch->psm = psm;
 
 	LOG_DBG("ch %p psm 0x%02x mtu %u mps %u credits 1", ch, ch->psm, ch->rx.mtu, ch->rx.mps);
@@ -2929,6 +3693,8 @@ fail:
 		}
 
 		bt_l2cap_chan_remove(conn, chan[i]);
+		IF_ENABLED(CONFIG_BT_L2CAP_CREDIT_TUNING,
+			   (l2cap_chan_credit_tune_release(BT_L2CAP_LE_CHAN(chan[i]));))
 	}
 
 	return err;
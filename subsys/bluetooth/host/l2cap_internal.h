@@ -220,6 +220,21 @@ int bt_l2cap_send_pdu(struct bt_l2cap_le_chan *le_chan, struct net_buf *pdu,
 /* Receive a new L2CAP PDU from a connection */
 void bt_l2cap_recv(struct bt_conn *conn, struct net_buf *buf, bool complete);
 
+/* Copy the fragments of a received frame into the tailroom of its first
+ * buffer. Returns -EMSGSIZE, leaving the chain as is, if they do not fit.
+ */
+int bt_l2cap_rx_linearize(struct net_buf *buf);
+
+#if defined(CONFIG_BT_L2CAP_RX_STATS)
+/* Account for `len` received bytes copied by the host */
+void bt_l2cap_rx_copied(size_t len);
+#else
+static inline void bt_l2cap_rx_copied(size_t len)
+{
+	ARG_UNUSED(len);
+}
+#endif /* CONFIG_BT_L2CAP_RX_STATS */
+
 /* Perform connection parameter update request */
 int bt_l2cap_update_conn_param(struct bt_conn *conn,
 			       const struct bt_le_conn_param *param);
@@ -587,6 +587,190 @@ failed:
 }
 #endif /* CONFIG_BT_CENTRAL */
 
+#if defined(CONFIG_BT_SCAN_STATS)
+static struct bt_le_scan_stats scan_stats;
+
+int bt_le_scan_stats_get(struct bt_le_scan_stats *stats)
+{
+	CHECKIF(stats == NULL) {
+		return -EINVAL;
+	}
+
+	*stats = scan_stats;
+
+	return 0;
+}
+
+void bt_le_scan_stats_reset(void)
+{
+	(void)memset(&scan_stats, 0, sizeof(scan_stats));
+}
+
+#define SCAN_STATS_INC(field) (scan_stats.field++)
+#else
+#define SCAN_STATS_INC(field)
+#endif /* CONFIG_BT_SCAN_STATS */
+
+#if defined(CONFIG_BT_SCAN_DUP_FILTER)
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_BT_SCAN_DUP_FILTER_SIZE),
+	     "CONFIG_BT_SCAN_DUP_FILTER_SIZE must be a power of two");
+
+/* Number of slots a report may occupy, starting at the one it hashes to */
+#define DUP_FILTER_PROBES 8
+
+#define DUP_ENTRY_USED     BIT(0)
+#define DUP_ENTRY_SCAN_RSP BIT(1)
+
+#define FNV1A_BASIS 2166136261U
+#define FNV1A_PRIME 16777619U
+
+/* Recently delivered reports, an open addressed hash set without deletion:
+ * lookups visit all the probes of a report, and inserts replace a free
+ * entry or else the one delivered longest ago.
+ */
+struct dup_filter_entry {
+	bt_addr_le_t addr;
+	uint8_t sid;
+	uint8_t flags;
+	/* Strongest RSSI of the duplicates dropped since the last delivery */
+	int8_t rssi;
+	uint32_t data_hash;
+	uint32_t delivered_ms;
+};
+
+static struct dup_filter_entry dup_filter[CONFIG_BT_SCAN_DUP_FILTER_SIZE];
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		hash = (hash ^ *p++) * FNV1A_PRIME;
+	}
+
+	return hash;
+}
+
+/* Set by bt_le_scan_start(), the table itself is only touched by the RX
+ * context, which empties it before the next lookup.
+ */
+static atomic_t dup_filter_stale;
+
+static void dup_filter_reset(void)
+{
+	atomic_set(&dup_filter_stale, 1);
+}
+
+static int8_t rssi_max(int8_t a, int8_t b)
+{
+	if (a == BT_GAP_RSSI_INVALID) {
+		return b;
+	}
+
+	if (b == BT_GAP_RSSI_INVALID) {
+		return a;
+	}
+
+	return MAX(a, b);
+}
+
+/* Returns true if the report duplicates one delivered within the window.
+ * Otherwise records it, and hands it the strongest RSSI of the duplicates
+ * dropped since the last delivery.
+ */
+static bool dup_filter_check(const bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
+			     const uint8_t *data, uint16_t len)
+{
+	uint8_t flags = DUP_ENTRY_USED;
+	struct dup_filter_entry *victim = NULL;
+	uint32_t now = k_uptime_get_32();
+	uint32_t data_hash;
+	uint32_t hash;
+
+	if (atomic_cas(&dup_filter_stale, 1, 0)) {
+		(void)memset(dup_filter, 0, sizeof(dup_filter));
+	}
+
+	if (info->adv_props & BT_GAP_ADV_PROP_SCAN_RESPONSE) {
+		flags |= DUP_ENTRY_SCAN_RSP;
+	}
+
+	data_hash = fnv1a(FNV1A_BASIS, data, len);
+	hash = fnv1a(data_hash, addr, sizeof(*addr));
+	hash = fnv1a(hash, &info->sid, sizeof(info->sid));
+	hash = fnv1a(hash, &flags, sizeof(flags));
+
+	for (int i = 0; i < DUP_FILTER_PROBES; i++) {
+		struct dup_filter_entry *entry =
+			&dup_filter[(hash + i) & (CONFIG_BT_SCAN_DUP_FILTER_SIZE - 1)];
+
+		if (!(entry->flags & DUP_ENTRY_USED)) {
+			if (!victim || (victim->flags & DUP_ENTRY_USED)) {
+				victim = entry;
+			}
+
+			continue;
+		}
+
+		if (entry->flags == flags && entry->sid == info->sid &&
+		    entry->data_hash == data_hash && bt_addr_le_eq(&entry->addr, addr)) {
+			if (now - entry->delivered_ms < CONFIG_BT_SCAN_DUP_FILTER_WINDOW) {
+				entry->rssi = rssi_max(entry->rssi, info->rssi);
+				return true;
+			}
+
+			info->rssi = rssi_max(entry->rssi, info->rssi);
+			entry->rssi = BT_GAP_RSSI_INVALID;
+			entry->delivered_ms = now;
+
+			return false;
+		}
+
+		if (!victim || ((victim->flags & DUP_ENTRY_USED) &&
+				now - entry->delivered_ms > now - victim->delivered_ms)) {
+			victim = entry;
+		}
+	}
+
+	bt_addr_le_copy(&victim->addr, addr);
+	victim->sid = info->sid;
+	victim->flags = flags;
+	victim->rssi = BT_GAP_RSSI_INVALID;
+	victim->data_hash = data_hash;
+	victim->delivered_ms = now;
+
+	return false;
+}
+#endif /* CONFIG_BT_SCAN_DUP_FILTER */
+
+/* Listeners whose accept callback is kept from the first pass over them */
+#define SCAN_ACCEPT_MAX 8
+
+static bool listener_accepts(const struct bt_le_scan_cb *listener,
+			     const struct bt_le_scan_recv_info *info,
+			     struct net_buf_simple *buf, uint16_t len)
+{
+	struct net_buf_simple_state state;
+	bool accept;
+
+	if (!listener->recv) {
+		return false;
+	}
+
+	if (!listener->accept) {
+		return true;
+	}
+
+	net_buf_simple_save(buf, &state);
+
+	buf->len = len;
+	accept = listener->accept(info, buf);
+
+	net_buf_simple_restore(buf, &state);
+
+	return accept;
+}
+
 /* Convert Legacy adv report evt_type field to adv props */
 static uint8_t get_adv_props_legacy(uint8_t evt_type)
 {
@@ -621,9 +805,13 @@ static uint8_t get_adv_props_legacy(uint8_t evt_type)
 static void le_adv_recv(bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
 			struct net_buf_simple *buf, uint16_t len)
 {
+	const struct bt_le_scan_cb *checked[SCAN_ACCEPT_MAX];
 	struct bt_le_scan_cb *listener, *next;
 	struct net_buf_simple_state state;
+	bool interested = false;
+	uint8_t accepted = 0U;
 	bt_addr_le_t id_addr;
+	int num_checked = 0;
 
 	LOG_DBG("%s event %u, len %u, rssi %d dBm", bt_addr_le_str(addr), info->adv_type, len,
 		info->rssi);
@@ -635,6 +823,49 @@ static void le_adv_recv(bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
 		return;
 	}
 
+	SCAN_STATS_INC(received);
+
+#if defined(CONFIG_BT_SCAN_DUP_FILTER)
+	if ((scan_state.explicit_scan_param.options & BT_LE_SCAN_OPT_FILTER_DUPLICATE) &&
+	    dup_filter_check(addr, info, buf->data, len)) {
+		SCAN_STATS_INC(duplicates);
+		goto skip;
+	}
+#endif /* CONFIG_BT_SCAN_DUP_FILTER */
+
+	/* Ask the listeners before resolving the address */
+	info->addr = addr;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&scan_cbs, listener, node) {
+		if (num_checked == SCAN_ACCEPT_MAX) {
+			/* The rest is asked while delivering */
+			interested = true;
+			break;
+		}
+
+		if (listener_accepts(listener, info, buf, len)) {
+			accepted |= BIT(num_checked);
+		}
+
+		checked[num_checked++] = listener;
+	}
+
+	info->addr = NULL;
+
+	interested = interested || accepted || scan_dev_found_cb;
+	if (!interested) {
+		SCAN_STATS_INC(uninterested);
+	}
+
+#if defined(CONFIG_BT_SCAN_DUP_FILTER)
+skip:
+#endif /* CONFIG_BT_SCAN_DUP_FILTER */
+	if (!interested &&
+	    !(IS_ENABLED(CONFIG_BT_CENTRAL) && (info->adv_props & BT_HCI_LE_ADV_EVT_TYPE_CONN))) {
+		/* Nobody needs the identity address */
+		return;
+	}
+
 	if (bt_addr_le_is_resolved(addr)) {
 		bt_addr_le_copy_resolved(&id_addr, addr);
 	} else if (addr->type == BT_HCI_PEER_ADDR_ANONYMOUS) {
@@ -644,30 +875,53 @@ static void le_adv_recv(bt_addr_le_t *addr, struct bt_le_scan_recv_info *info,
 				bt_lookup_id_addr(BT_ID_DEFAULT, addr));
 	}
 
-	if (scan_dev_found_cb) {
-		net_buf_simple_save(buf, &state);
+	if (interested) {
+		SCAN_STATS_INC(delivered);
 
-		buf->len = len;
-		scan_dev_found_cb(&id_addr, info->rssi, info->adv_type, buf);
-
-		net_buf_simple_restore(buf, &state);
-	}
-
-	info->addr = &id_addr;
-
-	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&scan_cbs, listener, next, node) {
-		if (listener->recv) {
+		if (scan_dev_found_cb) {
 			net_buf_simple_save(buf, &state);
 
 			buf->len = len;
-			listener->recv(info, buf);
+			scan_dev_found_cb(&id_addr, info->rssi, info->adv_type, buf);
 
 			net_buf_simple_restore(buf, &state);
 		}
-	}
 
-	/* Clear pointer to this stack frame before returning to calling function */
-	info->addr = NULL;
+		SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&scan_cbs, listener, next, node) {
+			bool accept;
+			int i;
+
+			/* Callbacks may have changed the listeners since the
+			 * first pass, so its answers are found by listener.
+			 */
+			for (i = 0; i < num_checked; i++) {
+				if (checked[i] == listener) {
+					break;
+				}
+			}
+
+			if (i < num_checked) {
+				accept = accepted & BIT(i);
+			} else {
+				/* Past SCAN_ACCEPT_MAX, or registered by a callback */
+				info->addr = addr;
+				accept = listener_accepts(listener, info, buf, len);
+			}
+
+			if (accept) {
+				info->addr = &id_addr;
+				net_buf_simple_save(buf, &state);
+
+				buf->len = len;
+				listener->recv(info, buf);
+
+				net_buf_simple_restore(buf, &state);
+			}
+		}
+
+		/* Clear pointer to this stack frame before returning to calling function */
+		info->addr = NULL;
+	}
 
 #if defined(CONFIG_BT_CENTRAL)
 	check_pending_conn(&id_addr, addr, info->adv_props);
@@ -1766,6 +2020,10 @@ int bt_le_scan_start(const struct bt_le_scan_param *param, bt_le_scan_cb_t cb)
 	memcpy(&scan_state.explicit_scan_param, param,
 	       sizeof(scan_state.explicit_scan_param));
 
+#if defined(CONFIG_BT_SCAN_DUP_FILTER)
+	dup_filter_reset();
+#endif /* CONFIG_BT_SCAN_DUP_FILTER */
+
 	scan_dev_found_cb = cb;
 	err = bt_le_scan_user_add(BT_LE_SCAN_USER_EXPLICIT_SCAN);
 	k_mutex_unlock(&scan_state.scan_explicit_params_mutex);
@@ -1109,7 +1109,7 @@ static void smp_br_distribute_keys(struct bt_smp_br *smp)
 
 		info = net_buf_add(buf, sizeof(*info));
 
-		if (bt_rand(info->csrk, sizeof(info->csrk))) {
+		if (bt_rand_pr(info->csrk, sizeof(info->csrk))) {
 			LOG_ERR("Unable to get random bytes");
 			return;
 		}
@@ -2026,14 +2026,14 @@ static void legacy_distribute_keys(struct bt_smp *smp)
 		struct bt_smp_encrypt_info *info;
 		struct bt_smp_central_ident *ident;
 		struct net_buf *buf;
-		/* Use struct to get randomness in single call to bt_rand */
+		/* Use struct to get randomness in single call to bt_rand_pr */
 		struct {
 			uint8_t key[16];
 			uint8_t rand[8];
 			uint8_t ediv[2];
 		} rand;
 
-		if (bt_rand((void *)&rand, sizeof(rand))) {
+		if (bt_rand_pr((void *)&rand, sizeof(rand))) {
 			LOG_ERR("Unable to get random bytes");
 			return;
 		}
@@ -2146,7 +2146,7 @@ static uint8_t bt_smp_distribute_keys(struct bt_smp *smp)
 
 		info = net_buf_add(buf, sizeof(*info));
 
-		if (bt_rand(info->csrk, sizeof(info->csrk))) {
+		if (bt_rand_pr(info->csrk, sizeof(info->csrk))) {
 			return BT_SMP_ERR_UNSPECIFIED;
 		}
 
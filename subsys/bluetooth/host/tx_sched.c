@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2024 Xiaomi Corporation
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/check.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/bluetooth/tx_sched.h>
+
+#include "conn_internal.h"
+#include "tx_sched_internal.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bt_tx_sched, CONFIG_BT_CONN_LOG_LEVEL);
+
+/* Virtual time charged per byte at weight 1 */
+#define QOS_VTIME_SHIFT 8
+
+static const struct bt_tx_sched *sched = &bt_tx_sched_rr;
+
+static struct k_spinlock stats_lock;
+static struct bt_tx_sched_stats stats[CONFIG_BT_TX_SCHED_PRIO_COUNT];
+
+static inline uint32_t now_ticks(void)
+{
+	return (uint32_t)k_uptime_ticks();
+}
+
+static struct bt_tx_sched_entity *rr_select(struct bt_tx_sched_iter *it)
+{
+	return bt_tx_sched_iter_next(it);
+}
+
+const struct bt_tx_sched bt_tx_sched_rr = {
+	.select = rr_select,
+};
+
+static bool qos_late(const struct bt_tx_sched_entity *e, uint32_t now)
+{
+	return e->qos.latency_ms != 0U &&
+	       now - e->ready_since >= k_ms_to_ticks_ceil32(e->qos.latency_ms);
+}
+
+static bool qos_before(const struct bt_tx_sched_entity *a, bool a_late,
+		       const struct bt_tx_sched_entity *b, bool b_late)
+{
+	if (a->qos.prio != b->qos.prio) {
+		return a->qos.prio < b->qos.prio;
+	}
+
+	if (a_late != b_late) {
+		return a_late;
+	}
+
+	if (a_late) {
+		/* Earliest deadline first */
+		uint32_t a_deadline = a->ready_since + k_ms_to_ticks_ceil32(a->qos.latency_ms);
+		uint32_t b_deadline = b->ready_since + k_ms_to_ticks_ceil32(b->qos.latency_ms);
+
+		return (int32_t)(a_deadline - b_deadline) < 0;
+	}
+
+	/* Smallest virtual time first, ties go to the oldest ready entity */
+	return (int32_t)(a->vtime - b->vtime) < 0;
+}
+
+static struct bt_tx_sched_entity *qos_select(struct bt_tx_sched_iter *it)
+{
+	uint32_t vmin[CONFIG_BT_TX_SCHED_PRIO_COUNT] = { 0 };
+	bool backlogged[CONFIG_BT_TX_SCHED_PRIO_COUNT] = { false };
+	struct bt_tx_sched_iter first = *it;
+	struct bt_tx_sched_entity *best = NULL;
+	struct bt_tx_sched_entity *e;
+	uint32_t now = now_ticks();
+	bool best_late = false;
+
+	/* Entities that were idle start at the smallest virtual time of the
+	 * backlogged ones of their class, so they cannot claim the bandwidth
+	 * they did not use while idle.
+	 */
+	while ((e = bt_tx_sched_iter_next(it)) != NULL) {
+		uint8_t prio = e->qos.prio;
+
+		if (e->fresh) {
+			continue;
+		}
+
+		if (!backlogged[prio] || (int32_t)(e->vtime - vmin[prio]) < 0) {
+			vmin[prio] = e->vtime;
+			backlogged[prio] = true;
+		}
+	}
+
+	while ((e = bt_tx_sched_iter_next(&first)) != NULL) {
+		uint8_t prio = e->qos.prio;
+		bool late;
+
+		if (e->fresh) {
+			e->fresh = false;
+
+			if (backlogged[prio] && (int32_t)(vmin[prio] - e->vtime) > 0) {
+				e->vtime = vmin[prio];
+			}
+		}
+
+		late = qos_late(e, now);
+		if (best == NULL || qos_before(e, late, best, best_late)) {
+			best = e;
+			best_late = late;
+		}
+	}
+
+	return best;
+}
+
+static void qos_sent(struct bt_tx_sched_entity *entity, size_t len)
+{
+	entity->vtime += (uint32_t)(len << QOS_VTIME_SHIFT) / MAX(entity->qos.weight, 1U);
+}
+
+const struct bt_tx_sched bt_tx_sched_qos = {
+	.select = qos_select,
+	.sent = qos_sent,
+};
+
+void bt_tx_sched_set(const struct bt_tx_sched *tx_sched)
+{
+	sched = tx_sched != NULL ? tx_sched : &bt_tx_sched_rr;
+}
+
+void bt_tx_sched_ready(struct bt_tx_sched_entity *entity)
+{
+	entity->ready_since = now_ticks();
+	entity->fresh = true;
+}
+
+sys_snode_t *bt_tx_sched_pick(sys_slist_t *ready, ptrdiff_t offset)
+{
+	struct bt_tx_sched_iter it = {
+		.node = sys_slist_peek_head(ready),
+		.offset = offset,
+	};
+	struct bt_tx_sched_entity *entity;
+	sys_snode_t *node;
+
+	entity = sched->select(&it);
+	__ASSERT_NO_MSG(entity != NULL);
+
+	node = (sys_snode_t *)((uint8_t *)entity - offset);
+	if (node != sys_slist_peek_head(ready)) {
+		/* The TX paths only ever serve the head of the list */
+		sys_slist_find_and_remove(ready, node);
+		sys_slist_prepend(ready, node);
+	}
+
+	return node;
+}
+
+void bt_tx_sched_served(struct bt_tx_sched_entity *entity, size_t len)
+{
+	uint32_t now = now_ticks();
+	uint32_t wait_us = k_ticks_to_us_floor32(now - entity->ready_since);
+	struct bt_tx_sched_stats *s = &stats[entity->qos.prio];
+	k_spinlock_key_t key;
+
+	/* The next wait starts now */
+	entity->ready_since = now;
+
+	if (sched->sent != NULL) {
+		sched->sent(entity, len);
+	}
+
+	key = k_spin_lock(&stats_lock);
+	s->count++;
+	s->total_us += wait_us;
+	s->max_us = MAX(s->max_us, wait_us);
+	k_spin_unlock(&stats_lock, key);
+}
+
+static int qos_check(const struct bt_tx_qos *qos)
+{
+	CHECKIF(qos == NULL) {
+		return -EINVAL;
+	}
+
+	CHECKIF(qos->prio >= CONFIG_BT_TX_SCHED_PRIO_COUNT) {
+		LOG_DBG("invalid priority class %u", qos->prio);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int bt_tx_sched_conn_qos_set(struct bt_conn *conn, const struct bt_tx_qos *qos)
+{
+	int err;
+
+	CHECKIF(conn == NULL) {
+		return -EINVAL;
+	}
+
+	err = qos_check(qos);
+	if (err) {
+		return err;
+	}
+
+	conn->_tx_sched.qos = *qos;
+
+	return 0;
+}
+
+int bt_tx_sched_chan_qos_set(struct bt_l2cap_chan *chan, const struct bt_tx_qos *qos)
+{
+	int err;
+
+	CHECKIF(chan == NULL) {
+		return -EINVAL;
+	}
+
+	err = qos_check(qos);
+	if (err) {
+		return err;
+	}
+
+	BT_L2CAP_LE_CHAN(chan)->_tx_sched.qos = *qos;
+
+	return 0;
+}
+
+int bt_tx_sched_stats_get(uint8_t prio, struct bt_tx_sched_stats *out)
+{
+	k_spinlock_key_t key;
+
+	CHECKIF(prio >= CONFIG_BT_TX_SCHED_PRIO_COUNT || out == NULL) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&stats_lock);
+	*out = stats[prio];
+	k_spin_unlock(&stats_lock, key);
+
+	return 0;
+}
+
+void bt_tx_sched_stats_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	memset(stats, 0, sizeof(stats));
+	k_spin_unlock(&stats_lock, key);
+}
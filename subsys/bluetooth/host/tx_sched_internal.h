@@ -0,0 +1,30 @@
+/** @file
+ *  @brief Internal APIs for the Bluetooth TX scheduler.
+ */
+
+/*
+ * Copyright (c) 2024 Xiaomi Corporation
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stddef.h>
+
+#include <zephyr/bluetooth/tx_sched.h>
+#include <zephyr/sys/slist.h>
+
+/* Mark `entity` as having joined a ready list */
+void bt_tx_sched_ready(struct bt_tx_sched_entity *entity);
+
+/* Let the scheduler pick one of the nodes of the non-empty `ready` list and
+ * move it to the head of the list. `offset` goes from a list node to its
+ * entity. Returns the (new) head.
+ */
+sys_snode_t *bt_tx_sched_pick(sys_slist_t *ready, ptrdiff_t offset);
+
+/* Charge `len` bytes to `entity` and record how long it waited */
+void bt_tx_sched_served(struct bt_tx_sched_entity *entity, size_t len);
+
+/* Offset from the `node` member of `type` to its `entity` member */
+#define BT_TX_SCHED_OFFSET(type, node, entity)                                                     \
+	((ptrdiff_t)offsetof(type, entity) - (ptrdiff_t)offsetof(type, node))
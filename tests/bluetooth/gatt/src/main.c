@@ -8,12 +8,15 @@
 
 #include <zephyr/kernel.h>
 #include <stddef.h>
+#include <string.h>
 #include <zephyr/ztest.h>
 
 #include <zephyr/bluetooth/buf.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/gatt.h>
 
+#include "subsys/bluetooth/host/gatt_internal.h"
+
 /* Custom Service Variables */
 static const struct bt_uuid_128 test_uuid = BT_UUID_INIT_128(
 	0xf0, 0xde, 0xbc, 0x9a, 0x78, 0x56, 0x34, 0x12,
@@ -230,6 +233,299 @@ ZTEST(test_gatt, test_gatt_foreach)
 	}
 }
 
+#define BENCH_SVC_INDEXED CONFIG_BT_GATT_DYNAMIC_DB_INDEX_SIZE
+#define BENCH_SVC_COUNT   (BENCH_SVC_INDEXED + 8)
+#define BENCH_ROUNDS      16
+
+static const struct bt_gatt_attr bench_tmpl[] = {
+	BT_GATT_PRIMARY_SERVICE(&test_uuid),
+	BT_GATT_CHARACTERISTIC(&test_chrc_uuid.uuid, BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ, read_test, NULL, test_value),
+};
+
+static struct bt_gatt_attr bench_attrs[BENCH_SVC_COUNT][ARRAY_SIZE(bench_tmpl)];
+static struct bt_gatt_service bench_svcs[BENCH_SVC_COUNT];
+
+static uint8_t find_first_attr(const struct bt_gatt_attr *attr, uint16_t handle,
+			       void *user_data)
+{
+	const struct bt_gatt_attr **tmp = user_data;
+
+	*tmp = attr;
+
+	return BT_GATT_ITER_STOP;
+}
+
+/* Look every bench attribute up by handle, returns the cycles spent */
+static uint32_t bench_lookup(size_t svc_count)
+{
+	uint32_t start = k_cycle_get_32();
+
+	for (int round = 0; round < BENCH_ROUNDS; round++) {
+		for (size_t i = 0; i < svc_count; i++) {
+			for (size_t j = 0; j < ARRAY_SIZE(bench_tmpl); j++) {
+				const struct bt_gatt_attr *attr = NULL;
+				uint16_t handle = bench_attrs[i][j].handle;
+
+				bt_gatt_foreach_attr(handle, handle, find_first_attr, &attr);
+				zassert_equal_ptr(attr, &bench_attrs[i][j],
+						  "Wrong attribute for handle 0x%04x", handle);
+			}
+		}
+	}
+
+	return k_cycle_get_32() - start;
+}
+
+static void bench_register(size_t from, size_t to)
+{
+	for (size_t i = from; i < to; i++) {
+		memcpy(bench_attrs[i], bench_tmpl, sizeof(bench_tmpl));
+		bench_svcs[i] = (struct bt_gatt_service)BT_GATT_SERVICE(bench_attrs[i]);
+		zassert_false(bt_gatt_service_register(&bench_svcs[i]),
+			      "Bench service %zu registration failed", i);
+	}
+}
+
+ZTEST(test_gatt, test_gatt_lookup_bench)
+{
+	size_t lookups = BENCH_ROUNDS * ARRAY_SIZE(bench_tmpl);
+	bool test_registered, test1_registered;
+	uint32_t cycles;
+
+	/* Start from an empty dynamic database, restored at the end */
+	test_registered = !bt_gatt_service_unregister(&test_svc);
+	test1_registered = !bt_gatt_service_unregister(&test1_svc);
+
+	/* All services in the handle index */
+	bench_register(0, BENCH_SVC_INDEXED);
+	cycles = bench_lookup(BENCH_SVC_INDEXED);
+	TC_PRINT("indexed: %u services %u cycles/lookup\n", BENCH_SVC_INDEXED,
+		 (uint32_t)(cycles / (lookups * BENCH_SVC_INDEXED)));
+
+	/* One service too many, lookups walk the list */
+	bench_register(BENCH_SVC_INDEXED, BENCH_SVC_COUNT);
+	cycles = bench_lookup(BENCH_SVC_COUNT);
+	TC_PRINT("list: %u services %u cycles/lookup\n", BENCH_SVC_COUNT,
+		 (uint32_t)(cycles / (lookups * BENCH_SVC_COUNT)));
+
+	/* Remove a service from the middle, then enough to fit the index again */
+	zassert_false(bt_gatt_service_unregister(&bench_svcs[BENCH_SVC_INDEXED / 2]),
+		      "Bench service unregister failed");
+	for (size_t i = BENCH_SVC_INDEXED; i < BENCH_SVC_COUNT; i++) {
+		zassert_false(bt_gatt_service_unregister(&bench_svcs[i]),
+			      "Bench service %zu unregister failed", i);
+	}
+
+	zassert_false(bt_gatt_service_register(&bench_svcs[BENCH_SVC_INDEXED / 2]),
+		      "Bench service re-registration failed");
+	bench_lookup(BENCH_SVC_INDEXED);
+
+	for (size_t i = 0; i < BENCH_SVC_INDEXED; i++) {
+		zassert_false(bt_gatt_service_unregister(&bench_svcs[i]),
+			      "Bench service %zu unregister failed", i);
+	}
+
+	if (test_registered) {
+		zassert_false(bt_gatt_service_register(&test_svc),
+			      "Test service registration failed");
+	}
+
+	if (test1_registered) {
+		zassert_false(bt_gatt_service_register(&test1_svc),
+			      "Test service1 registration failed");
+	}
+}
+
+/* Services with gaps between their handles and before the next service */
+static struct bt_gatt_attr idx_pri_attrs[] = {
+	BT_GATT_PRIMARY_SERVICE(&test_uuid),
+	BT_GATT_CHARACTERISTIC(&test_chrc_uuid.uuid, BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ, read_test, NULL, test_value),
+};
+
+static struct bt_gatt_attr idx_sec_attrs[] = {
+	BT_GATT_SECONDARY_SERVICE(&test1_uuid),
+	BT_GATT_CHARACTERISTIC(&test_chrc_uuid.uuid, BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ, read_test, NULL, test_value),
+};
+
+static struct bt_gatt_attr idx_last_attrs[] = {
+	BT_GATT_PRIMARY_SERVICE(&test1_uuid),
+	BT_GATT_CHARACTERISTIC(&test1_nfy_uuid.uuid, BT_GATT_CHRC_READ,
+			       BT_GATT_PERM_READ, read_test, NULL, test_value),
+};
+
+static struct bt_gatt_service idx_svcs[] = {
+	BT_GATT_SERVICE(idx_pri_attrs),
+	BT_GATT_SERVICE(idx_sec_attrs),
+	BT_GATT_SERVICE(idx_last_attrs),
+};
+
+static const uint16_t idx_handles[ARRAY_SIZE(idx_svcs)][3] = {
+	{ 0x0200, 0x0204, 0x0205 },
+	{ 0x0208, 0x0209, 0x020c },
+	{ 0x0210, 0x0211, 0x0212 },
+};
+
+struct handle_list {
+	uint16_t handles[16];
+	size_t count;
+};
+
+static uint8_t collect_handle(const struct bt_gatt_attr *attr, uint16_t handle,
+			      void *user_data)
+{
+	struct handle_list *list = user_data;
+
+	zassert_true(list->count < ARRAY_SIZE(list->handles), "Too many attributes");
+	list->handles[list->count++] = handle;
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+/* Attributes of a type the way the ATT type requests visit them, checked
+ * against a walk over the whole database.
+ */
+static void check_uuid_range(uint16_t start, uint16_t end, const struct bt_uuid *uuid,
+			     const uint16_t *expect, size_t expect_count)
+{
+	struct handle_list indexed = {};
+	struct handle_list walked = {};
+	int err;
+
+	err = bt_gatt_foreach_attr_uuid(start, end, uuid, collect_handle, &indexed);
+	zassert_equal(err, 0, "Index not used for 0x%04x-0x%04x", start, end);
+
+	bt_gatt_foreach_attr_type(start, end, uuid, NULL, 0, collect_handle, &walked);
+
+	zassert_equal(indexed.count, walked.count, "Index and walk differ in count");
+	zassert_mem_equal(indexed.handles, walked.handles,
+			  indexed.count * sizeof(indexed.handles[0]), "Index and walk differ");
+
+	zassert_equal(indexed.count, expect_count, "Expected %zu attributes, got %zu",
+		      expect_count, indexed.count);
+	if (expect_count > 0) {
+		zassert_mem_equal(indexed.handles, expect, expect_count * sizeof(expect[0]),
+				  "Unexpected handles");
+	}
+}
+
+static void idx_register(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(idx_svcs); i++) {
+		for (size_t j = 0; j < idx_svcs[i].attr_count; j++) {
+			idx_svcs[i].attrs[j].handle = idx_handles[i][j];
+		}
+
+		zassert_false(bt_gatt_service_register(&idx_svcs[i]),
+			      "Index service %zu registration failed", i);
+	}
+}
+
+static void idx_unregister(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(idx_svcs); i++) {
+		zassert_false(bt_gatt_service_unregister(&idx_svcs[i]),
+			      "Index service %zu unregister failed", i);
+	}
+}
+
+ZTEST(test_gatt, test_gatt_uuid_index)
+{
+	static const uint16_t primaries[] = { 0x0200, 0x0210 };
+	static const uint16_t secondaries[] = { 0x0208 };
+	static const uint16_t chrcs[] = { 0x0204, 0x0209, 0x0211 };
+	static const uint16_t values[] = { 0x0205, 0x020c };
+	bool test_registered, test1_registered;
+
+	test_registered = !bt_gatt_service_unregister(&test_svc);
+	test1_registered = !bt_gatt_service_unregister(&test1_svc);
+
+	idx_register();
+
+	/* Read By Group Type and Find By Type Value visit service declarations */
+	check_uuid_range(0x0200, 0xffff, BT_UUID_GATT_PRIMARY, primaries, 2);
+	check_uuid_range(0x0201, 0xffff, BT_UUID_GATT_PRIMARY, &primaries[1], 1);
+	check_uuid_range(0x0200, 0x020f, BT_UUID_GATT_PRIMARY, primaries, 1);
+	check_uuid_range(0x0200, 0xffff, BT_UUID_GATT_SECONDARY, secondaries, 1);
+
+	/* Read By Type, 128-bit value types sort apart from the 16-bit ones */
+	check_uuid_range(0x0200, 0xffff, BT_UUID_GATT_CHRC, chrcs, 3);
+	check_uuid_range(0x0205, 0x0210, BT_UUID_GATT_CHRC, &chrcs[1], 1);
+	check_uuid_range(0x0200, 0xffff, &test_chrc_uuid.uuid, values, 2);
+	check_uuid_range(0x0213, 0xffff, BT_UUID_GATT_CHRC, NULL, 0);
+
+	/* A group ends at the last handle before the next service, across the
+	 * gaps, and at the last handle of the database for the last service.
+	 */
+	zassert_equal(bt_gatt_service_end_handle(0x0200, 0xffff), 0x0205, "Wrong group end");
+	zassert_equal(bt_gatt_service_end_handle(0x0208, 0xffff), 0x020c, "Wrong group end");
+	zassert_equal(bt_gatt_service_end_handle(0x0210, 0xffff), 0x0212, "Wrong group end");
+
+	/* Clipped to the last existing handle within the request */
+	zassert_equal(bt_gatt_service_end_handle(0x0200, 0x0204), 0x0204, "Wrong group end");
+	zassert_equal(bt_gatt_service_end_handle(0x0200, 0x0203), 0x0200, "Wrong group end");
+	zassert_equal(bt_gatt_service_end_handle(0x0208, 0x020b), 0x0209, "Wrong group end");
+
+	idx_unregister();
+
+	/* Removed services are gone from the index */
+	check_uuid_range(0x0200, 0xffff, BT_UUID_GATT_PRIMARY, NULL, 0);
+
+	if (test_registered) {
+		zassert_false(bt_gatt_service_register(&test_svc),
+			      "Test service registration failed");
+	}
+
+	if (test1_registered) {
+		zassert_false(bt_gatt_service_register(&test1_svc),
+			      "Test service1 registration failed");
+	}
+}
+
+ZTEST(test_gatt, test_gatt_uuid_index_full)
+{
+	/* Within the handle index, but more attributes than the UUID index holds */
+	size_t svc_count = MIN(CONFIG_BT_GATT_DYNAMIC_DB_INDEX_SIZE - ARRAY_SIZE(idx_svcs),
+			       CONFIG_BT_GATT_UUID_INDEX_SIZE / ARRAY_SIZE(bench_tmpl) + 1);
+	static const uint16_t primaries[] = { 0x0200, 0x0210 };
+	struct handle_list list = {};
+	int err;
+
+	zassert_true(svc_count * ARRAY_SIZE(bench_tmpl) > CONFIG_BT_GATT_UUID_INDEX_SIZE,
+		     "Handle index too small to overflow the UUID index");
+
+	bt_gatt_service_unregister(&test_svc);
+	bt_gatt_service_unregister(&test1_svc);
+
+	idx_register();
+	bench_register(0, svc_count);
+
+	err = bt_gatt_foreach_attr_uuid(0x0001, 0xffff, BT_UUID_GATT_PRIMARY,
+					collect_handle, &list);
+	zassert_equal(err, -ENOTSUP, "Index used while the database does not fit");
+	zassert_equal(list.count, 0, "Attributes visited without the index");
+
+	/* Unregistering one service is not enough to fit again */
+	zassert_false(bt_gatt_service_unregister(&bench_svcs[0]),
+		      "Bench service 0 unregister failed");
+	err = bt_gatt_foreach_attr_uuid(0x0001, 0xffff, BT_UUID_GATT_PRIMARY,
+					collect_handle, &list);
+	zassert_equal(err, -ENOTSUP, "Index used while the database does not fit");
+
+	for (size_t i = 1; i < svc_count; i++) {
+		zassert_false(bt_gatt_service_unregister(&bench_svcs[i]),
+			      "Bench service %zu unregister failed", i);
+	}
+
+	/* Rebuilt once everything fits again */
+	check_uuid_range(0x0200, 0x0212, BT_UUID_GATT_PRIMARY, primaries, 2);
+	zassert_equal(bt_gatt_service_end_handle(0x0200, 0xffff), 0x0205, "Wrong group end");
+
+	idx_unregister();
+}
+
 ZTEST(test_gatt, test_gatt_read)
 {
 	const struct bt_gatt_attr *attr;